@@ -0,0 +1,495 @@
+/**
+ @file
+ Red-Black Binary Search Tree - benchmark: throughput under contention
+
+ @details T threads run a mix of #rbtree_retrieveByKey, #rbtree_insert & #rbtree_deleteByKey against
+ one tree for a fixed time. Reads hit the keys the tree was filled with, writes alternate between inserting
+ & deleting the oldest key the thread inserted so the tree stays the same size.
+ Two trees are measured: a standard tree, which is not safe for readers & writers at once, behind a
+ pthread rwlock as a thread pool would use it, and a shared tree which serialises every call itself.
+ Reports aggregate throughput, fairness across threads (Jain's index, 1.0 is perfectly fair, & the
+ slowest thread's share of the fastest's ops) & latency percentiles for T from 1 to 2x the core count.
+ Each tree is run at every read/write mix given, as the percentage of calls that are reads.
+ usage: bench_contention [-r read%,read%,...] [seconds per run] [entries], mixes default to 95,50,0
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>         /* sysconf */
+#include <pthread.h>
+#include "rbtree.h"
+
+
+#define BENCH_CONTENTION_RING (1024U)           /* keys a thread has inserted & not yet deleted */
+#define BENCH_CONTENTION_SUB_BITS (3U)
+#define BENCH_CONTENTION_BUCKETS (64U << BENCH_CONTENTION_SUB_BITS)
+#define BENCH_CONTENTION_SHM_NAME "/rbtree_bench_contention"
+#define BENCH_CONTENTION_MIXES_MAX (16U)
+
+
+typedef struct _BENCH_CONTENTION_SHARED
+{
+    RBTREE_HANDLE handle;
+    bool isLocked;                      /* standard tree, calls go through lock */
+    pthread_rwlock_t lock;
+    pthread_mutex_t gateLock;           /* workers wait at the gate until every thread has started */
+    pthread_cond_t gate;
+    bool isOpen;
+    bool isAborted;                     /* a thread failed to start, the ones waiting leave without running */
+    uint32_t entries;
+    uint32_t readPercent;
+    double seconds;
+} BENCH_CONTENTION_SHARED;
+
+typedef struct _BENCH_CONTENTION_THREAD
+{
+    BENCH_CONTENTION_SHARED * shared;
+    pthread_t thread;
+    uint64_t random;                    /* xorshift state */
+    uint64_t ops;
+    uint64_t failures;
+    uint64_t maxNs;
+    uint64_t hist[BENCH_CONTENTION_BUCKETS];
+    RBTREE_KEY ring[BENCH_CONTENTION_RING];
+} BENCH_CONTENTION_THREAD;
+
+
+static uint64_t bench_contention_now ( void )
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ( (uint64_t)ts.tv_sec * 1000000000U ) + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t bench_contention_random ( BENCH_CONTENTION_THREAD * self )
+{
+    self->random ^= self->random << 13;
+    self->random ^= self->random >> 7;
+    self->random ^= self->random << 17;
+
+    return self->random;
+}
+
+/* log-linear, 2^SUB_BITS buckets per power of two */
+static uint32_t bench_contention_bucket ( uint64_t ns )
+{
+    uint32_t bucket = (uint32_t)ns;
+
+    if ( ns >= ( 1U << BENCH_CONTENTION_SUB_BITS ) )
+    {
+        uint32_t msb = 63U - (uint32_t)__builtin_clzll(ns);
+        uint32_t shift = msb - BENCH_CONTENTION_SUB_BITS;
+
+        bucket = ( ( shift + 1U ) << BENCH_CONTENTION_SUB_BITS ) + (uint32_t)( ( ns >> shift ) & ( ( 1U << BENCH_CONTENTION_SUB_BITS ) - 1U ) );
+    }
+
+    return bucket;
+}
+
+/* midpoint of the values that land in bucket */
+static uint64_t bench_contention_bucketNs ( uint32_t bucket )
+{
+    uint64_t ns = bucket;
+
+    if ( bucket >= ( 1U << BENCH_CONTENTION_SUB_BITS ) )
+    {
+        uint32_t shift = ( bucket >> BENCH_CONTENTION_SUB_BITS ) - 1U;
+        uint64_t low = (uint64_t)( ( 1U << BENCH_CONTENTION_SUB_BITS ) + ( bucket & ( ( 1U << BENCH_CONTENTION_SUB_BITS ) - 1U ) ) ) << shift;
+
+        ns = low + ( ( (uint64_t)1U << shift ) / 2U );
+    }
+
+    return ns;
+}
+
+static bool bench_contention_op ( BENCH_CONTENTION_THREAD * self, bool isRead, uint32_t * head, uint32_t * count, bool * isInsert )
+{
+    BENCH_CONTENTION_SHARED * shared = self->shared;
+    bool didPass = false;
+
+    if ( isRead )
+    {
+        void * value = NULL;
+        RBTREE_KEY key = (RBTREE_KEY)( bench_contention_random(self) % shared->entries ) + 1U;
+
+        if ( shared->isLocked )
+        {
+            pthread_rwlock_rdlock(&shared->lock);
+        }
+
+        didPass = (bool) ( rbtree_retrieveByKey(shared->handle, key, &value) == RBTREE_STATUS_OK );
+
+        if ( shared->isLocked )
+        {
+            pthread_rwlock_unlock(&shared->lock);
+        }
+    }
+    else
+    {
+        /* an empty ring has to insert & a full one delete, otherwise alternate */
+        bool doInsert = (bool) ( ( *count == 0U ) || ( ( *isInsert ) && ( *count < BENCH_CONTENTION_RING ) ) );
+        RBTREE_KEY key = RBTREE_KEY_INVALID;
+
+        if ( shared->isLocked )
+        {
+            pthread_rwlock_wrlock(&shared->lock);
+        }
+
+        if ( doInsert )
+        {
+            didPass = (bool) ( rbtree_insert(shared->handle, (void *)(uintptr_t)self->ops, &key) == RBTREE_STATUS_OK );
+        }
+        else
+        {
+            didPass = (bool) ( rbtree_deleteByKey(shared->handle, self->ring[*head]) == RBTREE_STATUS_OK );
+        }
+
+        if ( shared->isLocked )
+        {
+            pthread_rwlock_unlock(&shared->lock);
+        }
+
+        if ( ( doInsert ) && ( didPass ) )
+        {
+            self->ring[( *head + *count ) % BENCH_CONTENTION_RING] = key;
+            (*count)++;
+        }
+        else if ( doInsert == false )
+        {
+            *head = ( *head + 1U ) % BENCH_CONTENTION_RING;
+            (*count)--;
+        }
+
+        *isInsert = (bool) ( doInsert == false );
+    }
+
+    return didPass;
+}
+
+static void * bench_contention_worker ( void * context )
+{
+    BENCH_CONTENTION_THREAD * self = (BENCH_CONTENTION_THREAD *)context;
+    BENCH_CONTENTION_SHARED * shared = self->shared;
+    uint64_t deadline = 0U;
+    uint64_t start = 0U;
+    uint64_t end = 0U;
+    uint32_t head = 0U;
+    uint32_t count = 0U;
+    bool isInsert = true;
+    bool isAborted = false;
+
+    pthread_mutex_lock(&shared->gateLock);
+
+    while ( shared->isOpen == false )
+    {
+        pthread_cond_wait(&shared->gate, &shared->gateLock);
+    }
+
+    isAborted = shared->isAborted;
+    pthread_mutex_unlock(&shared->gateLock);
+
+    if ( isAborted )
+    {
+        return NULL;
+    }
+
+    start = bench_contention_now();
+    deadline = start + (uint64_t)( shared->seconds * 1e9 );
+
+    do
+    {
+        bool isRead = (bool) ( ( bench_contention_random(self) % 100U ) < shared->readPercent );
+
+        if ( bench_contention_op(self, isRead, &head, &count, &isInsert) == false )
+        {
+            self->failures++;
+        }
+
+        end = bench_contention_now();
+        self->hist[bench_contention_bucket(end - start)]++;
+        self->maxNs = ( end - start > self->maxNs ) ? end - start : self->maxNs;
+        self->ops++;
+        start = end;
+    } while ( end < deadline );
+
+    /* leave the tree the size it was */
+    while ( count > 0U )
+    {
+        isInsert = false;
+        bench_contention_op(self, false, &head, &count, &isInsert);
+    }
+
+    return NULL;
+}
+
+static RBTREE_HANDLE bench_contention_createTree ( bool isLocked, uint32_t entries, uint32_t threads )
+{
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    uint32_t i = 0U;
+
+    if ( isLocked )
+    {
+        status = rbtree_createTree(&handle, NULL, NULL);
+    }
+    else
+    {
+        (void)rbtree_unlinkSharedTree(BENCH_CONTENTION_SHM_NAME);
+        status = rbtree_createSharedTree(&handle, BENCH_CONTENTION_SHM_NAME, entries + ( threads * BENCH_CONTENTION_RING ), NULL, NULL);
+    }
+
+    for ( i=0U; ( i<entries ) && ( status == RBTREE_STATUS_OK ); i++ )
+    {
+        status = rbtree_insert(handle, (void *)(uintptr_t)i, &key);
+    }
+
+    if ( ( status != RBTREE_STATUS_OK ) && ( handle != RBTREE_HANDLE_INVALID ) )
+    {
+        rbtree_destroyTree(handle);
+        handle = RBTREE_HANDLE_INVALID;
+    }
+
+    return handle;
+}
+
+static bool bench_contention_run ( bool isLocked, uint32_t readPercent, uint32_t threadCount, uint32_t entries, double seconds )
+{
+    BENCH_CONTENTION_SHARED shared;
+    BENCH_CONTENTION_THREAD * threads = calloc(threadCount, sizeof(BENCH_CONTENTION_THREAD));
+    uint64_t hist[BENCH_CONTENTION_BUCKETS];
+    const double percentiles[] = { 0.5, 0.99, 0.999 };
+    uint64_t total = 0U;
+    uint64_t failures = 0U;
+    uint64_t maxNs = 0U;
+    uint64_t minOps = UINT64_MAX;
+    uint64_t maxOps = 0U;
+    double sumSquares = 0.0;
+    uint64_t seen = 0U;
+    uint32_t b = 0U;
+    uint32_t p = 0U;
+    uint32_t i = 0U;
+    uint32_t started = 0U;
+    uint64_t start = 0U;
+    double elapsed = 0.0;
+
+    memset(&shared, 0, sizeof(shared));
+    memset(hist, 0, sizeof(hist));
+
+    shared.handle = bench_contention_createTree(isLocked, entries, threadCount);
+    shared.isLocked = isLocked;
+    shared.entries = entries;
+    shared.readPercent = readPercent;
+    shared.seconds = seconds;
+
+    if ( ( threads == NULL ) || ( shared.handle == RBTREE_HANDLE_INVALID ) )
+    {
+        printf("%-8s | %3u/%-3u | %7u | create tree failed\n", ( isLocked ) ? "rwlock" : "shared", readPercent, 100U - readPercent, threadCount);
+
+        if ( shared.handle != RBTREE_HANDLE_INVALID )
+        {
+            rbtree_destroyTree(shared.handle);
+        }
+
+        free(threads);
+        return false;
+    }
+
+    pthread_rwlock_init(&shared.lock, NULL);
+    pthread_mutex_init(&shared.gateLock, NULL);
+    pthread_cond_init(&shared.gate, NULL);
+
+    for ( started=0U; started<threadCount; started++ )
+    {
+        threads[started].shared = &shared;
+        threads[started].random = 0x9E3779B97F4A7C15ULL * ( started + 1U );
+
+        if ( pthread_create(&threads[started].thread, NULL, bench_contention_worker, &threads[started]) != 0 )
+        {
+            break;
+        }
+    }
+
+    /* open the gate, or send the threads that did start home */
+    pthread_mutex_lock(&shared.gateLock);
+    shared.isOpen = true;
+    shared.isAborted = (bool) ( started < threadCount );
+    pthread_cond_broadcast(&shared.gate);
+    pthread_mutex_unlock(&shared.gateLock);
+
+    start = bench_contention_now();
+
+    for ( i=0U; i<started; i++ )
+    {
+        pthread_join(threads[i].thread, NULL);
+    }
+
+    elapsed = (double)( bench_contention_now() - start ) / 1e9;
+
+    for ( i=0U; ( i<threadCount ) && ( shared.isAborted == false ); i++ )
+    {
+        total += threads[i].ops;
+        failures += threads[i].failures;
+        maxNs = ( threads[i].maxNs > maxNs ) ? threads[i].maxNs : maxNs;
+        minOps = ( threads[i].ops < minOps ) ? threads[i].ops : minOps;
+        maxOps = ( threads[i].ops > maxOps ) ? threads[i].ops : maxOps;
+        sumSquares += (double)threads[i].ops * (double)threads[i].ops;
+
+        for ( b=0U; b<BENCH_CONTENTION_BUCKETS; b++ )
+        {
+            hist[b] += threads[i].hist[b];
+        }
+    }
+
+    if ( shared.isAborted )
+    {
+        printf("%-8s | %3u/%-3u | %7u | started %u of %u threads\n", ( isLocked ) ? "rwlock" : "shared", readPercent, 100U - readPercent, threadCount, started, threadCount);
+    }
+    else
+    {
+        printf("%-8s | %3u/%-3u | %7u | %8.3f | %5.3f | %7.3f ", ( isLocked ) ? "rwlock" : "shared", readPercent, 100U - readPercent, threadCount,
+               (double)total / elapsed / 1e6, ( (double)total * (double)total ) / ( (double)threadCount * sumSquares ), (double)minOps / (double)maxOps);
+
+        for ( b=0U; ( b<BENCH_CONTENTION_BUCKETS ) && ( p<sizeof(percentiles)/sizeof(percentiles[0]) ); b++ )
+        {
+            seen += hist[b];
+
+            while ( ( p<sizeof(percentiles)/sizeof(percentiles[0]) ) && ( (double)seen >= percentiles[p] * (double)total ) )
+            {
+                printf("| %9llu ", (unsigned long long)bench_contention_bucketNs(b));
+                p++;
+            }
+        }
+
+        printf("| %9llu", (unsigned long long)maxNs);
+
+        if ( failures )
+        {
+            printf("  (%llu failed)", (unsigned long long)failures);
+        }
+
+        printf("\n");
+    }
+
+    pthread_cond_destroy(&shared.gate);
+    pthread_mutex_destroy(&shared.gateLock);
+    pthread_rwlock_destroy(&shared.lock);
+    rbtree_destroyTree(shared.handle);
+
+    if ( isLocked == false )
+    {
+        (void)rbtree_unlinkSharedTree(BENCH_CONTENTION_SHM_NAME);
+    }
+
+    free(threads);
+
+    return (bool) ( ( failures == 0U ) && ( shared.isAborted == false ) );
+}
+
+
+/* comma separated read percentages, false on anything that isn't one */
+static bool bench_contention_parseMixes ( const char * list, uint32_t * reads, uint32_t * count )
+{
+    bool didPass = true;
+    const char * cursor = list;
+    char * end = NULL;
+    unsigned long value = 0U;
+
+    *count = 0U;
+
+    while ( ( didPass ) && ( *cursor != '\0' ) )
+    {
+        value = strtoul(cursor, &end, 10);
+
+        if ( ( end == cursor ) || ( value > 100U ) || ( *count >= BENCH_CONTENTION_MIXES_MAX ) || ( ( *end != ',' ) && ( *end != '\0' ) ) )
+        {
+            didPass = false;
+        }
+        else
+        {
+            reads[(*count)++] = (uint32_t)value;
+            cursor = ( *end == ',' ) ? end + 1 : end;
+        }
+    }
+
+    return (bool) ( ( didPass ) && ( *count > 0U ) );
+}
+
+
+int main ( int argc, const char * argv[] )
+{
+    double seconds = 1.0;
+    uint32_t entries = 100000U;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t maxThreads = ( cores > 0 ) ? 2U * (uint32_t)cores : 2U;
+    uint32_t reads[BENCH_CONTENTION_MIXES_MAX] = { 95U, 50U, 0U };
+    uint32_t readCount = 3U;
+    uint32_t positional = 0U;
+    const bool locked[] = { true, false };
+    bool didPass = true;
+    int a = 0;
+    uint32_t t = 0U;
+    uint32_t r = 0U;
+    uint32_t l = 0U;
+
+    for ( a=1; ( a<argc ) && ( didPass ); a++ )
+    {
+        if ( strcmp(argv[a], "-r") == 0 )
+        {
+            didPass = (bool) ( ( a + 1 < argc ) && ( bench_contention_parseMixes(argv[++a], reads, &readCount) ) );
+        }
+        else if ( positional == 0U )
+        {
+            seconds = strtod(argv[a], NULL);
+            positional++;
+        }
+        else if ( positional == 1U )
+        {
+            entries = (uint32_t)strtoul(argv[a], NULL, 10);
+            positional++;
+        }
+        else
+        {
+            didPass = false;
+        }
+    }
+
+    if ( didPass == false )
+    {
+        printf("usage: %s [-r read%%,read%%,...] [seconds per run] [entries]\n", argv[0]);
+        return 1;
+    }
+
+    printf("entries:%u cores:%ld seconds per run:%.2f (latency in ns)\n", entries, cores, seconds);
+    printf("tree     |  rd/wr  | threads |   Mops/s | jain  | min/max |       p50 |       p99 |     p99.9 |       max\n");
+
+    for ( l=0U; l<sizeof(locked)/sizeof(locked[0]); l++ )
+    {
+        for ( r=0U; r<readCount; r++ )
+        {
+            /* doubling up to, & always including, 2x cores */
+            for ( t=1U; t<=maxThreads; t = ( ( t * 2U > maxThreads ) && ( t < maxThreads ) ) ? maxThreads : t * 2U )
+            {
+                if ( bench_contention_run(locked[l], reads[r], t, entries, seconds) == false )
+                {
+                    didPass = false;
+                }
+            }
+        }
+    }
+
+    return ( didPass ) ? 0 : 1;
+}
@@ -0,0 +1,159 @@
+/**
+ @file
+ Red-Black Binary Search Tree - benchmark: time to first match
+
+ @details compares #rbtree_find against #rbtree_parallelFind for a predicate that first
+ matches at a given fraction of the way through the tree.
+ usage: bench_find [entries] [predicate cost]
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include "rbtree.h"
+
+
+#define BENCH_FIND_REPEATS (5U)
+
+
+typedef struct _BENCH_FIND_QUERY
+{
+    uintptr_t target;
+    uint32_t cost;      /* busy work per comparison, stands in for an expensive predicate */
+} BENCH_FIND_QUERY;
+
+
+static bool bench_find_match ( void * storevalue, void * userdata )
+{
+    BENCH_FIND_QUERY * query = (BENCH_FIND_QUERY *)userdata;
+    volatile uint32_t spin = 0U;
+    uint32_t i = 0U;
+
+    for ( i=0U; i<query->cost; i++ )
+    {
+        spin += i;
+    }
+
+    return (bool) ( (uintptr_t)storevalue == query->target );
+}
+
+static double bench_find_now ( void )
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ( (double)ts.tv_sec * 1e3 ) + ( (double)ts.tv_nsec / 1e6 );
+}
+
+/* best of BENCH_FIND_REPEATS in ms. threads==0 runs the serial rbtree_find */
+static double bench_find_time ( RBTREE_HANDLE handle, uint32_t threads, BENCH_FIND_QUERY * query )
+{
+    double best = -1.0;
+    uint32_t i = 0U;
+
+    for ( i=0U; i<BENCH_FIND_REPEATS; i++ )
+    {
+        void * value = NULL;
+        RBTREE_KEY key = RBTREE_KEY_INVALID;
+        double start = bench_find_now();
+        double elapsed = 0.0;
+
+        if ( threads == 0U )
+        {
+            rbtree_find(handle, bench_find_match, query, &value, &key);
+        }
+        else
+        {
+            rbtree_parallelFind(handle, threads, bench_find_match, query, &value, &key);
+        }
+
+        elapsed = bench_find_now() - start;
+
+        if ( ( best < 0.0 ) || ( elapsed < best ) )
+        {
+            best = elapsed;
+        }
+    }
+
+    return best;
+}
+
+
+int main ( int argc, const char * argv[] )
+{
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    uint32_t entries = ( argc > 1 ) ? (uint32_t)strtoul(argv[1], NULL, 10) : 1000000U;
+    uint32_t cost = ( argc > 2 ) ? (uint32_t)strtoul(argv[2], NULL, 10) : 0U;
+    const double positions[] = { 0.0, 0.01, 0.1, 0.25, 0.5, 0.75, 0.99, 2.0 };
+    const uint32_t threads[] = { 1U, 2U, 4U, 8U };
+    uint32_t i = 0U;
+    uint32_t t = 0U;
+
+    if ( rbtree_createTree(&handle, NULL, NULL) != RBTREE_STATUS_OK )
+    {
+        printf("create tree failed\n");
+        return 1;
+    }
+
+    /* values are inserted in key order, so value n is the n'th entry */
+    for ( i=0U; i<entries; i++ )
+    {
+        if ( rbtree_insert(handle, (void *)(uintptr_t)i, &key) != RBTREE_STATUS_OK )
+        {
+            printf("insert %u failed\n",i);
+            return 1;
+        }
+    }
+
+    printf("entries:%u predicate cost:%u (ms, best of %u)\n", entries, cost, BENCH_FIND_REPEATS);
+    printf("position |   serial ");
+
+    for ( t=0U; t<sizeof(threads)/sizeof(threads[0]); t++ )
+    {
+        printf("| par x%-3u ", threads[t]);
+    }
+
+    printf("\n");
+
+    for ( i=0U; i<sizeof(positions)/sizeof(positions[0]); i++ )
+    {
+        BENCH_FIND_QUERY query;
+
+        /* positions past the end never match, the full scan case */
+        query.target = (uintptr_t)( positions[i] * (double)entries );
+        query.cost = cost;
+
+        if ( positions[i] > 1.0 )
+        {
+            printf("    none ");
+        }
+        else
+        {
+            printf("  %5.1f%% ", positions[i] * 100.0);
+        }
+
+        printf("| %8.3f ", bench_find_time(handle, 0U, &query));
+
+        for ( t=0U; t<sizeof(threads)/sizeof(threads[0]); t++ )
+        {
+            printf("| %8.3f ", bench_find_time(handle, threads[t], &query));
+        }
+
+        printf("\n");
+    }
+
+    rbtree_destroyTree(handle);
+
+    return 0;
+}
@@ -0,0 +1,184 @@
+/**
+ @file
+ Red-Black Binary Search Tree - benchmark hardware counters
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#define _GNU_SOURCE         /* syscall */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "bench_perf.h"
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+
+const char * const bench_perf_names[BENCH_PERF_COUNTERS] =
+{
+    "cycles",
+    "instructions",
+    "l1d_misses",
+    "llc_misses",
+    "dtlb_misses",
+    "branch_misses",
+};
+
+
+#ifdef __linux__
+
+static int bench_perf_openCounter ( uint32_t type, uint64_t config )
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    /* user space only, allowed up to perf_event_paranoid 2 */
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+bool bench_perf_open ( BENCH_PERF * perf )
+{
+    const uint32_t types[BENCH_PERF_COUNTERS] =
+    {
+        PERF_TYPE_HARDWARE,
+        PERF_TYPE_HARDWARE,
+        PERF_TYPE_HW_CACHE,
+        PERF_TYPE_HARDWARE,
+        PERF_TYPE_HW_CACHE,
+        PERF_TYPE_HARDWARE,
+    };
+    const uint64_t configs[BENCH_PERF_COUNTERS] =
+    {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_L1D | ( PERF_COUNT_HW_CACHE_OP_READ << 8 ) | ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 ),
+        PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_CACHE_DTLB | ( PERF_COUNT_HW_CACHE_OP_READ << 8 ) | ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 ),
+        PERF_COUNT_HW_BRANCH_MISSES,
+    };
+    bool isOpen = false;
+    uint32_t i = 0U;
+
+    for ( i=0U; i<BENCH_PERF_COUNTERS; i++ )
+    {
+        perf->fds[i] = bench_perf_openCounter(types[i], configs[i]);
+        perf->errors[i] = ( perf->fds[i] < 0 ) ? errno : 0;
+        isOpen = (bool) ( ( isOpen ) || ( perf->fds[i] >= 0 ) );
+    }
+
+    return isOpen;
+}
+
+void bench_perf_start ( BENCH_PERF * perf )
+{
+    uint32_t i = 0U;
+
+    for ( i=0U; i<BENCH_PERF_COUNTERS; i++ )
+    {
+        if ( perf->fds[i] >= 0 )
+        {
+            ioctl(perf->fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(perf->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void bench_perf_stop ( BENCH_PERF * perf, BENCH_PERF_COUNTS * counts )
+{
+    uint32_t i = 0U;
+
+    for ( i=0U; i<BENCH_PERF_COUNTERS; i++ )
+    {
+        if ( perf->fds[i] >= 0 )
+        {
+            ioctl(perf->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+
+    for ( i=0U; i<BENCH_PERF_COUNTERS; i++ )
+    {
+        uint64_t values[3] = { 0U, 0U, 0U };    /* value, time enabled, time running */
+
+        counts->isValid[i] = (bool) ( ( perf->fds[i] >= 0 ) && ( read(perf->fds[i], values, sizeof(values)) == (ssize_t)sizeof(values) ) && ( values[2] > 0U ) );
+        counts->counts[i] = ( counts->isValid[i] ) ? (double)values[0] * ( (double)values[1] / (double)values[2] ) : 0.0;
+    }
+}
+
+void bench_perf_close ( BENCH_PERF * perf )
+{
+    uint32_t i = 0U;
+
+    for ( i=0U; i<BENCH_PERF_COUNTERS; i++ )
+    {
+        if ( perf->fds[i] >= 0 )
+        {
+            close(perf->fds[i]);
+            perf->fds[i] = -1;
+        }
+    }
+}
+
+#else
+
+bool bench_perf_open ( BENCH_PERF * perf )
+{
+    uint32_t i = 0U;
+
+    for ( i=0U; i<BENCH_PERF_COUNTERS; i++ )
+    {
+        perf->fds[i] = -1;
+        perf->errors[i] = ENOSYS;
+    }
+
+    return false;
+}
+
+void bench_perf_start ( BENCH_PERF * perf )
+{
+    (void)perf;
+}
+
+void bench_perf_stop ( BENCH_PERF * perf, BENCH_PERF_COUNTS * counts )
+{
+    (void)perf;
+    memset(counts, 0, sizeof(BENCH_PERF_COUNTS));
+}
+
+void bench_perf_close ( BENCH_PERF * perf )
+{
+    (void)perf;
+}
+
+#endif
+
+void bench_perf_printUnavailable ( const BENCH_PERF * perf, FILE * out )
+{
+    uint32_t i = 0U;
+
+    for ( i=0U; i<BENCH_PERF_COUNTERS; i++ )
+    {
+        if ( perf->fds[i] < 0 )
+        {
+            fprintf(out, "perf counter %s unavailable: %s\n", bench_perf_names[i], strerror(perf->errors[i]));
+        }
+    }
+}
@@ -0,0 +1,78 @@
+/**
+ @file
+ Red-Black Binary Search Tree - benchmark hardware counters
+
+ @details wraps perf_event_open so a benchmark can count cycles, instructions, cache, dTLB & branch
+ misses over a measured phase of its own process. Each counter is opened on its own so one the CPU or
+ kernel does not allow (paranoid setting, VM without a PMU, non Linux) is reported as unavailable while
+ the rest still count. User space only, the library never enters the kernel on its hot paths.
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#ifndef __BENCH_PERF_H
+#define __BENCH_PERF_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdbool.h>
+#include <stdio.h>
+
+
+typedef enum _BENCH_PERF_COUNTER
+{
+    BENCH_PERF_CYCLES = 0,
+    BENCH_PERF_INSTRUCTIONS,
+    BENCH_PERF_L1D_MISSES,
+    BENCH_PERF_LLC_MISSES,
+    BENCH_PERF_DTLB_MISSES,
+    BENCH_PERF_BRANCH_MISSES,
+    BENCH_PERF_COUNTERS,
+} BENCH_PERF_COUNTER;
+
+typedef struct _BENCH_PERF
+{
+    int fds[BENCH_PERF_COUNTERS];               /* -1 when the counter could not be opened */
+    int errors[BENCH_PERF_COUNTERS];            /* errno from the failed open */
+} BENCH_PERF;
+
+typedef struct _BENCH_PERF_COUNTS
+{
+    bool isValid[BENCH_PERF_COUNTERS];
+    double counts[BENCH_PERF_COUNTERS];         /* scaled up if the kernel multiplexed the counter */
+} BENCH_PERF_COUNTS;
+
+
+/* JSON friendly names, "cycles", "l1d_misses"... */
+extern const char * const bench_perf_names[BENCH_PERF_COUNTERS];
+
+
+/* open every counter that is allowed, returns true if at least one was */
+bool bench_perf_open ( BENCH_PERF * perf );
+
+/* print the counters that could not be opened & why */
+void bench_perf_printUnavailable ( const BENCH_PERF * perf, FILE * out );
+
+/* zero & start every open counter */
+void bench_perf_start ( BENCH_PERF * perf );
+
+/* stop every open counter & read it into counts */
+void bench_perf_stop ( BENCH_PERF * perf, BENCH_PERF_COUNTS * counts );
+
+void bench_perf_close ( BENCH_PERF * perf );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* __BENCH_PERF_H */
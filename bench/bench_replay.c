@@ -0,0 +1,188 @@
+/**
+ @file
+ Red-Black Binary Search Tree - benchmark: replay a recorded call trace
+
+ @details runs a trace written by #rbtree_startTrace against a new tree with #rbtree_replayTrace &
+ compares how long each kind of call took when it was recorded to how long it takes now, so a workload
+ captured from an application can be re-run after a change to the library.
+ With no trace file a mixed workload is recorded first & replayed, which is what bench_run.sh does.
+ usage: bench_replay [-t] [trace file]
+   -t replay interleaved, on one thread per recorded thread, instead of on this thread
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "rbtree.h"
+
+
+#define BENCH_REPLAY_ENTRIES (100000U)
+#define BENCH_REPLAY_OPS (1000000U)
+
+
+static const char * const bench_replay_names[RBTREE_TRACE_OP_LAST_VALUE] =
+{
+    "",
+    "insert",
+    "insertReserved",
+    "reserveKeys",
+    "retrieveByKey",
+    "retrieveByIndex",
+    "deleteByKey",
+    "deleteByIndex",
+    "deleteByValue",
+};
+
+
+/* fill a tree, then 60% lookups, 20% deletes & 20% inserts, some into reserved keys */
+static bool bench_replay_record ( int fd )
+{
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_KEY * keys = malloc(sizeof(RBTREE_KEY) * BENCH_REPLAY_ENTRIES);
+    uint64_t random = 88172645463325252ULL;
+    bool didPass = false;
+    uint32_t i = 0U;
+
+    if ( ( keys != NULL ) && ( rbtree_createTree(&handle, NULL, NULL) == RBTREE_STATUS_OK ) )
+    {
+        didPass = (bool) ( rbtree_startTrace(handle, fd) == RBTREE_STATUS_OK );
+
+        for ( i=0U; ( didPass ) && ( i<BENCH_REPLAY_ENTRIES ); i++ )
+        {
+            didPass = (bool) ( rbtree_insert(handle, (void *)(uintptr_t)( i + 1U ), &keys[i]) == RBTREE_STATUS_OK );
+        }
+
+        for ( i=0U; ( didPass ) && ( i<BENCH_REPLAY_OPS ); i++ )
+        {
+            uint32_t slot = 0U;
+            uint32_t pick = 0U;
+            void * value = NULL;
+
+            random ^= random << 13;
+            random ^= random >> 7;
+            random ^= random << 17;
+
+            slot = (uint32_t)( random % BENCH_REPLAY_ENTRIES );
+            pick = (uint32_t)( ( random >> 32 ) % 10U );
+
+            if ( pick < 6U )
+            {
+                rbtree_retrieveByKey(handle, keys[slot], &value);
+            }
+            else if ( pick < 8U )
+            {
+                rbtree_deleteByKey(handle, keys[slot]);
+            }
+            else if ( pick < 9U )
+            {
+                rbtree_insert(handle, (void *)(uintptr_t)( slot + 1U ), &keys[slot]);
+            }
+            else if ( rbtree_reserveKeys(handle, 1U, &keys[slot]) == RBTREE_STATUS_OK )
+            {
+                rbtree_insertReserved(handle, (void *)(uintptr_t)( slot + 1U ), keys[slot]);
+            }
+        }
+
+        if ( rbtree_stopTrace(handle) != RBTREE_STATUS_OK )
+        {
+            didPass = false;
+        }
+
+        rbtree_destroyTree(handle);
+    }
+
+    free(keys);
+
+    return didPass;
+}
+
+
+static void bench_replay_print ( const RBTREE_TRACE_REPORT * report, bool isInterleaved )
+{
+    uint32_t op = 0U;
+
+    printf("%s replay, records:%llu threads:%u mismatches:%llu\n",
+           ( isInterleaved ) ? "interleaved" : "single threaded",
+           (unsigned long long)report->records, report->threads, (unsigned long long)report->mismatches);
+    printf("call            |      calls | traced ns/call | replay ns/call\n");
+
+    for ( op=RBTREE_TRACE_OP_UNDEF+1U; op<RBTREE_TRACE_OP_LAST_VALUE; op++ )
+    {
+        if ( report->calls[op] )
+        {
+            printf("%-15s | %10llu | %14.1f | %14.1f\n", bench_replay_names[op], (unsigned long long)report->calls[op],
+                   (double)report->tracedCallNs[op] / (double)report->calls[op],
+                   (double)report->replayCallNs[op] / (double)report->calls[op]);
+        }
+    }
+
+    printf("total traced:%.3fms replayed:%.3fms\n", (double)report->tracedNs / 1e6, (double)report->replayNs / 1e6);
+}
+
+
+int main ( int argc, const char * argv[] )
+{
+    RBTREE_TRACE_REPORT report;
+    const char * path = NULL;
+    bool isInterleaved = false;
+    bool didPass = true;
+    int fd = -1;
+    int i = 0;
+
+    for ( i=1; i<argc; i++ )
+    {
+        if ( strcmp(argv[i], "-t") == 0 )
+        {
+            isInterleaved = true;
+        }
+        else
+        {
+            path = argv[i];
+        }
+    }
+
+    if ( path != NULL )
+    {
+        fd = open(path, O_RDONLY);
+    }
+    else
+    {
+        FILE * fp = tmpfile();
+
+        /* the FILE is left open for the life of the process, only its descriptor is used */
+        fd = ( fp != NULL ) ? fileno(fp) : -1;
+
+        if ( ( fd >= 0 ) && ( ( bench_replay_record(fd) == false ) || ( lseek(fd, 0, SEEK_SET) != 0 ) ) )
+        {
+            fd = -1;
+        }
+    }
+
+    if ( fd < 0 )
+    {
+        fprintf(stderr, "no trace to replay\n");
+        didPass = false;
+    }
+    else if ( rbtree_replayTrace(fd, isInterleaved, &report) != RBTREE_STATUS_OK )
+    {
+        fprintf(stderr, "replay failed\n");
+        didPass = false;
+    }
+    else
+    {
+        bench_replay_print(&report, isInterleaved);
+    }
+
+    return ( didPass ) ? 0 : 1;
+}
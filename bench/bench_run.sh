@@ -0,0 +1,10 @@
+gcc -std=c99 -O2 bench_find.c ../src/rbtree.c ../src/rbtree_checks.c ../src/rbtree_common.c ../src/rbtree_persist.c ../src/rbtree_mvcc.c ../src/rbtree_parallel.c ../src/rbtree_serial.c ../src/rbtree_image.c ../src/rbtree_wal.c ../src/rbtree_checkpoint.c ../src/rbtree_arena.c ../src/rbtree_stats.c ../src/rbtree_latency.c ../src/rbtree_lockprof.c ../src/rbtree_trace.c -I ../inc -I ../src -o rbtree_bench_find
+./rbtree_bench_find
+g++ -O2 -c bench_suite_map.cpp -I ../inc -o bench_suite_map.o
+g++ -std=c++11 -O2 -c bench_suite_rbmap.cpp -I ../inc -o bench_suite_rbmap.o
+gcc -std=c99 -O2 bench_suite.c bench_perf.c bench_suite_gen.c bench_suite_map.o bench_suite_rbmap.o ../src/rbtree.c ../src/rbtree_checks.c ../src/rbtree_common.c ../src/rbtree_persist.c ../src/rbtree_mvcc.c ../src/rbtree_parallel.c ../src/rbtree_serial.c ../src/rbtree_image.c ../src/rbtree_wal.c ../src/rbtree_checkpoint.c ../src/rbtree_arena.c ../src/rbtree_stats.c ../src/rbtree_latency.c ../src/rbtree_lockprof.c ../src/rbtree_trace.c -I ../inc -I ../src -lstdc++ -lpthread -o rbtree_bench_suite
+./rbtree_bench_suite -p
+gcc -std=c99 -O2 bench_contention.c ../src/rbtree.c ../src/rbtree_checks.c ../src/rbtree_common.c ../src/rbtree_persist.c ../src/rbtree_mvcc.c ../src/rbtree_parallel.c ../src/rbtree_serial.c ../src/rbtree_image.c ../src/rbtree_wal.c ../src/rbtree_checkpoint.c ../src/rbtree_arena.c ../src/rbtree_stats.c ../src/rbtree_latency.c ../src/rbtree_lockprof.c ../src/rbtree_trace.c -I ../inc -I ../src -lpthread -o rbtree_bench_contention
+./rbtree_bench_contention
+gcc -std=c99 -O2 bench_replay.c ../src/rbtree.c ../src/rbtree_checks.c ../src/rbtree_common.c ../src/rbtree_persist.c ../src/rbtree_mvcc.c ../src/rbtree_parallel.c ../src/rbtree_serial.c ../src/rbtree_image.c ../src/rbtree_wal.c ../src/rbtree_checkpoint.c ../src/rbtree_arena.c ../src/rbtree_stats.c ../src/rbtree_latency.c ../src/rbtree_lockprof.c ../src/rbtree_trace.c -I ../inc -I ../src -lpthread -o rbtree_bench_replay
+./rbtree_bench_replay
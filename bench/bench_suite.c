@@ -0,0 +1,623 @@
+/**
+ @file
+ Red-Black Binary Search Tree - benchmark suite
+
+ @details runs the same workload over rbtree & std::map for every size from 1e3 up to the maximum,
+ with keys visited in ascending (sequential) or shuffled (random) order, & prints JSON:
+ ops/sec, ns/op & the peak RSS of the process so far for each op. Every library, size & pattern
+ runs in its own child process so peak RSS is per run & a run that exhausts memory only loses its own
+ results, it is reported with an "error" instead. rbtree_inline is rbtree looking keys up with the
+ static inline functions of rbtree_inline.h instead of #rbtree_retrieveByKey, everything else is the same.
+ rbtree_value is a tree from #rbtree_createValueTree, copying each pointer into its node & back out.
+ rbtree_gen is a tree generated by rbtree_gen.h for uint32_t keys. rbtree::map is the C++ layer of rbtree.hpp.
+
+ The workload, in order: insert every key, lookup every key (hit), lookup every key + entries (miss),
+ retrieve by index, find by value, copy, delete the first half of the keys, delete by value, delete by
+ index & destroy what is left. Index & value operations are linear in both libraries, so they run only
+ as many times as keeps them under #BENCH_SUITE_SCAN_VISITS entries visited. rbtree_copyInTree
+ retrieves each entry by index, quadratic, so copy only runs up to #BENCH_SUITE_COPY_MAX entries.
+
+ With -p each record also carries hardware counters per op (cycles, instructions, L1D/LLC/dTLB & branch
+ misses) from perf_event_open, user space only. Counters the kernel does not allow are left out of the
+ records & listed on stderr, if none are allowed the suite reports time only.
+
+ usage: bench_suite [-p] [max entries]
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>         /* fork, pipe */
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>   /* getrusage */
+#include "rbtree.h"
+#include "rbtree_inline.h"
+#include "bench_suite.h"
+#include "bench_perf.h"
+
+
+#define BENCH_SUITE_MIN_ENTRIES (1000U)
+#define BENCH_SUITE_MAX_ENTRIES (100000000U)
+#define BENCH_SUITE_SCAN_VISITS (10000000U)
+#define BENCH_SUITE_COPY_MAX (10000U)
+#define BENCH_SUITE_SEED (0x9E3779B97F4A7C15ULL)
+#define BENCH_SUITE_LINE_MAX (1024U)
+
+
+typedef struct _BENCH_SUITE_RBTREE
+{
+    RBTREE_HANDLE handle;
+    RBTREE_INLINE_TREE inlineTree;
+    bool isReserved;
+} BENCH_SUITE_RBTREE;
+
+/* one child's run, what each record is labelled with */
+typedef struct _BENCH_SUITE_RUN
+{
+    const BENCH_SUITE_BACKEND * backend;
+    uint32_t entries;
+    bool isRandom;
+    FILE * out;
+    uint64_t random;        /* xorshift state */
+    BENCH_PERF * perf;      /* NULL unless -p */
+} BENCH_SUITE_RUN;
+
+
+static void * bench_suite_rbtreeCreateTree ( uint32_t entries, bool inOrder, size_t valueSize );
+static void * bench_suite_rbtreeCreate ( uint32_t entries, bool inOrder );
+static void bench_suite_rbtreeDestroy ( void * tree );
+static bool bench_suite_rbtreeInsert ( void * tree, uint32_t key, void * value );
+static bool bench_suite_rbtreeLookup ( void * tree, uint32_t key, void ** value );
+static bool bench_suite_rbtreeInlineLookup ( void * tree, uint32_t key, void ** value );
+static bool bench_suite_rbtreeAtIndex ( void * tree, uint32_t index, void ** value );
+static bool bench_suite_rbtreeMatch ( void * storevalue, void * userdata );
+static bool bench_suite_rbtreeFind ( void * tree, void * value );
+static void * bench_suite_rbtreeCopy ( void * tree );
+static bool bench_suite_rbtreeDeleteByKey ( void * tree, uint32_t key );
+static bool bench_suite_rbtreeDeleteByIndex ( void * tree, uint32_t index );
+static bool bench_suite_rbtreeDeleteByValue ( void * tree, void * value );
+static void * bench_suite_rbtreeValueCreate ( uint32_t entries, bool inOrder );
+static bool bench_suite_rbtreeValueInsert ( void * tree, uint32_t key, void * value );
+static bool bench_suite_rbtreeValueLookup ( void * tree, uint32_t key, void ** value );
+static bool bench_suite_rbtreeValueAtIndex ( void * tree, uint32_t index, void ** value );
+static bool bench_suite_rbtreeValueMatch ( void * storevalue, void * userdata );
+static bool bench_suite_rbtreeValueFind ( void * tree, void * value );
+static void * bench_suite_rbtreeValueCopy ( void * tree );
+static bool bench_suite_rbtreeValueDeleteByValue ( void * tree, void * value );
+static double bench_suite_now ( void );
+static double bench_suite_begin ( BENCH_SUITE_RUN * run );
+static uint64_t bench_suite_random ( BENCH_SUITE_RUN * run );
+static void bench_suite_record ( BENCH_SUITE_RUN * run, const char * op, uint32_t ops, double start );
+static bool bench_suite_run ( BENCH_SUITE_RUN * run );
+static void bench_suite_spawn ( const BENCH_SUITE_BACKEND * backend, uint32_t entries, bool isRandom, bool usePerf, uint32_t * records );
+
+
+static const BENCH_SUITE_BACKEND bench_suite_rbtreeBackend =
+{
+    "rbtree",
+    bench_suite_rbtreeCreate,
+    bench_suite_rbtreeDestroy,
+    bench_suite_rbtreeInsert,
+    bench_suite_rbtreeLookup,
+    bench_suite_rbtreeAtIndex,
+    bench_suite_rbtreeFind,
+    bench_suite_rbtreeCopy,
+    bench_suite_rbtreeDeleteByKey,
+    bench_suite_rbtreeDeleteByIndex,
+    bench_suite_rbtreeDeleteByValue,
+};
+
+static const BENCH_SUITE_BACKEND bench_suite_rbtreeInlineBackend =
+{
+    "rbtree_inline",
+    bench_suite_rbtreeCreate,
+    bench_suite_rbtreeDestroy,
+    bench_suite_rbtreeInsert,
+    bench_suite_rbtreeInlineLookup,
+    bench_suite_rbtreeAtIndex,
+    bench_suite_rbtreeFind,
+    bench_suite_rbtreeCopy,
+    bench_suite_rbtreeDeleteByKey,
+    bench_suite_rbtreeDeleteByIndex,
+    bench_suite_rbtreeDeleteByValue,
+};
+
+static const BENCH_SUITE_BACKEND bench_suite_rbtreeValueBackend =
+{
+    "rbtree_value",
+    bench_suite_rbtreeValueCreate,
+    bench_suite_rbtreeDestroy,
+    bench_suite_rbtreeValueInsert,
+    bench_suite_rbtreeValueLookup,
+    bench_suite_rbtreeValueAtIndex,
+    bench_suite_rbtreeValueFind,
+    bench_suite_rbtreeValueCopy,
+    bench_suite_rbtreeDeleteByKey,
+    bench_suite_rbtreeDeleteByIndex,
+    bench_suite_rbtreeValueDeleteByValue,
+};
+
+
+static void * bench_suite_rbtreeCreateTree ( uint32_t entries, bool inOrder, size_t valueSize )
+{
+    BENCH_SUITE_RBTREE * tree = malloc(sizeof(BENCH_SUITE_RBTREE));
+    RBTREE_KEY first = RBTREE_KEY_INVALID;
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+
+    if ( tree )
+    {
+        status = ( valueSize > 0U ) ? rbtree_createValueTree(&tree->handle, valueSize, NULL, NULL) : rbtree_createTree(&tree->handle, NULL, NULL);
+    }
+
+    if ( status == RBTREE_STATUS_OK )
+    {
+        (void)rbtree_getInlineTree(tree->handle, &tree->inlineTree);
+
+        /* keys in order are what rbtree_insert hands out anyway, any other order needs them reserved */
+        tree->isReserved = (bool) ( ( inOrder == false ) && ( rbtree_reserveKeys(tree->handle, entries, &first) == RBTREE_STATUS_OK ) );
+    }
+    else
+    {
+        free(tree);
+        tree = NULL;
+    }
+
+    return tree;
+}
+
+static void * bench_suite_rbtreeCreate ( uint32_t entries, bool inOrder )
+{
+    return bench_suite_rbtreeCreateTree(entries, inOrder, 0U);
+}
+
+static void bench_suite_rbtreeDestroy ( void * tree )
+{
+    (void)rbtree_destroyTree(((BENCH_SUITE_RBTREE *)tree)->handle);
+    free(tree);
+}
+
+static bool bench_suite_rbtreeInsert ( void * tree, uint32_t key, void * value )
+{
+    BENCH_SUITE_RBTREE * rbtree = (BENCH_SUITE_RBTREE *)tree;
+    RBTREE_KEY newKey = RBTREE_KEY_INVALID;
+    bool didInsert = false;
+
+    if ( rbtree->isReserved )
+    {
+        didInsert = (bool) ( rbtree_insertReserved(rbtree->handle, value, key) == RBTREE_STATUS_OK );
+    }
+    else
+    {
+        didInsert = (bool) ( ( rbtree_insert(rbtree->handle, value, &newKey) == RBTREE_STATUS_OK ) && ( newKey == key ) );
+    }
+
+    return didInsert;
+}
+
+static bool bench_suite_rbtreeLookup ( void * tree, uint32_t key, void ** value )
+{
+    return (bool) ( rbtree_retrieveByKey(((BENCH_SUITE_RBTREE *)tree)->handle, key, value) == RBTREE_STATUS_OK );
+}
+
+static bool bench_suite_rbtreeInlineLookup ( void * tree, uint32_t key, void ** value )
+{
+    return rbtree_inline_retrieveByKey(&((BENCH_SUITE_RBTREE *)tree)->inlineTree, key, value);
+}
+
+static bool bench_suite_rbtreeAtIndex ( void * tree, uint32_t index, void ** value )
+{
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+
+    return (bool) ( rbtree_retrieveByIndex(((BENCH_SUITE_RBTREE *)tree)->handle, index, value, &key) == RBTREE_STATUS_OK );
+}
+
+static bool bench_suite_rbtreeMatch ( void * storevalue, void * userdata )
+{
+    return (bool) ( storevalue == userdata );
+}
+
+static bool bench_suite_rbtreeFind ( void * tree, void * value )
+{
+    void * found = NULL;
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+
+    return (bool) ( rbtree_find(((BENCH_SUITE_RBTREE *)tree)->handle, bench_suite_rbtreeMatch, value, &found, &key) == RBTREE_STATUS_OK );
+}
+
+static void * bench_suite_rbtreeCopy ( void * tree )
+{
+    BENCH_SUITE_RBTREE * copy = bench_suite_rbtreeCreate(0U, true);
+
+    if ( ( copy ) && ( rbtree_copyInTree(copy->handle, ((BENCH_SUITE_RBTREE *)tree)->handle) != RBTREE_STATUS_OK ) )
+    {
+        bench_suite_rbtreeDestroy(copy);
+        copy = NULL;
+    }
+
+    return copy;
+}
+
+static bool bench_suite_rbtreeDeleteByKey ( void * tree, uint32_t key )
+{
+    return (bool) ( rbtree_deleteByKey(((BENCH_SUITE_RBTREE *)tree)->handle, key) == RBTREE_STATUS_OK );
+}
+
+static bool bench_suite_rbtreeDeleteByIndex ( void * tree, uint32_t index )
+{
+    return (bool) ( rbtree_deleteByIndex(((BENCH_SUITE_RBTREE *)tree)->handle, index) == RBTREE_STATUS_OK );
+}
+
+static bool bench_suite_rbtreeDeleteByValue ( void * tree, void * value )
+{
+    return (bool) ( rbtree_deleteByValue(((BENCH_SUITE_RBTREE *)tree)->handle, value) == RBTREE_STATUS_OK );
+}
+
+static void * bench_suite_rbtreeValueCreate ( uint32_t entries, bool inOrder )
+{
+    return bench_suite_rbtreeCreateTree(entries, inOrder, sizeof(void *));
+}
+
+static bool bench_suite_rbtreeValueInsert ( void * tree, uint32_t key, void * value )
+{
+    /* copied in, so the local's address will do */
+    return bench_suite_rbtreeInsert(tree, key, &value);
+}
+
+static bool bench_suite_rbtreeValueLookup ( void * tree, uint32_t key, void ** value )
+{
+    return (bool) ( rbtree_retrieveValue(((BENCH_SUITE_RBTREE *)tree)->handle, key, value) == RBTREE_STATUS_OK );
+}
+
+static bool bench_suite_rbtreeValueAtIndex ( void * tree, uint32_t index, void ** value )
+{
+    void * stored = NULL;
+    bool isFound = bench_suite_rbtreeAtIndex(tree, index, &stored);
+
+    if ( isFound )
+    {
+        *value = *(void **)stored;
+    }
+
+    return isFound;
+}
+
+static bool bench_suite_rbtreeValueMatch ( void * storevalue, void * userdata )
+{
+    return (bool) ( *(void **)storevalue == userdata );
+}
+
+static bool bench_suite_rbtreeValueFind ( void * tree, void * value )
+{
+    void * found = NULL;
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+
+    return (bool) ( rbtree_find(((BENCH_SUITE_RBTREE *)tree)->handle, bench_suite_rbtreeValueMatch, value, &found, &key) == RBTREE_STATUS_OK );
+}
+
+static void * bench_suite_rbtreeValueCopy ( void * tree )
+{
+    BENCH_SUITE_RBTREE * copy = bench_suite_rbtreeValueCreate(0U, true);
+
+    if ( ( copy ) && ( rbtree_copyInTree(copy->handle, ((BENCH_SUITE_RBTREE *)tree)->handle) != RBTREE_STATUS_OK ) )
+    {
+        bench_suite_rbtreeDestroy(copy);
+        copy = NULL;
+    }
+
+    return copy;
+}
+
+static bool bench_suite_rbtreeValueDeleteByValue ( void * tree, void * value )
+{
+    void * found = NULL;
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+
+    /* deleteByValue matches the pointer into the node, find it first */
+    return (bool) ( ( rbtree_find(((BENCH_SUITE_RBTREE *)tree)->handle, bench_suite_rbtreeValueMatch, value, &found, &key) == RBTREE_STATUS_OK )
+                 && ( rbtree_deleteByKey(((BENCH_SUITE_RBTREE *)tree)->handle, key) == RBTREE_STATUS_OK ) );
+}
+
+static double bench_suite_now ( void )
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double)ts.tv_sec + ( (double)ts.tv_nsec / 1e9 );
+}
+
+/* start of a measured phase */
+static double bench_suite_begin ( BENCH_SUITE_RUN * run )
+{
+    if ( run->perf )
+    {
+        bench_perf_start(run->perf);
+    }
+
+    return bench_suite_now();
+}
+
+static uint64_t bench_suite_random ( BENCH_SUITE_RUN * run )
+{
+    run->random ^= run->random << 13;
+    run->random ^= run->random >> 7;
+    run->random ^= run->random << 17;
+
+    return run->random;
+}
+
+/* end of the measured phase started by bench_suite_begin */
+static void bench_suite_record ( BENCH_SUITE_RUN * run, const char * op, uint32_t ops, double start )
+{
+    double seconds = bench_suite_now() - start;
+    BENCH_PERF_COUNTS counts;
+    struct rusage usage;
+    uint32_t i = 0U;
+
+    memset(&counts, 0, sizeof(counts));
+
+    if ( run->perf )
+    {
+        bench_perf_stop(run->perf, &counts);
+    }
+
+    (void)getrusage(RUSAGE_SELF, &usage);
+
+    /* one line per record, the parent joins them into the array */
+    fprintf(run->out, "{\"library\":\"%s\",\"op\":\"%s\",\"pattern\":\"%s\",\"entries\":%u,\"ops\":%u,\"ns_per_op\":%.1f,\"ops_per_sec\":%.0f,\"peak_rss_kb\":%ld",
+            run->backend->name, op, ( run->isRandom ) ? "random" : "sequential", run->entries, ops,
+            ( ops ) ? ( seconds * 1e9 ) / (double)ops : 0.0, ( seconds > 0.0 ) ? (double)ops / seconds : 0.0, (long)usage.ru_maxrss);
+
+    for ( i=0U; ( i<BENCH_PERF_COUNTERS ) && ( ops ); i++ )
+    {
+        if ( counts.isValid[i] )
+        {
+            fprintf(run->out, ",\"%s_per_op\":%.2f", bench_perf_names[i], counts.counts[i] / (double)ops);
+        }
+    }
+
+    fprintf(run->out, "}\n");
+    fflush(run->out);
+}
+
+static bool bench_suite_run ( BENCH_SUITE_RUN * run )
+{
+    const BENCH_SUITE_BACKEND * backend = run->backend;
+    uint32_t entries = run->entries;
+    uint32_t half = entries / 2U;
+    uint32_t scans = BENCH_SUITE_SCAN_VISITS / entries;
+    uint32_t * keys = malloc((size_t)entries * sizeof(uint32_t));
+    void * tree = NULL;
+    void * value = NULL;
+    bool didPass = true;
+    double start = 0.0;
+    uint32_t i = 0U;
+
+    /* leave at least half of the second half of the tree for destroy */
+    scans = ( scans == 0U ) ? 1U : ( ( scans > half / 4U ) ? half / 4U : scans );
+
+    if ( keys == NULL )
+    {
+        return false;
+    }
+
+    for ( i=0U; i<entries; i++ )
+    {
+        keys[i] = i + 1U;
+    }
+
+    for ( i=entries - 1U; ( run->isRandom ) && ( i > 0U ); i-- )
+    {
+        uint32_t j = (uint32_t)( bench_suite_random(run) % ( (uint64_t)i + 1U ) );
+        uint32_t key = keys[i];
+
+        keys[i] = keys[j];
+        keys[j] = key;
+    }
+
+    tree = backend->create(entries, ( run->isRandom == false ));
+    didPass = (bool) ( tree != NULL );
+
+    start = bench_suite_begin(run);
+    for ( i=0U; ( i<entries ) && didPass; i++ )
+    {
+        didPass = backend->insert(tree, keys[i], (void *)(uintptr_t)keys[i]);
+    }
+    bench_suite_record(run, "insert", entries, start);
+
+    start = bench_suite_begin(run);
+    for ( i=0U; ( i<entries ) && didPass; i++ )
+    {
+        didPass = backend->lookup(tree, keys[i], &value);
+    }
+    bench_suite_record(run, "lookup_hit", entries, start);
+
+    start = bench_suite_begin(run);
+    for ( i=0U; ( i<entries ) && didPass; i++ )
+    {
+        didPass = ( backend->lookup(tree, keys[i] + entries, &value) == false );
+    }
+    bench_suite_record(run, "lookup_miss", entries, start);
+
+    /* sequential walks the front of the tree, random anywhere in it */
+    start = bench_suite_begin(run);
+    for ( i=0U; ( i<scans ) && didPass; i++ )
+    {
+        didPass = backend->atIndex(tree, ( run->isRandom ) ? (uint32_t)( bench_suite_random(run) % entries ) : i, &value);
+    }
+    bench_suite_record(run, "retrieve_by_index", scans, start);
+
+    start = bench_suite_begin(run);
+    for ( i=0U; ( i<scans ) && didPass; i++ )
+    {
+        didPass = backend->find(tree, (void *)(uintptr_t)keys[i]);
+    }
+    bench_suite_record(run, "find", scans, start);
+
+    if ( ( entries <= BENCH_SUITE_COPY_MAX ) && ( didPass ) )
+    {
+        void * copy = NULL;
+
+        start = bench_suite_begin(run);
+        copy = backend->copy(tree);
+        bench_suite_record(run, "copy", entries, start);
+
+        didPass = (bool) ( copy != NULL );
+
+        if ( copy )
+        {
+            backend->destroy(copy);
+        }
+    }
+
+    start = bench_suite_begin(run);
+    for ( i=0U; ( i<half ) && didPass; i++ )
+    {
+        didPass = backend->deleteByKey(tree, keys[i]);
+    }
+    bench_suite_record(run, "delete_by_key", half, start);
+
+    start = bench_suite_begin(run);
+    for ( i=0U; ( i<scans ) && didPass; i++ )
+    {
+        didPass = backend->deleteByValue(tree, (void *)(uintptr_t)keys[half + i]);
+    }
+    bench_suite_record(run, "delete_by_value", scans, start);
+
+    /* entries - half - scans remain */
+    start = bench_suite_begin(run);
+    for ( i=0U; ( i<scans ) && didPass; i++ )
+    {
+        uint32_t remaining = entries - half - scans - i;
+
+        didPass = backend->deleteByIndex(tree, ( run->isRandom ) ? (uint32_t)( bench_suite_random(run) % remaining ) : 0U);
+    }
+    bench_suite_record(run, "delete_by_index", scans, start);
+
+    if ( tree )
+    {
+        start = bench_suite_begin(run);
+        backend->destroy(tree);
+        bench_suite_record(run, "destroy", entries - half - ( 2U * scans ), start);
+    }
+
+    free(keys);
+
+    return didPass;
+}
+
+static void bench_suite_spawn ( const BENCH_SUITE_BACKEND * backend, uint32_t entries, bool isRandom, bool usePerf, uint32_t * records )
+{
+    int fds[2];
+    pid_t child = -1;
+    int wstatus = 0;
+    char line[BENCH_SUITE_LINE_MAX];
+    FILE * in = NULL;
+
+    fflush(stdout);
+
+    if ( pipe(fds) != 0 )
+    {
+        return;
+    }
+
+    child = fork();
+
+    if ( child == 0 )
+    {
+        BENCH_SUITE_RUN run;
+        BENCH_PERF perf;
+
+        close(fds[0]);
+
+        run.backend = backend;
+        run.entries = entries;
+        run.isRandom = isRandom;
+        run.out = fdopen(fds[1], "w");
+        run.random = BENCH_SUITE_SEED;
+        /* counters follow this process only, so each child opens its own */
+        run.perf = ( ( usePerf ) && ( bench_perf_open(&perf) ) ) ? &perf : NULL;
+
+        _exit( ( ( run.out ) && ( bench_suite_run(&run) ) ) ? 0 : 1 );
+    }
+
+    close(fds[1]);
+
+    in = ( child > 0 ) ? fdopen(fds[0], "r") : NULL;
+
+    while ( ( in ) && ( fgets(line, sizeof(line), in) ) )
+    {
+        line[strcspn(line, "\n")] = '\0';
+        printf("%s    %s", ( *records ) ? ",\n" : "", line);
+        (*records)++;
+    }
+
+    if ( in )
+    {
+        fclose(in);
+    }
+    else
+    {
+        close(fds[0]);
+    }
+
+    if ( ( child < 0 ) || ( waitpid(child, &wstatus, 0) < 0 ) || ( WIFEXITED(wstatus) == 0 ) || ( WEXITSTATUS(wstatus) != 0 ) )
+    {
+        /* killed by the OOM killer, or an op failed part way */
+        printf("%s    {\"library\":\"%s\",\"pattern\":\"%s\",\"entries\":%u,\"error\":\"%s\"}",
+               ( *records ) ? ",\n" : "", backend->name, ( isRandom ) ? "random" : "sequential", entries,
+               ( ( child > 0 ) && ( WIFSIGNALED(wstatus) ) ) ? "killed" : "failed");
+        (*records)++;
+    }
+}
+
+
+int main ( int argc, const char * argv[] )
+{
+    bool usePerf = (bool) ( ( argc > 1 ) && ( strcmp(argv[1], "-p") == 0 ) );
+    int arg = ( usePerf ) ? 2 : 1;
+    uint32_t maxEntries = ( argc > arg ) ? (uint32_t)strtoul(argv[arg], NULL, 10) : BENCH_SUITE_MAX_ENTRIES;
+    const BENCH_SUITE_BACKEND * backends[] = { &bench_suite_rbtreeBackend, &bench_suite_rbtreeInlineBackend, &bench_suite_rbtreeValueBackend, &bench_suite_genBackend, &bench_suite_rbmapBackend, &bench_suite_mapBackend };
+    uint32_t records = 0U;
+    uint32_t b = 0U;
+
+    if ( usePerf )
+    {
+        BENCH_PERF perf;
+
+        usePerf = bench_perf_open(&perf);
+        bench_perf_printUnavailable(&perf, stderr);
+        bench_perf_close(&perf);
+
+        if ( usePerf == false )
+        {
+            fprintf(stderr, "no perf counters allowed (see /proc/sys/kernel/perf_event_paranoid), reporting time only\n");
+        }
+    }
+
+    printf("{\n  \"benchmark\": \"bench_suite\",\n  \"results\": [\n");
+
+    for ( uint64_t entries = BENCH_SUITE_MIN_ENTRIES; entries <= maxEntries; entries *= 10U )
+    {
+        for ( b=0U; b<sizeof(backends)/sizeof(backends[0]); b++ )
+        {
+            bench_suite_spawn(backends[b], (uint32_t)entries, false, usePerf, &records);
+            bench_suite_spawn(backends[b], (uint32_t)entries, true, usePerf, &records);
+        }
+    }
+
+    printf("\n  ]\n}\n");
+
+    return 0;
+}
@@ -0,0 +1,59 @@
+/**
+ @file
+ Red-Black Binary Search Tree - benchmark suite: the container under test
+
+ @details each library the suite measures fills in a #BENCH_SUITE_BACKEND. Keys are chosen by the
+ suite, 1..entries, & the value stored for a key is the key cast to a pointer.
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#ifndef __BENCH_SUITE_H
+#define __BENCH_SUITE_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+typedef struct _BENCH_SUITE_BACKEND
+{
+    const char * name;
+    void * (*create) ( uint32_t entries, bool inOrder );    /* inOrder: keys will be inserted 1..entries ascending */
+    void (*destroy) ( void * tree );
+    bool (*insert) ( void * tree, uint32_t key, void * value );
+    bool (*lookup) ( void * tree, uint32_t key, void ** value );
+    bool (*atIndex) ( void * tree, uint32_t index, void ** value );
+    bool (*find) ( void * tree, void * value );             /* linear search by value */
+    void * (*copy) ( void * tree );
+    bool (*deleteByKey) ( void * tree, uint32_t key );
+    bool (*deleteByIndex) ( void * tree, uint32_t index );
+    bool (*deleteByValue) ( void * tree, void * value );
+} BENCH_SUITE_BACKEND;
+
+
+/* bench_suite_map.cpp */
+extern const BENCH_SUITE_BACKEND bench_suite_mapBackend;
+
+/* bench_suite_rbmap.cpp */
+extern const BENCH_SUITE_BACKEND bench_suite_rbmapBackend;
+
+/* bench_suite_gen.c */
+extern const BENCH_SUITE_BACKEND bench_suite_genBackend;
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* __BENCH_SUITE_H */
@@ -0,0 +1,154 @@
+/**
+ @file
+ Red-Black Binary Search Tree - benchmark suite: rbtree_gen.h
+
+ @details a tree generated for the suite's uint32_t keys & pointer values, the comparison expanded in place.
+ Index & value operations walk first/next, there is no rank or clone, so copy inserts in key order.
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#include <stdlib.h>
+#include "rbtree_gen.h"
+#include "bench_suite.h"
+
+
+RBTREE_GENERATE(bench_suite_gen, uint32_t, void *, RBTREE_GEN_CMP_NUM)
+
+
+static bench_suite_gen_node * bench_suite_genAtIndex ( bench_suite_gen_tree * tree, uint32_t index )
+{
+    bench_suite_gen_node * node = ( index < bench_suite_gen_count(tree) ) ? bench_suite_gen_first(tree) : NULL;
+
+    while ( ( node != NULL ) && ( index-- > 0U ) )
+    {
+        node = bench_suite_gen_next(node);
+    }
+
+    return node;
+}
+
+static bench_suite_gen_node * bench_suite_genFindValue ( bench_suite_gen_tree * tree, void * value )
+{
+    bench_suite_gen_node * node = bench_suite_gen_first(tree);
+
+    while ( ( node != NULL ) && ( node->value != value ) )
+    {
+        node = bench_suite_gen_next(node);
+    }
+
+    return node;
+}
+
+static void * bench_suite_genCreate ( uint32_t entries, bool inOrder )
+{
+    bench_suite_gen_tree * tree = malloc(sizeof(bench_suite_gen_tree));
+
+    (void)entries;
+    (void)inOrder;
+
+    if ( tree )
+    {
+        bench_suite_gen_init(tree);
+    }
+
+    return tree;
+}
+
+static void bench_suite_genDestroy ( void * tree )
+{
+    bench_suite_gen_destroy((bench_suite_gen_tree *)tree);
+    free(tree);
+}
+
+static bool bench_suite_genInsert ( void * tree, uint32_t key, void * value )
+{
+    return (bool) ( bench_suite_gen_insert((bench_suite_gen_tree *)tree, key, value) == RBTREE_STATUS_OK );
+}
+
+static bool bench_suite_genLookup ( void * tree, uint32_t key, void ** value )
+{
+    void ** found = bench_suite_gen_retrieve((bench_suite_gen_tree *)tree, key);
+
+    if ( found )
+    {
+        *value = *found;
+    }
+
+    return (bool) ( found != NULL );
+}
+
+static bool bench_suite_genGetAtIndex ( void * tree, uint32_t index, void ** value )
+{
+    bench_suite_gen_node * node = bench_suite_genAtIndex((bench_suite_gen_tree *)tree, index);
+
+    if ( node )
+    {
+        *value = node->value;
+    }
+
+    return (bool) ( node != NULL );
+}
+
+static bool bench_suite_genFind ( void * tree, void * value )
+{
+    return (bool) ( bench_suite_genFindValue((bench_suite_gen_tree *)tree, value) != NULL );
+}
+
+static void * bench_suite_genCopy ( void * tree )
+{
+    bench_suite_gen_tree * copy = bench_suite_genCreate(0U, true);
+    bench_suite_gen_node * node = bench_suite_gen_first((bench_suite_gen_tree *)tree);
+
+    while ( ( copy != NULL ) && ( node != NULL ) )
+    {
+        if ( bench_suite_gen_insert(copy, node->key, node->value) != RBTREE_STATUS_OK )
+        {
+            bench_suite_genDestroy(copy);
+            copy = NULL;
+        }
+
+        node = bench_suite_gen_next(node);
+    }
+
+    return copy;
+}
+
+static bool bench_suite_genDeleteByKey ( void * tree, uint32_t key )
+{
+    return (bool) ( bench_suite_gen_delete((bench_suite_gen_tree *)tree, key, NULL) == RBTREE_STATUS_OK );
+}
+
+static bool bench_suite_genDeleteByIndex ( void * tree, uint32_t index )
+{
+    bench_suite_gen_node * node = bench_suite_genAtIndex((bench_suite_gen_tree *)tree, index);
+
+    return (bool) ( ( node != NULL ) && ( bench_suite_gen_delete((bench_suite_gen_tree *)tree, node->key, NULL) == RBTREE_STATUS_OK ) );
+}
+
+static bool bench_suite_genDeleteByValue ( void * tree, void * value )
+{
+    bench_suite_gen_node * node = bench_suite_genFindValue((bench_suite_gen_tree *)tree, value);
+
+    return (bool) ( ( node != NULL ) && ( bench_suite_gen_delete((bench_suite_gen_tree *)tree, node->key, NULL) == RBTREE_STATUS_OK ) );
+}
+
+
+const BENCH_SUITE_BACKEND bench_suite_genBackend =
+{
+    "rbtree_gen",
+    bench_suite_genCreate,
+    bench_suite_genDestroy,
+    bench_suite_genInsert,
+    bench_suite_genLookup,
+    bench_suite_genGetAtIndex,
+    bench_suite_genFind,
+    bench_suite_genCopy,
+    bench_suite_genDeleteByKey,
+    bench_suite_genDeleteByIndex,
+    bench_suite_genDeleteByValue,
+};
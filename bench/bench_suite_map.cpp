@@ -0,0 +1,133 @@
+/**
+ @file
+ Red-Black Binary Search Tree - benchmark suite: std::map baseline
+
+ @details std::map is a red-black tree in every mainstream standard library, so it is the
+ reference point for the suite. Index & value operations walk iterators as rbtree does.
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#include <map>
+#include <new>
+#include <iterator>
+#include <algorithm>
+#include "bench_suite.h"
+
+
+typedef std::map<uint32_t, void *> bench_suite_map_t;
+
+
+static bench_suite_map_t::iterator bench_suite_mapFindValue ( bench_suite_map_t * map, void * value )
+{
+    return std::find_if(map->begin(), map->end(), [value] ( const bench_suite_map_t::value_type & entry ) { return entry.second == value; });
+}
+
+static void * bench_suite_mapCreate ( uint32_t entries, bool inOrder )
+{
+    (void)entries;
+    (void)inOrder;
+
+    return new (std::nothrow) bench_suite_map_t();
+}
+
+static void bench_suite_mapDestroy ( void * tree )
+{
+    delete static_cast<bench_suite_map_t *>(tree);
+}
+
+static bool bench_suite_mapInsert ( void * tree, uint32_t key, void * value )
+{
+    return static_cast<bench_suite_map_t *>(tree)->emplace(key, value).second;
+}
+
+static bool bench_suite_mapLookup ( void * tree, uint32_t key, void ** value )
+{
+    bench_suite_map_t * map = static_cast<bench_suite_map_t *>(tree);
+    bench_suite_map_t::iterator it = map->find(key);
+    bool isFound = ( it != map->end() );
+
+    if ( isFound )
+    {
+        *value = it->second;
+    }
+
+    return isFound;
+}
+
+static bool bench_suite_mapAtIndex ( void * tree, uint32_t index, void ** value )
+{
+    bench_suite_map_t * map = static_cast<bench_suite_map_t *>(tree);
+    bool isFound = ( index < map->size() );
+
+    if ( isFound )
+    {
+        *value = std::next(map->begin(), index)->second;
+    }
+
+    return isFound;
+}
+
+static bool bench_suite_mapFind ( void * tree, void * value )
+{
+    bench_suite_map_t * map = static_cast<bench_suite_map_t *>(tree);
+
+    return ( bench_suite_mapFindValue(map, value) != map->end() );
+}
+
+static void * bench_suite_mapCopy ( void * tree )
+{
+    return new (std::nothrow) bench_suite_map_t(*static_cast<bench_suite_map_t *>(tree));
+}
+
+static bool bench_suite_mapDeleteByKey ( void * tree, uint32_t key )
+{
+    return ( static_cast<bench_suite_map_t *>(tree)->erase(key) == 1U );
+}
+
+static bool bench_suite_mapDeleteByIndex ( void * tree, uint32_t index )
+{
+    bench_suite_map_t * map = static_cast<bench_suite_map_t *>(tree);
+    bool isFound = ( index < map->size() );
+
+    if ( isFound )
+    {
+        map->erase(std::next(map->begin(), index));
+    }
+
+    return isFound;
+}
+
+static bool bench_suite_mapDeleteByValue ( void * tree, void * value )
+{
+    bench_suite_map_t * map = static_cast<bench_suite_map_t *>(tree);
+    bench_suite_map_t::iterator it = bench_suite_mapFindValue(map, value);
+    bool isFound = ( it != map->end() );
+
+    if ( isFound )
+    {
+        map->erase(it);
+    }
+
+    return isFound;
+}
+
+
+extern "C" const BENCH_SUITE_BACKEND bench_suite_mapBackend =
+{
+    "std::map",
+    bench_suite_mapCreate,
+    bench_suite_mapDestroy,
+    bench_suite_mapInsert,
+    bench_suite_mapLookup,
+    bench_suite_mapAtIndex,
+    bench_suite_mapFind,
+    bench_suite_mapCopy,
+    bench_suite_mapDeleteByKey,
+    bench_suite_mapDeleteByIndex,
+    bench_suite_mapDeleteByValue,
+};
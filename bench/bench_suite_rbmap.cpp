@@ -0,0 +1,133 @@
+/**
+ @file
+ Red-Black Binary Search Tree - benchmark suite: rbtree::map
+
+ @details the C++ layer over the same keys & values as the other libraries. Index & value operations walk
+ iterators as the std::map baseline does, the predicate inlined where rbtree calls rbtree_comparator_t per node.
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#include <new>
+#include <iterator>
+#include <algorithm>
+#include "rbtree.hpp"
+#include "bench_suite.h"
+
+
+typedef rbtree::map<uint32_t, void *> bench_suite_rbmap_t;
+
+
+static bench_suite_rbmap_t::iterator bench_suite_rbmapFindValue ( bench_suite_rbmap_t * map, void * value )
+{
+    return std::find_if(map->begin(), map->end(), [value] ( const bench_suite_rbmap_t::value_type & entry ) { return entry.second == value; });
+}
+
+static void * bench_suite_rbmapCreate ( uint32_t entries, bool inOrder )
+{
+    (void)entries;
+    (void)inOrder;
+
+    return new (std::nothrow) bench_suite_rbmap_t();
+}
+
+static void bench_suite_rbmapDestroy ( void * tree )
+{
+    delete static_cast<bench_suite_rbmap_t *>(tree);
+}
+
+static bool bench_suite_rbmapInsert ( void * tree, uint32_t key, void * value )
+{
+    return static_cast<bench_suite_rbmap_t *>(tree)->try_emplace(key, value).second;
+}
+
+static bool bench_suite_rbmapLookup ( void * tree, uint32_t key, void ** value )
+{
+    bench_suite_rbmap_t * map = static_cast<bench_suite_rbmap_t *>(tree);
+    bench_suite_rbmap_t::iterator it = map->find(key);
+    bool isFound = ( it != map->end() );
+
+    if ( isFound )
+    {
+        *value = it->second;
+    }
+
+    return isFound;
+}
+
+static bool bench_suite_rbmapAtIndex ( void * tree, uint32_t index, void ** value )
+{
+    bench_suite_rbmap_t * map = static_cast<bench_suite_rbmap_t *>(tree);
+    bool isFound = ( index < map->size() );
+
+    if ( isFound )
+    {
+        *value = std::next(map->begin(), index)->second;
+    }
+
+    return isFound;
+}
+
+static bool bench_suite_rbmapFind ( void * tree, void * value )
+{
+    bench_suite_rbmap_t * map = static_cast<bench_suite_rbmap_t *>(tree);
+
+    return ( bench_suite_rbmapFindValue(map, value) != map->end() );
+}
+
+static void * bench_suite_rbmapCopy ( void * tree )
+{
+    return new (std::nothrow) bench_suite_rbmap_t(*static_cast<bench_suite_rbmap_t *>(tree));
+}
+
+static bool bench_suite_rbmapDeleteByKey ( void * tree, uint32_t key )
+{
+    return ( static_cast<bench_suite_rbmap_t *>(tree)->erase(key) == 1U );
+}
+
+static bool bench_suite_rbmapDeleteByIndex ( void * tree, uint32_t index )
+{
+    bench_suite_rbmap_t * map = static_cast<bench_suite_rbmap_t *>(tree);
+    bool isFound = ( index < map->size() );
+
+    if ( isFound )
+    {
+        map->erase(std::next(map->begin(), index));
+    }
+
+    return isFound;
+}
+
+static bool bench_suite_rbmapDeleteByValue ( void * tree, void * value )
+{
+    bench_suite_rbmap_t * map = static_cast<bench_suite_rbmap_t *>(tree);
+    bench_suite_rbmap_t::iterator it = bench_suite_rbmapFindValue(map, value);
+    bool isFound = ( it != map->end() );
+
+    if ( isFound )
+    {
+        map->erase(it);
+    }
+
+    return isFound;
+}
+
+
+extern "C" const BENCH_SUITE_BACKEND bench_suite_rbmapBackend =
+{
+    "rbtree::map",
+    bench_suite_rbmapCreate,
+    bench_suite_rbmapDestroy,
+    bench_suite_rbmapInsert,
+    bench_suite_rbmapLookup,
+    bench_suite_rbmapAtIndex,
+    bench_suite_rbmapFind,
+    bench_suite_rbmapCopy,
+    bench_suite_rbmapDeleteByKey,
+    bench_suite_rbmapDeleteByIndex,
+    bench_suite_rbmapDeleteByValue,
+};
@@ -1,2 +1,2 @@
-gcc -std=c99 example_main.c ../src/rbtree.c ../src/rbtree_checks.c ../src/rbtree_common.c -I ../inc -I ../src -o rbtree_example
+gcc -std=c99 example_main.c ../src/rbtree.c ../src/rbtree_checks.c ../src/rbtree_common.c ../src/rbtree_persist.c ../src/rbtree_mvcc.c ../src/rbtree_parallel.c ../src/rbtree_serial.c ../src/rbtree_image.c ../src/rbtree_wal.c ../src/rbtree_checkpoint.c ../src/rbtree_arena.c ../src/rbtree_stats.c ../src/rbtree_latency.c ../src/rbtree_lockprof.c ../src/rbtree_trace.c -I ../inc -I ../src -o rbtree_example
 ./rbtree_example
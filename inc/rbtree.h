@@ -34,6 +34,11 @@ extern "C" {
  RBTREE_STATUS_FAIL_KEY_DOES_NOT_EXIST api call failed - cannot find key in tree \n
  RBTREE_STATUS_FAIL_KEY_ALREADY_STORED api call failed - cannot store duplicate key \n
  RBTREE_STATUS_FAIL_INDEX_OUT_OF_RANGE api call failed - index of item is outside of range of tree (i>tree_size) \n
+ RBTREE_STATUS_FAIL_READ_ONLY api call failed - tree handle is a read-only view (eg #rbtree_snapshot) \n
+ RBTREE_STATUS_FAIL_NOT_SUPPORTED api call failed - not available for this kind of tree \n
+ RBTREE_STATUS_FAIL_VERSION_NOT_RETAINED api call failed - version is older than the retention horizon \n
+ RBTREE_STATUS_FAIL_IO api call failed - read or write on a file descriptor failed \n
+ RBTREE_STATUS_FAIL_CORRUPT_DATA api call failed - stream or file is truncated or not in the expected format, or a check (RBT_CHECK_LEVEL) found the tree broken \n
  */
 typedef enum _RBTREE_STATUS
 {
@@ -46,6 +51,11 @@ typedef enum _RBTREE_STATUS
     RBTREE_STATUS_FAIL_KEY_DOES_NOT_EXIST,
     RBTREE_STATUS_FAIL_KEY_ALREADY_STORED,
     RBTREE_STATUS_FAIL_INDEX_OUT_OF_RANGE,
+    RBTREE_STATUS_FAIL_READ_ONLY,
+    RBTREE_STATUS_FAIL_NOT_SUPPORTED,
+    RBTREE_STATUS_FAIL_VERSION_NOT_RETAINED,
+    RBTREE_STATUS_FAIL_IO,
+    RBTREE_STATUS_FAIL_CORRUPT_DATA,
     RBTREE_STATUS_LAST_VALUE
 } RBTREE_STATUS;
 
@@ -67,6 +77,104 @@ typedef uint32_t RBTREE_KEY;
 typedef bool (*rbtree_comparator_t)(void* storevalue, void* userdata);
 
 
+/**
+ @brief type definition for visitor
+ @param storevalue value stored in tree
+ @param key key of value
+ @param userdata user data passed in to api call
+ */
+typedef void (*rbtree_visitor_t)(void* storevalue, RBTREE_KEY key, void* userdata);
+
+
+/**
+ @brief type definition for accumulator
+ @param accumulator result so far, starts as the initial value passed in to api call
+ @param storevalue value stored in tree
+ @param key key of value
+ @param userdata user data passed in to api call
+ @return must return the new result
+ */
+typedef void* (*rbtree_accumulator_t)(void* accumulator, void* storevalue, RBTREE_KEY key, void* userdata);
+
+
+/**
+ @brief type definition for combiner
+ @details must be associative. lhs always covers lower keys than rhs
+ @param lhs result of the lower range of keys
+ @param rhs result of the upper range of keys
+ @param userdata user data passed in to api call
+ @return must return the combined result
+ */
+typedef void* (*rbtree_combiner_t)(void* lhs, void* rhs, void* userdata);
+
+
+/**
+ @brief type definition for completion of a background operation
+ @param status result of the operation
+ @param userdata user data passed in to api call
+ */
+typedef void (*rbtree_completion_t)(RBTREE_STATUS status, void* userdata);
+
+
+/**
+ @brief largest encoded value #rbtree_saveToFd & #rbtree_loadFromFd handle
+ */
+#define RBTREE_ENCODED_VALUE_MAX (65536U)
+
+
+/**
+ @brief largest value #rbtree_createValueTree stores in a node, 4 cache lines
+ */
+#define RBTREE_VALUE_SIZE_MAX (256U)
+
+
+/**
+ @brief deepest path a walk of any tree may need. A red-black tree of 2^32 nodes is at most 64 deep,
+ the rest is room for rotations during fix-up. Anything deeper is a broken tree
+ */
+#define RBTREE_DEPTH_MAX (72U)
+
+
+/**
+ @brief when a logged change is on disk, see #rbtree_attachLog
+ @details
+ RBTREE_LOG_SYNC_NONE changes are written as the log buffer fills or on #rbtree_syncLog. Cheapest, a crash loses the buffer \n
+ RBTREE_LOG_SYNC_WRITE a change is written to the OS before its call returns. Survives the process crashing \n
+ RBTREE_LOG_SYNC_FSYNC a change is written & fdatasync'd before its call returns. Survives power loss \n
+ Concurrent changes under WRITE & FSYNC share a single write & sync (group commit)
+ */
+typedef enum _RBTREE_LOG_SYNC
+{
+    RBTREE_LOG_SYNC_UNDEF = 0,
+    RBTREE_LOG_SYNC_NONE,
+    RBTREE_LOG_SYNC_WRITE,
+    RBTREE_LOG_SYNC_FSYNC,
+    RBTREE_LOG_SYNC_LAST_VALUE
+} RBTREE_LOG_SYNC;
+
+
+/**
+ @brief type definition for value encoder
+ @param storevalue value stored in tree
+ @param buffer where to write the encoded value
+ @param length in: size of buffer (#RBTREE_ENCODED_VALUE_MAX) out: number of bytes written
+ @param userdata user data passed in to api call
+ @return must return #TRUE on success
+ */
+typedef bool (*rbtree_encoder_t)(void* storevalue, void* buffer, uint32_t* length, void* userdata);
+
+
+/**
+ @brief type definition for value decoder
+ @param buffer encoded value
+ @param length number of bytes in buffer
+ @param storevalue decoded value to store in tree
+ @param userdata user data passed in to api call
+ @return must return #TRUE on success
+ */
+typedef bool (*rbtree_decoder_t)(const void* buffer, uint32_t length, void** storevalue, void* userdata);
+
+
 /**
  @brief type definition for memory allocator
  @details form must take same as 'malloc'
@@ -94,6 +202,89 @@ typedef void (*rbtree_memfree_t)(void* memptr);
 RBTREE_STATUS rbtree_createTree ( RBTREE_HANDLE * handle, rbtree_memalloc_t mem_alloc, rbtree_memfree_t mem_free );
 
 
+/**
+ @brief create new persistent tree
+ @details inserts & deletes copy the path from the modified node to the root whenever a
+ snapshot still shares it, so #rbtree_snapshot is O(1). Without snapshots nodes are updated in place.
+ @param[out] handle returned tree handle
+ @param[in] mem_alloc function pointer to allocate memory pool (optional)
+ @param[in] mem_free function pointer to free from memory pool (optional, must be thread safe if snapshots are destroyed on other threads)
+ @return returns RBTREE_STATUS_OK on success
+ */
+RBTREE_STATUS rbtree_createPersistentTree ( RBTREE_HANDLE * handle, rbtree_memalloc_t mem_alloc, rbtree_memfree_t mem_free );
+
+
+/**
+ @brief create new tree that stores fixed size values inside its nodes
+ @details values are copied in by #rbtree_insert & #rbtree_insertReserved, storevalue points at valueSize bytes.
+ Every call that hands back a value (#rbtree_retrieveByKey, #rbtree_find, visitors...) hands back a pointer
+ to it in the node, valid until its entry is removed, so a lookup is one allocation & one miss rather than
+ two. #rbtree_retrieveValue copies it out. #rbtree_deleteByValue & #rbtree_doesValueExist take that pointer.
+ Values are aligned for any scalar type. Files can't hold them: #rbtree_saveToFd, #rbtree_loadFromFd,
+ #rbtree_attachLog, #rbtree_replayLog, #rbtree_checkpointAsync & #rbtree_exportImage return
+ #RBTREE_STATUS_FAIL_NOT_SUPPORTED, encoders & decoders pass values by pointer that a node can't own
+ @param[out] handle returned tree handle
+ @param[in] valueSize bytes in each value, 1..#RBTREE_VALUE_SIZE_MAX
+ @param[in] mem_alloc function pointer to allocate memory pool (optional)
+ @param[in] mem_free function pointer to free from memory pool (optional)
+ @return returns RBTREE_STATUS_OK on success
+ */
+RBTREE_STATUS rbtree_createValueTree ( RBTREE_HANDLE * handle, size_t valueSize, rbtree_memalloc_t mem_alloc, rbtree_memfree_t mem_free );
+
+
+/**
+ @brief take an immutable snapshot of a persistent tree
+ @details O(1). The snapshot shares all nodes with handle and is unaffected by later changes to it.
+ It can be read from any thread without blocking writers. Modifying calls return #RBTREE_STATUS_FAIL_READ_ONLY.
+ Release with #rbtree_destroyTree, nodes are reclaimed once no tree or snapshot references them
+ @param[in] handle tree handle created by #rbtree_createPersistentTree (or another snapshot)
+ @param[out] snapshot returned read-only tree handle
+ @return returns #RBTREE_STATUS_OK on success, #RBTREE_STATUS_FAIL_NOT_SUPPORTED if handle is not persistent
+ */
+RBTREE_STATUS rbtree_snapshot ( RBTREE_HANDLE handle, RBTREE_HANDLE * snapshot );
+
+
+/**
+ @brief set how many superseded versions of a persistent tree stay readable through #rbtree_beginRead
+ @details every successful insert/delete stamps a new version. While versions are retained writers path-copy
+ instead of updating in place. Versions beyond the horizon are freed by a background collector thread,
+ so mem_free must be thread safe. Pass 0 to drop all history
+ @param[in] handle tree handle created by #rbtree_createPersistentTree
+ @param[in] versions number of versions to retain in addition to the current one
+ @return returns #RBTREE_STATUS_OK on success
+ */
+RBTREE_STATUS rbtree_setVersionRetention ( RBTREE_HANDLE handle, uint32_t versions );
+
+
+/**
+ @brief retrieve the version stamped by the most recent mutation
+ @details a new tree is at version 0
+ @param[in] handle tree handle
+ @param[out] version current version
+ @return returns #RBTREE_STATUS_OK on success
+ */
+RBTREE_STATUS rbtree_currentVersion ( RBTREE_HANDLE handle, uint64_t * version );
+
+
+/**
+ @brief open a read-only view of a persistent tree as it was at a given version
+ @details O(log n). The view behaves as a #rbtree_snapshot and stays valid after the version leaves the retention horizon
+ @param[in] handle tree handle created by #rbtree_createPersistentTree
+ @param[in] version version to read, from #rbtree_currentVersion
+ @param[out] view returned read-only tree handle
+ @return returns #RBTREE_STATUS_OK on success, #RBTREE_STATUS_FAIL_VERSION_NOT_RETAINED if version is no longer available
+ */
+RBTREE_STATUS rbtree_beginRead ( RBTREE_HANDLE handle, uint64_t version, RBTREE_HANDLE * view );
+
+
+/**
+ @brief close a view opened by #rbtree_beginRead
+ @param[in] view view handle
+ @return returns #RBTREE_STATUS_OK on success
+ */
+RBTREE_STATUS rbtree_endRead ( RBTREE_HANDLE view );
+
+
 /**
  @brief destroy tree
  @param[in] handle handle of tree to remove
@@ -105,23 +296,55 @@ RBTREE_STATUS rbtree_destroyTree ( RBTREE_HANDLE handle );
 /**
  @brief insert new value into tree
  @param[in] handle tree handle
- @param[in] storevalue value to be stored (note:duplicates are allowed)
+ @param[in] storevalue value to be stored (note:duplicates are allowed), a value tree copies in the bytes it points at
  @param[out] key unique reference to retrieve value by
  @return returns #RBTREE_STATUS_OK on success
  */
 RBTREE_STATUS rbtree_insert ( RBTREE_HANDLE handle, void * storevalue, RBTREE_KEY * key );
 
 
+/**
+ @brief reserve a contiguous range of keys without touching the tree
+ @details lock-free. Keys first_key..first_key+count-1 will never be handed out by #rbtree_insert, store values against them with #rbtree_insertReserved
+ @param[in] handle tree handle
+ @param[in] count number of keys to reserve (must be >0)
+ @param[out] first_key first key of the reserved range
+ @return returns #RBTREE_STATUS_OK on success
+ */
+RBTREE_STATUS rbtree_reserveKeys ( RBTREE_HANDLE handle, uint32_t count, RBTREE_KEY * first_key );
+
+
+/**
+ @brief insert new value into tree against a key from #rbtree_reserveKeys
+ @param[in] handle tree handle
+ @param[in] storevalue value to be stored (note:duplicates are allowed), a value tree copies in the bytes it points at
+ @param[in] key previously reserved key
+ @return returns #RBTREE_STATUS_OK on success, #RBTREE_STATUS_FAIL_KEY_ALREADY_STORED if key is in use
+ */
+RBTREE_STATUS rbtree_insertReserved ( RBTREE_HANDLE handle, void * storevalue, RBTREE_KEY key );
+
+
 /**
  @brief retrieves value from tree by key
  @param[in] handle tree handle
  @param[in] key unique reference to retrieve value by
- @param[out] ret_data value to be populated upon success
+ @param[out] ret_data value to be populated upon success, in a value tree a pointer to the value in the node
  @return returns #RBTREE_STATUS_OK on success
  */
 RBTREE_STATUS rbtree_retrieveByKey ( RBTREE_HANDLE handle, RBTREE_KEY key, void ** ret_data );
 
 
+/**
+ @brief copy a value out of a tree created by #rbtree_createValueTree
+ @details the copy stays valid after the entry is removed, unlike the pointer from #rbtree_retrieveByKey
+ @param[in] handle value tree handle
+ @param[in] key unique reference to retrieve value by
+ @param[out] ret_value populated with valueSize bytes upon success
+ @return returns #RBTREE_STATUS_OK on success, #RBTREE_STATUS_FAIL_NOT_SUPPORTED if handle does not store values
+ */
+RBTREE_STATUS rbtree_retrieveValue ( RBTREE_HANDLE handle, RBTREE_KEY key, void * ret_value );
+
+
 /**
  @brief retrieves value from tree by key
  @param[in] handle tree handle
@@ -173,6 +396,52 @@ RBTREE_STATUS rbtree_deleteByIndex ( RBTREE_HANDLE handle, uint32_t index );
 RBTREE_STATUS rbtree_find ( RBTREE_HANDLE handle, rbtree_comparator_t cmp_fn, void * userdata, void ** ret_storevalue, RBTREE_KEY * ret_key );
 
 
+/**
+ @brief call visit_fn for every entry, split across threadCount threads
+ @details the tree is split by subtree into key ordered ranges, idle threads steal ranges from busy ones.
+ Each thread visits its range in key order but ranges run concurrently, so visit_fn must be thread safe.
+ Writers to a persistent tree are not blocked, otherwise they wait until this returns. visit_fn must not modify the tree
+ @param[in] handle tree handle
+ @param[in] threadCount number of threads to use including the caller (1..64)
+ @param[in] visit_fn called once per entry
+ @param[in] userdata data to pass into visit_fn
+ @return returns #RBTREE_STATUS_OK on success
+ */
+RBTREE_STATUS rbtree_parallelForEach ( RBTREE_HANDLE handle, uint32_t threadCount, rbtree_visitor_t visit_fn, void * userdata );
+
+
+/**
+ @brief fold every entry into a single result, split across threadCount threads
+ @details each key ordered range is folded from initial with accumulate_fn, then the range results
+ are merged in key order with combine_fn. So initial must be an identity of combine_fn. Threading as #rbtree_parallelForEach
+ @param[in] handle tree handle
+ @param[in] threadCount number of threads to use including the caller (1..64)
+ @param[in] initial starting value of every range
+ @param[in] accumulate_fn folds one entry into a range result
+ @param[in] combine_fn merges two adjacent range results
+ @param[in] userdata data to pass into accumulate_fn & combine_fn
+ @param[out] result combined result, initial if the tree is empty
+ @return returns #RBTREE_STATUS_OK on success
+ */
+RBTREE_STATUS rbtree_parallelReduce ( RBTREE_HANDLE handle, uint32_t threadCount, void * initial, rbtree_accumulator_t accumulate_fn, rbtree_combiner_t combine_fn, void * userdata, void ** result );
+
+
+/**
+ @brief search tree for entry, split across threadCount threads
+ @details returns the same entry as #rbtree_find, the match with the lowest key. Ranges are searched
+ concurrently and once a match is found, ranges above it are abandoned. cmp_fn must be thread safe.
+ Threading as #rbtree_parallelForEach
+ @param[in] handle tree handle
+ @param[in] threadCount number of threads to use including the caller (1..64)
+ @param[in] cmp_fn comparator ( searching will stop when this returns #TRUE )
+ @param[in] userdata data to pass into cmp_fn
+ @param[out] ret_storevalue returned value
+ @param[out] ret_key returned key
+ @return returns #RBTREE_STATUS_OK on success
+ */
+RBTREE_STATUS rbtree_parallelFind ( RBTREE_HANDLE handle, uint32_t threadCount, rbtree_comparator_t cmp_fn, void * userdata, void ** ret_storevalue, RBTREE_KEY * ret_key );
+
+
 /**
  @brief check if key exists
  @param[in] handle tree handle
@@ -205,12 +474,449 @@ RBTREE_STATUS rbtree_entryCount ( RBTREE_HANDLE handle, uint32_t * numberOfEntri
 /**
  @brief duplicate the values from copyInTree into handle tree
  @param[in] handle tree handle that will contain both sets of values
- @param[out] copyInTree tree handle to copy all values from
+ @param[out] copyInTree tree handle to copy all values from, storing values of the same size as handle
  @return returns #RBTREE_STATUS_OK on success
  */
 RBTREE_STATUS rbtree_copyInTree ( RBTREE_HANDLE handle, RBTREE_HANDLE copyInTree );
 
 
+/**
+ @brief write all entries to a file descriptor
+ @details entries are streamed in key order through a buffered writer. Keys are stored as the
+ difference from the previous key, so sequentially allocated keys cost a byte each.
+ Writers to a persistent tree are not blocked, otherwise they wait until this returns
+ @param[in] handle tree handle
+ @param[in] fd file descriptor open for writing (file, pipe or socket)
+ @param[in] encode_fn converts each value to bytes (optional, NULL stores the value pointer itself)
+ @param[in] userdata data to pass into encode_fn
+ @return returns #RBTREE_STATUS_OK on success
+ */
+RBTREE_STATUS rbtree_saveToFd ( RBTREE_HANDLE handle, int fd, rbtree_encoder_t encode_fn, void * userdata );
+
+
+/**
+ @brief read entries written by #rbtree_saveToFd into an empty tree
+ @details O(n), the tree is rebuilt balanced directly from the key ordered stream. Keys are preserved
+ and later inserts continue from the saved key seed
+ @param[in] handle empty tree handle, either mode
+ @param[in] fd file descriptor open for reading, positioned at the start of the saved stream
+ @param[in] decode_fn converts bytes back to a value (NULL if the stream was saved without an encoder)
+ @param[in] userdata data to pass into decode_fn
+ @return returns #RBTREE_STATUS_OK on success, the tree is left empty on failure
+ */
+RBTREE_STATUS rbtree_loadFromFd ( RBTREE_HANDLE handle, int fd, rbtree_decoder_t decode_fn, void * userdata );
+
+
+/**
+ @brief write all entries as an image that #rbtree_openImage can map without loading
+ @details keys are laid out as an implicit search tree (eytzinger order) & as a key ordered array,
+ values in a parallel array. Native endian, so only readable on the same architecture
+ @param[in] handle tree handle, standard or persistent
+ @param[in] fd file descriptor of an empty regular file, the image must be the whole file
+ @param[in] encode_fn converts each value to bytes (optional, NULL stores the value pointer itself)
+ @param[in] userdata data to pass into encode_fn
+ @return returns #RBTREE_STATUS_OK on success
+ */
+RBTREE_STATUS rbtree_exportImage ( RBTREE_HANDLE handle, int fd, rbtree_encoder_t encode_fn, void * userdata );
+
+
+/**
+ @brief open an image written by #rbtree_exportImage as a read-only tree
+ @details the file is mapped, not read, so opening is O(1) regardless of size. Lookup by key is
+ O(log n), by index O(1). If the image was written with an encoder the values returned are pointers
+ to the encoded bytes inside the mapping, valid until the tree is destroyed. The tree is read-only,
+ every mutation fails with #RBTREE_STATUS_FAIL_READ_ONLY
+ @param[out] handle populated with the new tree handle, release with #rbtree_destroyTree
+ @param[in] fd file descriptor open for reading, may be closed once this returns
+ @param[in] mem_alloc memory allocator (optional)
+ @param[in] mem_free memory free (optional)
+ @return returns #RBTREE_STATUS_OK on success
+ */
+RBTREE_STATUS rbtree_openImage ( RBTREE_HANDLE * handle, int fd, rbtree_memalloc_t mem_alloc, rbtree_memfree_t mem_free );
+
+
+/**
+ @brief record every later change to the tree in a write-ahead log
+ @details inserts & deletes (by key, index or value) append a compact record. Pair with #rbtree_saveToFd:
+ after a crash load the last save & #rbtree_replayLog the log written since. If a change cannot be logged
+ it is still applied & the call returns the log failure, which then sticks until the log is detached
+ @param[in] handle tree handle, standard or persistent
+ @param[in] fd file descriptor open for appending, the caller closes it after #rbtree_detachLog
+ @param[in] sync when a change must be on disk, see #RBTREE_LOG_SYNC
+ @param[in] encode_fn converts each value to bytes (optional, NULL logs the value pointer itself)
+ @param[in] userdata data to pass into encode_fn
+ @return returns #RBTREE_STATUS_OK on success
+ */
+RBTREE_STATUS rbtree_attachLog ( RBTREE_HANDLE handle, int fd, RBTREE_LOG_SYNC sync, rbtree_encoder_t encode_fn, void * userdata );
+
+
+/**
+ @brief write & fdatasync every change logged so far, whatever the sync policy
+ @param[in] handle tree handle with a log attached
+ @return returns #RBTREE_STATUS_OK on success
+ */
+RBTREE_STATUS rbtree_syncLog ( RBTREE_HANDLE handle );
+
+
+/**
+ @brief sync & stop logging. Must not race with changes to the tree
+ @param[in] handle tree handle with a log attached
+ @return returns #RBTREE_STATUS_OK on success, or the first failure the log had
+ */
+RBTREE_STATUS rbtree_detachLog ( RBTREE_HANDLE handle );
+
+
+/**
+ @brief apply a log written by #rbtree_attachLog
+ @details the tree is locked once for the whole log & changes skip the per-call checks. Inserts of keys already
+ stored & deletes of absent keys are skipped, so a log can be replayed onto a save taken part way through it.
+ A crash mid-commit leaves a torn final frame, replay stops before it & leaves fd positioned there so the
+ log can be truncated before it is appended to again
+ @param[in] handle tree handle without a log attached
+ @param[in] fd file descriptor open for reading, positioned at the start of the log
+ @param[in] decode_fn converts bytes back to a value (NULL if the log was written without an encoder)
+ @param[in] userdata data to pass into decode_fn
+ @return returns #RBTREE_STATUS_OK on success
+ */
+RBTREE_STATUS rbtree_replayLog ( RBTREE_HANDLE handle, int fd, rbtree_decoder_t decode_fn, void * userdata );
+
+
+/**
+ @brief write the tree as it is now to a file in the #rbtree_saveToFd format, on a background thread
+ @details only the capture is done on the calling thread, writers carry on while the file is written.
+ A persistent tree is captured with #rbtree_snapshot. A standard tree is captured by fork() with the tree
+ locked, which costs a copy of the page tables & then copy-on-write of pages the writers touch; the child
+ process writes the file, so encode_fn runs there & any side effects it has are lost. The child is a copy of a
+ possibly multi-threaded process with only one thread, so for standard trees encode_fn must not allocate, take
+ locks or use stdio, only async-signal-safe calls. The file is written beside path & renamed over it once synced,
+ so path only ever holds a complete checkpoint. If SIGCHLD is ignored the writer's exit status is lost & done_fn
+ is given #RBTREE_STATUS_FAIL once it has finished, path may or may not hold the new checkpoint. Pair with #rbtree_attachLog to replay the changes made since
+ @param[in] handle tree handle, standard or persistent
+ @param[in] path file to write, replaced if it exists
+ @param[in] encode_fn converts each value to bytes (optional, NULL stores the value pointer itself), runs in the forked child for standard trees
+ @param[in] userdata data to pass into encode_fn
+ @param[in] done_fn called once from the background thread when the file is complete or the write failed
+ @param[in] done_userdata data to pass into done_fn
+ @return returns #RBTREE_STATUS_OK once the tree is captured, done_fn is then called exactly once
+ */
+RBTREE_STATUS rbtree_checkpointAsync ( RBTREE_HANDLE handle, const char * path, rbtree_encoder_t encode_fn, void * userdata, rbtree_completion_t done_fn, void * done_userdata );
+
+
+/**
+ @brief create a tree in a new POSIX shared memory segment that other processes can attach to
+ @details nodes are linked by index rather than address, so the segment can be mapped anywhere in each
+ process, and every call is serialised across processes by a robust process-shared mutex held in it.
+ A process that dies mid-change leaves the tree marked broken, later calls fail with #RBTREE_STATUS_FAIL_CORRUPT_DATA.
+ The usual API applies apart from parallel walks, logging, checkpoints, save/load & images which fail with
+ #RBTREE_STATUS_FAIL_NOT_SUPPORTED. Values are stored as their raw bits, so only values that are not local
+ pointers (ids, offsets, small integers) mean the same in every process
+ @param[out] handle populated with the new tree handle. #rbtree_destroyTree detaches, the segment lives on
+ @param[in] name segment name as for shm_open, "/name". Fails if it already exists
+ @param[in] capacity maximum number of entries, inserts beyond it fail with #RBTREE_STATUS_FAIL_MALLOC_FAILURE
+ @param[in] mem_alloc memory allocator for the per process handle (optional)
+ @param[in] mem_free memory free (optional)
+ @return returns #RBTREE_STATUS_OK on success
+ */
+RBTREE_STATUS rbtree_createSharedTree ( RBTREE_HANDLE * handle, const char * name, uint32_t capacity, rbtree_memalloc_t mem_alloc, rbtree_memfree_t mem_free );
+
+
+/**
+ @brief attach to a tree created by #rbtree_createSharedTree, possibly in another process
+ @details O(1), the segment is mapped & its header validated. Changes from any attached process are
+ visible to all of them on their next call
+ @param[out] handle populated with the new tree handle, release with #rbtree_destroyTree
+ @param[in] name segment name passed to #rbtree_createSharedTree
+ @param[in] mem_alloc memory allocator for the per process handle (optional)
+ @param[in] mem_free memory free (optional)
+ @return returns #RBTREE_STATUS_OK on success, #RBTREE_STATUS_FAIL_INVALID_PARAM if name does not exist
+ */
+RBTREE_STATUS rbtree_attachSharedTree ( RBTREE_HANDLE * handle, const char * name, rbtree_memalloc_t mem_alloc, rbtree_memfree_t mem_free );
+
+
+/**
+ @brief remove the name of a shared tree
+ @details processes already attached keep using it, the memory is released once the last one detaches
+ @param[in] name segment name passed to #rbtree_createSharedTree
+ @return returns #RBTREE_STATUS_OK on success
+ */
+RBTREE_STATUS rbtree_unlinkSharedTree ( const char * name );
+
+
+/**
+ @brief open a tree that lives in a file, creating it if the file is empty
+ @details the file is mapped & used as the tree's node storage directly, in the layout of
+ #rbtree_createSharedTree, so reopening is O(1) whatever the size: there is nothing to parse or rebuild.
+ The file starts small & is extended as it fills, the mapping reserves address space for maxEntries so it
+ never moves. Changes reach the file as the OS writes pages back; #rbtree_syncMappedTree forces it.
+ A process crash at any point leaves the file usable unless it was mid insert or delete, which the next open
+ reports as #RBTREE_STATUS_FAIL_CORRUPT_DATA. After a power cut only the state at the last sync is reliable,
+ & only if nothing changed after it. The file is locked to one process, open it once per process.
+ Values are stored as their raw bits, as for #rbtree_createSharedTree, with the same unsupported calls
+ @param[out] handle populated with the new tree handle, release with #rbtree_destroyTree
+ @param[in] path file to open or create
+ @param[in] maxEntries most entries the file may grow to. Raised, never lowered, on reopen
+ @param[in] mem_alloc memory allocator for the handle (optional)
+ @param[in] mem_free memory free (optional)
+ @return returns #RBTREE_STATUS_OK on success, #RBTREE_STATUS_FAIL if another process has path open
+ */
+RBTREE_STATUS rbtree_openMappedTree ( RBTREE_HANDLE * handle, const char * path, uint32_t maxEntries, rbtree_memalloc_t mem_alloc, rbtree_memfree_t mem_free );
+
+
+/**
+ @brief write all changes to a tree from #rbtree_openMappedTree to disk
+ @details msync of the pages in use, with writers held off so the file holds a whole tree
+ @param[in] handle tree handle from #rbtree_openMappedTree or #rbtree_createSharedTree
+ @return returns #RBTREE_STATUS_OK once the data is on disk, #RBTREE_STATUS_FAIL_NOT_SUPPORTED for other trees
+ */
+RBTREE_STATUS rbtree_syncMappedTree ( RBTREE_HANDLE handle );
+
+
+/**
+ @brief counters & shape reported by #rbtree_getStats
+ @details counters are per handle, a snapshot or view starts its own at zero. Rotations, recolours,
+ fix-up iterations & allocs are counted for standard & persistent trees, images & mapped trees have no
+ nodes of their own so report 0. Black height counts the black nodes on any root to leaf path
+ */
+typedef struct _RBTREE_STATS
+{
+    uint64_t inserts;           /* successful inserts */
+    uint64_t deletes;           /* successful deletes */
+    uint64_t lookups;           /* retrieves & existence checks by key */
+    uint64_t misses;            /* lookups that found nothing */
+    uint64_t rotations;
+    uint64_t recolours;         /* nodes whose colour changed */
+    uint64_t fixUpIterations;   /* passes round the insert & delete rebalancing loops */
+    uint64_t allocs;            /* calls to mem_alloc for nodes */
+    uint32_t entries;
+    uint32_t height;            /* nodes on the longest root to leaf path */
+    uint32_t blackHeight;
+} RBTREE_STATS;
+
+
+/**
+ @brief read a tree's operation counters & measure its shape
+ @details counters are relaxed atomics read without stopping writers, so they are individually exact
+ but not a consistent set while the tree is changing. Height is an O(n) walk, writers to a standard
+ tree wait for it
+ @param[in] handle tree handle
+ @param[out] stats populated with the counters & shape
+ @return returns #RBTREE_STATUS_OK on success
+ */
+RBTREE_STATUS rbtree_getStats ( RBTREE_HANDLE handle, RBTREE_STATS * stats );
+
+
+/**
+ @brief calls timed by #rbtree_setLatencySampling
+ */
+typedef enum _RBTREE_LATENCY_OP
+{
+    RBTREE_LATENCY_OP_UNDEF = 0,
+    RBTREE_LATENCY_OP_INSERT,
+    RBTREE_LATENCY_OP_INSERT_RESERVED,
+    RBTREE_LATENCY_OP_RETRIEVE_BY_KEY,
+    RBTREE_LATENCY_OP_DELETE_BY_KEY,
+    RBTREE_LATENCY_OP_DELETE_BY_INDEX,
+    RBTREE_LATENCY_OP_LAST_VALUE
+} RBTREE_LATENCY_OP;
+
+
+/**
+ @brief where a timed call spent its time
+ @details
+ RBTREE_LATENCY_PHASE_TOTAL the whole call \n
+ RBTREE_LATENCY_PHASE_LOCK_WAIT waiting for the tree mutex \n
+ RBTREE_LATENCY_PHASE_ALLOC in mem_alloc & mem_free for the node \n
+ RBTREE_LATENCY_PHASE_TREE_WORK the rest: search, rebalancing & logging \n
+ A call without a phase, eg a lookup has no alloc, records 0 for it
+ */
+typedef enum _RBTREE_LATENCY_PHASE
+{
+    RBTREE_LATENCY_PHASE_UNDEF = 0,
+    RBTREE_LATENCY_PHASE_TOTAL,
+    RBTREE_LATENCY_PHASE_LOCK_WAIT,
+    RBTREE_LATENCY_PHASE_ALLOC,
+    RBTREE_LATENCY_PHASE_TREE_WORK,
+    RBTREE_LATENCY_PHASE_LAST_VALUE
+} RBTREE_LATENCY_PHASE;
+
+
+/**
+ @brief distribution of one phase of one call, see #rbtree_getLatency
+ @details values are in ns & to within about 3%, a percentile is the middle of the histogram bucket it falls in
+ */
+typedef struct _RBTREE_LATENCY
+{
+    uint64_t samples;
+    uint64_t minNs;
+    uint64_t p50Ns;
+    uint64_t p90Ns;
+    uint64_t p99Ns;
+    uint64_t p999Ns;
+    uint64_t maxNs;
+} RBTREE_LATENCY;
+
+
+/**
+ @brief time one in every sampleEvery calls to the #RBTREE_LATENCY_OP api's
+ @details off by default. While off a call tests one pointer up front & the same local at each phase,
+ all predicted not taken. Turning it on the first time allocates the histograms (about 150KB) & spends
+ a couple of ms calibrating the clock. Each thread counts its own calls, histograms are kept when
+ sampling is turned off or the period changed, until the tree is destroyed. Mapped trees take their
+ lock inside the arena so report it as tree work
+ @param[in] handle tree handle
+ @param[in] sampleEvery 1 times every call, 0 turns sampling off
+ @return returns #RBTREE_STATUS_OK on success
+ */
+RBTREE_STATUS rbtree_setLatencySampling ( RBTREE_HANDLE handle, uint32_t sampleEvery );
+
+
+/**
+ @brief read the latency distribution of one phase of one call
+ @param[in] handle tree handle
+ @param[in] op call
+ @param[in] phase phase of the call
+ @param[out] latency populated, all 0 if sampling was never turned on
+ @return returns #RBTREE_STATUS_OK on success
+ */
+RBTREE_STATUS rbtree_getLatency ( RBTREE_HANDLE handle, RBTREE_LATENCY_OP op, RBTREE_LATENCY_PHASE phase, RBTREE_LATENCY * latency );
+
+
+/**
+ @brief print a table of every sampled call & phase
+ @param[in] handle tree handle
+ @param[in] fp stream to print to
+ @return returns #RBTREE_STATUS_OK on success, #RBTREE_STATUS_FAIL if sampling was never turned on
+ */
+RBTREE_STATUS rbtree_printLatency ( RBTREE_HANDLE handle, FILE * fp );
+
+
+/**
+ @brief one place the library takes a mutex, see #rbtree_getLockProfile
+ @details times are in ns. Hold percentiles are the top of the power of two they fall in
+ */
+typedef struct _RBTREE_LOCK_SITE
+{
+    const char * file;
+    const char * function;
+    uint32_t line;
+    uint64_t acquisitions;
+    uint64_t contended;         /* acquisitions that found the mutex held & blocked */
+    uint64_t waitNs;            /* total time blocked */
+    uint64_t holdNs;            /* total time held */
+    uint64_t maxHoldNs;
+    uint64_t holdP50Ns;
+    uint64_t holdP99Ns;
+} RBTREE_LOCK_SITE;
+
+
+/**
+ @brief profile every mutex the library takes, in every tree
+ @details process wide & off by default. While on each lock is tried first & only a failed try is timed
+ as a wait, every hold is timed. Turning it on clears the counters. While off a lock or unlock costs one
+ extra predictable branch. Locks inside a mapped tree's arena are not profiled
+ @param[in] enable true to start profiling, false to stop
+ @return returns #RBTREE_STATUS_OK on success
+ */
+RBTREE_STATUS rbtree_setLockProfiling ( bool enable );
+
+
+/**
+ @brief read the lock profile, the site that held its mutex longest first
+ @param[out] sites populated with up to *count sites
+ @param[in,out] count in: size of sites out: number written
+ @return returns #RBTREE_STATUS_OK on success
+ */
+RBTREE_STATUS rbtree_getLockProfile ( RBTREE_LOCK_SITE * sites, uint32_t * count );
+
+
+/**
+ @brief print a table of the lock profile, the site that held its mutex longest first
+ @param[in] fp stream to print to
+ @return returns #RBTREE_STATUS_OK on success
+ */
+RBTREE_STATUS rbtree_printLockProfile ( FILE * fp );
+
+
+/**
+ @brief calls recorded by #rbtree_startTrace, with what each record's arg & result hold
+ @details
+ RBTREE_TRACE_OP_INSERT arg: value result: key assigned \n
+ RBTREE_TRACE_OP_INSERT_RESERVED arg: value result: key \n
+ RBTREE_TRACE_OP_RESERVE_KEYS arg: count result: first key \n
+ RBTREE_TRACE_OP_RETRIEVE_BY_KEY arg: key \n
+ RBTREE_TRACE_OP_RETRIEVE_BY_INDEX arg: index result: key found \n
+ RBTREE_TRACE_OP_DELETE_BY_KEY arg: key \n
+ RBTREE_TRACE_OP_DELETE_BY_INDEX arg: index \n
+ RBTREE_TRACE_OP_DELETE_BY_VALUE arg: value \n
+ Values are recorded as their raw bits
+ */
+typedef enum _RBTREE_TRACE_OP
+{
+    RBTREE_TRACE_OP_UNDEF = 0,
+    RBTREE_TRACE_OP_INSERT,
+    RBTREE_TRACE_OP_INSERT_RESERVED,
+    RBTREE_TRACE_OP_RESERVE_KEYS,
+    RBTREE_TRACE_OP_RETRIEVE_BY_KEY,
+    RBTREE_TRACE_OP_RETRIEVE_BY_INDEX,
+    RBTREE_TRACE_OP_DELETE_BY_KEY,
+    RBTREE_TRACE_OP_DELETE_BY_INDEX,
+    RBTREE_TRACE_OP_DELETE_BY_VALUE,
+    RBTREE_TRACE_OP_LAST_VALUE
+} RBTREE_TRACE_OP;
+
+
+/**
+ @brief result of #rbtree_replayTrace, times are in ns & arrays are indexed by #RBTREE_TRACE_OP
+ */
+typedef struct _RBTREE_TRACE_REPORT
+{
+    uint64_t records;
+    uint32_t threads;           /* threads that made the recorded calls */
+    uint64_t tracedNs;          /* first recorded call starting to the last one returning */
+    uint64_t replayNs;          /* wall time of the replay */
+    uint64_t mismatches;        /* replayed calls that returned a different status to the recording */
+    uint64_t calls[RBTREE_TRACE_OP_LAST_VALUE];
+    uint64_t tracedCallNs[RBTREE_TRACE_OP_LAST_VALUE];     /* total time in each call when recorded */
+    uint64_t replayCallNs[RBTREE_TRACE_OP_LAST_VALUE];     /* & when replayed */
+} RBTREE_TRACE_REPORT;
+
+
+/**
+ @brief record every #RBTREE_TRACE_OP call on this tree to fd, for #rbtree_replayTrace
+ @details off by default. While off a call tests one pointer. While on each call appends a record of
+ about 10 bytes, its arguments, start time, duration, thread & status, under a mutex of the trace's own,
+ & records are written to fd in 64KB blocks. Replay starts from an empty tree so start tracing before
+ the tree is filled, calls on entries from before the trace show up as mismatches
+ @param[in] handle tree handle
+ @param[in] fd file descriptor to write to, left open
+ @return returns #RBTREE_STATUS_OK on success, #RBTREE_STATUS_FAIL if the tree is already tracing
+ */
+RBTREE_STATUS rbtree_startTrace ( RBTREE_HANDLE handle, int fd );
+
+
+/**
+ @brief write what is buffered & stop tracing
+ @param[in] handle tree handle
+ @return returns #RBTREE_STATUS_OK on success, #RBTREE_STATUS_FAIL_IO if any write to fd failed
+ */
+RBTREE_STATUS rbtree_stopTrace ( RBTREE_HANDLE handle );
+
+
+/**
+ @brief run a trace written by #rbtree_startTrace against a new tree & time it
+ @details the new tree is persistent if the traced tree was, otherwise standard. Keys it hands out are
+ mapped from the recorded ones. Single threaded replay runs every call in the order they returned when
+ recorded. Interleaved replay runs each call on a thread of its own per recorded thread, in the same
+ order, handing the turn from thread to thread, so cache & lock behaviour is closer to the original
+ but replayNs includes the hand overs. A trace cut short by a crash is replayed up to the last whole record
+ @param[in] fd file descriptor to read the trace from
+ @param[in] isInterleaved true to replay on the recorded threads, false on the calling thread
+ @param[out] report populated with call counts & times
+ @return returns #RBTREE_STATUS_OK on success, #RBTREE_STATUS_FAIL_CORRUPT_DATA if fd does not hold a trace
+ */
+RBTREE_STATUS rbtree_replayTrace ( int fd, bool isInterleaved, RBTREE_TRACE_REPORT * report );
+
+
 /**
  @brief get the memory allocator functions passed into #rbtree_createTree
  @param[in] handle tree handle 
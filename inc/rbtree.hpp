@@ -0,0 +1,1278 @@
+/**
+ @file
+ Red-Black Binary Search Tree - C++ map
+
+ @details header-only, C++11. The C api orders library handed out #RBTREE_KEY's & stores void *'s, so
+ C++ callers box every value & pay an indirect call per node for #rbtree_find. rbtree::map carries the same
+ red-black algorithms over nodes of its own type: any key with a Compare, values constructed in place in
+ the node, comparators, predicates & visitors passed as template parameters so they inline.
+ Bidirectional iterators make it a standard container for <algorithm> & range-for. With C++17
+ rbtree::pmr::map allocates from a std::pmr::memory_resource, eg a request scoped arena.
+ Not thread safe, guard a map shared between threads.
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#ifndef __RBTREE_HPP
+#define __RBTREE_HPP
+
+
+#include <algorithm>        /* std::equal */
+#include <cstddef>
+#include <functional>       /* std::less */
+#include <initializer_list>
+#include <iterator>         /* std::bidirectional_iterator_tag, std::reverse_iterator */
+#include <memory>           /* std::allocator, std::allocator_traits */
+#include <new>
+#include <stdexcept>        /* std::out_of_range */
+#include <tuple>            /* std::forward_as_tuple */
+#include <type_traits>
+#include <utility>
+
+#if ( __cplusplus >= 201703L ) && defined(__has_include)
+#  if __has_include(<memory_resource>)
+#    include <memory_resource>
+#    define RBTREE_HPP_PMR
+#  endif
+#endif
+
+
+namespace rbtree
+{
+
+
+/**
+ @brief ordered map of unique keys
+ @details Compare must be a strict weak ordering over Key. Alloc is rebound to allocate nodes, entries are
+ constructed in them through Alloc so allocator aware values share it. Pointers returned stay valid until
+ their entry is erased
+ */
+template < typename Key, typename Value, typename Compare = std::less<Key>, typename Alloc = std::allocator< std::pair<const Key, Value> > >
+class map
+{
+public:
+    typedef Key key_type;
+    typedef Value mapped_type;
+    typedef std::pair<const Key, Value> value_type;
+    typedef Compare key_compare;
+    typedef Alloc allocator_type;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef value_type & reference;
+    typedef const value_type & const_reference;
+    typedef value_type * pointer;
+    typedef const value_type * const_pointer;
+
+private:
+    /* links & colour first, the entry is constructed in storage once the node is allocated */
+    struct node
+    {
+        node * left;
+        node * right;
+        node * parent;
+        bool isRed;
+        alignas(value_type) unsigned char storage[sizeof(value_type)];
+
+        value_type * entry ( )
+        {
+            return reinterpret_cast<value_type *>(storage);
+        }
+
+        const value_type * entry ( ) const
+        {
+            return reinterpret_cast<const value_type *>(storage);
+        }
+    };
+
+    typedef std::allocator_traits<Alloc> value_traits;
+    typedef typename value_traits::template rebind_alloc<node> node_alloc;
+    typedef std::allocator_traits<node_alloc> node_traits;
+
+    node * root;
+    size_type nodeCount;
+    Compare compare;
+    Alloc alloc;
+
+    /**
+     @brief bidirectional, steps with the parent links like rbtree_prv_getNext/getPrev. end() is a nullptr node,
+     decrementing it finds the last entry from the map's root. Stays valid until its entry is erased
+     */
+    template < bool isConst >
+    class iterator_base
+    {
+        friend class map;
+        template < bool > friend class iterator_base;
+
+        typedef typename std::conditional<isConst, const node, node>::type node_type;
+
+        node_type * cur_node;
+        node * const * rootRef;
+
+        iterator_base ( node_type * n, node * const * r ) : cur_node(n), rootRef(r)
+        {
+        }
+
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef typename map::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef typename std::conditional<isConst, const value_type *, value_type *>::type pointer;
+        typedef typename std::conditional<isConst, const value_type &, value_type &>::type reference;
+
+        iterator_base ( ) : cur_node(nullptr), rootRef(nullptr)
+        {
+        }
+
+        /* iterator to const_iterator, not back */
+        template < bool wasConst, typename = typename std::enable_if< isConst && ! wasConst >::type >
+        iterator_base ( const iterator_base<wasConst> & other ) : cur_node(other.cur_node), rootRef(other.rootRef)
+        {
+        }
+
+        reference operator* ( ) const
+        {
+            return *cur_node->entry();
+        }
+
+        pointer operator-> ( ) const
+        {
+            return cur_node->entry();
+        }
+
+        iterator_base & operator++ ( )
+        {
+            cur_node = getNext(cur_node);
+            return *this;
+        }
+
+        iterator_base operator++ ( int )
+        {
+            iterator_base prev = *this;
+            cur_node = getNext(cur_node);
+            return prev;
+        }
+
+        iterator_base & operator-- ( )
+        {
+            cur_node = ( cur_node ) ? getPrev(cur_node) : getLast(*rootRef);
+            return *this;
+        }
+
+        iterator_base operator-- ( int )
+        {
+            iterator_base next = *this;
+            --(*this);
+            return next;
+        }
+
+        friend bool operator== ( const iterator_base & lhs, const iterator_base & rhs )
+        {
+            return ( lhs.cur_node == rhs.cur_node );
+        }
+
+        friend bool operator!= ( const iterator_base & lhs, const iterator_base & rhs )
+        {
+            return ( lhs.cur_node != rhs.cur_node );
+        }
+    };
+
+public:
+    typedef iterator_base<false> iterator;
+    typedef iterator_base<true> const_iterator;
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    map ( ) : root(nullptr), nodeCount(0U), compare(), alloc()
+    {
+    }
+
+    explicit map ( const Compare & cmp, const Alloc & a = Alloc() ) : root(nullptr), nodeCount(0U), compare(cmp), alloc(a)
+    {
+    }
+
+    explicit map ( const Alloc & a ) : root(nullptr), nodeCount(0U), compare(), alloc(a)
+    {
+    }
+
+    template < typename InputIt >
+    map ( InputIt first, InputIt last, const Compare & cmp = Compare(), const Alloc & a = Alloc() ) : root(nullptr), nodeCount(0U), compare(cmp), alloc(a)
+    {
+        insert(first, last);
+    }
+
+    map ( std::initializer_list<value_type> entries, const Compare & cmp = Compare(), const Alloc & a = Alloc() ) : root(nullptr), nodeCount(0U), compare(cmp), alloc(a)
+    {
+        insert(entries.begin(), entries.end());
+    }
+
+    map ( const map & other ) : root(nullptr), nodeCount(0U), compare(other.compare),
+        alloc(value_traits::select_on_container_copy_construction(other.alloc))
+    {
+        root = cloneSubtree(other.root, nullptr);
+        nodeCount = other.nodeCount;
+    }
+
+    map ( map && other ) noexcept : root(other.root), nodeCount(other.nodeCount), compare(std::move(other.compare)), alloc(std::move(other.alloc))
+    {
+        other.root = nullptr;
+        other.nodeCount = 0U;
+    }
+
+    ~map ( )
+    {
+        clear();
+    }
+
+    map & operator= ( const map & other )
+    {
+        if ( this != &other )
+        {
+            clear();
+            compare = other.compare;
+            propagate(other.alloc, typename value_traits::propagate_on_container_copy_assignment());
+            root = cloneSubtree(other.root, nullptr);
+            nodeCount = other.nodeCount;
+        }
+
+        return *this;
+    }
+
+    map & operator= ( map && other )
+    {
+        if ( this != &other )
+        {
+            clear();
+            compare = std::move(other.compare);
+
+            if ( ( value_traits::propagate_on_container_move_assignment::value ) || ( alloc == other.alloc ) )
+            {
+                /* the nodes can be freed by either allocator, take them */
+                propagate(other.alloc, typename value_traits::propagate_on_container_move_assignment());
+                root = other.root;
+                nodeCount = other.nodeCount;
+                other.root = nullptr;
+                other.nodeCount = 0U;
+            }
+            else
+            {
+                /* nodes must come from our own allocator, move the entries across one by one */
+                for ( node * cur_node = getFirst(other.root); cur_node != nullptr; cur_node = getNext(cur_node) )
+                {
+                    emplace(std::move(*cur_node->entry()));
+                }
+
+                other.clear();
+            }
+        }
+
+        return *this;
+    }
+
+    void swap ( map & other ) noexcept
+    {
+        std::swap(root, other.root);
+        std::swap(nodeCount, other.nodeCount);
+        std::swap(compare, other.compare);
+        swapAlloc(other.alloc, typename value_traits::propagate_on_container_swap());
+    }
+
+    iterator begin ( )
+    {
+        return iterator(getFirst(root), &root);
+    }
+
+    const_iterator begin ( ) const
+    {
+        return const_iterator(getFirst(root), &root);
+    }
+
+    const_iterator cbegin ( ) const
+    {
+        return begin();
+    }
+
+    iterator end ( )
+    {
+        return iterator(nullptr, &root);
+    }
+
+    const_iterator end ( ) const
+    {
+        return const_iterator(nullptr, &root);
+    }
+
+    const_iterator cend ( ) const
+    {
+        return end();
+    }
+
+    reverse_iterator rbegin ( )
+    {
+        return reverse_iterator(end());
+    }
+
+    const_reverse_iterator rbegin ( ) const
+    {
+        return const_reverse_iterator(end());
+    }
+
+    const_reverse_iterator crbegin ( ) const
+    {
+        return rbegin();
+    }
+
+    reverse_iterator rend ( )
+    {
+        return reverse_iterator(begin());
+    }
+
+    const_reverse_iterator rend ( ) const
+    {
+        return const_reverse_iterator(begin());
+    }
+
+    const_reverse_iterator crend ( ) const
+    {
+        return rend();
+    }
+
+    /* kept up to date by every insert & erase, O(1) */
+    size_type size ( ) const
+    {
+        return nodeCount;
+    }
+
+    bool empty ( ) const
+    {
+        return ( nodeCount == 0U );
+    }
+
+    size_type max_size ( ) const
+    {
+        node_alloc nodeAlloc(alloc);
+
+        return node_traits::max_size(nodeAlloc);
+    }
+
+    key_compare key_comp ( ) const
+    {
+        return compare;
+    }
+
+    allocator_type get_allocator ( ) const
+    {
+        return alloc;
+    }
+
+    iterator find ( const Key & key )
+    {
+        return iterator(findNode(key), &root);
+    }
+
+    const_iterator find ( const Key & key ) const
+    {
+        return const_iterator(findNode(key), &root);
+    }
+
+    bool contains ( const Key & key ) const
+    {
+        return ( findNode(key) != nullptr );
+    }
+
+    size_type count ( const Key & key ) const
+    {
+        return ( findNode(key) != nullptr ) ? 1U : 0U;
+    }
+
+    /* first entry not below key */
+    iterator lower_bound ( const Key & key )
+    {
+        return iterator(findBound(key, false), &root);
+    }
+
+    const_iterator lower_bound ( const Key & key ) const
+    {
+        return const_iterator(findBound(key, false), &root);
+    }
+
+    /* first entry above key */
+    iterator upper_bound ( const Key & key )
+    {
+        return iterator(findBound(key, true), &root);
+    }
+
+    const_iterator upper_bound ( const Key & key ) const
+    {
+        return const_iterator(findBound(key, true), &root);
+    }
+
+    /**
+     @brief value stored against key
+     @throws std::out_of_range if key is not stored
+     */
+    mapped_type & at ( const Key & key )
+    {
+        node * cur_node = findNode(key);
+
+        if ( cur_node == nullptr )
+        {
+            throw std::out_of_range("rbtree::map::at");
+        }
+
+        return cur_node->entry()->second;
+    }
+
+    const mapped_type & at ( const Key & key ) const
+    {
+        const node * cur_node = findNode(key);
+
+        if ( cur_node == nullptr )
+        {
+            throw std::out_of_range("rbtree::map::at");
+        }
+
+        return cur_node->entry()->second;
+    }
+
+    /**
+     @brief value stored against key, a value initialised one is inserted if key is not stored
+     */
+    mapped_type & operator[] ( const Key & key )
+    {
+        return try_emplace(key).first->second;
+    }
+
+    mapped_type & operator[] ( Key && key )
+    {
+        return try_emplace(std::move(key)).first->second;
+    }
+
+    /**
+     @brief construct an entry from args directly in a new node
+     @details the node is built before the key can be compared, if the key is already stored it is destroyed again.
+     Prefer #try_emplace where the key is at hand
+     @return the entry of the key & true if it was inserted, false if the key was already stored
+     */
+    template < typename... Args >
+    std::pair<iterator, bool> emplace ( Args &&... args )
+    {
+        node * ins_node = createNode(std::forward<Args>(args)...);
+        node * parent = nullptr;
+        bool isLeft = false;
+        node * cur_node = nullptr;
+
+        try
+        {
+            cur_node = findSlot(ins_node->entry()->first, &parent, &isLeft);
+        }
+        catch ( ... )
+        {
+            /* a throwing Compare */
+            freeNode(ins_node);
+            throw;
+        }
+
+        if ( cur_node )
+        {
+            freeNode(ins_node);
+        }
+        else
+        {
+            linkNode(ins_node, parent, isLeft);
+            cur_node = ins_node;
+        }
+
+        return std::pair<iterator, bool>(iterator(cur_node, &root), ( cur_node == ins_node ));
+    }
+
+    /**
+     @brief construct the value from args in a new node, only if key is not already stored
+     @return the entry of the key & true if it was inserted
+     */
+    template < typename... Args >
+    std::pair<iterator, bool> try_emplace ( const Key & key, Args &&... args )
+    {
+        return emplaceKey(key, std::forward<Args>(args)...);
+    }
+
+    template < typename... Args >
+    std::pair<iterator, bool> try_emplace ( Key && key, Args &&... args )
+    {
+        return emplaceKey(std::move(key), std::forward<Args>(args)...);
+    }
+
+    std::pair<iterator, bool> insert ( const value_type & entry )
+    {
+        return emplaceKey(entry.first, entry.second);
+    }
+
+    std::pair<iterator, bool> insert ( value_type && entry )
+    {
+        return emplace(std::move(entry));
+    }
+
+    /**
+     @brief hinted forms for std::inserter & code written against std::map. The hint is ignored,
+     the key is always placed by a search from the root
+     @return the entry of the key, inserted or already stored
+     */
+    iterator insert ( const_iterator hint, const value_type & entry )
+    {
+        (void)hint;
+        return insert(entry).first;
+    }
+
+    iterator insert ( const_iterator hint, value_type && entry )
+    {
+        (void)hint;
+        return insert(std::move(entry)).first;
+    }
+
+    template < typename... Args >
+    iterator emplace_hint ( const_iterator hint, Args &&... args )
+    {
+        (void)hint;
+        return emplace(std::forward<Args>(args)...).first;
+    }
+
+    template < typename InputIt >
+    void insert ( InputIt first, InputIt last )
+    {
+        for ( ; first != last; ++first )
+        {
+            emplace(*first);
+        }
+    }
+
+    void insert ( std::initializer_list<value_type> entries )
+    {
+        insert(entries.begin(), entries.end());
+    }
+
+    /**
+     @brief remove the entry at pos, which must not be end()
+     @return the entry after it
+     */
+    iterator erase ( const_iterator pos )
+    {
+        node * rm_node = const_cast<node *>(pos.cur_node);
+        node * next_node = getNext(rm_node);
+
+        /* deleteNode relinks nodes rather than moving entries, so next_node is still the successor */
+        deleteNode(rm_node);
+        freeNode(rm_node);
+        nodeCount--;
+
+        return iterator(next_node, &root);
+    }
+
+    iterator erase ( iterator pos )
+    {
+        return erase(const_iterator(pos));
+    }
+
+    iterator erase ( const_iterator first, const_iterator last )
+    {
+        while ( first != last )
+        {
+            first = erase(first);
+        }
+
+        return iterator(const_cast<node *>(last.cur_node), &root);
+    }
+
+    /**
+     @brief remove the entry of key
+     @return number of entries removed, 0 or 1
+     */
+    size_type erase ( const Key & key )
+    {
+        node * rm_node = findNode(key);
+
+        if ( rm_node )
+        {
+            erase(const_iterator(rm_node, &root));
+        }
+
+        return ( rm_node ) ? 1U : 0U;
+    }
+
+    void clear ( )
+    {
+        freeSubtree(root);
+        root = nullptr;
+        nodeCount = 0U;
+    }
+
+    /**
+     @brief first entry in key order that pred(entry) is true for, the #rbtree_find of the map
+     @return the entry, end() if none match
+     */
+    template < typename Predicate >
+    iterator find_if ( Predicate pred )
+    {
+        node * cur_node = getFirst(root);
+
+        while ( ( cur_node != nullptr ) && ( ! pred(*cur_node->entry()) ) )
+        {
+            cur_node = getNext(cur_node);
+        }
+
+        return iterator(cur_node, &root);
+    }
+
+    template < typename Predicate >
+    const_iterator find_if ( Predicate pred ) const
+    {
+        const node * cur_node = getFirst(root);
+
+        while ( ( cur_node != nullptr ) && ( ! pred(*cur_node->entry()) ) )
+        {
+            cur_node = getNext(cur_node);
+        }
+
+        return const_iterator(cur_node, &root);
+    }
+
+    /**
+     @brief call visit(entry) for every entry in key order. visit must not insert or erase
+     */
+    template < typename Visitor >
+    void for_each ( Visitor visit )
+    {
+        for ( node * cur_node = getFirst(root); cur_node != nullptr; cur_node = getNext(cur_node) )
+        {
+            visit(*cur_node->entry());
+        }
+    }
+
+    template < typename Visitor >
+    void for_each ( Visitor visit ) const
+    {
+        for ( const node * cur_node = getFirst(root); cur_node != nullptr; cur_node = getNext(cur_node) )
+        {
+            visit(*cur_node->entry());
+        }
+    }
+private:
+    void propagate ( const Alloc & other, std::true_type )
+    {
+        alloc = other;
+    }
+
+    void propagate ( const Alloc &, std::false_type )
+    {
+    }
+
+    /* std::pmr::polymorphic_allocator can't be assigned, only touch the allocator when the traits say to */
+    void swapAlloc ( Alloc & other, std::true_type )
+    {
+        using std::swap;
+        swap(alloc, other);
+    }
+
+    void swapAlloc ( Alloc &, std::false_type )
+    {
+    }
+
+    template < typename... Args >
+    node * createNode ( Args &&... args )
+    {
+        node_alloc nodeAlloc(alloc);
+        node * new_node = node_traits::allocate(nodeAlloc, 1U);
+
+        try
+        {
+            value_traits::construct(alloc, new_node->entry(), std::forward<Args>(args)...);
+        }
+        catch ( ... )
+        {
+            node_traits::deallocate(nodeAlloc, new_node, 1U);
+            throw;
+        }
+
+        new_node->left = nullptr;
+        new_node->right = nullptr;
+        new_node->parent = nullptr;
+        new_node->isRed = true;
+
+        return new_node;
+    }
+
+    void freeNode ( node * old_node )
+    {
+        node_alloc nodeAlloc(alloc);
+
+        value_traits::destroy(alloc, old_node->entry());
+        node_traits::deallocate(nodeAlloc, old_node, 1U);
+    }
+
+    void freeSubtree ( node * cur_node )
+    {
+        /* a balanced tree is shallow, the recursion is bounded by its height */
+        if ( cur_node )
+        {
+            freeSubtree(cur_node->left);
+            freeSubtree(cur_node->right);
+            freeNode(cur_node);
+        }
+    }
+
+    /* same shape & colours, no rebalancing. A throw frees what was copied so far */
+    node * cloneSubtree ( const node * src_node, node * parent )
+    {
+        node * copy_node = nullptr;
+
+        if ( src_node )
+        {
+            copy_node = createNode(*src_node->entry());
+            copy_node->isRed = src_node->isRed;
+            copy_node->parent = parent;
+
+            try
+            {
+                copy_node->left = cloneSubtree(src_node->left, copy_node);
+                copy_node->right = cloneSubtree(src_node->right, copy_node);
+            }
+            catch ( ... )
+            {
+                freeSubtree(copy_node);
+                throw;
+            }
+        }
+
+        return copy_node;
+    }
+
+    node * findNode ( const Key & key ) const
+    {
+        node * cur_node = root;
+
+        while ( cur_node )
+        {
+            if ( compare(key, cur_node->entry()->first) )
+            {
+                cur_node = cur_node->left;
+            }
+            else if ( compare(cur_node->entry()->first, key) )
+            {
+                cur_node = cur_node->right;
+            }
+            else
+            {
+                /* match */
+                break;
+            }
+        }
+
+        return cur_node;
+    }
+
+    /* lowest node above key if isUpper, otherwise the lowest not below it */
+    node * findBound ( const Key & key, bool isUpper ) const
+    {
+        node * cur_node = root;
+        node * bound = nullptr;
+
+        while ( cur_node )
+        {
+            if ( ( isUpper ) ? compare(key, cur_node->entry()->first) : ( ! compare(cur_node->entry()->first, key) ) )
+            {
+                bound = cur_node;
+                cur_node = cur_node->left;
+            }
+            else
+            {
+                cur_node = cur_node->right;
+            }
+        }
+
+        return bound;
+    }
+
+    /* the node holding key, or nullptr with where a node for key would hang */
+    node * findSlot ( const Key & key, node ** parent, bool * isLeft ) const
+    {
+        node * cur_node = root;
+
+        while ( cur_node )
+        {
+            *parent = cur_node;
+
+            if ( compare(key, cur_node->entry()->first) )
+            {
+                *isLeft = true;
+                cur_node = cur_node->left;
+            }
+            else if ( compare(cur_node->entry()->first, key) )
+            {
+                *isLeft = false;
+                cur_node = cur_node->right;
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        return cur_node;
+    }
+
+    template < typename K, typename... Args >
+    std::pair<iterator, bool> emplaceKey ( K && key, Args &&... args )
+    {
+        node * parent = nullptr;
+        bool isLeft = false;
+        node * cur_node = findSlot(key, &parent, &isLeft);
+        bool isInserted = ( cur_node == nullptr );
+
+        if ( isInserted )
+        {
+            cur_node = createNode(std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)), std::forward_as_tuple(std::forward<Args>(args)...));
+            linkNode(cur_node, parent, isLeft);
+        }
+
+        return std::pair<iterator, bool>(iterator(cur_node, &root), isInserted);
+    }
+
+    void linkNode ( node * ins_node, node * parent, bool isLeft )
+    {
+        ins_node->parent = parent;
+
+        if ( parent == nullptr )
+        {
+            root = ins_node;
+        }
+        else if ( isLeft )
+        {
+            parent->left = ins_node;
+        }
+        else
+        {
+            parent->right = ins_node;
+        }
+
+        insertFixUp(ins_node);
+        nodeCount++;
+    }
+
+    static bool isRed ( const node * cur_node )
+    {
+        /* leaves are black */
+        return ( ( cur_node != nullptr ) && ( cur_node->isRed ) );
+    }
+
+    template < typename N >
+    static N * getFirst ( N * cur_node )
+    {
+        while ( ( cur_node ) && ( cur_node->left ) )
+        {
+            cur_node = cur_node->left;
+        }
+
+        return cur_node;
+    }
+
+    template < typename N >
+    static N * getLast ( N * cur_node )
+    {
+        while ( ( cur_node ) && ( cur_node->right ) )
+        {
+            cur_node = cur_node->right;
+        }
+
+        return cur_node;
+    }
+
+    template < typename N >
+    static N * getNext ( N * cur_node )
+    {
+        N * parent = nullptr;
+
+        if ( cur_node->right )
+        {
+            return getFirst(cur_node->right);
+        }
+
+        parent = cur_node->parent;
+
+        while ( ( parent != nullptr ) && ( parent->right == cur_node ) )
+        {
+            cur_node = parent;
+            parent = parent->parent;
+        }
+
+        return parent;
+    }
+
+    template < typename N >
+    static N * getPrev ( N * cur_node )
+    {
+        N * parent = nullptr;
+
+        if ( cur_node->left )
+        {
+            return getLast(cur_node->left);
+        }
+
+        parent = cur_node->parent;
+
+        while ( ( parent != nullptr ) && ( parent->left == cur_node ) )
+        {
+            cur_node = parent;
+            parent = parent->parent;
+        }
+
+        return parent;
+    }
+
+    void rotateLeft ( node * p )
+    {
+        node * q = p->right;
+        node * parent = p->parent;
+
+        if ( parent == nullptr )
+        {
+            root = q;
+        }
+        else if ( parent->left == p )
+        {
+            parent->left = q;
+        }
+        else
+        {
+            parent->right = q;
+        }
+
+        q->parent = parent;
+        p->parent = q;
+        p->right = q->left;
+
+        if ( p->right )
+        {
+            p->right->parent = p;
+        }
+
+        q->left = p;
+    }
+
+    void rotateRight ( node * p )
+    {
+        node * q = p->left;
+        node * parent = p->parent;
+
+        if ( parent == nullptr )
+        {
+            root = q;
+        }
+        else if ( parent->left == p )
+        {
+            parent->left = q;
+        }
+        else
+        {
+            parent->right = q;
+        }
+
+        q->parent = parent;
+        p->parent = q;
+        p->left = q->right;
+
+        if ( p->left )
+        {
+            p->left->parent = p;
+        }
+
+        q->right = p;
+    }
+
+    void insertFixUp ( node * cur_node )
+    {
+        while ( isRed(cur_node->parent) )
+        {
+            /* a red parent is never the root, so there is a grandparent */
+            node * parent = cur_node->parent;
+            node * grandParent = parent->parent;
+
+            if ( parent == grandParent->left )
+            {
+                node * uncle = grandParent->right;
+
+                if ( isRed(uncle) )
+                {
+                    parent->isRed = false;
+                    uncle->isRed = false;
+                    grandParent->isRed = true;
+
+                    cur_node = grandParent;
+                }
+                else
+                {
+                    if ( cur_node == parent->right )
+                    {
+                        /* Move up to our parent first, the rotation puts it below us */
+                        cur_node = parent;
+                        rotateLeft(cur_node);
+                    }
+
+                    cur_node->parent->isRed = false;
+                    grandParent->isRed = true;
+
+                    rotateRight(grandParent);
+                }
+            }
+            /* symmetric to above branch */
+            else
+            {
+                node * uncle = grandParent->left;
+
+                if ( isRed(uncle) )
+                {
+                    parent->isRed = false;
+                    uncle->isRed = false;
+                    grandParent->isRed = true;
+
+                    cur_node = grandParent;
+                }
+                else
+                {
+                    if ( cur_node == parent->left )
+                    {
+                        /* Move up to our parent first, the rotation puts it below us */
+                        cur_node = parent;
+                        rotateRight(cur_node);
+                    }
+
+                    cur_node->parent->isRed = false;
+                    grandParent->isRed = true;
+
+                    rotateLeft(grandParent);
+                }
+            }
+        }
+
+        root->isRed = false;
+    }
+
+    void transplant ( node * old_node, node * new_node )
+    {
+        if ( old_node->parent == nullptr )
+        {
+            root = new_node;
+        }
+        else if ( old_node == old_node->parent->left )
+        {
+            old_node->parent->left = new_node;
+        }
+        else
+        {
+            old_node->parent->right = new_node;
+        }
+
+        if ( new_node )
+        {
+            new_node->parent = old_node->parent;
+        }
+    }
+
+    void deleteNode ( node * rm_node )
+    {
+        bool removedRed = rm_node->isRed;
+        node * child = nullptr;
+        node * child_parent = nullptr;
+
+        /* z has at most one child. Replace nodes position with that child */
+        if ( rm_node->left == nullptr )
+        {
+            child = rm_node->right;
+            child_parent = rm_node->parent;
+            transplant(rm_node, rm_node->right);
+        }
+        else if ( rm_node->right == nullptr )
+        {
+            child = rm_node->left;
+            child_parent = rm_node->parent;
+            transplant(rm_node, rm_node->left);
+        }
+        /* z has both children */
+        else
+        {
+            /* find the closest living relative on the right side & drop in place */
+            node * replacement_node = getFirst(rm_node->right);
+
+            removedRed = replacement_node->isRed;
+            child = replacement_node->right;
+
+            if ( replacement_node->parent == rm_node )
+            {
+                child_parent = replacement_node;
+            }
+            else
+            {
+                child_parent = replacement_node->parent;
+                transplant(replacement_node, replacement_node->right);
+
+                replacement_node->right = rm_node->right;
+                replacement_node->right->parent = replacement_node;
+            }
+
+            transplant(rm_node, replacement_node);
+
+            /* now tidy up the links */
+            replacement_node->left = rm_node->left;
+            replacement_node->left->parent = replacement_node;
+            replacement_node->isRed = rm_node->isRed;
+        }
+
+        /* removing a black node shortens every path through it. Restore the black height */
+        if ( removedRed == false )
+        {
+            deleteFixUp(child, child_parent);
+        }
+    }
+
+    void deleteFixUp ( node * cur_node, node * cur_parent )
+    {
+        /* cur_node may be nullptr (a black leaf), so its parent is tracked separately */
+        while ( ( cur_node != root ) && ( ! isRed(cur_node) ) )
+        {
+            if ( cur_node == cur_parent->left )
+            {
+                node * sibling = cur_parent->right;
+
+                if ( isRed(sibling) )
+                {
+                    sibling->isRed = false;
+                    cur_parent->isRed = true;
+
+                    rotateLeft(cur_parent);
+
+                    sibling = cur_parent->right;
+                }
+
+                if ( ( ! isRed(sibling->left) ) && ( ! isRed(sibling->right) ) )
+                {
+                    sibling->isRed = true;
+
+                    cur_node = cur_parent;
+                    cur_parent = cur_node->parent;
+                }
+                else
+                {
+                    if ( ! isRed(sibling->right) )
+                    {
+                        sibling->left->isRed = false;
+                        sibling->isRed = true;
+
+                        rotateRight(sibling);
+
+                        sibling = cur_parent->right;
+                    }
+
+                    sibling->isRed = cur_parent->isRed;
+                    cur_parent->isRed = false;
+                    sibling->right->isRed = false;
+
+                    rotateLeft(cur_parent);
+
+                    /* adjustments finished */
+                    cur_node = root;
+                }
+            }
+            /* same as previous branch */
+            else
+            {
+                node * sibling = cur_parent->left;
+
+                if ( isRed(sibling) )
+                {
+                    sibling->isRed = false;
+                    cur_parent->isRed = true;
+
+                    rotateRight(cur_parent);
+
+                    sibling = cur_parent->left;
+                }
+
+                if ( ( ! isRed(sibling->right) ) && ( ! isRed(sibling->left) ) )
+                {
+                    sibling->isRed = true;
+
+                    cur_node = cur_parent;
+                    cur_parent = cur_node->parent;
+                }
+                else
+                {
+                    if ( ! isRed(sibling->left) )
+                    {
+                        sibling->right->isRed = false;
+                        sibling->isRed = true;
+
+                        rotateLeft(sibling);
+
+                        sibling = cur_parent->left;
+                    }
+
+                    sibling->isRed = cur_parent->isRed;
+                    cur_parent->isRed = false;
+                    sibling->left->isRed = false;
+
+                    rotateRight(cur_parent);
+
+                    /* adjustments complete */
+                    cur_node = root;
+                }
+            }
+        }
+
+        if ( cur_node )
+        {
+            cur_node->isRed = false;
+        }
+    }
+};
+
+
+template < typename Key, typename Value, typename Compare, typename Alloc >
+void swap ( map<Key, Value, Compare, Alloc> & lhs, map<Key, Value, Compare, Alloc> & rhs ) noexcept
+{
+    lhs.swap(rhs);
+}
+
+template < typename Key, typename Value, typename Compare, typename Alloc >
+bool operator== ( const map<Key, Value, Compare, Alloc> & lhs, const map<Key, Value, Compare, Alloc> & rhs )
+{
+    return ( ( lhs.size() == rhs.size() ) && ( std::equal(lhs.begin(), lhs.end(), rhs.begin()) ) );
+}
+
+template < typename Key, typename Value, typename Compare, typename Alloc >
+bool operator!= ( const map<Key, Value, Compare, Alloc> & lhs, const map<Key, Value, Compare, Alloc> & rhs )
+{
+    return ! ( lhs == rhs );
+}
+
+
+#ifdef RBTREE_HPP_PMR
+namespace pmr
+{
+
+/**
+ @brief rbtree::map on a std::pmr::memory_resource. Entries are built with uses-allocator construction, so
+ std::pmr values (eg std::pmr::string) allocate from the same resource. With a std::pmr::monotonic_buffer_resource
+ destroying the map frees nothing & the memory goes back in one release() of the resource
+ */
+template < typename Key, typename Value, typename Compare = std::less<Key> >
+using map = rbtree::map< Key, Value, Compare, std::pmr::polymorphic_allocator< std::pair<const Key, Value> > >;
+
+} /* namespace pmr */
+#endif
+
+
+} /* namespace rbtree */
+
+
+#endif /* __RBTREE_HPP */
@@ -0,0 +1,638 @@
+/**
+ @file
+ Red-Black Binary Search Tree - typed trees generated by macro
+
+ @details optional, in the style of the BSD tree.h & klib macros. The library stores void *'s under
+ #RBTREE_KEY's it hands out, so a value is a second allocation & a second miss, and keys can only be
+ compared as integers. #RBTREE_GENERATE instantiates the same red-black algorithms for one key type, value
+ type & comparison: nodes hold the key & the value inline, and the comparison is expanded in place, so a
+ lookup of integer keys compiles to a compare & select per level, as rbtree_inline.h does.
+
+ @code
+ typedef struct { uint32_t hits; char tag[12]; } RECORD;
+
+ RBTREE_GENERATE(records, uint32_t, RECORD, RBTREE_GEN_CMP_NUM)
+
+ records_tree tree;
+ RECORD record = { 0U, "a" };
+ RECORD * stored = NULL;
+
+ records_init(&tree);
+ records_insert(&tree, 42U, record);
+
+ if ( ( stored = records_retrieve(&tree, 42U) ) != NULL )
+ {
+     stored->hits++;
+ }
+
+ records_destroy(&tree);
+ @endcode
+
+ For name the following are generated, all operating in O(log n) unless stated:
+ name_node & name_tree types \n
+ void name_init ( name_tree * tree ) - an empty tree \n
+ void name_destroy ( name_tree * tree ) - frees every node, O(n). The tree is empty afterwards \n
+ uint32_t name_count ( const name_tree * tree ) - O(1) \n
+ name_node * name_find ( const name_tree * tree, key_type key ) - NULL if not stored \n
+ value_type * name_retrieve ( const name_tree * tree, key_type key ) - the value in the node, NULL if not stored \n
+ RBTREE_STATUS name_insert ( name_tree * tree, key_type key, value_type value ) - value is copied into the node \n
+ RBTREE_STATUS name_delete ( name_tree * tree, key_type key, value_type * ret_value ) - ret_value may be NULL \n
+ name_node * name_first / name_last ( const name_tree * tree ) \n
+ name_node * name_next / name_prev ( const name_node * node ) - in key order, NULL past the ends \n
+ RBTREE_STATUS name_validate ( const name_tree * tree ) - checks every red-black property, O(n)
+
+ cmp(a,b) may be a function or function like macro, returning < 0, 0 or > 0 as a orders before, the same as
+ or after b. Nodes come from RBTREE_GEN_MALLOC & go back through RBTREE_GEN_FREE, define them before
+ including this header to use another allocator. Not thread safe, guard a tree shared between threads.
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#ifndef __RBTREE_GEN_H
+#define __RBTREE_GEN_H
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "rbtree.h"
+
+
+#ifndef RBTREE_GEN_MALLOC
+#define RBTREE_GEN_MALLOC(size) malloc(size)
+#endif
+
+#ifndef RBTREE_GEN_FREE
+#define RBTREE_GEN_FREE(ptr) free(ptr)
+#endif
+
+/* numeric keys, ascending. Equality first, so a lookup compiles to compares & a select rather than arithmetic */
+#define RBTREE_GEN_CMP_NUM(a,b) ( ( (a) == (b) ) ? 0 : ( ( (a) < (b) ) ? -1 : 1 ) )
+
+/* NULL leaves are black */
+#define RBTREE_GEN_ISRED(n) ( ( (n) != NULL ) && ( (n)->isRed ) )
+
+/**
+ @brief the node & tree types of name
+ */
+#define RBTREE_GEN_TYPES(name, key_type, value_type) \
+typedef struct _##name##_node \
+{ \
+    struct _##name##_node * left;       /* lower keys */ \
+    struct _##name##_node * right;      /* higher keys */ \
+    struct _##name##_node * parent; \
+    key_type key; \
+    bool isRed; \
+    value_type value; \
+} name##_node; \
+\
+typedef struct _##name##_tree \
+{ \
+    name##_node * root; \
+    uint32_t count; \
+} name##_tree;
+
+/**
+ @brief declarations of the functions of name, for a header when RBTREE_GEN_FUNCS is expanded in one source file
+ */
+#define RBTREE_GEN_PROTOTYPES(scope, name, key_type, value_type) \
+scope void name##_init ( name##_tree * tree ); \
+scope void name##_destroy ( name##_tree * tree ); \
+scope uint32_t name##_count ( const name##_tree * tree ); \
+scope name##_node * name##_find ( const name##_tree * tree, key_type key ); \
+scope value_type * name##_retrieve ( const name##_tree * tree, key_type key ); \
+scope RBTREE_STATUS name##_insert ( name##_tree * tree, key_type key, value_type value ); \
+scope RBTREE_STATUS name##_delete ( name##_tree * tree, key_type key, value_type * ret_value ); \
+scope name##_node * name##_first ( const name##_tree * tree ); \
+scope name##_node * name##_last ( const name##_tree * tree ); \
+scope name##_node * name##_next ( const name##_node * node ); \
+scope name##_node * name##_prev ( const name##_node * node ); \
+scope RBTREE_STATUS name##_validate ( const name##_tree * tree );
+
+/**
+ @brief definitions of the functions of name
+ @details scope is static inline for a tree private to a source file, or empty alongside RBTREE_GEN_PROTOTYPES
+ */
+#define RBTREE_GEN_FUNCS(scope, name, key_type, value_type, cmp) \
+static inline name##_node * name##_prv_getFirst ( name##_node * node ) \
+{ \
+    while ( ( node != NULL ) && ( node->left != NULL ) ) \
+    { \
+        node = node->left; \
+    } \
+    \
+    return node; \
+} \
+\
+static inline name##_node * name##_prv_getLast ( name##_node * node ) \
+{ \
+    while ( ( node != NULL ) && ( node->right != NULL ) ) \
+    { \
+        node = node->right; \
+    } \
+    \
+    return node; \
+} \
+\
+static inline void name##_prv_replaceChild ( name##_tree * tree, name##_node * parent, name##_node * old_node, name##_node * new_node ) \
+{ \
+    if ( parent == NULL ) \
+    { \
+        tree->root = new_node; \
+    } \
+    else if ( parent->left == old_node ) \
+    { \
+        parent->left = new_node; \
+    } \
+    else \
+    { \
+        parent->right = new_node; \
+    } \
+} \
+\
+static inline void name##_prv_rotateLeft ( name##_tree * tree, name##_node * node ) \
+{ \
+    name##_node * right = node->right; \
+    \
+    node->right = right->left; \
+    \
+    if ( right->left ) \
+    { \
+        right->left->parent = node; \
+    } \
+    \
+    name##_prv_replaceChild(tree, node->parent, node, right); \
+    right->parent = node->parent; \
+    right->left = node; \
+    node->parent = right; \
+} \
+\
+static inline void name##_prv_rotateRight ( name##_tree * tree, name##_node * node ) \
+{ \
+    name##_node * left = node->left; \
+    \
+    node->left = left->right; \
+    \
+    if ( left->right ) \
+    { \
+        left->right->parent = node; \
+    } \
+    \
+    name##_prv_replaceChild(tree, node->parent, node, left); \
+    left->parent = node->parent; \
+    left->right = node; \
+    node->parent = left; \
+} \
+\
+static inline void name##_prv_insertFixUp ( name##_tree * tree, name##_node * cur_node ) \
+{ \
+    while ( RBTREE_GEN_ISRED(cur_node->parent) ) \
+    { \
+        name##_node * parent = cur_node->parent; \
+        name##_node * grandparent = parent->parent;     /* a red parent is never the root */ \
+        \
+        if ( parent == grandparent->left ) \
+        { \
+            name##_node * uncle = grandparent->right; \
+            \
+            if ( RBTREE_GEN_ISRED(uncle) ) \
+            { \
+                parent->isRed = false; \
+                uncle->isRed = false; \
+                grandparent->isRed = true; \
+                cur_node = grandparent; \
+            } \
+            else \
+            { \
+                if ( cur_node == parent->right ) \
+                { \
+                    cur_node = parent; \
+                    name##_prv_rotateLeft(tree, cur_node); \
+                    parent = cur_node->parent; \
+                } \
+                \
+                parent->isRed = false; \
+                grandparent->isRed = true; \
+                name##_prv_rotateRight(tree, grandparent); \
+            } \
+        } \
+        /* same as previous branch */ \
+        else \
+        { \
+            name##_node * uncle = grandparent->left; \
+            \
+            if ( RBTREE_GEN_ISRED(uncle) ) \
+            { \
+                parent->isRed = false; \
+                uncle->isRed = false; \
+                grandparent->isRed = true; \
+                cur_node = grandparent; \
+            } \
+            else \
+            { \
+                if ( cur_node == parent->left ) \
+                { \
+                    cur_node = parent; \
+                    name##_prv_rotateRight(tree, cur_node); \
+                    parent = cur_node->parent; \
+                } \
+                \
+                parent->isRed = false; \
+                grandparent->isRed = true; \
+                name##_prv_rotateLeft(tree, grandparent); \
+            } \
+        } \
+    } \
+    \
+    tree->root->isRed = false; \
+} \
+\
+static inline void name##_prv_transplant ( name##_tree * tree, name##_node * old_node, name##_node * new_node ) \
+{ \
+    name##_prv_replaceChild(tree, old_node->parent, old_node, new_node); \
+    \
+    if ( new_node ) \
+    { \
+        new_node->parent = old_node->parent; \
+    } \
+} \
+\
+static inline void name##_prv_deleteFixUp ( name##_tree * tree, name##_node * cur_node, name##_node * cur_parent ) \
+{ \
+    /* cur_node may be NULL (a black leaf), so its parent is tracked separately */ \
+    while ( ( cur_node != tree->root ) && ( RBTREE_GEN_ISRED(cur_node) == false ) ) \
+    { \
+        if ( cur_node == cur_parent->left ) \
+        { \
+            name##_node * sibling = cur_parent->right; \
+            \
+            if ( RBTREE_GEN_ISRED(sibling) ) \
+            { \
+                sibling->isRed = false; \
+                cur_parent->isRed = true; \
+                name##_prv_rotateLeft(tree, cur_parent); \
+                sibling = cur_parent->right; \
+            } \
+            \
+            if ( ( RBTREE_GEN_ISRED(sibling->left) == false ) && ( RBTREE_GEN_ISRED(sibling->right) == false ) ) \
+            { \
+                sibling->isRed = true; \
+                cur_node = cur_parent; \
+                cur_parent = cur_node->parent; \
+            } \
+            else \
+            { \
+                if ( RBTREE_GEN_ISRED(sibling->right) == false ) \
+                { \
+                    sibling->left->isRed = false; \
+                    sibling->isRed = true; \
+                    name##_prv_rotateRight(tree, sibling); \
+                    sibling = cur_parent->right; \
+                } \
+                \
+                sibling->isRed = cur_parent->isRed; \
+                cur_parent->isRed = false; \
+                sibling->right->isRed = false; \
+                name##_prv_rotateLeft(tree, cur_parent); \
+                \
+                /* adjustments finished */ \
+                cur_node = tree->root; \
+                break; \
+            } \
+        } \
+        /* same as previous branch */ \
+        else \
+        { \
+            name##_node * sibling = cur_parent->left; \
+            \
+            if ( RBTREE_GEN_ISRED(sibling) ) \
+            { \
+                sibling->isRed = false; \
+                cur_parent->isRed = true; \
+                name##_prv_rotateRight(tree, cur_parent); \
+                sibling = cur_parent->left; \
+            } \
+            \
+            if ( ( RBTREE_GEN_ISRED(sibling->left) == false ) && ( RBTREE_GEN_ISRED(sibling->right) == false ) ) \
+            { \
+                sibling->isRed = true; \
+                cur_node = cur_parent; \
+                cur_parent = cur_node->parent; \
+            } \
+            else \
+            { \
+                if ( RBTREE_GEN_ISRED(sibling->left) == false ) \
+                { \
+                    sibling->right->isRed = false; \
+                    sibling->isRed = true; \
+                    name##_prv_rotateLeft(tree, sibling); \
+                    sibling = cur_parent->left; \
+                } \
+                \
+                sibling->isRed = cur_parent->isRed; \
+                cur_parent->isRed = false; \
+                sibling->left->isRed = false; \
+                name##_prv_rotateRight(tree, cur_parent); \
+                \
+                /* adjustments finished */ \
+                cur_node = tree->root; \
+                break; \
+            } \
+        } \
+    } \
+    \
+    if ( cur_node ) \
+    { \
+        cur_node->isRed = false; \
+    } \
+} \
+\
+static inline void name##_prv_deleteNode ( name##_tree * tree, name##_node * rmnode ) \
+{ \
+    bool removedRed = rmnode->isRed; \
+    name##_node * child = NULL; \
+    name##_node * child_parent = NULL; \
+    \
+    /* z has at most one child. Replace nodes position with that child */ \
+    if ( rmnode->left == NULL ) \
+    { \
+        child = rmnode->right; \
+        child_parent = rmnode->parent; \
+        name##_prv_transplant(tree, rmnode, rmnode->right); \
+    } \
+    else if ( rmnode->right == NULL ) \
+    { \
+        child = rmnode->left; \
+        child_parent = rmnode->parent; \
+        name##_prv_transplant(tree, rmnode, rmnode->left); \
+    } \
+    /* z has both children */ \
+    else \
+    { \
+        /* find the closest living relative on the right side & drop in place */ \
+        name##_node * replacement_node = name##_prv_getFirst(rmnode->right); \
+        \
+        removedRed = replacement_node->isRed; \
+        child = replacement_node->right; \
+        \
+        if ( replacement_node->parent == rmnode ) \
+        { \
+            child_parent = replacement_node; \
+        } \
+        else \
+        { \
+            child_parent = replacement_node->parent; \
+            name##_prv_transplant(tree, replacement_node, replacement_node->right); \
+            replacement_node->right = rmnode->right; \
+            replacement_node->right->parent = replacement_node; \
+        } \
+        \
+        name##_prv_transplant(tree, rmnode, replacement_node); \
+        \
+        /* now tidy up the links */ \
+        replacement_node->left = rmnode->left; \
+        replacement_node->left->parent = replacement_node; \
+        replacement_node->isRed = rmnode->isRed; \
+    } \
+    \
+    /* removing a black node shortens every path through it. Restore the black height */ \
+    if ( removedRed == false ) \
+    { \
+        name##_prv_deleteFixUp(tree, child, child_parent); \
+    } \
+} \
+\
+/* post-order, returns the black height counting the NULL leaves, or 0 if the subtree is broken */ \
+static inline uint32_t name##_prv_validateSubtree ( const name##_node * node, const name##_node * parent, const name##_node * low, const name##_node * high, uint32_t depth, uint32_t * count ) \
+{ \
+    uint32_t height = 0U; \
+    uint32_t leftHeight = 0U; \
+    uint32_t rightHeight = 0U; \
+    \
+    if ( node == NULL ) \
+    { \
+        height = 1U; \
+    } \
+    else if ( ( depth < RBTREE_DEPTH_MAX ) && ( node->parent == parent ) \
+           && ( ( low == NULL ) || ( cmp(low->key, node->key) < 0 ) ) && ( ( high == NULL ) || ( cmp(node->key, high->key) < 0 ) ) \
+           && ( ( node->isRed == false ) || ( ( RBTREE_GEN_ISRED(node->left) == false ) && ( RBTREE_GEN_ISRED(node->right) == false ) ) ) \
+           && ( ( leftHeight = name##_prv_validateSubtree(node->left, node, low, node, depth+1U, count) ) != 0U ) \
+           && ( ( rightHeight = name##_prv_validateSubtree(node->right, node, node, high, depth+1U, count) ) == leftHeight ) ) \
+    { \
+        height = leftHeight + ( node->isRed ? 0U : 1U ); \
+        (*count)++; \
+    } \
+    \
+    return height; \
+} \
+\
+scope void name##_init ( name##_tree * tree ) \
+{ \
+    tree->root = NULL; \
+    tree->count = 0U; \
+} \
+\
+scope void name##_destroy ( name##_tree * tree ) \
+{ \
+    name##_node * node = tree->root; \
+    \
+    /* post-order over the parent links, detaching each leaf before it is freed */ \
+    while ( node ) \
+    { \
+        if ( node->left ) \
+        { \
+            node = node->left; \
+        } \
+        else if ( node->right ) \
+        { \
+            node = node->right; \
+        } \
+        else \
+        { \
+            name##_node * parent = node->parent; \
+            \
+            name##_prv_replaceChild(tree, parent, node, NULL); \
+            RBTREE_GEN_FREE(node); \
+            node = parent; \
+        } \
+    } \
+    \
+    name##_init(tree); \
+} \
+\
+scope uint32_t name##_count ( const name##_tree * tree ) \
+{ \
+    return tree->count; \
+} \
+\
+scope name##_node * name##_find ( const name##_tree * tree, key_type key ) \
+{ \
+    name##_node * node = tree->root; \
+    int order = 0; \
+    \
+    /* one select per level rather than a branch each way, there is no jump to mispredict on random keys */ \
+    while ( ( node != NULL ) && ( ( order = cmp(key, node->key) ) != 0 ) ) \
+    { \
+        node = ( order < 0 ) ? node->left : node->right; \
+    } \
+    \
+    return node; \
+} \
+\
+scope value_type * name##_retrieve ( const name##_tree * tree, key_type key ) \
+{ \
+    name##_node * node = name##_find(tree, key); \
+    \
+    return ( node != NULL ) ? &node->value : NULL; \
+} \
+\
+scope RBTREE_STATUS name##_insert ( name##_tree * tree, key_type key, value_type value ) \
+{ \
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF; \
+    name##_node * parent = NULL; \
+    name##_node ** link = &tree->root; \
+    \
+    while ( *link != NULL ) \
+    { \
+        int order = cmp(key, (*link)->key); \
+        \
+        if ( order == 0 ) \
+        { \
+            break; \
+        } \
+        \
+        parent = *link; \
+        link = ( order < 0 ) ? &parent->left : &parent->right; \
+    } \
+    \
+    if ( *link != NULL ) \
+    { \
+        status = RBTREE_STATUS_FAIL_KEY_ALREADY_STORED; \
+    } \
+    else if ( tree->count == UINT32_MAX ) \
+    { \
+        status = RBTREE_STATUS_FAIL; \
+    } \
+    else if ( ( *link = (name##_node *)RBTREE_GEN_MALLOC(sizeof(name##_node)) ) == NULL ) \
+    { \
+        status = RBTREE_STATUS_FAIL_MALLOC_FAILURE; \
+    } \
+    else \
+    { \
+        name##_node * node = *link; \
+        \
+        node->left = NULL; \
+        node->right = NULL; \
+        node->parent = parent; \
+        node->key = key; \
+        node->isRed = true; \
+        node->value = value; \
+        tree->count++; \
+        \
+        name##_prv_insertFixUp(tree, node); \
+        status = RBTREE_STATUS_OK; \
+    } \
+    \
+    return status; \
+} \
+\
+scope RBTREE_STATUS name##_delete ( name##_tree * tree, key_type key, value_type * ret_value ) \
+{ \
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF; \
+    name##_node * node = name##_find(tree, key); \
+    \
+    if ( node == NULL ) \
+    { \
+        status = RBTREE_STATUS_FAIL_KEY_DOES_NOT_EXIST; \
+    } \
+    else \
+    { \
+        if ( ret_value ) \
+        { \
+            *ret_value = node->value; \
+        } \
+        \
+        name##_prv_deleteNode(tree, node); \
+        RBTREE_GEN_FREE(node); \
+        tree->count--; \
+        status = RBTREE_STATUS_OK; \
+    } \
+    \
+    return status; \
+} \
+\
+scope name##_node * name##_first ( const name##_tree * tree ) \
+{ \
+    return name##_prv_getFirst(tree->root); \
+} \
+\
+scope name##_node * name##_last ( const name##_tree * tree ) \
+{ \
+    return name##_prv_getLast(tree->root); \
+} \
+\
+scope name##_node * name##_next ( const name##_node * node ) \
+{ \
+    name##_node * parent = node->parent; \
+    \
+    if ( node->right ) \
+    { \
+        return name##_prv_getFirst(node->right); \
+    } \
+    \
+    while ( ( parent != NULL ) && ( parent->right == node ) ) \
+    { \
+        node = parent; \
+        parent = parent->parent; \
+    } \
+    \
+    return parent; \
+} \
+\
+scope name##_node * name##_prev ( const name##_node * node ) \
+{ \
+    name##_node * parent = node->parent; \
+    \
+    if ( node->left ) \
+    { \
+        return name##_prv_getLast(node->left); \
+    } \
+    \
+    while ( ( parent != NULL ) && ( parent->left == node ) ) \
+    { \
+        node = parent; \
+        parent = parent->parent; \
+    } \
+    \
+    return parent; \
+} \
+\
+scope RBTREE_STATUS name##_validate ( const name##_tree * tree ) \
+{ \
+    RBTREE_STATUS status = RBTREE_STATUS_FAIL_CORRUPT_DATA; \
+    uint32_t count = 0U; \
+    \
+    if ( ( RBTREE_GEN_ISRED(tree->root) == false ) \
+      && ( name##_prv_validateSubtree(tree->root, NULL, NULL, NULL, 0U, &count) != 0U ) \
+      && ( count == tree->count ) ) \
+    { \
+        status = RBTREE_STATUS_OK; \
+    } \
+    \
+    return status; \
+}
+
+/**
+ @brief a complete tree private to the including source file
+ */
+#define RBTREE_GENERATE(name, key_type, value_type, cmp) \
+RBTREE_GEN_TYPES(name, key_type, value_type) \
+RBTREE_GEN_FUNCS(static inline, name, key_type, value_type, cmp)
+
+
+#endif /* __RBTREE_GEN_H */
@@ -0,0 +1,195 @@
+/**
+ @file
+ Red-Black Binary Search Tree - inline lookups
+
+ @details optional. Lookups through #rbtree_retrieveByKey are calls into the library, which also count stats
+ & check for latency sampling & tracing. The functions here walk the nodes directly & are static inline, so
+ a lookup in a loop compiles down to the compare & branch per level with no call, without LTO.
+ Get an #RBTREE_INLINE_TREE for a handle with #rbtree_getInlineTree. Standard & persistent trees only.
+
+ The same rules apply as for #rbtree_retrieveByKey: a standard tree must not be modified during the lookup.
+ A persistent tree frees nodes that writers copy, so to read alongside writers use a #rbtree_snapshot or
+ #rbtree_beginRead view. Inline lookups are not counted by #rbtree_getStats, sampled or traced.
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#ifndef __RBTREE_INLINE_H
+#define __RBTREE_INLINE_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "rbtree.h"
+
+
+/**
+ @brief a node as the library lays it out in memory, checked against the library's own at compile time
+ @details only key, value, left & right are for reading. Nodes of persistent trees have no parent
+ */
+typedef struct _RBTREE_INLINE_NODE
+{
+    int colour;                             /* internal */
+    RBTREE_KEY key;
+    void * value;
+    struct _RBTREE_INLINE_NODE * left;      /* lower keys */
+    struct _RBTREE_INLINE_NODE * right;     /* higher keys */
+    struct _RBTREE_INLINE_NODE * parent;    /* internal */
+} RBTREE_INLINE_NODE;
+
+/**
+ @brief where a tree's root is kept, valid until the handle is destroyed
+ */
+typedef struct _RBTREE_INLINE_TREE
+{
+    RBTREE_INLINE_NODE * const * root;      /* read on every call, rebalancing moves the root */
+} RBTREE_INLINE_TREE;
+
+/**
+ @brief in order walk that keeps its own path, so it needs no parent links
+ */
+typedef struct _RBTREE_INLINE_CURSOR
+{
+    uint32_t depth;
+    const RBTREE_INLINE_NODE * stack[RBTREE_DEPTH_MAX];  /* top is the current node */
+} RBTREE_INLINE_CURSOR;
+
+
+/**
+ @brief get the root reference of a tree for the inline functions
+ @param[in] handle tree handle
+ @param[out] tree populated upon success
+ @return returns #RBTREE_STATUS_OK on success, #RBTREE_STATUS_FAIL_NOT_SUPPORTED for image, shared & mapped trees
+ */
+RBTREE_STATUS rbtree_getInlineTree ( RBTREE_HANDLE handle, RBTREE_INLINE_TREE * tree );
+
+
+/**
+ @brief find the node of a key
+ @return the node, NULL if the key is not stored
+ */
+static inline const RBTREE_INLINE_NODE * rbtree_inline_find ( const RBTREE_INLINE_TREE * tree, RBTREE_KEY key )
+{
+    const RBTREE_INLINE_NODE * node = *tree->root;
+
+    while ( ( node != NULL ) && ( node->key != key ) )
+    {
+        node = ( key < node->key ) ? node->left : node->right;
+    }
+
+    return node;
+}
+
+/**
+ @brief #rbtree_retrieveByKey without the call
+ @return true & ret_data populated if the key is stored
+ */
+static inline bool rbtree_inline_retrieveByKey ( const RBTREE_INLINE_TREE * tree, RBTREE_KEY key, void ** ret_data )
+{
+    const RBTREE_INLINE_NODE * node = rbtree_inline_find(tree, key);
+
+    if ( node )
+    {
+        *ret_data = node->value;
+    }
+
+    return (bool) ( node != NULL );
+}
+
+/**
+ @brief #rbtree_doesKeyExist without the call
+ */
+static inline bool rbtree_inline_doesKeyExist ( const RBTREE_INLINE_TREE * tree, RBTREE_KEY key )
+{
+    return (bool) ( rbtree_inline_find(tree, key) != NULL );
+}
+
+/**
+ @brief current node of a cursor
+ @return the node, NULL once the cursor has stepped past the last key
+ */
+static inline const RBTREE_INLINE_NODE * rbtree_inline_cursorNode ( const RBTREE_INLINE_CURSOR * cursor )
+{
+    return ( cursor->depth > 0U ) ? cursor->stack[cursor->depth-1U] : NULL;
+}
+
+/**
+ @brief move a cursor to the lowest key
+ @return the node, NULL if the tree is empty
+ */
+static inline const RBTREE_INLINE_NODE * rbtree_inline_cursorFirst ( const RBTREE_INLINE_TREE * tree, RBTREE_INLINE_CURSOR * cursor )
+{
+    const RBTREE_INLINE_NODE * node = *tree->root;
+
+    cursor->depth = 0U;
+
+    while ( ( node != NULL ) && ( cursor->depth < RBTREE_DEPTH_MAX ) )
+    {
+        cursor->stack[cursor->depth++] = node;
+        node = node->left;
+    }
+
+    return rbtree_inline_cursorNode(cursor);
+}
+
+/**
+ @brief move a cursor to the lowest key >= key
+ @return the node, NULL if every key is lower
+ */
+static inline const RBTREE_INLINE_NODE * rbtree_inline_cursorSeek ( const RBTREE_INLINE_TREE * tree, RBTREE_INLINE_CURSOR * cursor, RBTREE_KEY key )
+{
+    const RBTREE_INLINE_NODE * node = *tree->root;
+
+    cursor->depth = 0U;
+
+    /* stack holds every node >= key that we went left of. Top is the lowest */
+    while ( ( node != NULL ) && ( cursor->depth < RBTREE_DEPTH_MAX ) )
+    {
+        if ( node->key >= key )
+        {
+            cursor->stack[cursor->depth++] = node;
+            node = node->left;
+        }
+        else
+        {
+            node = node->right;
+        }
+    }
+
+    return rbtree_inline_cursorNode(cursor);
+}
+
+/**
+ @brief step a cursor to the next key up
+ @return the node, NULL after the last key
+ */
+static inline const RBTREE_INLINE_NODE * rbtree_inline_cursorNext ( RBTREE_INLINE_CURSOR * cursor )
+{
+    if ( cursor->depth > 0U )
+    {
+        const RBTREE_INLINE_NODE * node = cursor->stack[--cursor->depth]->right;
+
+        while ( ( node != NULL ) && ( cursor->depth < RBTREE_DEPTH_MAX ) )
+        {
+            cursor->stack[cursor->depth++] = node;
+            node = node->left;
+        }
+    }
+
+    return rbtree_inline_cursorNode(cursor);
+}
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* __RBTREE_INLINE_H */
@@ -12,15 +12,71 @@
 #include "rbtree.h"
 #include <string.h>         /* memset */
 #include "rbtree_checks.h"
+#include "rbtree_persist.h"
+#include "rbtree_mvcc.h"
+#include "rbtree_parallel.h"
+#include "rbtree_serial.h"
+#include "rbtree_image.h"
+#include "rbtree_wal.h"
+#include "rbtree_checkpoint.h"
+#include "rbtree_arena.h"
+#include "rbtree_stats.h"
+#include "rbtree_latency.h"
+#include "rbtree_trace.h"
+#include "rbtree_lockprof.h"
+#include "rbtree_inline.h"
+#include <stddef.h>         /* offsetof */
+
+
+/* in-order position in any tree mode. Persistent nodes have no parent link so need a stack,
+   images & arenas have no RBT_NODE's so the entry is copied into copyNode */
+typedef struct _RBT_CURSOR
+{
+    RBT_NODE * node;
+    RBT_PERSIST_ITER iter;
+    uint32_t rank;
+    RBT_NODE copyNode;
+} RBT_CURSOR;
+
+/* rbtree_inline.h walks RBT_NODE's as RBTREE_INLINE_NODE's, fails to compile if the layouts part */
+typedef char RBT_INLINE_LAYOUT_CHECK[ ( ( sizeof(RBT_NODE) == sizeof(RBTREE_INLINE_NODE) ) &&
+                                       ( sizeof(RBT_COLOUR) == sizeof(int) ) &&
+                                       ( offsetof(RBT_NODE, key) == offsetof(RBTREE_INLINE_NODE, key) ) &&
+                                       ( offsetof(RBT_NODE, value) == offsetof(RBTREE_INLINE_NODE, value) ) &&
+                                       ( offsetof(RBT_NODE, left) == offsetof(RBTREE_INLINE_NODE, left) ) &&
+                                       ( offsetof(RBT_NODE, right) == offsetof(RBTREE_INLINE_NODE, right) ) ) ? 1 : -1 ];
+
+/* per-call state shared by the parallel workers */
+typedef struct _RBT_PARALLEL_CALL
+{
+    rbtree_visitor_t visit_fn;
+    rbtree_accumulator_t accumulate_fn;
+    rbtree_comparator_t cmp_fn;
+    void * userdata;
+    void ** results;        /* one accumulator, or matching node, per task */
+    RBT_ATOMIC(uint32_t) firstMatch;    /* lowest task holding a match */
+} RBT_PARALLEL_CALL;
+
+
+/* per-call state for rbtree_replayLog */
+typedef struct _RBT_REPLAY
+{
+    RBT_TREE * tree;
+    rbtree_decoder_t decode_fn;
+    void * userdata;
+    uint64_t keySeed;       /* one past the highest key seen */
+    bool isChanged;
+} RBT_REPLAY;
 
 
 /* private function declarations */
 static void* rbtree_prv_memAlloc_default ( size_t size );        /* NOT inline */
 static void rbtree_prv_memFree_default ( void * ptr );           /* NOT inline */
-static inline RBT_NODE * rbtree_prv_createNode ( RBT_TREE * tree );
-static inline void rbtree_prv_freeNode ( RBT_NODE * node, RBT_TREE * tree );
+static inline RBT_NODE * rbtree_prv_createNode ( RBT_TREE * tree, RBT_LATENCY_SAMPLE * timing );
+static inline void rbtree_prv_freeNode ( RBT_NODE * node, RBT_TREE * tree, RBT_LATENCY_SAMPLE * timing );
+static inline void rbtree_prv_setValue ( RBT_NODE * node, void * value, RBT_TREE * tree );
 static inline RBT_COLOUR rbtree_prv_getColour ( RBT_NODE * node );
-static inline void rbtree_prv_setColour ( RBT_COLOUR colour, RBT_NODE * node);
+static inline void rbtree_prv_setColour ( RBT_COLOUR colour, RBT_NODE * node, RBT_TREE * tree );
 static inline RBT_NODE * rbtree_prv_getSibling ( RBT_NODE * node );
 static inline RBT_NODE * rbtree_prv_getUncle ( RBT_NODE * node );
 static inline RBT_NODE * rbtree_prv_getParent ( RBT_NODE * node );
@@ -42,18 +98,41 @@ static inline void rbtree_prv_severLinkParentToNode ( RBT_NODE * node );
 static inline void rbtree_prv_rotateLeft ( RBT_NODE * node, RBT_TREE * tree );
 static inline void rbtree_prv_rotateRight ( RBT_NODE * node, RBT_TREE * tree );
 static inline RBTREE_STATUS rbtree_prv_insertNode ( RBT_NODE * ins_node, RBT_TREE * tree );
-static inline void rbtree_prv_deleteBSTCheck2 ( RBT_NODE * rmnode, RBT_TREE * tree );
-static inline void rbtree_prv_deleteBSTCheck1 ( RBT_NODE * rmnode, RBT_TREE * tree );
-static inline void rbtree_prv_deleteRBFixUp ( RBT_NODE * rmnode, RBT_TREE * tree );
+static inline void rbtree_prv_transplant ( RBT_NODE * old_node, RBT_NODE * new_node, RBT_TREE * tree );
+static inline void rbtree_prv_deleteNode ( RBT_NODE * rmnode, RBT_TREE * tree );
+static inline void rbtree_prv_deleteRBFixUp ( RBT_NODE * cur_node, RBT_NODE * cur_parent, RBT_TREE * tree );
 static inline void rbtree_prv_insertRBFixUp ( RBT_NODE * insnode, RBT_TREE * tree );
-static inline RBTREE_STATUS rbtree_prv_removeNodeFromTree ( RBT_NODE * rmnode, RBT_TREE * tree );
+static inline RBTREE_STATUS rbtree_prv_linkNodeIntoTree ( RBT_NODE * ins_node, RBT_TREE * tree, RBT_LATENCY_SAMPLE * timing, bool * linked );
+static inline RBTREE_STATUS rbtree_prv_removeNodeFromTree ( RBT_NODE * rmnode, RBT_TREE * tree, RBT_LATENCY_SAMPLE * timing );
 static inline void rbtree_prv_resetKeySeed ( RBT_TREE * tree );
+static inline RBTREE_STATUS rbtree_prv_reserveKeys ( RBT_TREE * tree, uint32_t count, RBTREE_KEY * first_key );
 static inline RBT_NODE * rbtree_prv_findKey ( RBTREE_KEY key, RBT_NODE * node );
+static inline RBTREE_STATUS rbtree_prv_removeKeyFromTree ( RBTREE_KEY key, RBT_TREE * tree, RBT_LATENCY_SAMPLE * timing );
+static inline RBT_NODE * rbtree_prv_cursorFirst ( RBT_CURSOR * cursor, RBT_TREE * tree );
+static inline RBT_NODE * rbtree_prv_cursorNext ( RBT_CURSOR * cursor, RBT_TREE * tree );
+static inline RBT_NODE * rbtree_prv_cursorAtRank ( RBT_CURSOR * cursor, uint32_t rank, RBT_TREE * tree );
+static inline RBT_NODE * rbtree_prv_cursorCopy ( RBT_CURSOR * cursor, RBTREE_KEY key, void * value );
+static inline RBT_NODE * rbtree_prv_lookupKey ( RBTREE_KEY key, RBT_CURSOR * cursor, RBT_TREE * tree );
+static inline RBT_NODE * rbtree_prv_getNodeAtIndex ( uint32_t index, RBT_CURSOR * cursor, RBT_TREE * tree );
+static inline uint32_t rbtree_prv_entryCount ( RBT_TREE * tree );
+static inline bool rbtree_prv_isMapped ( RBTREE_HANDLE handle );
+static inline bool rbtree_prv_isValueTree ( RBTREE_HANDLE handle );
+static inline RBT_LATENCY_SAMPLE * rbtree_prv_latencyBegin ( RBT_TREE * tree, RBT_LATENCY_SAMPLE * sample, RBTREE_LATENCY_OP op );
+static inline RBT_TRACE * rbtree_prv_traceBegin ( RBT_TREE * tree, uint64_t * start );
+static inline RBTREE_STATUS rbtree_prv_createTree ( RBTREE_HANDLE * handle, rbtree_memalloc_t mem_alloc, rbtree_memfree_t mem_free, RBT_TREE_MODE mode );
+static inline void rbtree_prv_raiseKeySeed ( RBT_TREE * tree, uint64_t keySeed );
+static inline RBTREE_STATUS rbtree_prv_commitLog ( RBT_TREE * tree );
+static RBTREE_STATUS rbtree_prv_replayRecord ( void * context, const RBT_WAL_RECORD * record );
+static inline RBT_NODE * rbtree_prv_pinRoot ( RBT_TREE * tree, uint32_t * nodeCount );
+static inline void rbtree_prv_unpinRoot ( RBT_NODE * root, RBT_TREE * tree );
+static bool rbtree_prv_visitForEach ( void * context, uint32_t task, RBT_NODE * node );
+static bool rbtree_prv_visitReduce ( void * context, uint32_t task, RBT_NODE * node );
+static bool rbtree_prv_visitFind ( void * context, uint32_t task, RBT_NODE * node );
 
 
 /* shorthand form's */
 #define getColour(n) rbtree_prv_getColour(n)
-#define setColour(colour,n) rbtree_prv_setColour(colour,n)
+#define setColour(colour,n,tree) rbtree_prv_setColour(colour,n,tree)
 #define isRoot(n) rbtree_prv_isRoot(n)
 #define isRed(n) rbtree_prv_isRed(n)
 #define isBlack(n) rbtree_prv_isBlack(n)
@@ -89,14 +168,27 @@ static void rbtree_prv_memFree_default ( void * ptr )
     rbtree_default_memFree(ptr);
 }
 
-static inline RBT_NODE * rbtree_prv_createNode ( RBT_TREE * tree )
+static inline RBT_NODE * rbtree_prv_createNode ( RBT_TREE * tree, RBT_LATENCY_SAMPLE * timing )
 {
-    RBT_NODE * node = tree->mem_alloc(sizeof(RBT_NODE));
+    uint64_t mark = RBT_LATENCY_MARK(timing);
+    RBT_NODE * node = tree->mem_alloc(tree->nodeSize);
+    
+    RBT_LATENCY_ADD(timing, alloc, mark);
     
     if ( node )
     {
         RBTPRINT_DBG_I("Alloc'ed %p",node);        
-        memset(node, '\0', sizeof(RBT_NODE));
+        memset(node, '\0', tree->nodeSize);
+        RBT_STATS_ADD(tree->stats.allocs, 1U);
+        
+        if ( tree->mode == RBT_TREE_MODE_PERSISTENT )
+        {
+            RBT_ATOMIC_INIT(((RBT_PNODE *)node)->refCount, 1U);
+        }
+        else if ( tree->valueSize > 0U )
+        {
+            node->value = ((RBT_VNODE *)node)->value;
+        }
     }
     else
     {
@@ -106,25 +198,42 @@ static inline RBT_NODE * rbtree_prv_createNode ( RBT_TREE * tree )
     return node;
 }
 
-static inline void rbtree_prv_freeNode ( RBT_NODE * node, RBT_TREE * tree )
+static inline void rbtree_prv_freeNode ( RBT_NODE * node, RBT_TREE * tree, RBT_LATENCY_SAMPLE * timing )
 {
     if ( node )
     {
+        uint64_t mark = RBT_LATENCY_MARK(timing);
+        
         tree->mem_free(node);
+        RBT_LATENCY_ADD(timing, alloc, mark);
         RBTPRINT_DBG_I("Free'd %p",node);        
     }
 }
 
+static inline void rbtree_prv_setValue ( RBT_NODE * node, void * value, RBT_TREE * tree )
+{
+    if ( tree->valueSize > 0U )
+    {
+        /* node->value already points at the node's own copy */
+        memcpy(node->value, value, tree->valueSize);
+    }
+    else
+    {
+        node->value = value;
+    }
+}
+
 static inline RBT_COLOUR rbtree_prv_getColour ( RBT_NODE * node )
 {
 	return node == NULL ? RBT_COLOUR_BLACK : node->colour;
 }
 
-static inline void rbtree_prv_setColour ( RBT_COLOUR colour, RBT_NODE * node)
+static inline void rbtree_prv_setColour ( RBT_COLOUR colour, RBT_NODE * node, RBT_TREE * tree )
 {
-    if ( node )
+    if ( ( node ) && ( node->colour != colour ) )
     {
         node->colour = colour;
+        RBT_STATS_ADD_LOCKED(tree->stats.recolours, 1U);
     }
 }
 
@@ -359,6 +468,8 @@ static inline void rbtree_prv_rotateLeft ( RBT_NODE * node, RBT_TREE * tree )
         }
         
         q->left = p;
+        
+        RBT_STATS_ADD_LOCKED(tree->stats.rotations, 1U);
     }
 }
 
@@ -399,6 +510,8 @@ static inline void rbtree_prv_rotateRight ( RBT_NODE * node, RBT_TREE * tree )
         }
         
         q->right = p;
+        
+        RBT_STATS_ADD_LOCKED(tree->stats.rotations, 1U);
     }
 }
 
@@ -424,11 +537,18 @@ static inline RBTREE_STATUS rbtree_prv_insertNode ( RBT_NODE * ins_node, RBT_TRE
                 
                 if ( l_cur_node == NULL )
                 {
-                    /* no left child so insert here */
-                    cur_node->left = ins_node;
-                    ins_node->parent = cur_node;
-
-                    status = RBTREE_STATUS_OK;
+                    /* no left child so insert here, unless the node it would hang from is broken */
+                    if ( rbtree_checks_validateNodeLinks(cur_node) )
+                    {
+                        cur_node->left = ins_node;
+                        ins_node->parent = cur_node;
+
+                        status = RBTREE_STATUS_OK;
+                    }
+                    else
+                    {
+                        status = RBTREE_STATUS_FAIL_CORRUPT_DATA;
+                    }
                     
                     break;
                 }
@@ -444,11 +564,18 @@ static inline RBTREE_STATUS rbtree_prv_insertNode ( RBT_NODE * ins_node, RBT_TRE
                 
                 if ( r_cur_node == NULL )
                 {
-                    /* no right child so insert here */
-                    cur_node->right = ins_node;
-                    ins_node->parent = cur_node;
-
-                    status = RBTREE_STATUS_OK;
+                    /* no right child so insert here, unless the node it would hang from is broken */
+                    if ( rbtree_checks_validateNodeLinks(cur_node) )
+                    {
+                        cur_node->right = ins_node;
+                        ins_node->parent = cur_node;
+
+                        status = RBTREE_STATUS_OK;
+                    }
+                    else
+                    {
+                        status = RBTREE_STATUS_FAIL_CORRUPT_DATA;
+                    }
                     
                     break;
                 }
@@ -465,247 +592,214 @@ static inline RBTREE_STATUS rbtree_prv_insertNode ( RBT_NODE * ins_node, RBT_TRE
                 break;
             }
         } /* end while */
-        
-        rbtree_checks_validateNodeLinks(cur_node);
-        rbtree_checks_validateNodeLinks(cur_node?cur_node->parent:NULL);
     }
     
     return status;
 }
 
-static inline void rbtree_prv_deleteBSTCheck2 ( RBT_NODE * rmnode, RBT_TREE * tree )
+static inline void rbtree_prv_transplant ( RBT_NODE * old_node, RBT_NODE * new_node, RBT_TREE * tree )
 {
-    RBT_NODE * nLeft = rmnode->left;
-    RBT_NODE * nRight = rmnode->right;
-    RBT_NODE ** parent_link;
-
-    /* find the parent link*/
-    if ( rmnode->parent->left == rmnode )
+    RBT_NODE * parent = getParent(old_node);
+    
+    if ( parent == NULL )
     {
-        parent_link = &rmnode->parent->left;
+        setRoot(new_node,tree);
     }
-    else
+    else if ( parent->left == old_node )
     {
-        parent_link = &rmnode->parent->right;
-        RBTPRINT_ASSERT(rmnode->parent->right==rmnode);
+        parent->left = new_node;
     }
-    
-    /* z has no children - simply remove from parent */
-    if ( ( nLeft == NULL ) && ( nRight == NULL ) )
+    else
     {
-        /* find the parent link & remove */
-        *parent_link = NULL;
+        RBTPRINT_ASSERT(parent->right==old_node);
+        parent->right = new_node;
     }
-    /* z has only child left. Replace nodes position with child left */
-    else if ( (nLeft!=NULL) && (nRight==NULL) )
+    
+    setParent(parent, new_node);
+}
+
+static inline void rbtree_prv_deleteNode ( RBT_NODE * rmnode, RBT_TREE * tree )
+{
+    RBT_COLOUR removed_colour = getColour(rmnode);
+    RBT_NODE * child = NULL;
+    RBT_NODE * child_parent = NULL;
+    
+    /* z has at most one child. Replace nodes position with that child */
+    if ( rmnode->left == NULL )
     {
-        *parent_link = nLeft;
-        nLeft->parent = rmnode->parent;
+        child = rmnode->right;
+        child_parent = rmnode->parent;
+        rbtree_prv_transplant(rmnode, rmnode->right, tree);
     }
-    /* z has only child right. Replace nodes position with child right */
-    else if ( (nLeft==NULL) && (nRight!=NULL) )
+    else if ( rmnode->right == NULL )
     {
-        *parent_link = nRight;
-        nRight->parent = rmnode->parent;
+        child = rmnode->left;
+        child_parent = rmnode->parent;
+        rbtree_prv_transplant(rmnode, rmnode->left, tree);
     }
     /* z has both children */
     else
     {
         /* find the closest living relative on the right side & drop in place */
-        RBT_NODE * replacement_node = rbtree_prv_getFirst(nRight);
-        RBTPRINT_ASSERT(replacement_node!=NULL);
+        RBT_NODE * replacement_node = getFirst(rmnode->right);
         RBTPRINT_ASSERT(getLeft(replacement_node)==NULL);
-        RBTPRINT_ASSERT(getRight(replacement_node)==NULL);
-        *parent_link = replacement_node;
         
-        /* now tidy up the links */
-        replacement_node->parent = getParent(rmnode);
-        replacement_node->left = nLeft;
-        replacement_node->right = nRight;        
-    }
-}
-
-static inline void rbtree_prv_deleteBSTCheck1 ( RBT_NODE * rmnode, RBT_TREE * tree )
-{
-    /* node is root. so set root to null */
-    if ( rmnode->parent == NULL )
-    {
-        RBTPRINT_ASSERT(rmnode==tree->rootNode);
-
-        RBT_NODE * rep_node = NULL;
+        removed_colour = getColour(replacement_node);
+        child = replacement_node->right;
         
-        if ( rmnode->right )
-        {
-            rep_node = getFirst(rmnode->right);
-            
-            if ( rep_node != rmnode->right )
-            {
-                rep_node->left = rmnode->left;
-                rep_node->right = rmnode->right;
-            }
-
-            rbtree_prv_severLinkParentToNode(rep_node);
-
-            if ( rep_node->right )
-            {
-                rep_node->right->parent = rep_node;
-            }
-
-            tree->rootNode = rep_node;
-        }
-        else if ( rmnode->left )
+        if ( replacement_node->parent == rmnode )
         {
-            rep_node = getLast(rmnode->left);
-
-            if ( rep_node != rmnode->left )
-            {
-                rep_node->left = rmnode->left;
-                rep_node->right = rmnode->right;
-            }
-
-            rbtree_prv_severLinkParentToNode(rep_node);
-            
-            if ( rep_node->left )
-            {
-                rep_node->left->parent = rep_node;
-            }
-
-            tree->rootNode = rep_node;
+            child_parent = replacement_node;
         }
         else
         {
-            /* root is only node */
-            tree->rootNode = NULL;
+            child_parent = replacement_node->parent;
+            rbtree_prv_transplant(replacement_node, replacement_node->right, tree);
+            
+            replacement_node->right = rmnode->right;
+            setParent(replacement_node, replacement_node->right);
         }
+        
+        rbtree_prv_transplant(rmnode, replacement_node, tree);
+        
+        /* now tidy up the links */
+        replacement_node->left = rmnode->left;
+        setParent(replacement_node, replacement_node->left);
+        setColour(getColour(rmnode), replacement_node, tree);
     }
-    else
+    
+    rmnode->left = NULL;
+    rmnode->right = NULL;
+    rmnode->parent = NULL;
+    
+    /* removing a black node shortens every path through it. Restore the black height */
+    if ( removed_colour == RBT_COLOUR_BLACK )
     {
-        rbtree_prv_deleteBSTCheck2(rmnode,tree);
+        rbtree_prv_deleteRBFixUp(child, child_parent, tree);
     }
 }
 
-static inline void rbtree_prv_deleteRBFixUp ( RBT_NODE * rmnode, RBT_TREE * tree )
+static inline void rbtree_prv_deleteRBFixUp ( RBT_NODE * cur_node, RBT_NODE * cur_parent, RBT_TREE * tree )
 {
-    RBT_NODE * cur_node = rmnode;
-    
-    if ( getColour(cur_node) == RBT_COLOUR_RED )
-    {
-        /* only adjust if node is black */
-        return;
-    }
-    
-    while ( (cur_node!=NULL) && 
-            (isBlack(cur_node)) )
+    /* cur_node may be NULL (a black leaf), so its parent is tracked separately */
+    while ( ( cur_node != getRoot(tree) ) && 
+            ( isBlack(cur_node) ) )
     {
-        if ( cur_node == getParentLeft(cur_node) )
+        RBT_STATS_ADD_LOCKED(tree->stats.fixUps, 1U);
+        
+        if ( cur_node == getLeft(cur_parent) )
         {            
-            RBT_NODE * sibling = getParentRight(cur_node);
+            RBT_NODE * sibling = getRight(cur_parent);
 
-            if ( getColour(sibling) == RBT_COLOUR_RED )
+            if ( isRed(sibling) )
             {
-                setColour(RBT_COLOUR_BLACK, sibling);
-                setColour(RBT_COLOUR_RED, getParent(cur_node));
+                setColour(RBT_COLOUR_BLACK, sibling, tree);
+                setColour(RBT_COLOUR_RED, cur_parent, tree);
                 
-                leftRotate(cur_node->parent, tree);
+                leftRotate(cur_parent, tree);
+                
+                sibling = getRight(cur_parent);
             }
             
             if ( ( isBlack(getLeft(sibling)) ) &&
                  ( isBlack(getRight(sibling)) ) )
             {
-                setColour(RBT_COLOUR_RED, sibling);
+                setColour(RBT_COLOUR_RED, sibling, tree);
                 
-                cur_node = getParent(cur_node);
+                cur_node = cur_parent;
+                cur_parent = getParent(cur_node);
             }
             else
             {
                 if ( isBlack(getRight(sibling)) )
                 {
-                    setColour(RBT_COLOUR_BLACK, getLeft(sibling));
-                    setColour(RBT_COLOUR_RED, sibling);
+                    setColour(RBT_COLOUR_BLACK, getLeft(sibling), tree);
+                    setColour(RBT_COLOUR_RED, sibling, tree);
 
                     rightRotate(sibling, tree);
 
-                    sibling = getParentRight(cur_node);
+                    sibling = getRight(cur_parent);
                 }
                 
-                setColour(getColour(getParent(cur_node)), sibling);
-                setColour(RBT_COLOUR_BLACK, getParent(cur_node));
-                setColour(RBT_COLOUR_BLACK, getRight(sibling));
+                setColour(getColour(cur_parent), sibling, tree);
+                setColour(RBT_COLOUR_BLACK, cur_parent, tree);
+                setColour(RBT_COLOUR_BLACK, getRight(sibling), tree);
                 
-                leftRotate(getParent(cur_node), tree);
+                leftRotate(cur_parent, tree);
                 
                 /* adjustments finished */
+                cur_node = getRoot(tree);
                 break;
             }
         }
         /* same as previous branch */
-        else if ( cur_node == getParentRight(cur_node) )
+        else
         {
-            RBT_NODE * sibling = getParentLeft(cur_node);
+            RBT_NODE * sibling = getLeft(cur_parent);
             
-            if ( getColour(sibling) == RBT_COLOUR_RED )
+            if ( isRed(sibling) )
             {
-                setColour(RBT_COLOUR_BLACK, sibling);
-                setColour(RBT_COLOUR_RED,   getParent(cur_node));
+                setColour(RBT_COLOUR_BLACK, sibling, tree);
+                setColour(RBT_COLOUR_RED,   cur_parent, tree);
                 
-                rightRotate(getParent(cur_node), tree);
+                rightRotate(cur_parent, tree);
                 
-                sibling = getParentLeft(cur_node);
+                sibling = getLeft(cur_parent);
             }
             
             if ( ( isBlack(getRight(sibling)) ) &&
                  ( isBlack(getLeft(sibling)) ) )
             {
-                setColour(RBT_COLOUR_RED, sibling);
+                setColour(RBT_COLOUR_RED, sibling, tree);
                 
-                cur_node = getParent(cur_node);
+                cur_node = cur_parent;
+                cur_parent = getParent(cur_node);
             }
             else
             {
                 if ( isBlack(getLeft(sibling)) )
                 {
-                    setColour(RBT_COLOUR_BLACK, getRight(sibling));
-                    setColour(RBT_COLOUR_RED, sibling);
+                    setColour(RBT_COLOUR_BLACK, getRight(sibling), tree);
+                    setColour(RBT_COLOUR_RED, sibling, tree);
                     
                     leftRotate(sibling, tree);
                     
-                    sibling = getParentLeft(cur_node);
+                    sibling = getLeft(cur_parent);
                 }
                 
-                setColour(getColour(getParent(cur_node)), sibling);
-                setColour(RBT_COLOUR_BLACK, getParent(cur_node));
-                setColour(RBT_COLOUR_BLACK, getLeft(sibling));
+                setColour(getColour(cur_parent), sibling, tree);
+                setColour(RBT_COLOUR_BLACK, cur_parent, tree);
+                setColour(RBT_COLOUR_BLACK, getLeft(sibling), tree);
 
-                rightRotate(getParent(cur_node), tree);
+                rightRotate(cur_parent, tree);
                 
                 /* adjustments complete */
+                cur_node = getRoot(tree);
                 break;
             }
         }
-        else
-        {
-            cur_node = getParent(cur_node);
-        }
     }
     
-    setColour(RBT_COLOUR_BLACK, tree->rootNode);
+    setColour(RBT_COLOUR_BLACK, cur_node, tree);
 }
 
 static inline void rbtree_prv_insertRBFixUp ( RBT_NODE * insnode, RBT_TREE * tree )
 {
-    setColour(RBT_COLOUR_RED,insnode);
+    setColour(RBT_COLOUR_RED,insnode, tree);
     
     RBT_NODE * cur_node = insnode;
 
     while ( (cur_node!=NULL) && (isRed(getParent(cur_node))) )
     {
+        RBT_STATS_ADD_LOCKED(tree->stats.fixUps, 1U);
+        
         if ( getParent(cur_node) == getGrandParentLeft(cur_node) )
         {
             if ( isRed(getGrandParentRight(cur_node)) )
             {
-                setColour(RBT_COLOUR_BLACK, getParent(cur_node));
-                setColour(RBT_COLOUR_BLACK, getGrandParentRight(cur_node));
-                setColour(RBT_COLOUR_RED,   getGrandParent(cur_node));
+                setColour(RBT_COLOUR_BLACK, getParent(cur_node), tree);
+                setColour(RBT_COLOUR_BLACK, getGrandParentRight(cur_node), tree);
+                setColour(RBT_COLOUR_RED,   getGrandParent(cur_node), tree);
                 
                 cur_node = getGrandParent(cur_node);
             }
@@ -713,13 +807,13 @@ static inline void rbtree_prv_insertRBFixUp ( RBT_NODE * insnode, RBT_TREE * tre
             {
                 if ( cur_node == getParentRight(cur_node) )
                 {
-                    leftRotate(getParent(cur_node), tree);
-                    /* Move up to our parent */
+                    /* Move up to our parent first, the rotation puts it below us */
                     cur_node = getParent(cur_node);
+                    leftRotate(cur_node, tree);
                 }
                 
-                setColour(RBT_COLOUR_BLACK, getParent(cur_node));
-                setColour(RBT_COLOUR_RED,   getGrandParent(cur_node));
+                setColour(RBT_COLOUR_BLACK, getParent(cur_node), tree);
+                setColour(RBT_COLOUR_RED,   getGrandParent(cur_node), tree);
                 
                 rightRotate(getGrandParent(cur_node), tree);
             }
@@ -729,9 +823,9 @@ static inline void rbtree_prv_insertRBFixUp ( RBT_NODE * insnode, RBT_TREE * tre
         {
             if ( isRed(getGrandParentLeft(cur_node)) )
             {
-                setColour(RBT_COLOUR_BLACK, getParent(cur_node));
-                setColour(RBT_COLOUR_BLACK, getGrandParentLeft(cur_node));
-                setColour(RBT_COLOUR_RED,   getGrandParent(cur_node));
+                setColour(RBT_COLOUR_BLACK, getParent(cur_node), tree);
+                setColour(RBT_COLOUR_BLACK, getGrandParentLeft(cur_node), tree);
+                setColour(RBT_COLOUR_RED,   getGrandParent(cur_node), tree);
                 
                 cur_node = getGrandParent(cur_node);
             }
@@ -739,15 +833,15 @@ static inline void rbtree_prv_insertRBFixUp ( RBT_NODE * insnode, RBT_TREE * tre
             {
                 if ( cur_node == getParentLeft(cur_node) )
                 {
-                    rightRotate(getParent(cur_node), tree);
-                    /* Move up to our parent */
+                    /* Move up to our parent first, the rotation puts it below us */
                     cur_node = getParent(cur_node);
+                    rightRotate(cur_node, tree);
                 }
                 
-                setColour(RBT_COLOUR_BLACK, getParent(cur_node));
-                setColour(RBT_COLOUR_RED,   getGrandParent(cur_node));
+                setColour(RBT_COLOUR_BLACK, getParent(cur_node), tree);
+                setColour(RBT_COLOUR_RED,   getGrandParent(cur_node), tree);
                 
-                leftRotate(getParent(cur_node), tree);
+                leftRotate(getGrandParent(cur_node), tree);
             }
         }
         else
@@ -758,41 +852,155 @@ static inline void rbtree_prv_insertRBFixUp ( RBT_NODE * insnode, RBT_TREE * tre
         }
     } /* end while */
     
-    setColour(RBT_COLOUR_BLACK, tree->rootNode);
+    setColour(RBT_COLOUR_BLACK, tree->rootNode, tree);
 }
 
-static inline RBTREE_STATUS rbtree_prv_removeNodeFromTree ( RBT_NODE * rmnode, RBT_TREE * tree )
+static inline RBTREE_STATUS rbtree_prv_linkNodeIntoTree ( RBT_NODE * ins_node, RBT_TREE * tree, RBT_LATENCY_SAMPLE * timing, bool * linked )
 {
     RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    uint64_t mark = RBT_LATENCY_MARK(timing);
+    
+    *linked = false;
     
+    /* node is fully prepared by the caller. Only the tree surgery is done under the lock */
     RBT_LOCK_MUTEX(tree->mutex);
+    RBT_LATENCY_ADD(timing, lockWait, mark);
+    
+    if ( tree->mode == RBT_TREE_MODE_PERSISTENT )
+    {
+        /* copies any shared nodes on the path & rebalances */
+        rbtree_mvcc_preserve(tree);
+        status = rbtree_persist_insertNode(ins_node, tree);
+    }
+    else
+    {
+        /* insert node into tree maintaining BST */
+        status = rbtree_prv_insertNode(ins_node,tree);
+        
+        if ( status == RBTREE_STATUS_OK )
+        {
+            /* fix the red-black tree properties */
+            rbtree_prv_insertRBFixUp(ins_node, tree);
+        }
+    }
+    
+    if ( status == RBTREE_STATUS_OK )
+    {
+        /* from here the node belongs to the tree, a failed check below must not free it */
+        *linked = true;
+        
+        RBT_STATS_ADD(tree->stats.inserts, 1U);
+        tree->nodeCount++;
+        tree->version++;
+        RBTPRINT_ASSERT(tree->nodeCount<RBT_TREE_NODECOUNT_MAXVALUE);
+        
+        if ( tree->wal )
+        {
+            rbtree_wal_logInsert(tree->wal, ins_node->key, ins_node->value);
+        }
+        
+        status = rbtree_checks_isTreeValid(tree);
+    }
+    
+    RBT_UNLOCK_MUTEX(tree->mutex);
+    
+    return status;
+}
+
+static inline RBTREE_STATUS rbtree_prv_removeNodeFromTree ( RBT_NODE * rmnode, RBT_TREE * tree, RBT_LATENCY_SAMPLE * timing )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    uint64_t mark = RBT_LATENCY_MARK(timing);
     
-    /* remove node from tree maintaing binary-search-tree */
-    rbtree_prv_deleteBSTCheck1(rmnode, tree);
+    RBT_LOCK_MUTEX(tree->mutex);
+    RBT_LATENCY_ADD(timing, lockWait, mark);
     
-    /* now fix any issue's to restore red-black tree properties */
-    rbtree_prv_deleteRBFixUp(rmnode, tree);
+    /* remove node from tree maintaing binary-search-tree & red-black tree properties */
+    rbtree_prv_deleteNode(rmnode, tree);
     
     /* check for rollover */
     RBTPRINT_ASSERT(tree->nodeCount>0);
+    RBT_STATS_ADD(tree->stats.deletes, 1U);
     tree->nodeCount--;
+    tree->version++;
     
-    if ( tree->nodeCount == 0U )
+    if ( tree->wal )
     {
-        /* no nodes so this is safe */
-        rbtree_prv_resetKeySeed(tree);
+        rbtree_wal_logDelete(tree->wal, rmnode->key);
     }
     
+    status = rbtree_checks_isTreeValid(tree);
+    
     RBT_UNLOCK_MUTEX(tree->mutex);            
     
-    status = RBTREE_STATUS_OK;
+    return status;
+}
+
+static inline RBTREE_STATUS rbtree_prv_removeKeyFromTree ( RBTREE_KEY key, RBT_TREE * tree, RBT_LATENCY_SAMPLE * timing )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    uint64_t mark = RBT_LATENCY_MARK(timing);
+    
+    RBT_LOCK_MUTEX(tree->mutex);
+    RBT_LATENCY_ADD(timing, lockWait, mark);
+    
+    /* persistent mode. Node is located & freed by the path-copying delete */
+    rbtree_mvcc_preserve(tree);
+    status = rbtree_persist_deleteKey(key, tree);
+    
+    if ( status == RBTREE_STATUS_OK )
+    {
+        RBTPRINT_ASSERT(tree->nodeCount>0);
+        RBT_STATS_ADD(tree->stats.deletes, 1U);
+        tree->nodeCount--;
+        tree->version++;
+        
+        if ( tree->wal )
+        {
+            rbtree_wal_logDelete(tree->wal, key);
+        }
+        
+        status = rbtree_checks_isTreeValid(tree);
+    }
+    
+    RBT_UNLOCK_MUTEX(tree->mutex);
     
     return status;
 }
 
 static inline void rbtree_prv_resetKeySeed ( RBT_TREE * tree )
 {
-    tree->keySeed = RBTREE_KEY_INVALID + 1U;
+    RBT_ATOMIC_INIT(tree->keySeed, (uint64_t)RBTREE_KEY_INVALID + 1U);
+}
+
+static inline RBTREE_STATUS rbtree_prv_reserveKeys ( RBT_TREE * tree, uint32_t count, RBTREE_KEY * first_key )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    uint64_t first = 0U;
+    
+    if ( tree->mode == RBT_TREE_MODE_ARENA )
+    {
+        /* the seed is shared with every process, it lives in the arena */
+        status = rbtree_arena_reserveKeys(tree->arena, count, first_key);
+    }
+    else
+    {
+        /* lock-free. The seed is never wound back, so a reserved key stays unique until used */
+        first = RBT_ATOMIC_FETCH_ADD(tree->keySeed, (uint64_t)count);
+        
+        if ( first + count - 1U <= RBT_TREE_KEYSEED_MAXVALUE )
+        {
+            *first_key = (RBTREE_KEY)first;
+            status = RBTREE_STATUS_OK;
+        }
+        else
+        {
+            RBTPRINT_DBG_E("Key space exhausted");
+            status = RBTREE_STATUS_FAIL;
+        }
+    }
+    
+    return status;
 }
 
 static inline RBT_NODE * rbtree_prv_findKey ( RBTREE_KEY key, RBT_NODE * node )
@@ -816,9 +1024,186 @@ static inline RBT_NODE * rbtree_prv_findKey ( RBTREE_KEY key, RBT_NODE * node )
     
     return node;
 }
-/* private functions - end */
 
-RBTREE_STATUS rbtree_createTree ( RBTREE_HANDLE * handle, rbtree_memalloc_t mem_alloc, rbtree_memfree_t mem_free )
+static inline RBT_NODE * rbtree_prv_cursorFirst ( RBT_CURSOR * cursor, RBT_TREE * tree )
+{
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    void * value = NULL;
+    
+    if ( tree->mode == RBT_TREE_MODE_IMAGE )
+    {
+        rbtree_prv_cursorAtRank(cursor, 0U, tree);
+    }
+    else if ( tree->mode == RBT_TREE_MODE_ARENA )
+    {
+        cursor->node = rbtree_arena_next(tree->arena, RBTREE_KEY_INVALID, &key, &value) ? rbtree_prv_cursorCopy(cursor, key, value) : NULL;
+    }
+    else if ( tree->mode == RBT_TREE_MODE_PERSISTENT )
+    {
+        cursor->node = rbtree_persist_iterFirst(&cursor->iter, tree->rootNode);
+    }
+    else
+    {
+        cursor->node = getFirst(tree->rootNode);
+    }
+    
+    return cursor->node;
+}
+
+static inline RBT_NODE * rbtree_prv_cursorNext ( RBT_CURSOR * cursor, RBT_TREE * tree )
+{
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    void * value = NULL;
+    
+    if ( tree->mode == RBT_TREE_MODE_IMAGE )
+    {
+        rbtree_prv_cursorAtRank(cursor, cursor->rank + 1U, tree);
+    }
+    else if ( tree->mode == RBT_TREE_MODE_ARENA )
+    {
+        /* by key, other processes may have changed the tree since */
+        cursor->node = rbtree_arena_next(tree->arena, cursor->copyNode.key, &key, &value) ? rbtree_prv_cursorCopy(cursor, key, value) : NULL;
+    }
+    else if ( tree->mode == RBT_TREE_MODE_PERSISTENT )
+    {
+        cursor->node = rbtree_persist_iterNext(&cursor->iter);
+    }
+    else
+    {
+        cursor->node = getNext(cursor->node);
+    }
+    
+    return cursor->node;
+}
+
+static inline RBT_NODE * rbtree_prv_cursorAtRank ( RBT_CURSOR * cursor, uint32_t rank, RBT_TREE * tree )
+{
+    cursor->rank = rank;
+    cursor->node = NULL;
+    
+    if ( rank < tree->image->count )
+    {
+        rbtree_prv_cursorCopy(cursor, tree->image->keys[rank], rbtree_image_getValue(tree->image, rank));
+    }
+    
+    return cursor->node;
+}
+
+static inline RBT_NODE * rbtree_prv_cursorCopy ( RBT_CURSOR * cursor, RBTREE_KEY key, void * value )
+{
+    cursor->copyNode.colour = RBT_COLOUR_BLACK;
+    cursor->copyNode.key = key;
+    cursor->copyNode.value = value;
+    cursor->copyNode.left = NULL;
+    cursor->copyNode.right = NULL;
+    cursor->copyNode.parent = NULL;
+    
+    cursor->node = &cursor->copyNode;
+    
+    return cursor->node;
+}
+
+static inline RBT_NODE * rbtree_prv_lookupKey ( RBTREE_KEY key, RBT_CURSOR * cursor, RBT_TREE * tree )
+{
+    RBT_STATS_STRIPE * stripe = NULL;
+    uint32_t rank = 0U;
+    void * value = NULL;
+    
+    if ( tree->mode == RBT_TREE_MODE_ARENA )
+    {
+        cursor->node = rbtree_arena_find(tree->arena, key, &value) ? rbtree_prv_cursorCopy(cursor, key, value) : NULL;
+    }
+    else if ( tree->mode != RBT_TREE_MODE_IMAGE )
+    {
+        cursor->node = rbtree_prv_findKey(key, tree->rootNode);
+    }
+    else if ( rbtree_image_findKey(tree->image, key, &rank) == RBTREE_STATUS_OK )
+    {
+        /* a damaged slot is reported by the image & read as a miss */
+        rbtree_prv_cursorAtRank(cursor, rank, tree);
+    }
+    else
+    {
+        cursor->node = NULL;
+    }
+    
+    stripe = rbtree_stats_stripe(&tree->stats);
+    RBT_STATS_ADD(stripe->lookups, 1U);
+    
+    if ( cursor->node == NULL )
+    {
+        RBT_STATS_ADD(stripe->misses, 1U);
+    }
+    
+    return cursor->node;
+}
+
+static inline RBT_NODE * rbtree_prv_getNodeAtIndex ( uint32_t index, RBT_CURSOR * cursor, RBT_TREE * tree )
+{
+    RBT_NODE * node = NULL;
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    void * value = NULL;
+    uint32_t i = 0U;
+    
+    if ( tree->mode == RBT_TREE_MODE_IMAGE )
+    {
+        /* key ordered arrays, no walk needed */
+        node = rbtree_prv_cursorAtRank(cursor, index, tree);
+    }
+    else if ( tree->mode == RBT_TREE_MODE_ARENA )
+    {
+        /* one locked walk rather than a lock per step */
+        node = rbtree_arena_atRank(tree->arena, index, &key, &value) ? rbtree_prv_cursorCopy(cursor, key, value) : NULL;
+    }
+    else
+    {
+        node = rbtree_prv_cursorFirst(cursor, tree);
+        
+        for ( i=0U; ( i<index ) && ( node != NULL ); i++ )
+        {
+            node = rbtree_prv_cursorNext(cursor, tree);
+        }
+    }
+    
+    return node;
+}
+
+static inline uint32_t rbtree_prv_entryCount ( RBT_TREE * tree )
+{
+    /* an arena's count is changed by other processes */
+    return ( tree->mode == RBT_TREE_MODE_ARENA ) ? rbtree_arena_count(tree->arena) : tree->nodeCount;
+}
+
+static inline bool rbtree_prv_isMapped ( RBTREE_HANDLE handle )
+{
+    /* images & arenas have no RBT_NODE's to walk, pin or log */
+    return (bool) ( ( handle != RBTREE_HANDLE_INVALID ) && ( ( ((RBT_TREE *)handle)->mode == RBT_TREE_MODE_IMAGE ) || ( ((RBT_TREE *)handle)->mode == RBT_TREE_MODE_ARENA ) ) );
+}
+
+static inline bool rbtree_prv_isValueTree ( RBTREE_HANDLE handle )
+{
+    /* node->value points into the node, files would hold its address rather than the value */
+    return (bool) ( ( handle != RBTREE_HANDLE_INVALID ) && ( ((RBT_TREE *)handle)->valueSize > 0U ) );
+}
+
+static inline RBT_LATENCY_SAMPLE * rbtree_prv_latencyBegin ( RBT_TREE * tree, RBT_LATENCY_SAMPLE * sample, RBTREE_LATENCY_OP op )
+{
+    RBT_LATENCY * latency = RBT_ATOMIC_LOAD_ACQUIRE(tree->latency);
+    
+    /* all an unsampled call pays while sampling is off is the NULL test */
+    return ( ( latency ) && ( rbtree_latency_begin(latency, sample, op) ) ) ? sample : NULL;
+}
+
+static inline RBT_TRACE * rbtree_prv_traceBegin ( RBT_TREE * tree, uint64_t * start )
+{
+    RBT_TRACE * trace = RBT_ATOMIC_LOAD_ACQUIRE(tree->trace);
+    
+    *start = ( trace ) ? rbtree_trace_now() : 0U;
+    
+    return trace;
+}
+
+static inline RBTREE_STATUS rbtree_prv_createTree ( RBTREE_HANDLE * handle, rbtree_memalloc_t mem_alloc, rbtree_memfree_t mem_free, RBT_TREE_MODE mode )
 {
     RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
 
@@ -838,8 +1223,25 @@ RBTREE_STATUS rbtree_createTree ( RBTREE_HANDLE * handle, rbtree_memalloc_t mem_
 
         if ( tree )
         {
+            tree->mode = mode;
+            tree->readOnly = false;
+            tree->nodeSize = ( mode == RBT_TREE_MODE_PERSISTENT ) ? sizeof(RBT_PNODE) : sizeof(RBT_NODE);
+            tree->valueSize = 0U;
             tree->nodeCount = 0U;
+            tree->version = 0U;
+            tree->checkCountdown = 0U;
             tree->rootNode = NULL;
+            tree->spareNodes = NULL;
+            tree->spareCount = 0U;
+            tree->mvcc = NULL;
+            tree->image = NULL;
+            tree->wal = NULL;
+            tree->arena = NULL;
+            memset(&tree->stats, 0, sizeof(tree->stats));
+            RBT_ATOMIC_INIT(tree->latency, NULL);
+            tree->latencyData = NULL;
+            RBT_ATOMIC_INIT(tree->trace, NULL);
+            tree->traceData = NULL;
             
             rbtree_prv_resetKeySeed(tree);
 
@@ -882,34 +1284,1886 @@ RBTREE_STATUS rbtree_createTree ( RBTREE_HANDLE * handle, rbtree_memalloc_t mem_
     return status;
 }
 
-
-RBTREE_STATUS rbtree_destroyTree ( RBTREE_HANDLE handle )
+static inline void rbtree_prv_raiseKeySeed ( RBT_TREE * tree, uint64_t keySeed )
 {
-    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    uint64_t curSeed = RBT_ATOMIC_LOAD(tree->keySeed);
     
-    if ( handle != RBTREE_HANDLE_INVALID )
+    /* never hand out a key that is already stored. Reservations don't take the lock */
+    while ( ( curSeed < keySeed ) && ( RBT_ATOMIC_CAS(tree->keySeed, curSeed, keySeed) == false ) )
     {
-        RBT_TREE * tree = (RBT_TREE *)handle;
-        rbtree_memfree_t mem_free = tree->mem_free;
-        
-        /* free all elements */
-        RBT_TERM_MUTEX(tree->mutex);
+        /* curSeed reloaded by the failed exchange */
+    }
+}
 
-        RBT_NODE * cur_node = getFirst(tree->rootNode);
+static inline RBTREE_STATUS rbtree_prv_commitLog ( RBT_TREE * tree )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_OK;
+    
+    /* the change is already applied, only its durability is in question */
+    if ( tree->wal )
+    {
+        status = rbtree_wal_commit(tree->wal);
+    }
+    
+    return status;
+}
 
-        while ( cur_node )
+static RBTREE_STATUS rbtree_prv_replayRecord ( void * context, const RBT_WAL_RECORD * record )
+{
+    RBT_REPLAY * replay = (RBT_REPLAY *)context;
+    RBT_TREE * tree = replay->tree;
+    RBT_NODE * node = rbtree_prv_findKey(record->key, tree->rootNode);
+    RBTREE_STATUS status = RBTREE_STATUS_OK;
+    
+    /* a deleted key was handed out too */
+    if ( (uint64_t)record->key >= replay->keySeed )
+    {
+        replay->keySeed = (uint64_t)record->key + 1U;
+    }
+    
+    if ( record->op == RBT_WAL_OP_DELETE )
+    {
+        if ( node == NULL )
+        {
+            /* already gone in the base */
+        }
+        else if ( tree->mode == RBT_TREE_MODE_PERSISTENT )
+        {
+            status = rbtree_persist_deleteKey(record->key, tree);
+        }
+        else
+        {
+            rbtree_prv_deleteNode(node, tree);
+            rbtree_prv_freeNode(node, tree, NULL);
+        }
+        
+        if ( ( node != NULL ) && ( status == RBTREE_STATUS_OK ) )
+        {
+            tree->nodeCount--;
+            replay->isChanged = true;
+        }
+    }
+    else if ( node == NULL )
+    {
+        void * value = (void *)(uintptr_t)record->rawValue;
+        
+        if ( ( record->bytes != NULL ) && ( ! replay->decode_fn(record->bytes, record->length, &value, replay->userdata) ) )
+        {
+            RBTPRINT_DBG_E("Decoder failed");
+            status = RBTREE_STATUS_FAIL;
+        }
+        else if ( ( node = rbtree_prv_createNode(tree, NULL) ) == NULL )
+        {
+            RBTPRINT_DBG_E("Malloc failure");
+            status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+        }
+        else
+        {
+            node->key = record->key;
+            node->value = value;
+            node->colour = RBT_COLOUR_RED;
+            
+            if ( tree->mode == RBT_TREE_MODE_PERSISTENT )
+            {
+                status = rbtree_persist_insertNode(node, tree);
+            }
+            else if ( ( status = rbtree_prv_insertNode(node, tree) ) == RBTREE_STATUS_OK )
+            {
+                rbtree_prv_insertRBFixUp(node, tree);
+            }
+            
+            if ( status == RBTREE_STATUS_OK )
+            {
+                tree->nodeCount++;
+                replay->isChanged = true;
+            }
+            else
+            {
+                rbtree_prv_freeNode(node, tree, NULL);
+            }
+        }
+    }
+    
+    /* else: insert already in the base */
+    return status;
+}
+
+static inline RBT_NODE * rbtree_prv_pinRoot ( RBT_TREE * tree, uint32_t * nodeCount )
+{
+    RBT_NODE * root = NULL;
+    
+    RBT_LOCK_MUTEX(tree->mutex);
+    
+    root = tree->rootNode;
+    
+    if ( nodeCount )
+    {
+        *nodeCount = tree->nodeCount;
+    }
+    
+    if ( tree->mode == RBT_TREE_MODE_PERSISTENT )
+    {
+        /* the reference keeps this version intact, writers carry on by path-copying */
+        rbtree_persist_retainNode(root);
+        RBT_UNLOCK_MUTEX(tree->mutex);
+    }
+    
+    /* standard mode: lock is held until unpinned */
+    return root;
+}
+
+static inline void rbtree_prv_unpinRoot ( RBT_NODE * root, RBT_TREE * tree )
+{
+    if ( tree->mode == RBT_TREE_MODE_PERSISTENT )
+    {
+        rbtree_persist_releaseNode(root, tree);
+    }
+    else
+    {
+        RBT_UNLOCK_MUTEX(tree->mutex);
+    }
+}
+
+static bool rbtree_prv_visitForEach ( void * context, uint32_t task, RBT_NODE * node )
+{
+    RBT_PARALLEL_CALL * call = (RBT_PARALLEL_CALL *)context;
+    
+    (void)task;
+    
+    call->visit_fn(node->value, node->key, call->userdata);
+    
+    return true;
+}
+
+static bool rbtree_prv_visitReduce ( void * context, uint32_t task, RBT_NODE * node )
+{
+    RBT_PARALLEL_CALL * call = (RBT_PARALLEL_CALL *)context;
+    
+    /* only the worker running task touches its slot */
+    call->results[task] = call->accumulate_fn(call->results[task], node->value, node->key, call->userdata);
+    
+    return true;
+}
+
+static bool rbtree_prv_visitFind ( void * context, uint32_t task, RBT_NODE * node )
+{
+    RBT_PARALLEL_CALL * call = (RBT_PARALLEL_CALL *)context;
+    uint32_t firstMatch = RBT_ATOMIC_LOAD(call->firstMatch);
+    bool carryOn = true;
+    
+    if ( task > firstMatch )
+    {
+        /* a lower range already matched, nothing here can win */
+        carryOn = false;
+    }
+    else if ( call->cmp_fn(node->value, call->userdata) )
+    {
+        call->results[task] = node;
+        carryOn = false;
+        
+        while ( ( task < firstMatch ) && ( RBT_ATOMIC_CAS(call->firstMatch, firstMatch, task) == false ) )
+        {
+            /* firstMatch reloaded by the failed exchange */
+        }
+    }
+    
+    return carryOn;
+}
+/* private functions - end */
+
+RBTREE_STATUS rbtree_createTree ( RBTREE_HANDLE * handle, rbtree_memalloc_t mem_alloc, rbtree_memfree_t mem_free )
+{
+    return rbtree_prv_createTree(handle, mem_alloc, mem_free, RBT_TREE_MODE_STANDARD);
+}
+
+
+RBTREE_STATUS rbtree_createPersistentTree ( RBTREE_HANDLE * handle, rbtree_memalloc_t mem_alloc, rbtree_memfree_t mem_free )
+{
+    return rbtree_prv_createTree(handle, mem_alloc, mem_free, RBT_TREE_MODE_PERSISTENT);
+}
+
+
+RBTREE_STATUS rbtree_createValueTree ( RBTREE_HANDLE * handle, size_t valueSize, rbtree_memalloc_t mem_alloc, rbtree_memfree_t mem_free )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( valueSize > 0U ) && ( valueSize <= RBTREE_VALUE_SIZE_MAX ) )
+    {
+        status = rbtree_prv_createTree(handle, mem_alloc, mem_free, RBT_TREE_MODE_STANDARD);
+        
+        if ( status == RBTREE_STATUS_OK )
+        {
+            RBT_TREE * tree = (RBT_TREE *)*handle;
+            
+            /* one allocation for the node & its value */
+            tree->valueSize = valueSize;
+            tree->nodeSize = sizeof(RBT_VNODE) + valueSize;
+        }
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_snapshot ( RBTREE_HANDLE handle, RBTREE_HANDLE * snapshot )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( snapshot != NULL ) )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        RBT_TREE * snap_tree = NULL;
+        
+        if ( tree->mode == RBT_TREE_MODE_PERSISTENT )
+        {
+            status = rbtree_prv_createTree((RBTREE_HANDLE *)&snap_tree, tree->mem_alloc, tree->mem_free, RBT_TREE_MODE_PERSISTENT);
+        }
+        else
+        {
+            RBTPRINT_DBG_E("Snapshots need a persistent tree");
+            status = RBTREE_STATUS_FAIL_NOT_SUPPORTED;
+        }
+        
+        if ( status == RBTREE_STATUS_OK )
+        {
+            /* the root reference keeps every node of this version alive */
+            RBT_LOCK_MUTEX(tree->mutex);
+            
+            snap_tree->rootNode = tree->rootNode;
+            snap_tree->nodeCount = tree->nodeCount;
+            snap_tree->version = tree->version;
+            RBT_ATOMIC_INIT(snap_tree->keySeed, RBT_ATOMIC_LOAD(tree->keySeed));
+            rbtree_persist_retainNode(snap_tree->rootNode);
+            
+            RBT_UNLOCK_MUTEX(tree->mutex);
+            
+            snap_tree->readOnly = true;
+            *snapshot = snap_tree;
+        }
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_setVersionRetention ( RBTREE_HANDLE handle, uint32_t versions )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( handle != RBTREE_HANDLE_INVALID )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        
+        if ( tree->mode != RBT_TREE_MODE_PERSISTENT )
+        {
+            RBTPRINT_DBG_E("Versions need a persistent tree");
+            status = RBTREE_STATUS_FAIL_NOT_SUPPORTED;
+        }
+        else if ( tree->readOnly )
+        {
+            RBTPRINT_DBG_E("Tree is read-only");
+            status = RBTREE_STATUS_FAIL_READ_ONLY;
+        }
+        else
+        {
+            RBT_LOCK_MUTEX(tree->mutex);
+            status = rbtree_mvcc_setRetention(tree, versions);
+            RBT_UNLOCK_MUTEX(tree->mutex);
+        }
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_currentVersion ( RBTREE_HANDLE handle, uint64_t * version )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( version != NULL ) )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        
+        if ( tree->mode == RBT_TREE_MODE_ARENA )
+        {
+            *version = rbtree_arena_version(tree->arena);
+        }
+        else
+        {
+            RBT_LOCK_MUTEX(tree->mutex);
+            *version = tree->version;
+            RBT_UNLOCK_MUTEX(tree->mutex);
+        }
+        
+        status = RBTREE_STATUS_OK;
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_beginRead ( RBTREE_HANDLE handle, uint64_t version, RBTREE_HANDLE * view )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( view != NULL ) )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        RBT_TREE * view_tree = NULL;
+        
+        if ( tree->mode == RBT_TREE_MODE_PERSISTENT )
+        {
+            status = rbtree_prv_createTree((RBTREE_HANDLE *)&view_tree, tree->mem_alloc, tree->mem_free, RBT_TREE_MODE_PERSISTENT);
+        }
+        else
+        {
+            RBTPRINT_DBG_E("Versions need a persistent tree");
+            status = RBTREE_STATUS_FAIL_NOT_SUPPORTED;
+        }
+        
+        if ( status == RBTREE_STATUS_OK )
+        {
+            RBT_LOCK_MUTEX(tree->mutex);
+            
+            status = rbtree_mvcc_retainVersion(tree, version, &view_tree->rootNode, &view_tree->nodeCount);
+            RBT_ATOMIC_INIT(view_tree->keySeed, RBT_ATOMIC_LOAD(tree->keySeed));
+            
+            RBT_UNLOCK_MUTEX(tree->mutex);
+            
+            if ( status == RBTREE_STATUS_OK )
+            {
+                view_tree->version = version;
+                view_tree->readOnly = true;
+                *view = view_tree;
+            }
+            else
+            {
+                rbtree_destroyTree(view_tree);
+            }
+        }
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_endRead ( RBTREE_HANDLE view )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( view != RBTREE_HANDLE_INVALID ) && ( ((RBT_TREE *)view)->readOnly ) )
+    {
+        status = rbtree_destroyTree(view);
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_destroyTree ( RBTREE_HANDLE handle )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( handle != RBTREE_HANDLE_INVALID )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        rbtree_memfree_t mem_free = tree->mem_free;
+        
+        /* freeing the nodes below is not a change to log */
+        if ( tree->wal )
+        {
+            rbtree_wal_destroy(tree->wal, tree);
+            tree->wal = NULL;
+        }
+        
+        if ( tree->mode == RBT_TREE_MODE_IMAGE )
+        {
+            /* values handed out from the mapping are invalid from here */
+            rbtree_image_close(tree);
+        }
+        else if ( tree->mode == RBT_TREE_MODE_ARENA )
+        {
+            /* detach only, the entries belong to every process using the arena */
+            rbtree_arena_close(tree);
+        }
+        else if ( tree->mode == RBT_TREE_MODE_PERSISTENT )
+        {
+            /* stops the collector & drops retained versions */
+            rbtree_mvcc_destroy(tree);
+            
+            /* nodes still shared with a snapshot live on until it is destroyed */
+            rbtree_persist_releaseNode(tree->rootNode, tree);
+            tree->rootNode = NULL;
+            
+            while ( tree->spareNodes )
+            {
+                RBT_NODE * next_node = tree->spareNodes->left;
+                
+                mem_free(tree->spareNodes);
+                tree->spareNodes = next_node;
+            }
+        }
+        else
+        {
+            /* free all elements */
+            RBT_NODE * cur_node = getFirst(tree->rootNode);
+
+            while ( cur_node )
+            {
+                RBT_NODE * next_node = getNext(cur_node);
+                
+                rbtree_prv_removeNodeFromTree(cur_node, tree, NULL);
+                rbtree_prv_freeNode(cur_node, tree, NULL);
+                
+                cur_node = next_node;
+            }
+        }
+
+        if ( tree->latencyData )
+        {
+            rbtree_latency_destroy(tree->latencyData, tree);
+        }
+
+        if ( tree->traceData )
+        {
+            rbtree_trace_destroy(tree->traceData, tree);
+        }
+
+        RBT_TERM_MUTEX(tree->mutex);
+
+        mem_free(tree);
+        
+        status = RBTREE_STATUS_OK;
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_insert ( RBTREE_HANDLE handle, void * storevalue, RBTREE_KEY * key )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( key != NULL ) )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        uint64_t traceStart = 0U;
+        RBT_TRACE * trace = rbtree_prv_traceBegin(tree, &traceStart);
+        
+        RBT_NODE * ins_node = NULL;
+        RBT_LATENCY_SAMPLE sample;
+        RBT_LATENCY_SAMPLE * timing = rbtree_prv_latencyBegin(tree, &sample, RBTREE_LATENCY_OP_INSERT);
+        
+        if ( tree->readOnly )
+        {
+            RBTPRINT_DBG_E("Tree is read-only");
+            status = RBTREE_STATUS_FAIL_READ_ONLY;
+        }
+        else if ( ( tree->valueSize > 0U ) && ( storevalue == NULL ) )
+        {
+            RBTPRINT_DBG_E("Invalid param");
+            status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+        }
+        else if ( tree->mode == RBT_TREE_MODE_ARENA )
+        {
+            RBTREE_KEY new_key = RBTREE_KEY_INVALID;
+            
+            /* the key is assigned under the arena lock, with the node */
+            status = rbtree_arena_insert(tree->arena, &new_key, storevalue);
+            
+            if ( status == RBTREE_STATUS_OK )
+            {
+                RBT_STATS_ADD(tree->stats.inserts, 1U);
+                *key = new_key;
+            }
+        }
+        else if ( ( ins_node = rbtree_prv_createNode(tree, timing) ) != NULL )
+        {
+            RBTREE_KEY new_key = RBTREE_KEY_INVALID;
+            RBTREE_STATUS commitStatus = RBTREE_STATUS_UNDEF;
+            bool linked = false;
+            
+            /* key reservation & node setup need no lock */
+            status = rbtree_prv_reserveKeys(tree, 1U, &new_key);
+            
+            if ( status == RBTREE_STATUS_OK )
+            {
+                ins_node->key = new_key;
+                ins_node->colour = RBT_COLOUR_RED;
+                rbtree_prv_setValue(ins_node, storevalue, tree);
+                
+                status = rbtree_prv_linkNodeIntoTree(ins_node, tree, timing, &linked);
+            }
+            
+            if ( linked )
+            {
+                /* once linked the node may already be deleted by another writer.
+                   A failed check leaves the node in place & reports CORRUPT_DATA */
+                *key = new_key;
+                commitStatus = rbtree_prv_commitLog(tree);
+                
+                if ( status == RBTREE_STATUS_OK )
+                {
+                    status = commitStatus;
+                }
+            }
+            else
+            {
+                rbtree_prv_freeNode(ins_node, tree, timing);
+            }
+        }
+        else
+        {
+            RBTPRINT_DBG_E("Malloc failure");
+            status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+        }
+        
+        if ( timing )
+        {
+            rbtree_latency_end(timing);
+        }
+        
+        if ( trace )
+        {
+            rbtree_trace_log(trace, RBTREE_TRACE_OP_INSERT, traceStart, (uintptr_t)storevalue, ( status == RBTREE_STATUS_OK ) ? *key : 0U, status);
+        }
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_reserveKeys ( RBTREE_HANDLE handle, uint32_t count, RBTREE_KEY * first_key )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( count > 0U ) && ( first_key != NULL ) )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        uint64_t traceStart = 0U;
+        RBT_TRACE * trace = rbtree_prv_traceBegin(tree, &traceStart);
+        
+        if ( tree->readOnly )
+        {
+            RBTPRINT_DBG_E("Tree is read-only");
+            status = RBTREE_STATUS_FAIL_READ_ONLY;
+        }
+        else
+        {
+            status = rbtree_prv_reserveKeys(tree, count, first_key);
+        }
+        
+        if ( trace )
+        {
+            rbtree_trace_log(trace, RBTREE_TRACE_OP_RESERVE_KEYS, traceStart, count, ( status == RBTREE_STATUS_OK ) ? *first_key : 0U, status);
+        }
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_insertReserved ( RBTREE_HANDLE handle, void * storevalue, RBTREE_KEY key )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( key != RBTREE_KEY_INVALID ) )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        uint64_t traceStart = 0U;
+        RBT_TRACE * trace = rbtree_prv_traceBegin(tree, &traceStart);
+        RBT_LATENCY_SAMPLE sample;
+        RBT_LATENCY_SAMPLE * timing = rbtree_prv_latencyBegin(tree, &sample, RBTREE_LATENCY_OP_INSERT_RESERVED);
+        
+        if ( tree->readOnly )
+        {
+            RBTPRINT_DBG_E("Tree is read-only");
+            status = RBTREE_STATUS_FAIL_READ_ONLY;
+        }
+        else if ( ( tree->valueSize > 0U ) && ( storevalue == NULL ) )
+        {
+            RBTPRINT_DBG_E("Invalid param");
+            status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+        }
+        else if ( tree->mode == RBT_TREE_MODE_ARENA )
+        {
+            /* reservation & duplicates are checked against the arena's own seed */
+            status = rbtree_arena_insert(tree->arena, &key, storevalue);
+            
+            if ( status == RBTREE_STATUS_OK )
+            {
+                RBT_STATS_ADD(tree->stats.inserts, 1U);
+            }
+        }
+        else if ( (uint64_t)key < RBT_ATOMIC_LOAD(tree->keySeed) )
+        {
+            RBT_NODE * ins_node = rbtree_prv_createNode(tree, timing);
+            bool linked = false;
+            
+            if ( ins_node )
+            {
+                ins_node->key = key;
+                ins_node->colour = RBT_COLOUR_RED;
+                rbtree_prv_setValue(ins_node, storevalue, tree);
+                
+                /* a key used twice is rejected by the BST insert */
+                status = rbtree_prv_linkNodeIntoTree(ins_node, tree, timing, &linked);
+                
+                if ( linked )
+                {
+                    /* a failed check leaves the node in place & reports CORRUPT_DATA */
+                    RBTREE_STATUS commitStatus = rbtree_prv_commitLog(tree);
+                    
+                    if ( status == RBTREE_STATUS_OK )
+                    {
+                        status = commitStatus;
+                    }
+                }
+                else
+                {
+                    rbtree_prv_freeNode(ins_node, tree, timing);
+                }
+            }
+            else
+            {
+                RBTPRINT_DBG_E("Malloc failure");
+                status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+            }
+        }
+        else
+        {
+            RBTPRINT_DBG_E("Key:%u was never reserved",key);
+            status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+        }
+        
+        if ( timing )
+        {
+            rbtree_latency_end(timing);
+        }
+        
+        if ( trace )
+        {
+            rbtree_trace_log(trace, RBTREE_TRACE_OP_INSERT_RESERVED, traceStart, (uintptr_t)storevalue, key, status);
+        }
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_retrieveByKey ( RBTREE_HANDLE handle, RBTREE_KEY key, void ** ret_data )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( key != RBTREE_KEY_INVALID ) && ( ret_data != NULL ) )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        uint64_t traceStart = 0U;
+        RBT_TRACE * trace = rbtree_prv_traceBegin(tree, &traceStart);
+        RBT_LATENCY_SAMPLE sample;
+        RBT_LATENCY_SAMPLE * timing = rbtree_prv_latencyBegin(tree, &sample, RBTREE_LATENCY_OP_RETRIEVE_BY_KEY);
+        
+        RBT_CURSOR cursor;
+        RBT_NODE * node = rbtree_prv_lookupKey(key, &cursor, tree);
+        
+        if ( node )
+        {
+            *ret_data = node->value;
+            status = RBTREE_STATUS_OK;
+        }
+        else
+        {
+            RBTPRINT_DBG_E("Key does not exist");
+            status = RBTREE_STATUS_FAIL_KEY_DOES_NOT_EXIST;
+        }
+        
+        if ( timing )
+        {
+            rbtree_latency_end(timing);
+        }
+        
+        if ( trace )
+        {
+            rbtree_trace_log(trace, RBTREE_TRACE_OP_RETRIEVE_BY_KEY, traceStart, key, 0U, status);
+        }
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_retrieveValue ( RBTREE_HANDLE handle, RBTREE_KEY key, void * ret_value )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( ret_value != NULL ) )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        void * value = NULL;
+        
+        if ( tree->valueSize == 0U )
+        {
+            RBTPRINT_DBG_E("Tree does not store values");
+            status = RBTREE_STATUS_FAIL_NOT_SUPPORTED;
+        }
+        else if ( ( status = rbtree_retrieveByKey(handle, key, &value) ) == RBTREE_STATUS_OK )
+        {
+            memcpy(ret_value, value, tree->valueSize);
+        }
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_retrieveByIndex ( RBTREE_HANDLE handle, uint32_t index, void ** ret_data, RBTREE_KEY * ret_key )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( ret_data != NULL ) && ( ret_key != NULL ) )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        uint64_t traceStart = 0U;
+        RBT_TRACE * trace = rbtree_prv_traceBegin(tree, &traceStart);
+        
+        if ( index <= rbtree_prv_entryCount(tree) )
+        {
+            RBT_CURSOR cursor;
+            RBT_NODE * node = rbtree_prv_getNodeAtIndex(index, &cursor, tree);
+            
+            if ( node )
+            {
+                *ret_data = node->value;
+                *ret_key = node->key;
+                status = RBTREE_STATUS_OK;
+            }
+            else
+            {
+                status = RBTREE_STATUS_FAIL;
+            }
+        }
+        else
+        {
+            RBTPRINT_DBG_E("Index: %d out of range",index);
+            status = RBTREE_STATUS_FAIL_INDEX_OUT_OF_RANGE;
+        }
+        
+        if ( trace )
+        {
+            rbtree_trace_log(trace, RBTREE_TRACE_OP_RETRIEVE_BY_INDEX, traceStart, index, ( status == RBTREE_STATUS_OK ) ? *ret_key : 0U, status);
+        }
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_deleteByKey ( RBTREE_HANDLE handle, RBTREE_KEY key )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( key != RBTREE_KEY_INVALID ) )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        uint64_t traceStart = 0U;
+        RBT_TRACE * trace = rbtree_prv_traceBegin(tree, &traceStart);
+        RBT_NODE * node = NULL;
+        RBT_LATENCY_SAMPLE sample;
+        RBT_LATENCY_SAMPLE * timing = rbtree_prv_latencyBegin(tree, &sample, RBTREE_LATENCY_OP_DELETE_BY_KEY);
+        
+        if ( tree->readOnly )
+        {
+            RBTPRINT_DBG_E("Tree is read-only");
+            status = RBTREE_STATUS_FAIL_READ_ONLY;
+        }
+        else if ( tree->mode == RBT_TREE_MODE_PERSISTENT )
+        {
+            status = rbtree_prv_removeKeyFromTree(key, tree, timing);
+        }
+        else if ( tree->mode == RBT_TREE_MODE_ARENA )
+        {
+            status = rbtree_arena_delete(tree->arena, key);
+            
+            if ( status == RBTREE_STATUS_OK )
+            {
+                RBT_STATS_ADD(tree->stats.deletes, 1U);
+            }
+        }
+        else if ( ( node = rbtree_prv_findKey(key, tree->rootNode) ) != NULL )
+        {
+            status = rbtree_prv_removeNodeFromTree(node, tree, timing);
+            rbtree_prv_freeNode(node, tree, timing);
+        }
+        else
+        {
+            RBTPRINT_DBG_W("Key:%u does not exist",key);
+            status = RBTREE_STATUS_FAIL_KEY_DOES_NOT_EXIST;
+        }
+        
+        if ( status == RBTREE_STATUS_OK )
+        {
+            status = rbtree_prv_commitLog(tree);
+        }
+        
+        if ( timing )
+        {
+            rbtree_latency_end(timing);
+        }
+        
+        if ( trace )
+        {
+            rbtree_trace_log(trace, RBTREE_TRACE_OP_DELETE_BY_KEY, traceStart, key, 0U, status);
+        }
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_deleteByValue ( RBTREE_HANDLE handle, void * value )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( handle != RBTREE_HANDLE_INVALID )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        uint64_t traceStart = 0U;
+        RBT_TRACE * trace = rbtree_prv_traceBegin(tree, &traceStart);
+        RBT_CURSOR cursor;
+        RBT_NODE * node = NULL;
+        bool matchFound = false;
+        
+        if ( tree->readOnly == false )
+        {
+            node = rbtree_prv_cursorFirst(&cursor, tree);
+        }
+        
+        while ( node )
+        {
+            if ( node->value != value )
+            {
+                node = rbtree_prv_cursorNext(&cursor, tree);
+            }
+            else if ( tree->mode == RBT_TREE_MODE_PERSISTENT )
+            {
+                /* path-copying invalidates the cursor. Resume after the removed key */
+                RBTREE_KEY key = node->key;
+                
+                rbtree_prv_removeKeyFromTree(key, tree, NULL);
+                matchFound = true;
+                
+                node = ( key < RBT_TREE_KEYSEED_MAXVALUE ) ? rbtree_persist_iterSeek(&cursor.iter, tree->rootNode, key+1U) : NULL;
+            }
+            else if ( tree->mode == RBT_TREE_MODE_ARENA )
+            {
+                /* the cursor is a copy, it resumes after the removed key */
+                if ( rbtree_arena_delete(tree->arena, node->key) == RBTREE_STATUS_OK )
+                {
+                    RBT_STATS_ADD(tree->stats.deletes, 1U);
+                }
+                
+                matchFound = true;
+                
+                node = rbtree_prv_cursorNext(&cursor, tree);
+            }
+            else
+            {
+                /* nodes are relinked (not swapped) on removal, so the successor stays valid */
+                RBT_NODE * next_node = rbtree_prv_cursorNext(&cursor, tree);
+                
+                rbtree_prv_removeNodeFromTree(node, tree, NULL);
+                rbtree_prv_freeNode(node, tree, NULL);
+
+                matchFound = true;
+                
+                node = next_node;
+            }
+        }
+        
+        if ( tree->readOnly )
+        {
+            RBTPRINT_DBG_E("Tree is read-only");
+            status = RBTREE_STATUS_FAIL_READ_ONLY;
+        }
+        else if ( matchFound )
+        {
+            /* all is ok. Check validatity of tree */
+            status = rbtree_checks_isTreeValid(handle);
+        }
+        else
+        {
+            RBTPRINT_DBG_W("Value:%p does not exist",value);
+            status = RBTREE_STATUS_FAIL_VALUE_DOES_NOT_EXIST;
+        }
+        
+        if ( status == RBTREE_STATUS_OK )
+        {
+            status = rbtree_prv_commitLog(tree);
+        }
+        
+        if ( trace )
+        {
+            rbtree_trace_log(trace, RBTREE_TRACE_OP_DELETE_BY_VALUE, traceStart, (uintptr_t)value, 0U, status);
+        }
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_deleteByIndex ( RBTREE_HANDLE handle, uint32_t index )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( handle != RBTREE_HANDLE_INVALID )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        uint64_t traceStart = 0U;
+        RBT_TRACE * trace = rbtree_prv_traceBegin(tree, &traceStart);
+        RBT_LATENCY_SAMPLE sample;
+        RBT_LATENCY_SAMPLE * timing = rbtree_prv_latencyBegin(tree, &sample, RBTREE_LATENCY_OP_DELETE_BY_INDEX);
+        
+        if ( tree->readOnly )
+        {
+            RBTPRINT_DBG_E("Tree is read-only");
+            status = RBTREE_STATUS_FAIL_READ_ONLY;
+        }
+        else if ( index <= rbtree_prv_entryCount(tree) )
+        {
+            RBT_CURSOR cursor;
+            RBT_NODE * node = rbtree_prv_getNodeAtIndex(index, &cursor, tree);
+
+            if ( ( node ) && ( tree->mode == RBT_TREE_MODE_PERSISTENT ) )
+            {
+                status = rbtree_prv_removeKeyFromTree(node->key, tree, timing);
+            }
+            else if ( ( node ) && ( tree->mode == RBT_TREE_MODE_ARENA ) )
+            {
+                status = rbtree_arena_delete(tree->arena, node->key);
+                
+                if ( status == RBTREE_STATUS_OK )
+                {
+                    RBT_STATS_ADD(tree->stats.deletes, 1U);
+                }
+            }
+            else if ( node )
+            {
+                status = rbtree_prv_removeNodeFromTree(node, tree, timing);
+                rbtree_prv_freeNode(node, tree, timing);
+            }
+            else
+            {
+                RBTPRINT_DBG_W("Node:%p does not exist",node);
+                status = RBTREE_STATUS_FAIL_INDEX_OUT_OF_RANGE;
+            }
+        }
+        else
+        {
+            RBTPRINT_DBG_W("Index out of range: %u",index);
+            status = RBTREE_STATUS_FAIL_INDEX_OUT_OF_RANGE;
+        }
+        
+        if ( status == RBTREE_STATUS_OK )
+        {
+            status = rbtree_prv_commitLog(tree);
+        }
+        
+        if ( timing )
+        {
+            rbtree_latency_end(timing);
+        }
+        
+        if ( trace )
+        {
+            rbtree_trace_log(trace, RBTREE_TRACE_OP_DELETE_BY_INDEX, traceStart, index, 0U, status);
+        }
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_find ( RBTREE_HANDLE handle, rbtree_comparator_t cmp_fn, void * userdata, void ** ret_storevalue, RBTREE_KEY * ret_key )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( cmp_fn != NULL ) && ( ret_storevalue != NULL ) && ( ret_key != NULL ) )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        
+        RBT_CURSOR cursor;
+        RBT_NODE * node = rbtree_prv_cursorFirst(&cursor, tree);
+        
+        bool res = false;
+
+        status = RBTREE_STATUS_FAIL;
+
+        while ( node != NULL )
+        {
+            res = cmp_fn(node->value,userdata);
+            
+            if ( res )
+            {
+                *ret_storevalue = node->value;
+                *ret_key = node->key;
+                
+                status = RBTREE_STATUS_OK;
+                
+                break;
+            }
+            else
+            {
+                node = rbtree_prv_cursorNext(&cursor, tree);
+            }
+        }
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_parallelForEach ( RBTREE_HANDLE handle, uint32_t threadCount, rbtree_visitor_t visit_fn, void * userdata )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( rbtree_prv_isMapped(handle) )
+    {
+        RBTPRINT_DBG_E("Not available on a mapped tree");
+        status = RBTREE_STATUS_FAIL_NOT_SUPPORTED;
+    }
+    else if ( ( handle != RBTREE_HANDLE_INVALID ) && ( visit_fn != NULL ) && ( threadCount > 0U ) && ( threadCount <= RBT_PARALLEL_THREADS_MAX ) )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        RBT_PARALLEL_CALL call;
+        RBT_NODE * root = NULL;
+        
+        call.visit_fn = visit_fn;
+        call.accumulate_fn = NULL;
+        call.cmp_fn = NULL;
+        call.userdata = userdata;
+        call.results = NULL;
+        
+        root = rbtree_prv_pinRoot(tree, NULL);
+        
+        status = rbtree_parallel_run(root, threadCount, rbtree_prv_visitForEach, &call, tree);
+        
+        rbtree_prv_unpinRoot(root, tree);
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_parallelReduce ( RBTREE_HANDLE handle, uint32_t threadCount, void * initial, rbtree_accumulator_t accumulate_fn, rbtree_combiner_t combine_fn, void * userdata, void ** result )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( rbtree_prv_isMapped(handle) )
+    {
+        RBTPRINT_DBG_E("Not available on a mapped tree");
+        status = RBTREE_STATUS_FAIL_NOT_SUPPORTED;
+    }
+    else if ( ( handle != RBTREE_HANDLE_INVALID ) && ( accumulate_fn != NULL ) && ( combine_fn != NULL ) && ( result != NULL ) && ( threadCount > 0U ) && ( threadCount <= RBT_PARALLEL_THREADS_MAX ) )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        RBT_PARALLEL_CALL call;
+        RBT_NODE * root = NULL;
+        uint32_t taskCount = 0U;
+        uint32_t i = 0U;
+        
+        call.visit_fn = NULL;
+        call.accumulate_fn = accumulate_fn;
+        call.cmp_fn = NULL;
+        call.userdata = userdata;
+        call.results = NULL;
+        
+        root = rbtree_prv_pinRoot(tree, NULL);
+        
+        taskCount = rbtree_parallel_taskCount(root, threadCount);
+        
+        if ( ( taskCount > 0U ) && ( ( call.results = tree->mem_alloc(sizeof(void *) * taskCount) ) == NULL ) )
+        {
+            RBTPRINT_DBG_E("Malloc failure");
+            status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+        }
+        else
+        {
+            for ( i=0U; i<taskCount; i++ )
+            {
+                call.results[i] = initial;
+            }
+            
+            status = rbtree_parallel_run(root, threadCount, rbtree_prv_visitReduce, &call, tree);
+        }
+        
+        rbtree_prv_unpinRoot(root, tree);
+        
+        if ( status == RBTREE_STATUS_OK )
+        {
+            /* tasks are numbered in key order, so this keeps non-commutative combines correct */
+            *result = initial;
+            
+            for ( i=0U; i<taskCount; i++ )
+            {
+                *result = combine_fn(*result, call.results[i], userdata);
+            }
+        }
+        
+        if ( call.results )
+        {
+            tree->mem_free(call.results);
+        }
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_parallelFind ( RBTREE_HANDLE handle, uint32_t threadCount, rbtree_comparator_t cmp_fn, void * userdata, void ** ret_storevalue, RBTREE_KEY * ret_key )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( rbtree_prv_isMapped(handle) )
+    {
+        RBTPRINT_DBG_E("Not available on a mapped tree");
+        status = RBTREE_STATUS_FAIL_NOT_SUPPORTED;
+    }
+    else if ( ( handle != RBTREE_HANDLE_INVALID ) && ( cmp_fn != NULL ) && ( ret_storevalue != NULL ) && ( ret_key != NULL ) && ( threadCount > 0U ) && ( threadCount <= RBT_PARALLEL_THREADS_MAX ) )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        RBT_PARALLEL_CALL call;
+        RBT_NODE * root = NULL;
+        uint32_t taskCount = 0U;
+        uint32_t firstMatch = 0U;
+        
+        call.visit_fn = NULL;
+        call.accumulate_fn = NULL;
+        call.cmp_fn = cmp_fn;
+        call.userdata = userdata;
+        call.results = NULL;
+        RBT_ATOMIC_INIT(call.firstMatch, UINT32_MAX);
+        
+        root = rbtree_prv_pinRoot(tree, NULL);
+        
+        taskCount = rbtree_parallel_taskCount(root, threadCount);
+        
+        if ( ( taskCount > 0U ) && ( ( call.results = tree->mem_alloc(sizeof(void *) * taskCount) ) == NULL ) )
+        {
+            RBTPRINT_DBG_E("Malloc failure");
+            status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+        }
+        else
+        {
+            status = rbtree_parallel_run(root, threadCount, rbtree_prv_visitFind, &call, tree);
+        }
+        
+        firstMatch = RBT_ATOMIC_LOAD(call.firstMatch);
+        
+        if ( status != RBTREE_STATUS_OK )
+        {
+            /* failed */
+        }
+        else if ( firstMatch < taskCount )
+        {
+            /* workers are joined, so their writes to results are visible */
+            RBT_NODE * node = (RBT_NODE *)call.results[firstMatch];
+            
+            *ret_storevalue = node->value;
+            *ret_key = node->key;
+        }
+        else
+        {
+            status = RBTREE_STATUS_FAIL;
+        }
+        
+        rbtree_prv_unpinRoot(root, tree);
+        
+        if ( call.results )
+        {
+            tree->mem_free(call.results);
+        }
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_doesKeyExist ( RBTREE_HANDLE handle, RBTREE_KEY key, bool * doesExist )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( key != RBTREE_KEY_INVALID ) && ( doesExist != NULL ) )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        
+        RBT_CURSOR cursor;
+        RBT_NODE * node = rbtree_prv_lookupKey(key, &cursor, tree);
+        
+        if ( node )
+        {
+            *doesExist = true;
+        }
+        else
+        {
+            *doesExist = false;
+        }
+        
+        status = RBTREE_STATUS_OK;
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+bool rbtree_doesValueExist_prv_comp (void* storevalue, void* userdata)
+{
+    return ( storevalue == userdata ) ? true : false;
+}
+
+
+RBTREE_STATUS rbtree_doesValueExist ( RBTREE_HANDLE handle, void * storevalue, bool * doesExist )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( doesExist != NULL ) )
+    {
+        void * ret_storevalue = NULL;
+        RBTREE_KEY ret_key = RBTREE_KEY_INVALID;
+        
+        status = rbtree_find ( handle, rbtree_doesValueExist_prv_comp, storevalue, &ret_storevalue, &ret_key );
+        
+        if ( status == RBTREE_STATUS_OK )
+        {
+            *doesExist = true;
+        }
+        else
+        {
+            *doesExist = false;
+        }
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_entryCount ( RBTREE_HANDLE handle, uint32_t * numberOfEntries )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( numberOfEntries != NULL ) )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        
+        *numberOfEntries = rbtree_prv_entryCount(tree);
+        
+        status = RBTREE_STATUS_OK;
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_copyInTree ( RBTREE_HANDLE handle, RBTREE_HANDLE copyInTree )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    /* a value tree copies valueSize bytes from each value, they must be that big */
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( copyInTree != RBTREE_HANDLE_INVALID )
+      && ( ((RBT_TREE *)handle)->valueSize == ((RBT_TREE *)copyInTree)->valueSize ) )
+    {
+        uint32_t copyTreeSize = 0U;
+
+        status = rbtree_entryCount(copyInTree, &copyTreeSize);
+        
+        if ( status == RBTREE_STATUS_OK )
+        {
+            for ( uint32_t i = 0U; i<copyTreeSize; i++ )
+            {
+                void * storeval = NULL;
+                RBTREE_KEY key = RBTREE_KEY_INVALID;
+                RBTREE_KEY retrive_key = RBTREE_KEY_INVALID;
+                
+                rbtree_retrieveByIndex(copyInTree, i, &storeval, &retrive_key);
+                
+                status = rbtree_insert(handle, storeval, &key);
+                
+                if ( status != RBTREE_STATUS_OK )
+                {
+                    RBTPRINT_DBG_E("Insertion at %u failed",i);
+                    break;
+                }
+            }
+            
+            if ( status == RBTREE_STATUS_OK )
+            {
+                status = rbtree_checks_validateTree(handle);
+            }
+        }
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_saveToFd ( RBTREE_HANDLE handle, int fd, rbtree_encoder_t encode_fn, void * userdata )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( rbtree_prv_isMapped(handle) )
+    {
+        RBTPRINT_DBG_E("Not available on a mapped tree");
+        status = RBTREE_STATUS_FAIL_NOT_SUPPORTED;
+    }
+    else if ( rbtree_prv_isValueTree(handle) )
+    {
+        RBTPRINT_DBG_E("Not available on a value tree");
+        status = RBTREE_STATUS_FAIL_NOT_SUPPORTED;
+    }
+    else if ( ( handle != RBTREE_HANDLE_INVALID ) && ( fd >= 0 ) )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        uint32_t nodeCount = 0U;
+        RBT_NODE * root = rbtree_prv_pinRoot(tree, &nodeCount);
+        
+        status = rbtree_serial_save(root, nodeCount, RBT_ATOMIC_LOAD(tree->keySeed), fd, encode_fn, userdata, tree);
+        
+        rbtree_prv_unpinRoot(root, tree);
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_loadFromFd ( RBTREE_HANDLE handle, int fd, rbtree_decoder_t decode_fn, void * userdata )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( fd >= 0 ) && ( ((RBT_TREE *)handle)->nodeCount == 0U ) )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        RBT_NODE * root = NULL;
+        uint32_t nodeCount = 0U;
+        uint64_t keySeed = 0U;
+        bool isInstalled = false;
+        
+        if ( tree->readOnly )
+        {
+            RBTPRINT_DBG_E("Tree is read-only");
+            status = RBTREE_STATUS_FAIL_READ_ONLY;
+        }
+        else if ( tree->mode == RBT_TREE_MODE_ARENA )
+        {
+            RBTPRINT_DBG_E("Not available on a mapped tree");
+            status = RBTREE_STATUS_FAIL_NOT_SUPPORTED;
+        }
+        else if ( tree->valueSize > 0U )
+        {
+            RBTPRINT_DBG_E("Not available on a value tree");
+            status = RBTREE_STATUS_FAIL_NOT_SUPPORTED;
+        }
+        else
+        {
+            /* built outside the lock, only the hand over needs it */
+            status = rbtree_serial_load(fd, decode_fn, userdata, tree, &root, &nodeCount, &keySeed);
+        }
+        
+        if ( status == RBTREE_STATUS_OK )
+        {
+            RBT_LOCK_MUTEX(tree->mutex);
+            
+            if ( tree->nodeCount == 0U )
+            {
+                if ( tree->mode == RBT_TREE_MODE_PERSISTENT )
+                {
+                    rbtree_mvcc_preserve(tree);
+                    rbtree_persist_releaseNode(tree->rootNode, tree);
+                }
+                
+                tree->rootNode = root;
+                tree->nodeCount = nodeCount;
+                tree->version++;
+                isInstalled = true;
+                
+                rbtree_prv_raiseKeySeed(tree, keySeed);
+                
+                status = rbtree_checks_validateTree(tree);
+            }
+            else
+            {
+                RBTPRINT_DBG_E("Tree filled while loading");
+                status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+            }
+            
+            RBT_UNLOCK_MUTEX(tree->mutex);
+            
+            if ( isInstalled == false )
+            {
+                rbtree_serial_freeNodes(root, tree);
+            }
+        }
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_exportImage ( RBTREE_HANDLE handle, int fd, rbtree_encoder_t encode_fn, void * userdata )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( ((RBT_TREE *)handle)->mode == RBT_TREE_MODE_IMAGE ) )
+    {
+        RBTPRINT_DBG_E("Already an image");
+        status = RBTREE_STATUS_FAIL_NOT_SUPPORTED;
+    }
+    else if ( rbtree_prv_isValueTree(handle) )
+    {
+        RBTPRINT_DBG_E("Not available on a value tree");
+        status = RBTREE_STATUS_FAIL_NOT_SUPPORTED;
+    }
+    else if ( ( handle != RBTREE_HANDLE_INVALID ) && ( fd >= 0 ) )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        uint32_t nodeCount = 0U;
+        RBT_NODE * root = rbtree_prv_pinRoot(tree, &nodeCount);
+        
+        status = rbtree_image_export(root, nodeCount, RBT_ATOMIC_LOAD(tree->keySeed), fd, encode_fn, userdata, tree);
+        
+        rbtree_prv_unpinRoot(root, tree);
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_openImage ( RBTREE_HANDLE * handle, int fd, rbtree_memalloc_t mem_alloc, rbtree_memfree_t mem_free )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( handle != NULL ) && ( fd >= 0 ) )
+    {
+        RBT_TREE * tree = NULL;
+        
+        status = rbtree_prv_createTree((RBTREE_HANDLE *)&tree, mem_alloc, mem_free, RBT_TREE_MODE_IMAGE);
+        
+        if ( status == RBTREE_STATUS_OK )
+        {
+            status = rbtree_image_open(fd, tree);
+            
+            if ( status == RBTREE_STATUS_OK )
+            {
+                tree->readOnly = true;
+                *handle = tree;
+            }
+            else
+            {
+                rbtree_destroyTree(tree);
+            }
+        }
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_attachLog ( RBTREE_HANDLE handle, int fd, RBTREE_LOG_SYNC sync, rbtree_encoder_t encode_fn, void * userdata )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( fd >= 0 ) && ( sync > RBTREE_LOG_SYNC_UNDEF ) && ( sync < RBTREE_LOG_SYNC_LAST_VALUE ) )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        RBT_WAL * wal = NULL;
+        
+        if ( tree->readOnly )
+        {
+            RBTPRINT_DBG_E("Tree is read-only");
+            status = RBTREE_STATUS_FAIL_READ_ONLY;
+        }
+        else if ( tree->mode == RBT_TREE_MODE_ARENA )
+        {
+            RBTPRINT_DBG_E("Not available on a mapped tree");
+            status = RBTREE_STATUS_FAIL_NOT_SUPPORTED;
+        }
+        else if ( tree->valueSize > 0U )
+        {
+            RBTPRINT_DBG_E("Not available on a value tree");
+            status = RBTREE_STATUS_FAIL_NOT_SUPPORTED;
+        }
+        else
+        {
+            status = rbtree_wal_create(fd, sync, encode_fn, userdata, tree, &wal);
+        }
+        
+        if ( status == RBTREE_STATUS_OK )
+        {
+            /* changes from here on are logged */
+            RBT_LOCK_MUTEX(tree->mutex);
+            
+            if ( tree->wal == NULL )
+            {
+                tree->wal = wal;
+                wal = NULL;
+            }
+            
+            RBT_UNLOCK_MUTEX(tree->mutex);
+            
+            if ( wal )
+            {
+                RBTPRINT_DBG_E("Log already attached");
+                rbtree_wal_destroy(wal, tree);
+                status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+            }
+        }
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_syncLog ( RBTREE_HANDLE handle )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( ((RBT_TREE *)handle)->wal != NULL ) )
+    {
+        status = rbtree_wal_sync(((RBT_TREE *)handle)->wal);
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_detachLog ( RBTREE_HANDLE handle )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( ((RBT_TREE *)handle)->wal != NULL ) )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        RBT_WAL * wal = NULL;
+        
+        RBT_LOCK_MUTEX(tree->mutex);
+        
+        wal = tree->wal;
+        tree->wal = NULL;
+        
+        RBT_UNLOCK_MUTEX(tree->mutex);
+        
+        status = rbtree_wal_destroy(wal, tree);
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_replayLog ( RBTREE_HANDLE handle, int fd, rbtree_decoder_t decode_fn, void * userdata )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( fd >= 0 ) && ( ((RBT_TREE *)handle)->wal == NULL ) )
+    {
+        RBT_TREE * tree = (RBT_TREE *)handle;
+        RBT_REPLAY replay;
+        
+        replay.tree = tree;
+        replay.decode_fn = decode_fn;
+        replay.userdata = userdata;
+        replay.keySeed = 0U;
+        replay.isChanged = false;
+        
+        if ( tree->readOnly )
+        {
+            RBTPRINT_DBG_E("Tree is read-only");
+            status = RBTREE_STATUS_FAIL_READ_ONLY;
+        }
+        else if ( tree->mode == RBT_TREE_MODE_ARENA )
+        {
+            RBTPRINT_DBG_E("Not available on a mapped tree");
+            status = RBTREE_STATUS_FAIL_NOT_SUPPORTED;
+        }
+        else if ( tree->valueSize > 0U )
+        {
+            RBTPRINT_DBG_E("Not available on a value tree");
+            status = RBTREE_STATUS_FAIL_NOT_SUPPORTED;
+        }
+        else
+        {
+            /* one lock & one version for the whole log, it is a single change to readers */
+            RBT_LOCK_MUTEX(tree->mutex);
+            
+            if ( tree->mode == RBT_TREE_MODE_PERSISTENT )
+            {
+                rbtree_mvcc_preserve(tree);
+            }
+            
+            status = rbtree_wal_replay(fd, (bool) ( decode_fn != NULL ), rbtree_prv_replayRecord, &replay, tree);
+            
+            if ( replay.isChanged )
+            {
+                tree->version++;
+            }
+            
+            rbtree_prv_raiseKeySeed(tree, replay.keySeed);
+            
+            if ( status == RBTREE_STATUS_OK )
+            {
+                status = rbtree_checks_validateTree(tree);
+            }
+            
+            RBT_UNLOCK_MUTEX(tree->mutex);
+        }
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_checkpointAsync ( RBTREE_HANDLE handle, const char * path, rbtree_encoder_t encode_fn, void * userdata, rbtree_completion_t done_fn, void * done_userdata )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( rbtree_prv_isMapped(handle) )
+    {
+        RBTPRINT_DBG_E("Not available on a mapped tree");
+        status = RBTREE_STATUS_FAIL_NOT_SUPPORTED;
+    }
+    else if ( rbtree_prv_isValueTree(handle) )
+    {
+        RBTPRINT_DBG_E("Not available on a value tree");
+        status = RBTREE_STATUS_FAIL_NOT_SUPPORTED;
+    }
+    else if ( ( handle != RBTREE_HANDLE_INVALID ) && ( path != NULL ) && ( path[0] != '\0' ) && ( done_fn != NULL ) )
+    {
+        status = rbtree_checkpoint_start((RBT_TREE *)handle, path, encode_fn, userdata, done_fn, done_userdata);
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_createSharedTree ( RBTREE_HANDLE * handle, const char * name, uint32_t capacity, rbtree_memalloc_t mem_alloc, rbtree_memfree_t mem_free )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( handle != NULL ) && ( name != NULL ) && ( name[0] == '/' ) && ( capacity > 0U ) && ( capacity < RBT_TREE_NODECOUNT_MAXVALUE ) )
+    {
+        RBT_TREE * tree = NULL;
+        
+        status = rbtree_prv_createTree((RBTREE_HANDLE *)&tree, mem_alloc, mem_free, RBT_TREE_MODE_ARENA);
+        
+        if ( status == RBTREE_STATUS_OK )
         {
-            RBT_NODE * next_node = getNext(cur_node);
+            status = rbtree_arena_createShared(name, capacity, tree);
             
-            rbtree_prv_removeNodeFromTree(cur_node,tree);
-            rbtree_prv_freeNode(cur_node,tree);
+            if ( status == RBTREE_STATUS_OK )
+            {
+                *handle = tree;
+            }
+            else
+            {
+                rbtree_destroyTree(tree);
+            }
+        }
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_attachSharedTree ( RBTREE_HANDLE * handle, const char * name, rbtree_memalloc_t mem_alloc, rbtree_memfree_t mem_free )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( handle != NULL ) && ( name != NULL ) && ( name[0] == '/' ) )
+    {
+        RBT_TREE * tree = NULL;
+        
+        status = rbtree_prv_createTree((RBTREE_HANDLE *)&tree, mem_alloc, mem_free, RBT_TREE_MODE_ARENA);
+        
+        if ( status == RBTREE_STATUS_OK )
+        {
+            status = rbtree_arena_attachShared(name, tree);
             
-            cur_node = next_node;
+            if ( status == RBTREE_STATUS_OK )
+            {
+                *handle = tree;
+            }
+            else
+            {
+                rbtree_destroyTree(tree);
+            }
         }
-
-        mem_free(tree);
-        
-        status = RBTREE_STATUS_OK;
     }
     else
     {
@@ -921,54 +3175,46 @@ RBTREE_STATUS rbtree_destroyTree ( RBTREE_HANDLE handle )
 }
 
 
-RBTREE_STATUS rbtree_insert ( RBTREE_HANDLE handle, void * storevalue, RBTREE_KEY * key )
+RBTREE_STATUS rbtree_unlinkSharedTree ( const char * name )
 {
     RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( name != NULL ) && ( name[0] == '/' ) )
+    {
+        status = rbtree_arena_unlinkShared(name);
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
+}
 
-    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( key != NULL ) )
+
+RBTREE_STATUS rbtree_openMappedTree ( RBTREE_HANDLE * handle, const char * path, uint32_t maxEntries, rbtree_memalloc_t mem_alloc, rbtree_memfree_t mem_free )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( handle != NULL ) && ( path != NULL ) && ( path[0] != '\0' ) && ( maxEntries > 0U ) && ( maxEntries < RBT_TREE_NODECOUNT_MAXVALUE ) )
     {
-        RBT_TREE * tree = (RBT_TREE *)handle;
+        RBT_TREE * tree = NULL;
         
-        RBT_NODE * ins_node = rbtree_prv_createNode(tree);
+        status = rbtree_prv_createTree((RBTREE_HANDLE *)&tree, mem_alloc, mem_free, RBT_TREE_MODE_ARENA);
         
-        if ( ins_node )
+        if ( status == RBTREE_STATUS_OK )
         {
-            RBT_LOCK_MUTEX(tree->mutex);
-            
-            ins_node->value = storevalue;
-            ins_node->key = tree->keySeed;
-            
-            /* insert node into tree maintaining BST */
-            status = rbtree_prv_insertNode(ins_node,tree);
+            status = rbtree_arena_openFile(path, maxEntries, tree);
             
             if ( status == RBTREE_STATUS_OK )
             {
-                ins_node->colour = RBT_COLOUR_RED;
-                
-                /* fix the red-black tree properties */
-                rbtree_prv_insertRBFixUp(ins_node, tree);
-
-                tree->keySeed++;
-                RBTPRINT_ASSERT(tree->keySeed<RBT_TREE_KEYSEED_MAXVALUE);
-
-                tree->nodeCount++;
-                RBTPRINT_ASSERT(tree->nodeCount<RBT_TREE_NODECOUNT_MAXVALUE);
-                
-                status = rbtree_checks_isTreeValid(handle);
-                
-                *key = ins_node->key;
+                *handle = tree;
             }
             else
             {
-                rbtree_prv_freeNode(ins_node,tree);
+                rbtree_destroyTree(tree);
             }
-            
-            RBT_UNLOCK_MUTEX(tree->mutex);            
-        }
-        else
-        {
-            RBTPRINT_DBG_E("Malloc failure");
-            status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
         }
     }
     else
@@ -981,25 +3227,22 @@ RBTREE_STATUS rbtree_insert ( RBTREE_HANDLE handle, void * storevalue, RBTREE_KE
 }
 
 
-RBTREE_STATUS rbtree_retrieveByKey ( RBTREE_HANDLE handle, RBTREE_KEY key, void ** ret_data )
+RBTREE_STATUS rbtree_syncMappedTree ( RBTREE_HANDLE handle )
 {
     RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
     
-    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( key != RBTREE_KEY_INVALID ) && ( ret_data != NULL ) )
+    if ( handle != RBTREE_HANDLE_INVALID )
     {
         RBT_TREE * tree = (RBT_TREE *)handle;
         
-        RBT_NODE * node = rbtree_prv_findKey(key, tree->rootNode);
-        
-        if ( node )
+        if ( tree->mode == RBT_TREE_MODE_ARENA )
         {
-            *ret_data = node->value;
-            status = RBTREE_STATUS_OK;
+            status = rbtree_arena_sync(tree->arena);
         }
         else
         {
-            RBTPRINT_DBG_E("Key does not exist");
-            status = RBTREE_STATUS_FAIL_KEY_DOES_NOT_EXIST;
+            RBTPRINT_DBG_E("Not a mapped tree");
+            status = RBTREE_STATUS_FAIL_NOT_SUPPORTED;
         }
     }
     else
@@ -1012,41 +3255,42 @@ RBTREE_STATUS rbtree_retrieveByKey ( RBTREE_HANDLE handle, RBTREE_KEY key, void
 }
 
 
-RBTREE_STATUS rbtree_retrieveByIndex ( RBTREE_HANDLE handle, uint32_t index, void ** ret_data, RBTREE_KEY * ret_key )
+RBTREE_STATUS rbtree_getStats ( RBTREE_HANDLE handle, RBTREE_STATS * stats )
 {
     RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
     
-    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( ret_data != NULL ) && ( ret_key != NULL ) )
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( stats != NULL ) )
     {
         RBT_TREE * tree = (RBT_TREE *)handle;
+        RBT_NODE * root = NULL;
+        uint32_t count = 0U;
         
-        if ( index <= tree->nodeCount )
+        rbtree_stats_read(&tree->stats, stats);
+        stats->entries = rbtree_prv_entryCount(tree);
+        stats->height = 0U;
+        stats->blackHeight = 0U;
+        
+        if ( tree->mode == RBT_TREE_MODE_IMAGE )
         {
-            RBT_NODE * node = getFirst(tree->rootNode);
-            uint32_t i = 0U;
-            
-            for (i=0U; i<index; i++)
-            {
-                RBTPRINT_ASSERT(node!=NULL);
-                node = getNext(node);
-            }
-            
-            if ( node )
-            {
-                *ret_data = node->value;
-                *ret_key = node->key;
-                status = RBTREE_STATUS_OK;
-            }
-            else
+            /* implicit tree, complete but for the last level & uncoloured */
+            for ( count=stats->entries; count; count >>= 1 )
             {
-                status = RBTREE_STATUS_FAIL;
+                stats->height++;
             }
         }
+        else if ( tree->mode == RBT_TREE_MODE_ARENA )
+        {
+            rbtree_arena_shape(tree->arena, &stats->height, &stats->blackHeight);
+        }
         else
         {
-            RBTPRINT_DBG_E("Index: %d out of range",index);
-            status = RBTREE_STATUS_FAIL_INDEX_OUT_OF_RANGE;
+            /* writers to a standard tree wait for the walk, persistent ones carry on */
+            root = rbtree_prv_pinRoot(tree, NULL);
+            rbtree_stats_shape(root, &stats->height, &stats->blackHeight);
+            rbtree_prv_unpinRoot(root, tree);
         }
+        
+        status = RBTREE_STATUS_OK;
     }
     else
     {
@@ -1058,30 +3302,24 @@ RBTREE_STATUS rbtree_retrieveByIndex ( RBTREE_HANDLE handle, uint32_t index, voi
 }
 
 
-RBTREE_STATUS rbtree_deleteByKey ( RBTREE_HANDLE handle, RBTREE_KEY key )
+RBTREE_STATUS rbtree_getInlineTree ( RBTREE_HANDLE handle, RBTREE_INLINE_TREE * tree )
 {
     RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
     
-    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( key != RBTREE_KEY_INVALID ) )
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( tree != NULL ) )
     {
-        RBT_TREE * tree = (RBT_TREE *)handle;
+        RBT_TREE * rbtree = (RBT_TREE *)handle;
         
-        RBT_NODE * node = rbtree_prv_findKey(key, tree->rootNode);
-        
-        if ( node )
+        if ( ( rbtree->mode == RBT_TREE_MODE_STANDARD ) || ( rbtree->mode == RBT_TREE_MODE_PERSISTENT ) )
         {
-            status = rbtree_prv_removeNodeFromTree(node,tree);
-            rbtree_prv_freeNode(node,tree);
-            
-            if ( status == RBTREE_STATUS_OK )
-            {
-                status = rbtree_checks_isTreeValid(handle);
-            }
+            /* a persistent node starts with its RBT_NODE, so both walk the same */
+            tree->root = (RBTREE_INLINE_NODE * const *)&rbtree->rootNode;
+            status = RBTREE_STATUS_OK;
         }
         else
         {
-            RBTPRINT_DBG_W("Key:%u does not exist",key);
-            status = RBTREE_STATUS_FAIL_KEY_DOES_NOT_EXIST;
+            RBTPRINT_DBG_E("Tree has no nodes to walk");
+            status = RBTREE_STATUS_FAIL_NOT_SUPPORTED;
         }
     }
     else
@@ -1094,43 +3332,42 @@ RBTREE_STATUS rbtree_deleteByKey ( RBTREE_HANDLE handle, RBTREE_KEY key )
 }
 
 
-RBTREE_STATUS rbtree_deleteByValue ( RBTREE_HANDLE handle, void * value )
+RBTREE_STATUS rbtree_setLatencySampling ( RBTREE_HANDLE handle, uint32_t sampleEvery )
 {
     RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
     
     if ( handle != RBTREE_HANDLE_INVALID )
     {
         RBT_TREE * tree = (RBT_TREE *)handle;
-        RBT_NODE * node = rbtree_prv_getFirst(tree->rootNode);
-        uint32_t i = 0U;
-        bool matchFound = false;
         
-        for ( i=0U; i<tree->nodeCount; i++ )
+        RBT_LOCK_MUTEX(tree->mutex);
+        
+        if ( ( tree->latencyData == NULL ) && ( sampleEvery ) )
         {
-            if ( node )
-            {
-                if ( node->value == value )
-                {
-                    rbtree_prv_removeNodeFromTree(node,tree);
-                    rbtree_prv_freeNode(node,tree);
-
-                    matchFound = true;
-                }
-            }
-            
-            node = rbtree_prv_getNext(node);
+            tree->latencyData = rbtree_latency_create(tree);
         }
         
-        if ( matchFound )
+        if ( tree->latencyData )
         {
-            /* all is ok. Check validatity of tree */
-            status = rbtree_checks_isTreeValid(handle);
+            RBT_ATOMIC_STORE(tree->latencyData->sampleEvery, sampleEvery);
+            
+            /* callers that loaded the pointer before it is cleared finish with the histograms intact */
+            RBT_ATOMIC_STORE_RELEASE(tree->latency, ( sampleEvery ) ? tree->latencyData : NULL);
+            
+            status = RBTREE_STATUS_OK;
+        }
+        else if ( sampleEvery )
+        {
+            RBTPRINT_DBG_E("Malloc failure");
+            status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
         }
         else
         {
-            RBTPRINT_DBG_W("Value:%p does not exist",value);
-            status = RBTREE_STATUS_FAIL_VALUE_DOES_NOT_EXIST;
+            /* never on, nothing to turn off */
+            status = RBTREE_STATUS_OK;
         }
+        
+        RBT_UNLOCK_MUTEX(tree->mutex);
     }
     else
     {
@@ -1142,46 +3379,29 @@ RBTREE_STATUS rbtree_deleteByValue ( RBTREE_HANDLE handle, void * value )
 }
 
 
-RBTREE_STATUS rbtree_deleteByIndex ( RBTREE_HANDLE handle, uint32_t index )
+RBTREE_STATUS rbtree_getLatency ( RBTREE_HANDLE handle, RBTREE_LATENCY_OP op, RBTREE_LATENCY_PHASE phase, RBTREE_LATENCY * latency )
 {
     RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
     
-    if ( handle != RBTREE_HANDLE_INVALID )
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( op > RBTREE_LATENCY_OP_UNDEF ) && ( op < RBTREE_LATENCY_OP_LAST_VALUE ) && ( phase > RBTREE_LATENCY_PHASE_UNDEF ) && ( phase < RBTREE_LATENCY_PHASE_LAST_VALUE ) && ( latency != NULL ) )
     {
         RBT_TREE * tree = (RBT_TREE *)handle;
         
-        if ( index <= tree->nodeCount )
+        /* latencyData is only set under the mutex */
+        RBT_LOCK_MUTEX(tree->mutex);
+        
+        if ( tree->latencyData )
         {
-            RBT_NODE * node = getFirst(tree->rootNode);
-            uint32_t i = 0U;
-            
-            for ( i=0U; i<index; i++ )
-            {
-                RBTPRINT_ASSERT(node!=NULL);
-                node = getNext(node);
-            }
-
-            if ( node )
-            {
-                status = rbtree_prv_removeNodeFromTree(node,tree);
-                rbtree_prv_freeNode(node,tree);
-
-                if ( status == RBTREE_STATUS_OK )
-                {
-                    status = rbtree_checks_isTreeValid(handle);
-                }
-            }
-            else
-            {
-                RBTPRINT_DBG_W("Node:%p does not exist",node);
-                status = RBTREE_STATUS_FAIL_INDEX_OUT_OF_RANGE;
-            }
+            rbtree_latency_read(tree->latencyData, op, phase, latency);
         }
         else
         {
-            RBTPRINT_DBG_W("Index out of range: %u",index);
-            status = RBTREE_STATUS_FAIL_INDEX_OUT_OF_RANGE;
+            memset(latency, 0, sizeof(RBTREE_LATENCY));
         }
+        
+        RBT_UNLOCK_MUTEX(tree->mutex);
+        
+        status = RBTREE_STATUS_OK;
     }
     else
     {
@@ -1193,38 +3413,28 @@ RBTREE_STATUS rbtree_deleteByIndex ( RBTREE_HANDLE handle, uint32_t index )
 }
 
 
-RBTREE_STATUS rbtree_find ( RBTREE_HANDLE handle, rbtree_comparator_t cmp_fn, void * userdata, void ** ret_storevalue, RBTREE_KEY * ret_key )
+RBTREE_STATUS rbtree_printLatency ( RBTREE_HANDLE handle, FILE * fp )
 {
     RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
     
-    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( cmp_fn != NULL ) && ( ret_storevalue != NULL ) && ( ret_key != NULL ) )
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( fp != NULL ) )
     {
         RBT_TREE * tree = (RBT_TREE *)handle;
         
-        RBT_NODE * node = rbtree_prv_getFirst(tree->rootNode);
+        RBT_LOCK_MUTEX(tree->mutex);
         
-        bool res = false;
-
-        status = RBTREE_STATUS_FAIL;
-
-        while ( node != NULL )
+        if ( tree->latencyData )
         {
-            res = cmp_fn(node->value,userdata);
-            
-            if ( res )
-            {
-                *ret_storevalue = node->value;
-                *ret_key = node->key;
-                
-                status = RBTREE_STATUS_OK;
-                
-                break;
-            }
-            else
-            {
-                node = rbtree_prv_getNext(node);
-            }
+            rbtree_latency_print(tree->latencyData, fp);
+            status = RBTREE_STATUS_OK;
+        }
+        else
+        {
+            RBTPRINT_DBG_E("Latency sampling never turned on");
+            status = RBTREE_STATUS_FAIL;
         }
+        
+        RBT_UNLOCK_MUTEX(tree->mutex);
     }
     else
     {
@@ -1236,24 +3446,25 @@ RBTREE_STATUS rbtree_find ( RBTREE_HANDLE handle, rbtree_comparator_t cmp_fn, vo
 }
 
 
-RBTREE_STATUS rbtree_doesKeyExist ( RBTREE_HANDLE handle, RBTREE_KEY key, bool * doesExist )
+RBTREE_STATUS rbtree_setLockProfiling ( bool enable )
 {
     RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
     
-    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( key != RBTREE_KEY_INVALID ) && ( doesExist != NULL ) )
+    rbtree_lockprof_enable(enable);
+    
+    status = RBTREE_STATUS_OK;
+    
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_getLockProfile ( RBTREE_LOCK_SITE * sites, uint32_t * count )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( ( sites != NULL ) && ( count != NULL ) )
     {
-        RBT_TREE * tree = (RBT_TREE *)handle;
-        
-        RBT_NODE * node = rbtree_prv_findKey(key, tree->rootNode);
-        
-        if ( node )
-        {
-            *doesExist = true;
-        }
-        else
-        {
-            *doesExist = false;
-        }
+        rbtree_lockprof_read(sites, count);
         
         status = RBTREE_STATUS_OK;
     }
@@ -1267,31 +3478,57 @@ RBTREE_STATUS rbtree_doesKeyExist ( RBTREE_HANDLE handle, RBTREE_KEY key, bool *
 }
 
 
-bool rbtree_doesValueExist_prv_comp (void* storevalue, void* userdata)
+RBTREE_STATUS rbtree_printLockProfile ( FILE * fp )
 {
-    return ( storevalue == userdata ) ? true : false;
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+    if ( fp != NULL )
+    {
+        rbtree_lockprof_print(fp);
+        
+        status = RBTREE_STATUS_OK;
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Invalid param");
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    
+    return status;
 }
 
 
-RBTREE_STATUS rbtree_doesValueExist ( RBTREE_HANDLE handle, void * storevalue, bool * doesExist )
+RBTREE_STATUS rbtree_startTrace ( RBTREE_HANDLE handle, int fd )
 {
     RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
     
-    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( doesExist != NULL ) )
+    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( fd >= 0 ) )
     {
-        void * ret_storevalue = NULL;
-        RBTREE_KEY ret_key = RBTREE_KEY_INVALID;
+        RBT_TREE * tree = (RBT_TREE *)handle;
         
-        status = rbtree_find ( handle, rbtree_doesValueExist_prv_comp, storevalue, &ret_storevalue, &ret_key );
+        RBT_LOCK_MUTEX(tree->mutex);
         
-        if ( status == RBTREE_STATUS_OK )
+        if ( tree->traceData == NULL )
         {
-            *doesExist = true;
+            tree->traceData = rbtree_trace_create(tree);
+        }
+        
+        if ( tree->traceData )
+        {
+            status = rbtree_trace_start(tree->traceData, fd, (bool) ( tree->mode == RBT_TREE_MODE_PERSISTENT ));
+            
+            if ( status == RBTREE_STATUS_OK )
+            {
+                RBT_ATOMIC_STORE_RELEASE(tree->trace, tree->traceData);
+            }
         }
         else
         {
-            *doesExist = false;
+            RBTPRINT_DBG_E("Malloc failure");
+            status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
         }
+        
+        RBT_UNLOCK_MUTEX(tree->mutex);
     }
     else
     {
@@ -1303,17 +3540,30 @@ RBTREE_STATUS rbtree_doesValueExist ( RBTREE_HANDLE handle, void * storevalue, b
 }
 
 
-RBTREE_STATUS rbtree_entryCount ( RBTREE_HANDLE handle, uint32_t * numberOfEntries )
+RBTREE_STATUS rbtree_stopTrace ( RBTREE_HANDLE handle )
 {
     RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
     
-    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( numberOfEntries != NULL ) )
+    if ( handle != RBTREE_HANDLE_INVALID )
     {
         RBT_TREE * tree = (RBT_TREE *)handle;
         
-        *numberOfEntries = tree->nodeCount;
+        RBT_LOCK_MUTEX(tree->mutex);
         
-        status = RBTREE_STATUS_OK;
+        if ( tree->traceData )
+        {
+            /* callers that loaded the pointer before it is cleared have their records dropped by the trace */
+            RBT_ATOMIC_STORE_RELEASE(tree->trace, NULL);
+            
+            status = rbtree_trace_stop(tree->traceData);
+        }
+        else
+        {
+            /* never on, nothing to stop */
+            status = RBTREE_STATUS_OK;
+        }
+        
+        RBT_UNLOCK_MUTEX(tree->mutex);
     }
     else
     {
@@ -1325,40 +3575,13 @@ RBTREE_STATUS rbtree_entryCount ( RBTREE_HANDLE handle, uint32_t * numberOfEntri
 }
 
 
-RBTREE_STATUS rbtree_copyInTree ( RBTREE_HANDLE handle, RBTREE_HANDLE copyInTree )
+RBTREE_STATUS rbtree_replayTrace ( int fd, bool isInterleaved, RBTREE_TRACE_REPORT * report )
 {
     RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
     
-    if ( ( handle != RBTREE_HANDLE_INVALID ) && ( copyInTree != RBTREE_HANDLE_INVALID ) )
+    if ( ( fd >= 0 ) && ( report != NULL ) )
     {
-        uint32_t copyTreeSize = 0U;
-
-        status = rbtree_entryCount(copyInTree, &copyTreeSize);
-        
-        if ( status == RBTREE_STATUS_OK )
-        {
-            for ( uint32_t i = 0U; i<copyTreeSize; i++ )
-            {
-                void * storeval = NULL;
-                RBTREE_KEY key = RBTREE_KEY_INVALID;
-                RBTREE_KEY retrive_key = RBTREE_KEY_INVALID;
-                
-                rbtree_retrieveByIndex(copyInTree, i, &storeval, &retrive_key);
-                
-                status = rbtree_insert(handle, storeval, &key);
-                
-                if ( status != RBTREE_STATUS_OK )
-                {
-                    RBTPRINT_DBG_E("Insertion at %u failed",i);
-                    break;
-                }
-            }
-            
-            if ( status == RBTREE_STATUS_OK )
-            {
-                status = rbtree_checks_isTreeValid(handle);
-            }
-        }
+        status = rbtree_trace_replay(fd, isInterleaved, report);
     }
     else
     {
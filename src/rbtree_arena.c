@@ -0,0 +1,1126 @@
+/**
+ @file
+ Red-Black Binary Search Tree - Position independent tree in a mapped arena
+
+ @details The mapping holds a header, then an array of fixed size nodes linked by index.
+ Index 0 is a black nil sentinel, which keeps the delete fix-up free of NULL checks.
+ Nodes are handed out from a bump pointer & recycled through a free list, all under the
+ header mutex, so nothing in the arena refers to an address in any one process.
+
+ The mutex is process-shared & robust. If a process dies holding it between the start &
+ end of tree surgery the arena is marked broken & every later call fails rather than
+ trusting a half rotated tree.
+
+ The same layout backs a file. The whole of maxCapacity is mapped up front, past the end of the
+ file, & the file is extended as nodes run out, so the arena never moves & links never need
+ fixing up. Reopening is a header check.
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "rbtree.h"
+#include <string.h>         /* memcpy, memcmp */
+#include <errno.h>
+#include <fcntl.h>          /* open, fcntl, O_* */
+#include <unistd.h>         /* ftruncate, close, pread */
+#include <sys/mman.h>       /* shm_open, mmap, msync */
+#include <sys/stat.h>       /* fstat */
+#include "rbtree_common.h"
+#include "rbtree_arena.h"
+
+
+#define RBT_ARENA_MAGIC "RBTARENA"
+#define RBT_ARENA_FORMAT (1U)
+#define RBT_ARENA_BYTE_ORDER (0x01020304U)
+
+/* nodes start on a cache line */
+#define RBT_ARENA_NODES_OFFSET ( ( sizeof(RBT_ARENA_HEADER) + 63U ) & ~(size_t)63U )
+
+/* node slots in a new file, it doubles from there */
+#define RBT_ARENA_INITIAL_CAPACITY (1024U)
+
+#define RBT_ARENA_SIZE(capacity) ( RBT_ARENA_NODES_OFFSET + ( (size_t)(capacity) + 1U ) * sizeof(RBT_ANODE) )
+
+/* shorthand, every function using it has the arena as a */
+#define N(ref) ( &(a)->nodes[(ref)] )
+
+
+static inline RBTREE_STATUS rbtree_arena_prv_lock ( RBT_ARENA * arena );
+static inline void rbtree_arena_prv_unlock ( RBT_ARENA * arena );
+static inline RBTREE_STATUS rbtree_arena_prv_map ( int fd, size_t size, RBT_TREE * tree );
+static inline void rbtree_arena_prv_initMutex ( RBT_ARENA_HEADER * header );
+static inline void rbtree_arena_prv_init ( RBT_ARENA * arena, uint32_t capacity, uint32_t maxCapacity );
+static inline RBTREE_STATUS rbtree_arena_prv_readHeader ( int fd, RBT_ARENA_HEADER * header );
+static inline bool rbtree_arena_prv_grow ( RBT_ARENA * a );
+static inline RBT_AREF rbtree_arena_prv_allocNode ( RBT_ARENA * a );
+static inline void rbtree_arena_prv_freeNode ( RBT_ARENA * a, RBT_AREF ref );
+static inline RBT_AREF rbtree_arena_prv_findKey ( RBT_ARENA * a, RBTREE_KEY key );
+static inline RBT_AREF rbtree_arena_prv_first ( RBT_ARENA * a, RBT_AREF ref );
+static inline RBT_AREF rbtree_arena_prv_next ( RBT_ARENA * a, RBT_AREF ref );
+static inline void rbtree_arena_prv_rotateLeft ( RBT_ARENA * a, RBT_AREF x );
+static inline void rbtree_arena_prv_rotateRight ( RBT_ARENA * a, RBT_AREF x );
+static inline void rbtree_arena_prv_insertFixUp ( RBT_ARENA * a, RBT_AREF z );
+static inline void rbtree_arena_prv_transplant ( RBT_ARENA * a, RBT_AREF u, RBT_AREF v );
+static inline void rbtree_arena_prv_deleteFixUp ( RBT_ARENA * a, RBT_AREF x );
+static uint32_t rbtree_arena_prv_height ( RBT_ARENA * a, RBT_AREF ref );
+
+
+static inline RBTREE_STATUS rbtree_arena_prv_lock ( RBT_ARENA * arena )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_OK;
+    int res = pthread_mutex_lock(&arena->header->mutex);
+
+    if ( res == EOWNERDEAD )
+    {
+        /* the holder died. Only surgery in progress leaves the tree unusable */
+        if ( arena->header->isWriting )
+        {
+            RBTPRINT_DBG_E("Arena owner died mid update");
+            arena->header->isBroken = 1U;
+        }
+
+        pthread_mutex_consistent(&arena->header->mutex);
+    }
+    else if ( res != 0 )
+    {
+        RBTPRINT_DBG_E("Arena lock failed: %d",res);
+        status = RBTREE_STATUS_FAIL;
+    }
+
+    if ( ( status == RBTREE_STATUS_OK ) && ( arena->header->isBroken ) )
+    {
+        pthread_mutex_unlock(&arena->header->mutex);
+        status = RBTREE_STATUS_FAIL_CORRUPT_DATA;
+    }
+
+    return status;
+}
+
+static inline void rbtree_arena_prv_unlock ( RBT_ARENA * arena )
+{
+    pthread_mutex_unlock(&arena->header->mutex);
+}
+
+static inline RBTREE_STATUS rbtree_arena_prv_map ( int fd, size_t size, RBT_TREE * tree )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    RBT_ARENA * arena = tree->mem_alloc(sizeof(RBT_ARENA));
+    void * base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if ( base == MAP_FAILED )
+    {
+        RBTPRINT_DBG_E("mmap failed: %d",errno);
+        status = RBTREE_STATUS_FAIL_IO;
+    }
+    else if ( arena == NULL )
+    {
+        RBTPRINT_DBG_E("Malloc failure");
+        status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+    }
+    else
+    {
+        arena->header = (RBT_ARENA_HEADER *)base;
+        arena->nodes = (RBT_ANODE *)( (uint8_t *)base + RBT_ARENA_NODES_OFFSET );
+        arena->size = size;
+        arena->fd = fd;
+
+        tree->arena = arena;
+        status = RBTREE_STATUS_OK;
+    }
+
+    if ( status != RBTREE_STATUS_OK )
+    {
+        if ( base != MAP_FAILED )
+        {
+            munmap(base, size);
+        }
+
+        if ( arena )
+        {
+            tree->mem_free(arena);
+        }
+    }
+
+    return status;
+}
+
+static inline void rbtree_arena_prv_initMutex ( RBT_ARENA_HEADER * header )
+{
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&header->mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+static inline void rbtree_arena_prv_init ( RBT_ARENA * arena, uint32_t capacity, uint32_t maxCapacity )
+{
+    RBT_ARENA_HEADER * header = arena->header;
+
+    /* ftruncate zero fills, so only the sentinel's colour needs setting */
+    header->format = RBT_ARENA_FORMAT;
+    header->byteOrder = RBT_ARENA_BYTE_ORDER;
+    header->size = RBT_ARENA_SIZE(capacity);
+    header->capacity = capacity;
+    header->maxCapacity = maxCapacity;
+    header->keySeed = (uint64_t)RBTREE_KEY_INVALID + 1U;
+    arena->nodes[0].colour = RBT_COLOUR_BLACK;
+
+    rbtree_arena_prv_initMutex(header);
+
+    memcpy(header->magic, RBT_ARENA_MAGIC, sizeof(header->magic));
+}
+
+static inline RBTREE_STATUS rbtree_arena_prv_readHeader ( int fd, RBT_ARENA_HEADER * header )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    struct stat info;
+
+    /* read rather than mapped, the header says how much to map */
+    if ( fstat(fd, &info) != 0 )
+    {
+        RBTPRINT_DBG_E("fstat failed: %d",errno);
+        status = RBTREE_STATUS_FAIL_IO;
+    }
+    else if ( pread(fd, header, sizeof(RBT_ARENA_HEADER), 0) != (ssize_t)sizeof(RBT_ARENA_HEADER) )
+    {
+        RBTPRINT_DBG_E("Too small for an arena");
+        status = RBTREE_STATUS_FAIL_CORRUPT_DATA;
+    }
+    else if ( ( memcmp(header->magic, RBT_ARENA_MAGIC, sizeof(header->magic)) != 0 ) || ( header->format != RBT_ARENA_FORMAT ) || ( header->byteOrder != RBT_ARENA_BYTE_ORDER ) )
+    {
+        RBTPRINT_DBG_E("Not an arena, or not finished being created");
+        status = RBTREE_STATUS_FAIL_CORRUPT_DATA;
+    }
+    else if ( ( header->size > (uint64_t)info.st_size ) || ( header->size != RBT_ARENA_SIZE(header->capacity) ) || ( header->capacity > header->maxCapacity ) || ( header->used > header->capacity ) )
+    {
+        /* a grow interrupted after the ftruncate leaves the file larger, which is harmless */
+        RBTPRINT_DBG_E("Arena size mismatch");
+        status = RBTREE_STATUS_FAIL_CORRUPT_DATA;
+    }
+    else if ( ( header->root > header->used ) || ( header->freeList > header->used ) )
+    {
+        /* refs index the node array directly. 0 is the nil sentinel, anything past used was never handed out */
+        RBTPRINT_DBG_E("Arena root:%u or free list:%u out of range",header->root,header->freeList);
+        status = RBTREE_STATUS_FAIL_CORRUPT_DATA;
+    }
+    else
+    {
+        status = RBTREE_STATUS_OK;
+    }
+
+    return status;
+}
+
+static inline bool rbtree_arena_prv_grow ( RBT_ARENA * a )
+{
+    RBT_ARENA_HEADER * h = a->header;
+    uint64_t capacity = (uint64_t)h->capacity * 2U;
+    bool didGrow = false;
+
+    if ( capacity > h->maxCapacity )
+    {
+        capacity = h->maxCapacity;
+    }
+
+    /* the mapping already spans maxCapacity, only the file needs extending. Then the header, so
+       it never describes more than the file holds */
+    if ( capacity <= h->capacity )
+    {
+        /* at the limit */
+    }
+    else if ( ftruncate(a->fd, (off_t)RBT_ARENA_SIZE(capacity)) != 0 )
+    {
+        RBTPRINT_DBG_E("ftruncate failed: %d",errno);
+    }
+    else
+    {
+        h->capacity = (uint32_t)capacity;
+        h->size = RBT_ARENA_SIZE(capacity);
+        didGrow = true;
+    }
+
+    return didGrow;
+}
+
+static inline RBT_AREF rbtree_arena_prv_allocNode ( RBT_ARENA * a )
+{
+    RBT_ARENA_HEADER * h = a->header;
+    RBT_AREF ref = h->freeList;
+
+    if ( ref != 0U )
+    {
+        h->freeList = N(ref)->left;
+    }
+    else if ( ( h->used < h->capacity ) || ( rbtree_arena_prv_grow(a) ) )
+    {
+        ref = ++h->used;
+    }
+
+    return ref;
+}
+
+static inline void rbtree_arena_prv_freeNode ( RBT_ARENA * a, RBT_AREF ref )
+{
+    N(ref)->left = a->header->freeList;
+    a->header->freeList = ref;
+}
+
+static inline RBT_AREF rbtree_arena_prv_findKey ( RBT_ARENA * a, RBTREE_KEY key )
+{
+    RBT_AREF ref = a->header->root;
+
+    while ( ( ref != 0U ) && ( N(ref)->key != key ) )
+    {
+        ref = ( key < N(ref)->key ) ? N(ref)->left : N(ref)->right;
+    }
+
+    return ref;
+}
+
+static inline RBT_AREF rbtree_arena_prv_first ( RBT_ARENA * a, RBT_AREF ref )
+{
+    while ( ( ref != 0U ) && ( N(ref)->left != 0U ) )
+    {
+        ref = N(ref)->left;
+    }
+
+    return ref;
+}
+
+static inline RBT_AREF rbtree_arena_prv_next ( RBT_ARENA * a, RBT_AREF ref )
+{
+    if ( N(ref)->right != 0U )
+    {
+        ref = rbtree_arena_prv_first(a, N(ref)->right);
+    }
+    else
+    {
+        RBT_AREF parent = N(ref)->parent;
+
+        while ( ( parent != 0U ) && ( ref == N(parent)->right ) )
+        {
+            ref = parent;
+            parent = N(parent)->parent;
+        }
+
+        ref = parent;
+    }
+
+    return ref;
+}
+
+static inline void rbtree_arena_prv_rotateLeft ( RBT_ARENA * a, RBT_AREF x )
+{
+    RBT_AREF y = N(x)->right;
+
+    N(x)->right = N(y)->left;
+
+    if ( N(y)->left != 0U )
+    {
+        N(N(y)->left)->parent = x;
+    }
+
+    N(y)->parent = N(x)->parent;
+
+    if ( N(x)->parent == 0U )
+    {
+        a->header->root = y;
+    }
+    else if ( x == N(N(x)->parent)->left )
+    {
+        N(N(x)->parent)->left = y;
+    }
+    else
+    {
+        N(N(x)->parent)->right = y;
+    }
+
+    N(y)->left = x;
+    N(x)->parent = y;
+}
+
+static inline void rbtree_arena_prv_rotateRight ( RBT_ARENA * a, RBT_AREF x )
+{
+    RBT_AREF y = N(x)->left;
+
+    N(x)->left = N(y)->right;
+
+    if ( N(y)->right != 0U )
+    {
+        N(N(y)->right)->parent = x;
+    }
+
+    N(y)->parent = N(x)->parent;
+
+    if ( N(x)->parent == 0U )
+    {
+        a->header->root = y;
+    }
+    else if ( x == N(N(x)->parent)->right )
+    {
+        N(N(x)->parent)->right = y;
+    }
+    else
+    {
+        N(N(x)->parent)->left = y;
+    }
+
+    N(y)->right = x;
+    N(x)->parent = y;
+}
+
+static inline void rbtree_arena_prv_insertFixUp ( RBT_ARENA * a, RBT_AREF z )
+{
+    while ( N(N(z)->parent)->colour == RBT_COLOUR_RED )
+    {
+        RBT_AREF parent = N(z)->parent;
+        RBT_AREF grandParent = N(parent)->parent;
+
+        if ( parent == N(grandParent)->left )
+        {
+            RBT_AREF uncle = N(grandParent)->right;
+
+            if ( N(uncle)->colour == RBT_COLOUR_RED )
+            {
+                N(parent)->colour = RBT_COLOUR_BLACK;
+                N(uncle)->colour = RBT_COLOUR_BLACK;
+                N(grandParent)->colour = RBT_COLOUR_RED;
+                z = grandParent;
+            }
+            else
+            {
+                if ( z == N(parent)->right )
+                {
+                    z = parent;
+                    rbtree_arena_prv_rotateLeft(a, z);
+                    parent = N(z)->parent;
+                }
+
+                N(parent)->colour = RBT_COLOUR_BLACK;
+                N(grandParent)->colour = RBT_COLOUR_RED;
+                rbtree_arena_prv_rotateRight(a, grandParent);
+            }
+        }
+        else
+        {
+            RBT_AREF uncle = N(grandParent)->left;
+
+            if ( N(uncle)->colour == RBT_COLOUR_RED )
+            {
+                N(parent)->colour = RBT_COLOUR_BLACK;
+                N(uncle)->colour = RBT_COLOUR_BLACK;
+                N(grandParent)->colour = RBT_COLOUR_RED;
+                z = grandParent;
+            }
+            else
+            {
+                if ( z == N(parent)->left )
+                {
+                    z = parent;
+                    rbtree_arena_prv_rotateRight(a, z);
+                    parent = N(z)->parent;
+                }
+
+                N(parent)->colour = RBT_COLOUR_BLACK;
+                N(grandParent)->colour = RBT_COLOUR_RED;
+                rbtree_arena_prv_rotateLeft(a, grandParent);
+            }
+        }
+    }
+
+    N(a->header->root)->colour = RBT_COLOUR_BLACK;
+}
+
+static inline void rbtree_arena_prv_transplant ( RBT_ARENA * a, RBT_AREF u, RBT_AREF v )
+{
+    if ( N(u)->parent == 0U )
+    {
+        a->header->root = v;
+    }
+    else if ( u == N(N(u)->parent)->left )
+    {
+        N(N(u)->parent)->left = v;
+    }
+    else
+    {
+        N(N(u)->parent)->right = v;
+    }
+
+    /* v may be the sentinel, its parent is what the fix-up climbs from */
+    N(v)->parent = N(u)->parent;
+}
+
+static inline void rbtree_arena_prv_deleteFixUp ( RBT_ARENA * a, RBT_AREF x )
+{
+    while ( ( x != a->header->root ) && ( N(x)->colour == RBT_COLOUR_BLACK ) )
+    {
+        RBT_AREF parent = N(x)->parent;
+
+        if ( x == N(parent)->left )
+        {
+            RBT_AREF w = N(parent)->right;
+
+            if ( N(w)->colour == RBT_COLOUR_RED )
+            {
+                N(w)->colour = RBT_COLOUR_BLACK;
+                N(parent)->colour = RBT_COLOUR_RED;
+                rbtree_arena_prv_rotateLeft(a, parent);
+                w = N(parent)->right;
+            }
+
+            if ( ( N(N(w)->left)->colour == RBT_COLOUR_BLACK ) && ( N(N(w)->right)->colour == RBT_COLOUR_BLACK ) )
+            {
+                N(w)->colour = RBT_COLOUR_RED;
+                x = parent;
+            }
+            else
+            {
+                if ( N(N(w)->right)->colour == RBT_COLOUR_BLACK )
+                {
+                    N(N(w)->left)->colour = RBT_COLOUR_BLACK;
+                    N(w)->colour = RBT_COLOUR_RED;
+                    rbtree_arena_prv_rotateRight(a, w);
+                    w = N(parent)->right;
+                }
+
+                N(w)->colour = N(parent)->colour;
+                N(parent)->colour = RBT_COLOUR_BLACK;
+                N(N(w)->right)->colour = RBT_COLOUR_BLACK;
+                rbtree_arena_prv_rotateLeft(a, parent);
+                x = a->header->root;
+            }
+        }
+        else
+        {
+            RBT_AREF w = N(parent)->left;
+
+            if ( N(w)->colour == RBT_COLOUR_RED )
+            {
+                N(w)->colour = RBT_COLOUR_BLACK;
+                N(parent)->colour = RBT_COLOUR_RED;
+                rbtree_arena_prv_rotateRight(a, parent);
+                w = N(parent)->left;
+            }
+
+            if ( ( N(N(w)->right)->colour == RBT_COLOUR_BLACK ) && ( N(N(w)->left)->colour == RBT_COLOUR_BLACK ) )
+            {
+                N(w)->colour = RBT_COLOUR_RED;
+                x = parent;
+            }
+            else
+            {
+                if ( N(N(w)->left)->colour == RBT_COLOUR_BLACK )
+                {
+                    N(N(w)->right)->colour = RBT_COLOUR_BLACK;
+                    N(w)->colour = RBT_COLOUR_RED;
+                    rbtree_arena_prv_rotateLeft(a, w);
+                    w = N(parent)->left;
+                }
+
+                N(w)->colour = N(parent)->colour;
+                N(parent)->colour = RBT_COLOUR_BLACK;
+                N(N(w)->left)->colour = RBT_COLOUR_BLACK;
+                rbtree_arena_prv_rotateRight(a, parent);
+                x = a->header->root;
+            }
+        }
+    }
+
+    N(x)->colour = RBT_COLOUR_BLACK;
+}
+
+static uint32_t rbtree_arena_prv_height ( RBT_ARENA * a, RBT_AREF ref )
+{
+    uint32_t height = 0U;
+
+    if ( ref != 0U )
+    {
+        uint32_t left = rbtree_arena_prv_height(a, N(ref)->left);
+        uint32_t right = rbtree_arena_prv_height(a, N(ref)->right);
+
+        height = 1U + ( ( left > right ) ? left : right );
+    }
+
+    return height;
+}
+
+
+RBTREE_STATUS rbtree_arena_createShared ( const char * name, uint32_t capacity, RBT_TREE * tree )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    size_t size = RBT_ARENA_SIZE(capacity);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+
+    if ( fd < 0 )
+    {
+        RBTPRINT_DBG_E("shm_open %s failed: %d",name,errno);
+        status = ( errno == EEXIST ) ? RBTREE_STATUS_FAIL_INVALID_PARAM : RBTREE_STATUS_FAIL_IO;
+    }
+    else if ( ftruncate(fd, (off_t)size) != 0 )
+    {
+        RBTPRINT_DBG_E("ftruncate failed: %d",errno);
+        status = RBTREE_STATUS_FAIL_IO;
+    }
+    else
+    {
+        status = rbtree_arena_prv_map(fd, size, tree);
+    }
+
+    if ( status == RBTREE_STATUS_OK )
+    {
+        /* fixed size, every process maps all of it */
+        rbtree_arena_prv_init(tree->arena, capacity, capacity);
+    }
+    else if ( fd >= 0 )
+    {
+        close(fd);
+        shm_unlink(name);
+    }
+
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_arena_attachShared ( const char * name, RBT_TREE * tree )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    RBT_ARENA_HEADER header;
+    int fd = shm_open(name, O_RDWR, 0);
+
+    if ( fd < 0 )
+    {
+        RBTPRINT_DBG_E("shm_open %s failed: %d",name,errno);
+        status = ( errno == ENOENT ) ? RBTREE_STATUS_FAIL_INVALID_PARAM : RBTREE_STATUS_FAIL_IO;
+    }
+    else
+    {
+        status = rbtree_arena_prv_readHeader(fd, &header);
+    }
+
+    if ( status == RBTREE_STATUS_OK )
+    {
+        status = rbtree_arena_prv_map(fd, RBT_ARENA_SIZE(header.maxCapacity), tree);
+    }
+
+    if ( ( status != RBTREE_STATUS_OK ) && ( fd >= 0 ) )
+    {
+        close(fd);
+    }
+
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_arena_openFile ( const char * path, uint32_t maxCapacity, RBT_TREE * tree )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    RBT_ARENA_HEADER header;
+    struct flock lock;
+    struct stat info;
+    bool isNew = false;
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+
+    if ( fd < 0 )
+    {
+        RBTPRINT_DBG_E("open %s failed: %d",path,errno);
+        status = RBTREE_STATUS_FAIL_IO;
+    }
+    else if ( fcntl(fd, F_SETLK, &lock) != 0 )
+    {
+        /* the mutex in the file is only re-initialised safely by a sole owner */
+        RBTPRINT_DBG_E("%s is open in another process",path);
+        status = RBTREE_STATUS_FAIL;
+    }
+    else if ( fstat(fd, &info) != 0 )
+    {
+        RBTPRINT_DBG_E("fstat failed: %d",errno);
+        status = RBTREE_STATUS_FAIL_IO;
+    }
+    else if ( info.st_size == 0 )
+    {
+        memset(&header, 0, sizeof(header));
+        header.capacity = ( maxCapacity < RBT_ARENA_INITIAL_CAPACITY ) ? maxCapacity : RBT_ARENA_INITIAL_CAPACITY;
+        header.maxCapacity = maxCapacity;
+        isNew = true;
+
+        if ( ftruncate(fd, (off_t)RBT_ARENA_SIZE(header.capacity)) != 0 )
+        {
+            RBTPRINT_DBG_E("ftruncate failed: %d",errno);
+            status = RBTREE_STATUS_FAIL_IO;
+        }
+        else
+        {
+            status = RBTREE_STATUS_OK;
+        }
+    }
+    else
+    {
+        status = rbtree_arena_prv_readHeader(fd, &header);
+    }
+
+    if ( status == RBTREE_STATUS_OK )
+    {
+        /* room to grow into without moving the mapping */
+        status = rbtree_arena_prv_map(fd, RBT_ARENA_SIZE(( header.maxCapacity > maxCapacity ) ? header.maxCapacity : maxCapacity), tree);
+    }
+
+    if ( status != RBTREE_STATUS_OK )
+    {
+        /* failed before the mapping */
+    }
+    else if ( isNew )
+    {
+        rbtree_arena_prv_init(tree->arena, header.capacity, maxCapacity);
+    }
+    else
+    {
+        RBT_ARENA_HEADER * h = tree->arena->header;
+
+        /* whoever held the mutex is gone, it may still read as locked */
+        rbtree_arena_prv_initMutex(h);
+
+        if ( maxCapacity > h->maxCapacity )
+        {
+            h->maxCapacity = maxCapacity;
+        }
+
+        if ( h->isWriting )
+        {
+            /* the last process died mid surgery */
+            RBTPRINT_DBG_E("Arena was left mid update");
+            h->isBroken = 1U;
+        }
+
+        if ( h->isBroken )
+        {
+            status = RBTREE_STATUS_FAIL_CORRUPT_DATA;
+            rbtree_arena_close(tree);
+            fd = -1;
+        }
+    }
+
+    if ( ( status != RBTREE_STATUS_OK ) && ( fd >= 0 ) )
+    {
+        close(fd);
+    }
+
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_arena_sync ( RBT_ARENA * arena )
+{
+    RBTREE_STATUS status = rbtree_arena_prv_lock(arena);
+
+    if ( status != RBTREE_STATUS_OK )
+    {
+        /* lock failed */
+    }
+    else
+    {
+        /* under the lock, so what reaches the disk is a whole tree */
+        if ( msync(arena->header, (size_t)arena->header->size, MS_SYNC) != 0 )
+        {
+            RBTPRINT_DBG_E("msync failed: %d",errno);
+            status = RBTREE_STATUS_FAIL_IO;
+        }
+
+        rbtree_arena_prv_unlock(arena);
+    }
+
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_arena_unlinkShared ( const char * name )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_OK;
+
+    if ( shm_unlink(name) != 0 )
+    {
+        RBTPRINT_DBG_E("shm_unlink %s failed: %d",name,errno);
+        status = ( errno == ENOENT ) ? RBTREE_STATUS_FAIL_INVALID_PARAM : RBTREE_STATUS_FAIL_IO;
+    }
+
+    return status;
+}
+
+
+void rbtree_arena_close ( RBT_TREE * tree )
+{
+    RBT_ARENA * arena = tree->arena;
+
+    if ( arena )
+    {
+        munmap(arena->header, arena->size);
+        close(arena->fd);
+        tree->mem_free(arena);
+        tree->arena = NULL;
+    }
+}
+
+
+RBTREE_STATUS rbtree_arena_reserveKeys ( RBT_ARENA * arena, uint32_t count, RBTREE_KEY * first_key )
+{
+    RBTREE_STATUS status = rbtree_arena_prv_lock(arena);
+
+    if ( status != RBTREE_STATUS_OK )
+    {
+        /* lock failed */
+    }
+    else if ( arena->header->keySeed + count - 1U <= RBT_TREE_KEYSEED_MAXVALUE )
+    {
+        *first_key = (RBTREE_KEY)arena->header->keySeed;
+        arena->header->keySeed += count;
+
+        rbtree_arena_prv_unlock(arena);
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Key space exhausted");
+        status = RBTREE_STATUS_FAIL;
+
+        rbtree_arena_prv_unlock(arena);
+    }
+
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_arena_insert ( RBT_ARENA * arena, RBTREE_KEY * key, void * value )
+{
+    RBT_ARENA * a = arena;
+    RBT_ARENA_HEADER * h = arena->header;
+    RBTREE_STATUS status = rbtree_arena_prv_lock(arena);
+    bool isLocked = (bool) ( status == RBTREE_STATUS_OK );
+    RBT_AREF parent = 0U;
+    RBT_AREF cur = 0U;
+    RBT_AREF z = 0U;
+
+    if ( status != RBTREE_STATUS_OK )
+    {
+        /* lock failed */
+    }
+    else if ( *key == RBTREE_KEY_INVALID )
+    {
+        if ( h->keySeed <= RBT_TREE_KEYSEED_MAXVALUE )
+        {
+            *key = (RBTREE_KEY)h->keySeed;
+        }
+        else
+        {
+            RBTPRINT_DBG_E("Key space exhausted");
+            status = RBTREE_STATUS_FAIL;
+        }
+    }
+    else if ( (uint64_t)*key >= h->keySeed )
+    {
+        RBTPRINT_DBG_E("Key:%u was never reserved",*key);
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+
+    if ( status == RBTREE_STATUS_OK )
+    {
+        cur = h->root;
+    }
+
+    while ( ( status == RBTREE_STATUS_OK ) && ( cur != 0U ) )
+    {
+        parent = cur;
+
+        if ( *key < N(cur)->key )
+        {
+            cur = N(cur)->left;
+        }
+        else if ( *key > N(cur)->key )
+        {
+            cur = N(cur)->right;
+        }
+        else
+        {
+            RBTPRINT_DBG_E("Key:%u already stored",*key);
+            status = RBTREE_STATUS_FAIL_KEY_ALREADY_STORED;
+        }
+    }
+
+    if ( ( status == RBTREE_STATUS_OK ) && ( ( z = rbtree_arena_prv_allocNode(arena) ) == 0U ) )
+    {
+        RBTPRINT_DBG_E("Arena full");
+        status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+    }
+
+    if ( status == RBTREE_STATUS_OK )
+    {
+        h->isWriting = 1U;
+
+        N(z)->key = *key;
+        N(z)->value = (uint64_t)(uintptr_t)value;
+        N(z)->left = 0U;
+        N(z)->right = 0U;
+        N(z)->parent = parent;
+        N(z)->colour = RBT_COLOUR_RED;
+
+        if ( parent == 0U )
+        {
+            h->root = z;
+        }
+        else if ( *key < N(parent)->key )
+        {
+            N(parent)->left = z;
+        }
+        else
+        {
+            N(parent)->right = z;
+        }
+
+        rbtree_arena_prv_insertFixUp(arena, z);
+
+        if ( (uint64_t)*key == h->keySeed )
+        {
+            h->keySeed++;
+        }
+
+        h->nodeCount++;
+        h->version++;
+        h->isWriting = 0U;
+    }
+
+    if ( isLocked )
+    {
+        rbtree_arena_prv_unlock(arena);
+    }
+
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_arena_delete ( RBT_ARENA * arena, RBTREE_KEY key )
+{
+    RBT_ARENA * a = arena;
+    RBT_ARENA_HEADER * h = arena->header;
+    RBTREE_STATUS status = rbtree_arena_prv_lock(arena);
+    RBT_AREF z = 0U;
+
+    if ( status != RBTREE_STATUS_OK )
+    {
+        /* lock failed */
+    }
+    else if ( ( z = rbtree_arena_prv_findKey(arena, key) ) == 0U )
+    {
+        RBTPRINT_DBG_W("Key:%u does not exist",key);
+        status = RBTREE_STATUS_FAIL_KEY_DOES_NOT_EXIST;
+
+        rbtree_arena_prv_unlock(arena);
+    }
+    else
+    {
+        RBT_AREF x = 0U;
+        RBT_AREF y = z;
+        uint32_t removedColour = N(y)->colour;
+
+        h->isWriting = 1U;
+
+        if ( N(z)->left == 0U )
+        {
+            x = N(z)->right;
+            rbtree_arena_prv_transplant(arena, z, N(z)->right);
+        }
+        else if ( N(z)->right == 0U )
+        {
+            x = N(z)->left;
+            rbtree_arena_prv_transplant(arena, z, N(z)->left);
+        }
+        else
+        {
+            /* successor takes z's place & colour */
+            y = rbtree_arena_prv_first(arena, N(z)->right);
+            removedColour = N(y)->colour;
+            x = N(y)->right;
+
+            if ( N(y)->parent == z )
+            {
+                N(x)->parent = y;
+            }
+            else
+            {
+                rbtree_arena_prv_transplant(arena, y, N(y)->right);
+                N(y)->right = N(z)->right;
+                N(N(y)->right)->parent = y;
+            }
+
+            rbtree_arena_prv_transplant(arena, z, y);
+            N(y)->left = N(z)->left;
+            N(N(y)->left)->parent = y;
+            N(y)->colour = N(z)->colour;
+        }
+
+        if ( removedColour == RBT_COLOUR_BLACK )
+        {
+            rbtree_arena_prv_deleteFixUp(arena, x);
+        }
+
+        /* the sentinel's parent is scratch, leave it clean for the next fix-up */
+        N(0U)->parent = 0U;
+
+        rbtree_arena_prv_freeNode(arena, z);
+
+        h->nodeCount--;
+        h->version++;
+        h->isWriting = 0U;
+
+        rbtree_arena_prv_unlock(arena);
+    }
+
+    return status;
+}
+
+
+bool rbtree_arena_find ( RBT_ARENA * arena, RBTREE_KEY key, void ** value )
+{
+    RBT_ARENA * a = arena;
+    RBT_AREF ref = 0U;
+
+    if ( rbtree_arena_prv_lock(arena) == RBTREE_STATUS_OK )
+    {
+        ref = rbtree_arena_prv_findKey(arena, key);
+
+        if ( ref != 0U )
+        {
+            *value = (void *)(uintptr_t)N(ref)->value;
+        }
+
+        rbtree_arena_prv_unlock(arena);
+    }
+
+    return (bool) ( ref != 0U );
+}
+
+
+bool rbtree_arena_next ( RBT_ARENA * arena, RBTREE_KEY after, RBTREE_KEY * key, void ** value )
+{
+    RBT_ARENA * a = arena;
+    RBT_AREF match = 0U;
+
+    if ( rbtree_arena_prv_lock(arena) == RBTREE_STATUS_OK )
+    {
+        RBT_AREF ref = arena->header->root;
+
+        /* by key rather than by link, so it carries on correctly after the tree changed */
+        while ( ref != 0U )
+        {
+            if ( N(ref)->key > after )
+            {
+                match = ref;
+                ref = N(ref)->left;
+            }
+            else
+            {
+                ref = N(ref)->right;
+            }
+        }
+
+        if ( match != 0U )
+        {
+            *key = N(match)->key;
+            *value = (void *)(uintptr_t)N(match)->value;
+        }
+
+        rbtree_arena_prv_unlock(arena);
+    }
+
+    return (bool) ( match != 0U );
+}
+
+
+bool rbtree_arena_atRank ( RBT_ARENA * arena, uint32_t rank, RBTREE_KEY * key, void ** value )
+{
+    RBT_ARENA * a = arena;
+    RBT_AREF ref = 0U;
+
+    if ( rbtree_arena_prv_lock(arena) == RBTREE_STATUS_OK )
+    {
+        uint32_t i = 0U;
+
+        ref = ( rank < arena->header->nodeCount ) ? rbtree_arena_prv_first(arena, arena->header->root) : 0U;
+
+        for ( i=0U; ( i<rank ) && ( ref != 0U ); i++ )
+        {
+            ref = rbtree_arena_prv_next(arena, ref);
+        }
+
+        if ( ref != 0U )
+        {
+            *key = N(ref)->key;
+            *value = (void *)(uintptr_t)N(ref)->value;
+        }
+
+        rbtree_arena_prv_unlock(arena);
+    }
+
+    return (bool) ( ref != 0U );
+}
+
+
+void rbtree_arena_shape ( RBT_ARENA * arena, uint32_t * height, uint32_t * blackHeight )
+{
+    RBT_ARENA * a = arena;
+
+    *height = 0U;
+    *blackHeight = 0U;
+
+    if ( rbtree_arena_prv_lock(arena) == RBTREE_STATUS_OK )
+    {
+        RBT_AREF ref = arena->header->root;
+
+        while ( ref != 0U )
+        {
+            *blackHeight += ( N(ref)->colour == RBT_COLOUR_BLACK ) ? 1U : 0U;
+            ref = N(ref)->left;
+        }
+
+        *height = rbtree_arena_prv_height(arena, arena->header->root);
+
+        rbtree_arena_prv_unlock(arena);
+    }
+}
+
+
+uint32_t rbtree_arena_count ( RBT_ARENA * arena )
+{
+    uint32_t count = 0U;
+
+    if ( rbtree_arena_prv_lock(arena) == RBTREE_STATUS_OK )
+    {
+        count = arena->header->nodeCount;
+        rbtree_arena_prv_unlock(arena);
+    }
+
+    return count;
+}
+
+
+uint64_t rbtree_arena_version ( RBT_ARENA * arena )
+{
+    uint64_t version = 0U;
+
+    if ( rbtree_arena_prv_lock(arena) == RBTREE_STATUS_OK )
+    {
+        version = arena->header->version;
+        rbtree_arena_prv_unlock(arena);
+    }
+
+    return version;
+}
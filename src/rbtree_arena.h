@@ -0,0 +1,116 @@
+/**
+ @file
+ Red-Black Binary Search Tree - Position independent tree in a mapped arena
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#ifndef __RBTREE_ARENA_H
+#define __RBTREE_ARENA_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include <pthread.h>        /* process-shared mutex, C11 mtx_t can't be shared */
+#include "rbtree_common.h"
+
+
+/* node index into the arena. 0 is the black nil sentinel, so it doubles as NULL */
+typedef uint32_t RBT_AREF;
+
+/* links are indexes, so the arena can be mapped at any address in any process */
+typedef struct _RBT_ANODE
+{
+    uint64_t value;         /* the stored value bits, only meaningful across processes if they are not a local pointer */
+    RBTREE_KEY key;
+    RBT_AREF left;          /* also the next link on the free list */
+    RBT_AREF right;
+    RBT_AREF parent;
+    uint32_t colour;        /* RBT_COLOUR */
+    uint32_t reserved;
+} RBT_ANODE;
+
+/* start of the mapping. Everything a process needs to use the tree is here */
+typedef struct _RBT_ARENA_HEADER
+{
+    char magic[8];          /* written last on create, so a half built arena never validates */
+    uint32_t format;
+    uint32_t byteOrder;
+    uint64_t size;          /* bytes in use, the file or segment may be larger after an interrupted grow */
+    uint32_t capacity;      /* node slots after the header, slot 0 is the sentinel */
+    uint32_t used;          /* slots handed out so far */
+    RBT_AREF freeList;
+    RBT_AREF root;
+    uint32_t nodeCount;
+    uint32_t isWriting;     /* set across tree surgery */
+    uint32_t isBroken;      /* a process died mid surgery, the tree can't be trusted */
+    uint32_t maxCapacity;   /* capacity grows up to this, every process maps room for it */
+    uint64_t keySeed;
+    uint64_t version;
+    pthread_mutex_t mutex;  /* process-shared & robust */
+} RBT_ARENA_HEADER;
+
+/* per process view of an arena */
+typedef struct _RBT_ARENA
+{
+    RBT_ARENA_HEADER * header;
+    RBT_ANODE * nodes;      /* nodes[0] is the sentinel */
+    size_t size;            /* bytes this process has mapped, beyond the end of the file until it grows */
+    int fd;
+} RBT_ARENA;
+
+
+/* creates & maps a new segment, fails if name exists. Sets tree->arena */
+RBTREE_STATUS rbtree_arena_createShared ( const char * name, uint32_t capacity, RBT_TREE * tree );
+
+/* maps & validates an existing segment. Sets tree->arena */
+RBTREE_STATUS rbtree_arena_attachShared ( const char * name, RBT_TREE * tree );
+
+/* opens path, creating it if empty, & locks it to this process. Sets tree->arena */
+RBTREE_STATUS rbtree_arena_openFile ( const char * path, uint32_t maxCapacity, RBT_TREE * tree );
+
+/* msync's everything in use */
+RBTREE_STATUS rbtree_arena_sync ( RBT_ARENA * arena );
+
+/* removes the name, attached processes carry on */
+RBTREE_STATUS rbtree_arena_unlinkShared ( const char * name );
+
+/* unmaps, the segment & its contents live on */
+void rbtree_arena_close ( RBT_TREE * tree );
+
+RBTREE_STATUS rbtree_arena_reserveKeys ( RBT_ARENA * arena, uint32_t count, RBTREE_KEY * first_key );
+
+/* *key of RBTREE_KEY_INVALID assigns the next key, anything else must be reserved already */
+RBTREE_STATUS rbtree_arena_insert ( RBT_ARENA * arena, RBTREE_KEY * key, void * value );
+
+RBTREE_STATUS rbtree_arena_delete ( RBT_ARENA * arena, RBTREE_KEY key );
+
+/* lookups copy the entry out under the lock, another process may change the tree straight after */
+bool rbtree_arena_find ( RBT_ARENA * arena, RBTREE_KEY key, void ** value );
+
+/* smallest key above after, pass RBTREE_KEY_INVALID for the first */
+bool rbtree_arena_next ( RBT_ARENA * arena, RBTREE_KEY after, RBTREE_KEY * key, void ** value );
+
+bool rbtree_arena_atRank ( RBT_ARENA * arena, uint32_t rank, RBTREE_KEY * key, void ** value );
+
+/* O(n) under the lock */
+void rbtree_arena_shape ( RBT_ARENA * arena, uint32_t * height, uint32_t * blackHeight );
+
+uint32_t rbtree_arena_count ( RBT_ARENA * arena );
+
+uint64_t rbtree_arena_version ( RBT_ARENA * arena );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* __RBTREE_ARENA_H */
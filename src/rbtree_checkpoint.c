@@ -0,0 +1,285 @@
+/**
+ @file
+ Red-Black Binary Search Tree - Background checkpoint to a file
+
+ @details The capture is the only part done on the caller's thread. A persistent tree is captured
+ with #rbtree_snapshot, which shares every node, so writers carry on path-copying while the
+ snapshot is written. A standard tree updates nodes in place, so it is captured with fork():
+ the child gets a copy-on-write image of the process with the tree frozen as it was when the
+ mutex was held, writes the file & exits. The parent only pays for copying its page tables.
+ Other threads may hold the allocator's (or anything else's) locks at the fork, so everything the
+ child needs is allocated beforehand & it only makes async-signal-safe calls, bar encode_fn.
+
+ Either way the file is written to path + #RBT_CHECKPOINT_TEMP_SUFFIX, fsync'd & renamed over path.
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "rbtree.h"
+#include <string.h>         /* memcpy, strlen */
+#include <errno.h>
+#include <fcntl.h>          /* open */
+#include <stdio.h>          /* rename */
+#include <unistd.h>         /* fork, fsync, close, _exit */
+#include <sys/types.h>
+#include <sys/wait.h>       /* waitpid */
+#include "rbtree_common.h"
+#include "rbtree_serial.h"
+#include "rbtree_checkpoint.h"
+
+
+typedef struct _RBT_CHECKPOINT
+{
+    char * path;
+    char * tempPath;
+    RBTREE_HANDLE snapshot;     /* persistent trees */
+    pid_t child;                /* standard trees, the process writing the file */
+    rbtree_encoder_t encode_fn;
+    void * userdata;
+    rbtree_completion_t done_fn;
+    void * done_userdata;
+    uint8_t * buffer;           /* the serial stream's, allocated before the capture */
+    uint8_t * scratch;          /* encode_fn's, NULL without one */
+    rbtree_memfree_t mem_free;  /* the job can outlive the tree */
+} RBT_CHECKPOINT;
+
+
+static inline RBTREE_STATUS rbtree_checkpoint_prv_writeFile ( RBT_CHECKPOINT * job, RBT_NODE * root, uint32_t nodeCount, uint64_t keySeed );
+static inline RBTREE_STATUS rbtree_checkpoint_prv_waitChild ( pid_t child );
+static inline void rbtree_checkpoint_prv_free ( RBT_CHECKPOINT * job );
+static RBT_THREAD_RETURN rbtree_checkpoint_prv_main ( void * arg );
+
+
+/* runs in the forked child for standard trees, so no allocation & no stdio. Failures are reported by the caller */
+static inline RBTREE_STATUS rbtree_checkpoint_prv_writeFile ( RBT_CHECKPOINT * job, RBT_NODE * root, uint32_t nodeCount, uint64_t keySeed )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    int fd = open(job->tempPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if ( fd < 0 )
+    {
+        status = RBTREE_STATUS_FAIL_IO;
+    }
+    else
+    {
+        status = rbtree_serial_saveInto(root, nodeCount, keySeed, fd, job->encode_fn, job->userdata, job->buffer, job->scratch);
+
+        if ( ( status == RBTREE_STATUS_OK ) && ( fsync(fd) != 0 ) )
+        {
+            status = RBTREE_STATUS_FAIL_IO;
+        }
+
+        if ( ( close(fd) != 0 ) && ( status == RBTREE_STATUS_OK ) )
+        {
+            status = RBTREE_STATUS_FAIL_IO;
+        }
+
+        if ( ( status == RBTREE_STATUS_OK ) && ( rename(job->tempPath, job->path) != 0 ) )
+        {
+            status = RBTREE_STATUS_FAIL_IO;
+        }
+
+        if ( status != RBTREE_STATUS_OK )
+        {
+            (void)unlink(job->tempPath);
+        }
+    }
+
+    return status;
+}
+
+static inline RBTREE_STATUS rbtree_checkpoint_prv_waitChild ( pid_t child )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    int wstatus = 0;
+    pid_t res = -1;
+
+    do
+    {
+        res = waitpid(child, &wstatus, 0);
+    } while ( ( res < 0 ) && ( errno == EINTR ) );
+
+    if ( ( res < 0 ) && ( errno == ECHILD ) )
+    {
+        /* SIGCHLD is ignored so the child was reaped for us. It has finished, how is unknown so success can't be claimed */
+        RBTPRINT_DBG_E("Checkpoint writer's exit status lost");
+        status = RBTREE_STATUS_FAIL;
+    }
+    else if ( res < 0 )
+    {
+        RBTPRINT_DBG_E("waitpid failed: %d",errno);
+        status = RBTREE_STATUS_FAIL;
+    }
+    else if ( ( WIFEXITED(wstatus) ) && ( WEXITSTATUS(wstatus) > RBTREE_STATUS_UNDEF ) && ( WEXITSTATUS(wstatus) < RBTREE_STATUS_LAST_VALUE ) )
+    {
+        /* the child exits with its status */
+        status = (RBTREE_STATUS)WEXITSTATUS(wstatus);
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Checkpoint writer died: %d",wstatus);
+        status = RBTREE_STATUS_FAIL;
+    }
+
+    return status;
+}
+
+static inline void rbtree_checkpoint_prv_free ( RBT_CHECKPOINT * job )
+{
+    rbtree_memfree_t mem_free = job->mem_free;
+
+    if ( job->path )
+    {
+        mem_free(job->path);
+    }
+
+    if ( job->tempPath )
+    {
+        mem_free(job->tempPath);
+    }
+
+    if ( job->buffer )
+    {
+        mem_free(job->buffer);
+    }
+
+    if ( job->scratch )
+    {
+        mem_free(job->scratch);
+    }
+
+    mem_free(job);
+}
+
+static RBT_THREAD_RETURN rbtree_checkpoint_prv_main ( void * arg )
+{
+    RBT_CHECKPOINT * job = (RBT_CHECKPOINT *)arg;
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+
+    if ( job->snapshot != RBTREE_HANDLE_INVALID )
+    {
+        RBT_TREE * snap_tree = (RBT_TREE *)job->snapshot;
+
+        /* immutable, so no pinning. Nodes it shares stay alive until it is destroyed */
+        status = rbtree_checkpoint_prv_writeFile(job, snap_tree->rootNode, snap_tree->nodeCount, RBT_ATOMIC_LOAD(snap_tree->keySeed));
+
+        (void)rbtree_destroyTree(job->snapshot);
+    }
+    else
+    {
+        status = rbtree_checkpoint_prv_waitChild(job->child);
+    }
+
+    if ( status != RBTREE_STATUS_OK )
+    {
+        RBTPRINT_DBG_E("Checkpoint to %s failed: %d",job->path,status);
+    }
+
+    job->done_fn(status, job->done_userdata);
+
+    rbtree_checkpoint_prv_free(job);
+
+    return RBT_THREAD_RETURN_VALUE;
+}
+
+
+RBTREE_STATUS rbtree_checkpoint_start ( RBT_TREE * tree, const char * path, rbtree_encoder_t encode_fn, void * userdata, rbtree_completion_t done_fn, void * done_userdata )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    RBT_CHECKPOINT * job = tree->mem_alloc(sizeof(RBT_CHECKPOINT));
+    size_t length = strlen(path);
+
+    if ( job == NULL )
+    {
+        RBTPRINT_DBG_E("Malloc failure");
+        status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+    }
+    else
+    {
+        memset(job, 0, sizeof(RBT_CHECKPOINT));
+
+        job->snapshot = RBTREE_HANDLE_INVALID;
+        job->child = -1;
+        job->encode_fn = encode_fn;
+        job->userdata = userdata;
+        job->done_fn = done_fn;
+        job->done_userdata = done_userdata;
+        job->mem_free = tree->mem_free;
+        job->path = tree->mem_alloc(length + 1U);
+        job->tempPath = tree->mem_alloc(length + sizeof(RBT_CHECKPOINT_TEMP_SUFFIX));
+        job->buffer = tree->mem_alloc(RBT_SERIAL_BUFFER_SIZE);
+        job->scratch = ( encode_fn != NULL ) ? tree->mem_alloc(RBTREE_ENCODED_VALUE_MAX) : NULL;
+
+        if ( ( job->path == NULL ) || ( job->tempPath == NULL ) || ( job->buffer == NULL ) || ( ( encode_fn != NULL ) && ( job->scratch == NULL ) ) )
+        {
+            RBTPRINT_DBG_E("Malloc failure");
+            status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+        }
+        else
+        {
+            memcpy(job->path, path, length + 1U);
+            memcpy(job->tempPath, path, length);
+            memcpy(job->tempPath + length, RBT_CHECKPOINT_TEMP_SUFFIX, sizeof(RBT_CHECKPOINT_TEMP_SUFFIX));
+
+            status = RBTREE_STATUS_OK;
+        }
+    }
+
+    if ( status != RBTREE_STATUS_OK )
+    {
+        /* nothing captured yet */
+    }
+    else if ( tree->mode == RBT_TREE_MODE_PERSISTENT )
+    {
+        status = rbtree_snapshot(tree, &job->snapshot);
+    }
+    else
+    {
+        /* the mutex keeps the child's copy of the tree consistent, it never unlocks it */
+        RBT_LOCK_MUTEX(tree->mutex);
+
+        job->child = fork();
+
+        if ( job->child == 0 )
+        {
+            _exit((int)rbtree_checkpoint_prv_writeFile(job, tree->rootNode, tree->nodeCount, RBT_ATOMIC_LOAD(tree->keySeed)));
+        }
+
+        RBT_UNLOCK_MUTEX(tree->mutex);
+
+        if ( job->child < 0 )
+        {
+            RBTPRINT_DBG_E("fork failed: %d",errno);
+            status = RBTREE_STATUS_FAIL;
+        }
+    }
+
+    if ( status == RBTREE_STATUS_OK )
+    {
+        RBT_THREAD_TYPE thread;
+
+        /* the job belongs to the thread from here, it may already be freed */
+        if ( RBT_CREATE_THREAD(thread, rbtree_checkpoint_prv_main, job) )
+        {
+            RBT_DETACH_THREAD(thread);
+        }
+        else
+        {
+            /* the capture is already made, finish it here rather than lose it */
+            RBTPRINT_DBG_W("No checkpoint thread, writing on the caller");
+            (void)rbtree_checkpoint_prv_main(job);
+        }
+    }
+    else if ( job )
+    {
+        rbtree_checkpoint_prv_free(job);
+    }
+
+    return status;
+}
@@ -0,0 +1,42 @@
+/**
+ @file
+ Red-Black Binary Search Tree - Background checkpoint to a file
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#ifndef __RBTREE_CHECKPOINT_H
+#define __RBTREE_CHECKPOINT_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "rbtree_common.h"
+
+
+/* written beside the target & renamed over it once complete, so path always holds a whole checkpoint */
+#define RBT_CHECKPOINT_TEMP_SUFFIX ".tmp"
+
+
+/**
+ @brief capture tree as it is now & write it to path with #rbtree_serial_saveInto on a background thread
+ @details persistent trees are captured by an O(1) snapshot. Standard trees by fork() under the tree
+ mutex, the child process writes the file into buffers allocated beforehand & the thread waits for it.
+ done_fn is called exactly once when this returns #RBTREE_STATUS_OK
+ */
+RBTREE_STATUS rbtree_checkpoint_start ( RBT_TREE * tree, const char * path, rbtree_encoder_t encode_fn, void * userdata, rbtree_completion_t done_fn, void * done_userdata );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* __RBTREE_CHECKPOINT_H */
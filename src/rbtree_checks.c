@@ -1,7 +1,7 @@
 /**
  @file
  Red-Black Binary Search Tree - Validation checks
- 
+
  @author Ryan Powell
  @date 23-12-12
  @copyright Copyright (c) 2012  Ryan Powell
@@ -14,102 +14,17 @@
 #include "rbtree_checks.h"
 
 
-static inline RBT_NODE * rbtree_checks_prv_getNext ( RBT_NODE * node );
-static inline RBT_NODE * rbtree_checks_prv_getPrev ( RBT_NODE * node );
-static inline RBT_NODE * rbtree_checks_prv_getFirst( RBT_NODE * node );
-static inline RBT_NODE * rbtree_checks_prv_getLast( RBT_NODE * node );
-static inline RBT_COLOUR rbtree_checks_prv_getColour( RBT_NODE * node );
-
-
-#define getNext(n) rbtree_checks_prv_getNext(n);
-#define getPrev(n) rbtree_checks_prv_getPrev(n);
-#define getFirst(n) rbtree_checks_prv_getFirst(n);
-#define getLast(n) rbtree_checks_prv_getLast(n);
-#define getColour(n) rbtree_checks_prv_getColour(n);
-
-
-static inline RBT_NODE * rbtree_checks_prv_getNext ( RBT_NODE * node )
-{
-	RBT_NODE * parent;
-    
-	if ( node->right )
-    {
-		return getFirst(node->right);
-    }
-    
-    parent = node->parent;
-    
-    while ( ( parent != NULL ) && ( parent->right == node ) )
-    {
-        node = parent;
-        parent = parent->parent;
-    }
-    
-    return parent;
-}
-
-static inline RBT_NODE * rbtree_checks_prv_getPrev ( RBT_NODE * node )
-{
-	RBT_NODE * parent;
-    
-	if ( node->left != NULL )
-    {
-		return getLast(node->left);
-    }
-    
-    parent = node->parent;
-    
-	while ( ( parent != NULL ) && ( parent->left == node ) )
-    {
-		node = parent;
-        parent = parent->parent;
-    }
-    
-	return parent;
-}
+#if RBT_CHECK_LEVEL >= 2
+static uint32_t rbtree_checks_prv_validateSubtree ( RBT_NODE * node, RBT_NODE * parent, RBT_NODE * low, RBT_NODE * high, bool hasParents, uint32_t depth, uint32_t * count );
+#endif
 
-static inline RBT_NODE * rbtree_checks_prv_getFirst( RBT_NODE * node )
-{
-    if ( node )
-    {
-        while (node->left)
-        {
-            node = node->left;
-        }
-    }
-    
-	return node;
-}
 
-static inline RBT_NODE * rbtree_checks_prv_getLast( RBT_NODE * node )
-{
-    if ( node )
-    {
-        while (node->right)
-        {
-            node = node->right;
-        }
-    }
-    
-	return node;
-}
-
-static inline RBT_COLOUR rbtree_checks_prv_getColour( RBT_NODE * node )
-{
-    RBT_COLOUR colour = RBT_COLOUR_BLACK;
-    
-    if ( node )
-    {
-        colour = node->colour;
-    }
-    
-    return colour;
-}
+#if RBT_CHECK_LEVEL >= 1
 
 bool rbtree_checks_validateNodeLinks ( RBT_NODE * node )
 {
     bool isValid = true;
-    
+
     if ( node )
     {
         if ( (node->parent!=NULL) && (node->left!=NULL) && (node->parent==node->left) )
@@ -117,19 +32,19 @@ bool rbtree_checks_validateNodeLinks ( RBT_NODE * node )
             RBTPRINT_DBG_E("node: %p has matching left&parent nodes",node);
             isValid = false;
         }
-        
+
         if ( (node->parent!=NULL) && (node->right!=NULL) && (node->parent==node->right) )
         {
             RBTPRINT_DBG_E("node: %p has matching right&parent nodes",node);
             isValid = false;
         }
-        
+
         if ( (node->left!=NULL) && (node->right!=NULL) && (node->left==node->right) )
         {
             RBTPRINT_DBG_E("node: %p has matching right&left nodes",node);
             isValid = false;
         }
-        
+
         if ( node->parent )
         {
             if ( ( node->parent->left != node ) &&
@@ -139,7 +54,7 @@ bool rbtree_checks_validateNodeLinks ( RBT_NODE * node )
                 isValid = false;
             }
         }
-        
+
         if ( node->left )
         {
             if ( node->left->parent != node )
@@ -156,266 +71,119 @@ bool rbtree_checks_validateNodeLinks ( RBT_NODE * node )
                 RBTPRINT_DBG_E("node: %p right child does not link to parent ?!",node);
                 isValid = false;
             }
-        }        
+        }
     }
 
     return isValid;
 }
 
-bool rbtree_checks_validateAllNodeLinks ( RBT_TREE * tree )
-{
-    bool isValid = true;
-    RBT_NODE * node = tree->rootNode;
-    
-    while ( node )
-    {
-        if ( rbtree_checks_validateNodeLinks(node) == false )
-        {
-            RBTPRINT_DBG_E("node: %p failed validation",node);
-            isValid = false;
-            break;
-        }
+#endif
 
-        node = getNext(node);
-    }
-    
-    return isValid;
-}
+#if RBT_CHECK_LEVEL >= 2
 
-bool rbtree_checks_prv_isTreeValid_BST ( RBT_NODE * rootNode )
+/*
+ post-order, every property of the subtree in one visit per node. Returns its black height counting the
+ NULL leaves, or 0 if it is broken. Keys must lie strictly between low & high, which also rules out a child
+ linking back up the tree. Persistent nodes are shared between versions so carry no parent to check
+ */
+static uint32_t rbtree_checks_prv_validateSubtree ( RBT_NODE * node, RBT_NODE * parent, RBT_NODE * low, RBT_NODE * high, bool hasParents, uint32_t depth, uint32_t * count )
 {
-    bool isValid = true;
+    uint32_t height = 0U;
+    uint32_t leftHeight = 0U;
+    uint32_t rightHeight = 0U;
 
-#ifdef RBT_PRINT_DEBUG
-    if ( rootNode )
+    if ( node == NULL )
     {
-        RBT_NODE * node = getFirst(rootNode);
-        RBT_NODE * next = getNext(node);
-        
-        while ( node && next )
-        {
-            if ( node->key < next->key )
-            {
-                node = next;
-                next = getNext(next);
-            }
-            else
-            {
-                RBTPRINT_DBG_E("Is not BST! %u<%u ",node->key,next->key);
-                isValid = FALSE;
-                break;
-            }
-        }
+        height = 1U;
     }
-    else
+    else if ( depth >= RBT_TREE_DEPTH_MAX )
     {
-        /* nothing here. So it must be */
-        isValid = TRUE;
+        /* deeper than any balanced tree can be, stop before the stack does */
+        RBTPRINT_DBG_E("node: %p deeper than %u",node,depth);
     }
-#endif
-
-    return isValid;
-}
-
-bool rbtree_checks_prv_isTreeValid_RedHasBlackChildren ( RBT_NODE * rootNode )
-{
-    bool isValid = true;
-
-#ifdef RBT_PRINT_DEBUG    
-    if ( rootNode )
+    else if ( ( hasParents ) && ( node->parent != parent ) )
     {
-        RBT_NODE * node = getFirst(rootNode);
-        RBT_NODE * next = getNext(node);
-        
-        while ( node && next && isValid )
-        {
-            if ( node->colour == RBT_COLOUR_RED )
-            {
-                RBT_COLOUR cLeft = getColour(node->left);
-                RBT_COLOUR cRight = getColour(node->right);
-                
-                if ( ( cLeft != RBT_COLOUR_BLACK ) || ( cRight != RBT_COLOUR_BLACK ) )
-                {
-                    RBTPRINT_DBG_E("red node does not have black children. l:%d r:%d",cLeft,cRight);
-                    isValid = false;
-                }
-            }
-            
-            node = next;
-            next = getNext(next);
-        }
+        RBTPRINT_DBG_E("node: %p parent link %p, expected %p",node,node->parent,parent);
     }
-    else
+    else if ( ( ( low ) && ( node->key <= low->key ) ) || ( ( high ) && ( node->key >= high->key ) ) )
     {
-        /* nothing here. So it must be */
-        isValid = true;
-    }    
-#endif
-
-    return isValid;
-}
-
-bool rbtree_checks_prv_isTreeValid_isBlackHeightCorrect ( RBT_NODE * rootNode )
-{
-    bool isValid = true;
-
-#ifdef RBT_PRINT_DEBUG    
-    if ( rootNode == NULL )
+        RBTPRINT_DBG_E("Is not BST! key:%u outside %u..%u",node->key,low?low->key:0U,high?high->key:0U);
+    }
+    else if ( ( node->colour == RBT_COLOUR_RED ) &&
+              ( ( ( node->left ) && ( node->left->colour == RBT_COLOUR_RED ) ) || ( ( node->right ) && ( node->right->colour == RBT_COLOUR_RED ) ) ) )
     {
-        /* tree is empty */
-        return TRUE;
+        RBTPRINT_DBG_E("red node: %p key:%u does not have black children",node,node->key);
     }
-
-    RBT_NODE * node = getFirst(rootNode);
-    bool hasHeight = FALSE;
-    uint32_t black_height = 0U;
-
-    while ( node )
+    else if ( ( ( leftHeight = rbtree_checks_prv_validateSubtree(node->left, node, low, node, hasParents, depth+1U, count) ) != 0U ) &&
+              ( ( rightHeight = rbtree_checks_prv_validateSubtree(node->right, node, node, high, hasParents, depth+1U, count) ) != 0U ) )
     {
-        /* is it a leaf node */
-        if ( (node->left==NULL) && (node->right==NULL) )
+        if ( leftHeight == rightHeight )
         {
-            uint32_t l_black_height = 1U; /* height starts at 1 due to leaf's==black */
-            RBT_NODE * parent = node;
-            
-            /* get the black height */
-            while ( parent )
-            {
-                if ( parent->colour == RBT_COLOUR_BLACK )
-                {
-                    l_black_height++;
-                }
-                
-                parent = parent->parent;
-            }
-            
-            if ( hasHeight )
-            {
-                if ( l_black_height != black_height )
-                {
-                    RBTPRINT_DBG_E("Black height mismatch %d!=%d",l_black_height,black_height);
-                    isValid = false;
-                    break;
-                }
-            }
-            else
-            {
-                /* don't have anything to comare to yet. Set & come back after another iteration */
-                black_height = l_black_height;
-                hasHeight = true;
-            }
+            height = leftHeight + ( ( node->colour == RBT_COLOUR_BLACK ) ? 1U : 0U );
+            (*count)++;
+        }
+        else
+        {
+            RBTPRINT_DBG_E("Black height mismatch under key:%u %u!=%u",node->key,leftHeight,rightHeight);
         }
-        
-        node = getNext(node);
     }
-#endif
-    
-    return isValid;
+
+    return height;
 }
 
-uint32_t rbtree_checks_prv_getNodeCount ( RBT_NODE * rootNode )
+RBTREE_STATUS rbtree_checks_validateTree ( RBT_TREE * tree )
 {
-    uint32_t count = 0U;
-    
-    if ( rootNode )
+    RBTREE_STATUS status = RBTREE_STATUS_OK;
+
+    /* image & arena trees are not made of RBT_NODE's */
+    if ( ( tree->mode == RBT_TREE_MODE_STANDARD ) || ( tree->mode == RBT_TREE_MODE_PERSISTENT ) )
     {
-        RBT_NODE * node = getFirst(rootNode);
-        
-        while ( node )
+        bool hasParents = (bool) ( tree->mode == RBT_TREE_MODE_STANDARD );
+        uint32_t count = 0U;
+
+        if ( ( tree->rootNode ) && ( tree->rootNode->colour != RBT_COLOUR_BLACK ) )
         {
-            count++;
-            RBT_NODE * new_node = getNext(node);
-            
-            if ( new_node != node )
-            {
-                node = new_node;
-            }
-            else
-            {
-                node = NULL;
-            }
+            RBTPRINT_DBG_E("Root node is not black");
+            status = RBTREE_STATUS_FAIL;
+        }
+        else if ( rbtree_checks_prv_validateSubtree(tree->rootNode, NULL, NULL, NULL, hasParents, 0U, &count) == 0U )
+        {
+            RBTPRINT_DBG_E("Tree is not a valid red-black tree");
+            status = RBTREE_STATUS_FAIL;
+        }
+        else if ( count != tree->nodeCount )
+        {
+            RBTPRINT_DBG_E("Tree node count mismatch: %u!=%u",count,tree->nodeCount);
+            status = RBTREE_STATUS_FAIL;
         }
-    }
-    
-    return count;
-}
 
-bool rbtree_checks_rootHasNoParent ( RBT_TREE * tree )
-{
-    bool didPass = true;
-    
-    if ( tree )
-    {
-        if ( tree->rootNode )
+#ifdef RBT_PRINT_DEBUG
+        if ( status != RBTREE_STATUS_OK )
         {
-            if ( tree->rootNode->parent != NULL )
-            {
-                RBTPRINT_DBG_E("Root node has a parent?! %p -> %p",tree->rootNode,tree->rootNode->parent);
-            }
+            rbtree_prv_printSummary(tree, stderr);
         }
+#endif
     }
-    
-    return didPass;
+
+    return status;
 }
 
 RBTREE_STATUS rbtree_checks_isTreeValid ( RBT_TREE * tree )
 {
-#ifdef RBT_PRINT_DEBUG    
-    /* verify all node links are linked correctly */
-    if ( rbtree_checks_validateAllNodeLinks(tree) == FALSE )
-    {
-        RBTPRINT_DBG_E("Node links validation failed");
-        rbtree_prv_printSummary(tree, stderr);
-        return RBTREE_STATUS_FAIL;
-    }
-    
-    /* verify node count */
-    uint32_t l_nodecount = rbtree_checks_prv_getNodeCount(tree->rootNode);
-    if ( l_nodecount != tree->nodeCount )
-    {
-        RBTPRINT_DBG_E("Tree node count mismatch: %u!=%u",l_nodecount,tree->nodeCount);
-        rbtree_prv_printSummary(tree, stderr);
-        return RBTREE_STATUS_FAIL;
-    }
-    
-    if ( rbtree_checks_rootHasNoParent(tree) == FALSE )
-    {
-        RBTPRINT_DBG_E("Tree root node invalid");
-        rbtree_prv_printSummary(tree, stderr);
-        return RBTREE_STATUS_FAIL;
-    }
+    RBTREE_STATUS status = RBTREE_STATUS_OK;
 
-    /* verfiy is binary-search-tree */
-    if ( rbtree_checks_prv_isTreeValid_BST(tree->rootNode) == FALSE )
+    /* counts down under the tree mutex, validating on the last mutation of each period */
+    if ( tree->checkCountdown <= 1U )
     {
-        RBTPRINT_DBG_E("Tree is not a BST");
-        rbtree_prv_printSummary(tree, stderr);
-        return RBTREE_STATUS_FAIL;
+        tree->checkCountdown = RBT_CHECK_EVERY;
+        status = rbtree_checks_validateTree(tree);
     }
-
-    /* verify is rb tree red children colours */
-    if ( rbtree_checks_prv_isTreeValid_RedHasBlackChildren(tree->rootNode) == FALSE )
+    else
     {
-        RBTPRINT_DBG_E("Tree is has red nodes with red children!");
-        rbtree_prv_printSummary(tree, stderr);
-        return RBTREE_STATUS_FAIL;
+        tree->checkCountdown--;
     }
 
-    /* verify rb tree black height */
-    if ( rbtree_checks_prv_isTreeValid_isBlackHeightCorrect(tree->rootNode) == FALSE )
-    {
-        RBTPRINT_DBG_E("Tree is has unmatching black height!");
-        rbtree_prv_printSummary(tree, stderr);
-        return RBTREE_STATUS_FAIL;
-    }
-#endif
-    return RBTREE_STATUS_OK;
+    return status;
 }
 
-
-#undef getNext
-#undef getPrev
-#undef getFirst
-#undef getLast
-#undef getColour
-
+#endif
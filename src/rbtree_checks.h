@@ -21,20 +21,56 @@ extern "C" {
 #include "rbtree_common.h"
 
 
-bool rbtree_checks_validateNodeLinks ( RBT_NODE * node );
-
-bool rbtree_checks_validareAllNodeLinks ( RBT_TREE * tree );
+/*
+ RBT_CHECK_LEVEL
+ 0 no checks, the calls below compile away & the mutation paths inline fully
+ 1 cheap local checks, the links of the node an insert attaches to
+ 2 level 1 & a full validation of the tree after mutations, see RBT_CHECK_EVERY
+ Defaults to 2 when RBT_PRINT_DEBUG is defined, otherwise 0
+ */
+#ifndef RBT_CHECK_LEVEL
+#ifdef RBT_PRINT_DEBUG
+#define RBT_CHECK_LEVEL 2
+#else
+#define RBT_CHECK_LEVEL 0
+#endif
+#endif
 
-bool rbtree_checks_prv_isTreeValid_BST ( RBT_NODE * rootNode );
+/* level 2 validates the whole tree after every Nth mutation of it. 1 checks every mutation */
+#ifndef RBT_CHECK_EVERY
+#define RBT_CHECK_EVERY (1U)
+#endif
 
-bool rbtree_checks_prv_isTreeValid_RedHasBlackChildren ( RBT_NODE * rootNode );
 
-uint32_t rbtree_checks_prv_getNodeCount ( RBT_NODE * rootNode );
+#if RBT_CHECK_LEVEL >= 1
+bool rbtree_checks_validateNodeLinks ( RBT_NODE * node );
+#else
+static inline bool rbtree_checks_validateNodeLinks ( RBT_NODE * node )
+{
+    (void)node;
+    return true;
+}
+#endif
 
-bool rbtree_checks_prv_isTreeValid_isBlackHeightCorrect ( RBT_NODE * rootNode );
+#if RBT_CHECK_LEVEL >= 2
+/* one O(n) pass: links, order, no red child of a red node, equal black heights & the node count. Every call */
+RBTREE_STATUS rbtree_checks_validateTree ( RBT_TREE * tree );
 
+/* rbtree_checks_validateTree on every RBT_CHECK_EVERY'th call for the tree, call under its mutex after a mutation */
 RBTREE_STATUS rbtree_checks_isTreeValid ( RBT_TREE * tree );
+#else
+static inline RBTREE_STATUS rbtree_checks_validateTree ( RBT_TREE * tree )
+{
+    (void)tree;
+    return RBTREE_STATUS_OK;
+}
 
+static inline RBTREE_STATUS rbtree_checks_isTreeValid ( RBT_TREE * tree )
+{
+    (void)tree;
+    return RBTREE_STATUS_OK;
+}
+#endif
 
 #ifdef __cplusplus
 }
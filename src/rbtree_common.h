@@ -34,21 +34,163 @@ extern "C" {
 #  include <pthread.h>
 #endif
 
+#if (__STDC_VERSION__ >= 201112L) && !defined(__STDC_NO_ATOMICS__)
+#  define RBT_USE_C11ATOMICS
+#  include <stdatomic.h>
+#endif
+
 #include "rbtree.h"
 
 #if defined(RBT_USE_C11THREADS)
 #define RBT_MUTEX_TYPE mtx_t
-#define RBT_LOCK_MUTEX(a) do { mtx_lock(&(a)); } while(0)
-#define RBT_UNLOCK_MUTEX(a) do { mtx_unlock(&(a)); } while(0)
+#define RBT_LOCK_MUTEX_UNTRACED(a) do { mtx_lock(&(a)); } while(0)
+#define RBT_TRYLOCK_MUTEX(a) ( mtx_trylock(&(a)) == thrd_success )
+#define RBT_UNLOCK_MUTEX_UNTRACED(a) do { mtx_unlock(&(a)); } while(0)
 #define RBT_INIT_MUTEX(a) do { mtx_init(&(a),mtx_plain); } while(0)
 #define RBT_TERM_MUTEX(a) do { mtx_destroy(&(a)); } while(0)
+#define RBT_COND_TYPE cnd_t
+#define RBT_INIT_COND(a) do { cnd_init(&(a)); } while(0)
+#define RBT_WAIT_COND_UNTRACED(a,m) do { cnd_wait(&(a),&(m)); } while(0)
+#define RBT_SIGNAL_COND(a) do { cnd_signal(&(a)); } while(0)
+#define RBT_BROADCAST_COND(a) do { cnd_broadcast(&(a)); } while(0)
+#define RBT_TERM_COND(a) do { cnd_destroy(&(a)); } while(0)
+#define RBT_THREAD_TYPE thrd_t
+#define RBT_THREAD_RETURN int
+#define RBT_THREAD_RETURN_VALUE (0)
+#define RBT_CREATE_THREAD(t,fn,arg) ( thrd_create(&(t),(fn),(arg)) == thrd_success )
+#define RBT_JOIN_THREAD(t) do { thrd_join((t),NULL); } while(0)
+#define RBT_DETACH_THREAD(t) do { thrd_detach((t)); } while(0)
 #else
 #define RBT_MUTEX_TYPE pthread_mutex_t
-#define RBT_LOCK_MUTEX(a) do { pthread_mutex_lock(&(a)); } while(0)
-#define RBT_UNLOCK_MUTEX(a) do { pthread_mutex_unlock(&(a)); } while(0)
+#define RBT_LOCK_MUTEX_UNTRACED(a) do { pthread_mutex_lock(&(a)); } while(0)
+#define RBT_TRYLOCK_MUTEX(a) ( pthread_mutex_trylock(&(a)) == 0 )
+#define RBT_UNLOCK_MUTEX_UNTRACED(a) do { pthread_mutex_unlock(&(a)); } while(0)
 #define RBT_INIT_MUTEX(a) do { pthread_mutex_init(&(a),NULL); } while(0)
 #define RBT_TERM_MUTEX(a) do { pthread_mutex_destroy(&(a)); } while(0)
+#define RBT_COND_TYPE pthread_cond_t
+#define RBT_INIT_COND(a) do { pthread_cond_init(&(a),NULL); } while(0)
+#define RBT_WAIT_COND_UNTRACED(a,m) do { pthread_cond_wait(&(a),&(m)); } while(0)
+#define RBT_SIGNAL_COND(a) do { pthread_cond_signal(&(a)); } while(0)
+#define RBT_BROADCAST_COND(a) do { pthread_cond_broadcast(&(a)); } while(0)
+#define RBT_TERM_COND(a) do { pthread_cond_destroy(&(a)); } while(0)
+#define RBT_THREAD_TYPE pthread_t
+#define RBT_THREAD_RETURN void *
+#define RBT_THREAD_RETURN_VALUE (NULL)
+#define RBT_CREATE_THREAD(t,fn,arg) ( pthread_create(&(t),NULL,(fn),(arg)) == 0 )
+#define RBT_JOIN_THREAD(t) do { pthread_join((t),NULL); } while(0)
+#define RBT_DETACH_THREAD(t) do { pthread_detach((t)); } while(0)
+#endif
+
+/* relaxed atomics are used for counters that do not order other memory. acquire/release for reference counts */
+#if defined(RBT_USE_C11ATOMICS)
+#define RBT_ATOMIC(type) _Atomic type
+#define RBT_ATOMIC_INIT(a,v) do { atomic_init(&(a),(v)); } while(0)
+#define RBT_ATOMIC_LOAD(a) atomic_load_explicit(&(a),memory_order_relaxed)
+#define RBT_ATOMIC_STORE(a,v) atomic_store_explicit(&(a),(v),memory_order_relaxed)
+#define RBT_ATOMIC_FETCH_ADD(a,v) atomic_fetch_add_explicit(&(a),(v),memory_order_relaxed)
+#define RBT_ATOMIC_LOAD_ACQUIRE(a) atomic_load_explicit(&(a),memory_order_acquire)
+#define RBT_ATOMIC_STORE_RELEASE(a,v) atomic_store_explicit(&(a),(v),memory_order_release)
+#define RBT_ATOMIC_FETCH_SUB_ACQREL(a,v) atomic_fetch_sub_explicit(&(a),(v),memory_order_acq_rel)
+#define RBT_ATOMIC_CAS(a,e,v) atomic_compare_exchange_weak_explicit(&(a),&(e),(v),memory_order_relaxed,memory_order_relaxed)
+#define RBT_ATOMIC_CAS_RELEASE(a,e,v) atomic_compare_exchange_weak_explicit(&(a),&(e),(v),memory_order_release,memory_order_relaxed)
+#else
+#define RBT_ATOMIC(type) type
+#define RBT_ATOMIC_INIT(a,v) do { (a) = (v); } while(0)
+#define RBT_ATOMIC_LOAD(a) __atomic_load_n(&(a),__ATOMIC_RELAXED)
+#define RBT_ATOMIC_STORE(a,v) __atomic_store_n(&(a),(v),__ATOMIC_RELAXED)
+#define RBT_ATOMIC_FETCH_ADD(a,v) __atomic_fetch_add(&(a),(v),__ATOMIC_RELAXED)
+#define RBT_ATOMIC_LOAD_ACQUIRE(a) __atomic_load_n(&(a),__ATOMIC_ACQUIRE)
+#define RBT_ATOMIC_STORE_RELEASE(a,v) __atomic_store_n(&(a),(v),__ATOMIC_RELEASE)
+#define RBT_ATOMIC_FETCH_SUB_ACQREL(a,v) __atomic_fetch_sub(&(a),(v),__ATOMIC_ACQ_REL)
+#define RBT_ATOMIC_CAS(a,e,v) __atomic_compare_exchange_n(&(a),&(e),(v),true,__ATOMIC_RELAXED,__ATOMIC_RELAXED)
+#define RBT_ATOMIC_CAS_RELEASE(a,e,v) __atomic_compare_exchange_n(&(a),&(e),(v),true,__ATOMIC_RELEASE,__ATOMIC_RELAXED)
+#endif
+
+#if (__STDC_VERSION__ >= 201112L)
+#define RBT_THREAD_LOCAL _Thread_local
+#else
+#define RBT_THREAD_LOCAL __thread
+#endif
+
+/* index of the highest set bit, value must not be 0 */
+static inline uint32_t rbtree_common_highBit ( uint64_t value )
+{
+#if defined(__GNUC__)
+    return 63U - (uint32_t)__builtin_clzll(value);
+#else
+    uint32_t bit = 0U;
+
+    while ( value >>= 1U )
+    {
+        bit++;
+    }
+
+    return bit;
 #endif
+}
+
+/* counters never order other memory. RBT_STATS_ADD_LOCKED is for counters only changed with the
+   tree mutex held, one writer so no locked read-modify-write is needed */
+#define RBT_STATS_ADD(s,v) do { (void)RBT_ATOMIC_FETCH_ADD((s),(v)); } while(0)
+#define RBT_STATS_ADD_LOCKED(s,v) do { RBT_ATOMIC_STORE((s), RBT_ATOMIC_LOAD(s) + (v)); } while(0)
+
+/* lock profiling, see rbtree_setLockProfiling. Hold times are counted in power of two buckets of ticks */
+#define RBT_LOCK_HOLD_BUCKETS (64U)
+
+typedef struct _RBT_LOCK_COUNTERS
+{
+    struct _RBT_LOCK_SITE * next;       /* sites that have been profiled, newest first */
+    RBT_ATOMIC(uint32_t) isRegistered;
+    RBT_ATOMIC(uint64_t) acquisitions;
+    RBT_ATOMIC(uint64_t) contended;     /* the try-lock failed & the caller blocked */
+    RBT_ATOMIC(uint64_t) waitTicks;
+    RBT_ATOMIC(uint64_t) holdTicks;
+    RBT_ATOMIC(uint64_t) maxHoldTicks;
+    RBT_ATOMIC(uint64_t) holds[RBT_LOCK_HOLD_BUCKETS];
+} RBT_LOCK_COUNTERS;
+
+/* one per RBT_LOCK_MUTEX in the source, a static in the function using it */
+typedef struct _RBT_LOCK_SITE
+{
+    const char * file;
+    const char * function;
+    uint32_t line;
+    RBT_LOCK_COUNTERS counters;
+} RBT_LOCK_SITE;
+
+extern RBT_ATOMIC(uint32_t) rbtree_lockprof_isOn;
+extern RBT_THREAD_LOCAL uint32_t rbtree_lockprof_depth;     /* profiled locks this thread holds */
+
+void rbtree_lockprof_lock ( RBT_MUTEX_TYPE * mutex, RBT_LOCK_SITE * site );
+void rbtree_lockprof_unlock ( RBT_MUTEX_TYPE * mutex );
+RBT_LOCK_SITE * rbtree_lockprof_suspend ( RBT_MUTEX_TYPE * mutex );
+void rbtree_lockprof_resume ( RBT_MUTEX_TYPE * mutex, RBT_LOCK_SITE * site );
+
+/* while profiling is off a lock tests one flag & an unlock one thread local. A lock taken before
+   profiling was turned on is unlocked untraced, as is a condition wait on it */
+#define RBT_LOCK_MUTEX(a) \
+    do \
+    { \
+        static RBT_LOCK_SITE rbt_lockSite = { __FILE__, __func__, __LINE__, { 0 } }; \
+        if ( RBT_ATOMIC_LOAD(rbtree_lockprof_isOn) ) { rbtree_lockprof_lock(&(a), &rbt_lockSite); } \
+        else { RBT_LOCK_MUTEX_UNTRACED(a); } \
+    } while(0)
+
+#define RBT_UNLOCK_MUTEX(a) \
+    do \
+    { \
+        if ( rbtree_lockprof_depth ) { rbtree_lockprof_unlock(&(a)); } \
+        else { RBT_UNLOCK_MUTEX_UNTRACED(a); } \
+    } while(0)
+
+/* the wait isn't a hold, the hold is ended before it & a new one started after */
+#define RBT_WAIT_COND(a,m) \
+    do \
+    { \
+        RBT_LOCK_SITE * rbt_waitSite = ( rbtree_lockprof_depth ) ? rbtree_lockprof_suspend(&(m)) : NULL; \
+        RBT_WAIT_COND_UNTRACED(a,m); \
+        if ( rbt_waitSite ) { rbtree_lockprof_resume(&(m), rbt_waitSite); } \
+    } while(0)
 
 typedef enum _RBT_COLOUR
 {
@@ -68,12 +210,90 @@ typedef struct _RBT_NODE
     struct _RBT_NODE * parent;
 } RBT_NODE;
 
+/* persistent mode node. Nodes are shared between versions so carry a reference count instead of a parent */
+typedef struct _RBT_PNODE
+{
+    RBT_NODE node;
+    RBT_ATOMIC(uint32_t) refCount;
+} RBT_PNODE;
+
+/* value tree node. The value is copied in after the links & node->value points at it, so every read path returns it */
+typedef struct _RBT_VNODE
+{
+    RBT_NODE node;
+    union
+    {
+        uint64_t u64;
+        double d;
+        void * p;
+    } value[];                  /* aligned for any scalar, tree->valueSize bytes */
+} RBT_VNODE;
+
+typedef enum _RBT_TREE_MODE
+{
+    RBT_TREE_MODE_UNDEF = 0,
+    RBT_TREE_MODE_STANDARD,     /* RBT_NODE's with parent links, updated in place */
+    RBT_TREE_MODE_PERSISTENT,   /* RBT_PNODE's, updated by path-copying */
+    RBT_TREE_MODE_IMAGE,        /* read-only mapped image, no nodes */
+    RBT_TREE_MODE_ARENA,        /* RBT_ANODE's linked by index in a mapped arena, state in its header */
+    RBT_TREE_MODE_LAST_VALUE,
+} RBT_TREE_MODE;
+
+/* counters bumped by lockless readers. Threads are spread over the stripes so they rarely share a line */
+#define RBT_STATS_STRIPES (8U)
+
+typedef struct _RBT_STATS_STRIPE
+{
+    RBT_ATOMIC(uint64_t) lookups;
+    RBT_ATOMIC(uint64_t) misses;
+    uint8_t padding[64U - ( 2U * sizeof(uint64_t) )];
+} RBT_STATS_STRIPE;
+
+typedef struct _RBT_STATS
+{
+    RBT_ATOMIC(uint64_t) inserts;
+    RBT_ATOMIC(uint64_t) deletes;
+    RBT_ATOMIC(uint64_t) allocs;
+    RBT_ATOMIC(uint64_t) rotations;     /* this & below only change under the tree mutex */
+    RBT_ATOMIC(uint64_t) recolours;
+    RBT_ATOMIC(uint64_t) fixUps;
+    RBT_STATS_STRIPE stripes[RBT_STATS_STRIPES];
+} RBT_STATS;
+
+struct _RBT_MVCC;
+struct _RBT_IMAGE;
+struct _RBT_WAL;
+struct _RBT_ARENA;
+struct _RBT_LATENCY;
+struct _RBT_TRACE;
+
+/* typedefs so RBT_ATOMIC applies to the pointer, not what it points at */
+typedef struct _RBT_LATENCY * RBT_LATENCY_REF;
+typedef struct _RBT_TRACE * RBT_TRACE_REF;
+
 typedef struct _RBT_TREE
 {
+    RBT_TREE_MODE mode;
+    bool readOnly;
+    size_t nodeSize;
+    size_t valueSize;           /* value trees: bytes copied into each node, 0 stores the caller's pointers */
     uint32_t nodeCount;
-    uint32_t keySeed;
+    uint64_t version;           /* stamped by every successful mutation, under mutex */
+    uint32_t checkCountdown;    /* RBT_CHECK_LEVEL 2: mutations until the next full validation, under mutex */
+    RBT_ATOMIC(uint64_t) keySeed;   /* next unreserved key. 64bit so exhaustion can't wrap */
     RBT_MUTEX_TYPE mutex;
     RBT_NODE * rootNode;
+    RBT_NODE * spareNodes;      /* persistent mode: pre-allocated nodes for path-copying */
+    uint32_t spareCount;
+    struct _RBT_MVCC * mvcc;    /* persistent mode: retained versions, NULL until a retention is set */
+    struct _RBT_IMAGE * image;  /* image mode: the mapping */
+    struct _RBT_WAL * wal;      /* write-ahead log, NULL unless attached */
+    struct _RBT_ARENA * arena;  /* arena mode: this process's mapping */
+    RBT_STATS stats;            /* this handle's counters, see rbtree_getStats */
+    RBT_ATOMIC(RBT_LATENCY_REF) latency;    /* NULL unless sampling, the one test an unsampled call makes */
+    struct _RBT_LATENCY * latencyData;      /* histograms, kept once allocated as callers may still hold them */
+    RBT_ATOMIC(RBT_TRACE_REF) trace;        /* NULL unless tracing */
+    struct _RBT_TRACE * traceData;          /* kept once allocated for the same reason */
     rbtree_memalloc_t mem_alloc;
     rbtree_memfree_t mem_free;
 } RBT_TREE;
@@ -81,6 +301,7 @@ typedef struct _RBT_TREE
     
 #define RBT_TREE_KEYSEED_MAXVALUE (0xFFFFFFFFU)
 #define RBT_TREE_NODECOUNT_MAXVALUE (0xFFFFFFFFU)
+#define RBT_TREE_DEPTH_MAX RBTREE_DEPTH_MAX
 
     
 #define rbtree_default_memAlloc malloc
@@ -110,7 +331,7 @@ void rbtree_prv_printSummary ( RBT_TREE * tree, FILE * fp );
     #define RBTPRINT_DBG_I(fmt, ... ) RBTPRINT_DBG("-INFO-",fmt, ##__VA_ARGS__)
 
     #define RBTPRINT_ASSERT(cond) \
-        if ( (cond) != TRUE ) \
+        if ( ! (cond) ) \
         { \
             RBTPRINT_DBG_E("Assertion failure (%s:%d)",__FILE__,__LINE__); \
         }
@@ -0,0 +1,428 @@
+/**
+ @file
+ Red-Black Binary Search Tree - Memory mapped read-only image
+
+ @details Image layout, native endian, each section 8 byte aligned:
+ search slots (count+1, eytzinger order, page aligned as the image starts the file), keys (count, key order),
+ blob (encoded values, each a 32bit length then the bytes), values (count, 64bit),
+ then a fixed size footer describing the sections. The footer goes last so the image
+ is written in one sequential pass.
+
+ Lookups walk the eytzinger array: the children of slot i are 2i & 2i+1, so the first levels
+ of every search share a handful of cache lines and the next levels can be prefetched.
+ Index & in-order access go straight to the key ordered arrays. Nothing is decoded or copied
+ when the image is opened, pages are faulted in as queries touch them.
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "rbtree.h"
+#include <string.h>         /* memcmp, memcpy */
+#include <sys/mman.h>       /* mmap, munmap */
+#include <sys/stat.h>       /* fstat */
+#include "rbtree_common.h"
+#include "rbtree_persist.h"
+#include "rbtree_serial.h"
+#include "rbtree_image.h"
+
+
+#define RBT_IMAGE_MAGIC "RBTIMAGE"
+#define RBT_IMAGE_FORMAT (1U)
+#define RBT_IMAGE_BYTE_ORDER (0x01020304U)
+#define RBT_IMAGE_FLAG_RAW_VALUES (1U<<0)
+#define RBT_IMAGE_SECTION_ALIGN (8U)
+
+/* levels of the search array prefetched ahead, 16 slots is 2 cache lines */
+#define RBT_IMAGE_PREFETCH_LEVELS (4U)
+
+
+typedef struct _RBT_IMAGE_FOOTER
+{
+    uint64_t keySeed;
+    uint64_t keysOffset;
+    uint64_t blobOffset;
+    uint64_t blobSize;
+    uint64_t valuesOffset;
+    uint64_t footerOffset;  /* image size less the footer */
+    uint32_t count;
+    uint32_t flags;
+    uint32_t format;
+    uint32_t byteOrder;     /* a foreign endian image reads back as a different value */
+    char magic[8];
+} RBT_IMAGE_FOOTER;
+
+typedef struct _RBT_IMAGE_WRITER
+{
+    RBT_SERIAL_STREAM stream;
+    uint64_t position;      /* bytes written since the start of the image */
+} RBT_IMAGE_WRITER;
+
+
+static inline void rbtree_image_prv_put ( RBT_IMAGE_WRITER * writer, const void * data, uint64_t length );
+static inline void rbtree_image_prv_pad ( RBT_IMAGE_WRITER * writer, uint32_t align );
+static uint32_t rbtree_image_prv_fill ( RBT_IMAGE_SLOT * search, const RBTREE_KEY * keys, uint32_t count, uint32_t rank, uint64_t slot );
+static inline bool rbtree_image_prv_isValid ( const RBT_IMAGE_FOOTER * footer, size_t size );
+
+
+static inline void rbtree_image_prv_put ( RBT_IMAGE_WRITER * writer, const void * data, uint64_t length )
+{
+    const uint8_t * bytes = (const uint8_t *)data;
+
+    writer->position += length;
+
+    while ( length > 0U )
+    {
+        uint32_t chunk = ( length < RBT_SERIAL_BUFFER_SIZE ) ? (uint32_t)length : RBT_SERIAL_BUFFER_SIZE;
+
+        rbtree_serial_write(&writer->stream, bytes, chunk);
+        bytes += chunk;
+        length -= chunk;
+    }
+}
+
+static inline void rbtree_image_prv_pad ( RBT_IMAGE_WRITER * writer, uint32_t align )
+{
+    static const uint8_t zeros[RBT_IMAGE_SECTION_ALIGN] = { 0U };
+    uint32_t remainder = (uint32_t)( writer->position % align );
+
+    if ( remainder != 0U )
+    {
+        rbtree_image_prv_put(writer, zeros, align - remainder);
+    }
+}
+
+static uint32_t rbtree_image_prv_fill ( RBT_IMAGE_SLOT * search, const RBTREE_KEY * keys, uint32_t count, uint32_t rank, uint64_t slot )
+{
+    /* in-order walk of the implicit tree hands out ranks in key order. Depth is log2(count) */
+    if ( slot <= count )
+    {
+        rank = rbtree_image_prv_fill(search, keys, count, rank, slot * 2U);
+
+        search[slot].key = keys[rank];
+        search[slot].rank = rank;
+        rank++;
+
+        rank = rbtree_image_prv_fill(search, keys, count, rank, slot * 2U + 1U);
+    }
+
+    return rank;
+}
+
+static inline bool rbtree_image_prv_isValid ( const RBT_IMAGE_FOOTER * footer, size_t size )
+{
+    bool isValid = false;
+    uint64_t count = footer->count;
+
+    if ( memcmp(footer->magic, RBT_IMAGE_MAGIC, sizeof(footer->magic)) != 0 )
+    {
+        RBTPRINT_DBG_E("Not an image");
+    }
+    else if ( ( footer->format != RBT_IMAGE_FORMAT ) || ( footer->byteOrder != RBT_IMAGE_BYTE_ORDER ) )
+    {
+        RBTPRINT_DBG_E("Unsupported image format:%u byte order:%x",footer->format,footer->byteOrder);
+    }
+    else if ( footer->footerOffset + sizeof(RBT_IMAGE_FOOTER) != (uint64_t)size )
+    {
+        RBTPRINT_DBG_E("Image size mismatch");
+    }
+    else if ( ( footer->keysOffset % RBT_IMAGE_SECTION_ALIGN ) || ( footer->blobOffset % RBT_IMAGE_SECTION_ALIGN ) || ( footer->valuesOffset % RBT_IMAGE_SECTION_ALIGN ) )
+    {
+        RBTPRINT_DBG_E("Misaligned section");
+    }
+    /* sections in order & inside the file. count is 32bit so none of these can overflow */
+    else if ( ( ( count + 1U ) * sizeof(RBT_IMAGE_SLOT) > footer->keysOffset )
+           || ( footer->keysOffset + count * sizeof(RBTREE_KEY) > footer->blobOffset )
+           || ( footer->blobOffset > footer->valuesOffset )
+           || ( footer->blobSize > footer->valuesOffset - footer->blobOffset )
+           || ( footer->valuesOffset + count * sizeof(uint64_t) > footer->footerOffset ) )
+    {
+        RBTPRINT_DBG_E("Section out of bounds");
+    }
+    else if ( footer->keySeed > (uint64_t)RBT_TREE_KEYSEED_MAXVALUE + 1U )
+    {
+        RBTPRINT_DBG_E("Key seed out of range");
+    }
+    else
+    {
+        isValid = true;
+    }
+
+    return isValid;
+}
+
+
+RBTREE_STATUS rbtree_image_export ( RBT_NODE * root, uint32_t nodeCount, uint64_t keySeed, int fd, rbtree_encoder_t encode_fn, void * userdata, RBT_TREE * tree )
+{
+    RBT_IMAGE_WRITER writer;
+    RBT_IMAGE_FOOTER footer;
+    RBTREE_KEY * keys = NULL;
+    uint64_t * values = NULL;
+    RBT_IMAGE_SLOT * search = NULL;
+    uint8_t * scratch = NULL;
+
+    writer.position = 0U;
+
+    if ( rbtree_serial_openWriter(&writer.stream, fd, tree) != RBTREE_STATUS_OK )
+    {
+        /* already reported */
+    }
+    /* one spare entry each so an empty tree still allocates */
+    else if ( ( ( keys = tree->mem_alloc(sizeof(RBTREE_KEY) * ( (size_t)nodeCount + 1U )) ) == NULL )
+           || ( ( values = tree->mem_alloc(sizeof(uint64_t) * ( (size_t)nodeCount + 1U )) ) == NULL )
+           || ( ( search = tree->mem_alloc(sizeof(RBT_IMAGE_SLOT) * ( (size_t)nodeCount + 1U )) ) == NULL )
+           || ( ( encode_fn != NULL ) && ( ( scratch = tree->mem_alloc(RBTREE_ENCODED_VALUE_MAX) ) == NULL ) ) )
+    {
+        RBTPRINT_DBG_E("Malloc failure");
+        writer.stream.status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+    }
+    else
+    {
+        RBT_PERSIST_ITER iter;
+        RBT_NODE * node = rbtree_persist_iterFirst(&iter, root);
+        uint32_t i = 0U;
+
+        /* values hold the pointers until the blob pass swaps them for offsets */
+        while ( ( node != NULL ) && ( i < nodeCount ) )
+        {
+            keys[i] = node->key;
+            values[i] = (uint64_t)(uintptr_t)node->value;
+            i++;
+
+            node = rbtree_persist_iterNext(&iter);
+        }
+
+        search[0].key = RBTREE_KEY_INVALID;
+        search[0].rank = 0U;
+        rbtree_image_prv_fill(search, keys, nodeCount, 0U, 1U);
+
+        rbtree_image_prv_put(&writer, search, sizeof(RBT_IMAGE_SLOT) * ( (uint64_t)nodeCount + 1U ));
+        rbtree_image_prv_pad(&writer, RBT_IMAGE_SECTION_ALIGN);
+
+        footer.keysOffset = writer.position;
+        rbtree_image_prv_put(&writer, keys, sizeof(RBTREE_KEY) * (uint64_t)nodeCount);
+        rbtree_image_prv_pad(&writer, RBT_IMAGE_SECTION_ALIGN);
+
+        footer.blobOffset = writer.position;
+
+        for ( i=0U; ( encode_fn != NULL ) && ( i<nodeCount ) && ( writer.stream.status == RBTREE_STATUS_OK ); i++ )
+        {
+            uint32_t length = RBTREE_ENCODED_VALUE_MAX;
+
+            if ( ( ! encode_fn((void *)(uintptr_t)values[i], scratch, &length, userdata) ) || ( length > RBTREE_ENCODED_VALUE_MAX ) )
+            {
+                RBTPRINT_DBG_E("Encoder failed");
+                writer.stream.status = RBTREE_STATUS_FAIL;
+            }
+            else
+            {
+                values[i] = writer.position - footer.blobOffset;
+
+                rbtree_image_prv_put(&writer, &length, sizeof(length));
+                rbtree_image_prv_put(&writer, scratch, length);
+                rbtree_image_prv_pad(&writer, RBT_IMAGE_SECTION_ALIGN);
+            }
+        }
+
+        footer.blobSize = writer.position - footer.blobOffset;
+
+        footer.valuesOffset = writer.position;
+        rbtree_image_prv_put(&writer, values, sizeof(uint64_t) * (uint64_t)nodeCount);
+
+        footer.keySeed = keySeed;
+        footer.footerOffset = writer.position;
+        footer.count = nodeCount;
+        footer.flags = ( encode_fn == NULL ) ? RBT_IMAGE_FLAG_RAW_VALUES : 0U;
+        footer.format = RBT_IMAGE_FORMAT;
+        footer.byteOrder = RBT_IMAGE_BYTE_ORDER;
+        memcpy(footer.magic, RBT_IMAGE_MAGIC, sizeof(footer.magic));
+
+        rbtree_image_prv_put(&writer, &footer, sizeof(footer));
+    }
+
+    if ( scratch )
+    {
+        tree->mem_free(scratch);
+    }
+
+    if ( search )
+    {
+        tree->mem_free(search);
+    }
+
+    if ( values )
+    {
+        tree->mem_free(values);
+    }
+
+    if ( keys )
+    {
+        tree->mem_free(keys);
+    }
+
+    return rbtree_serial_closeWriter(&writer.stream, tree);
+}
+
+
+RBTREE_STATUS rbtree_image_open ( int fd, RBT_TREE * tree )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    RBT_IMAGE * image = NULL;
+    struct stat info;
+
+    if ( ( image = tree->mem_alloc(sizeof(RBT_IMAGE)) ) == NULL )
+    {
+        RBTPRINT_DBG_E("Malloc failure");
+        status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+    }
+    else if ( fstat(fd, &info) != 0 )
+    {
+        RBTPRINT_DBG_E("fstat failed");
+        status = RBTREE_STATUS_FAIL_IO;
+    }
+    else if ( ( info.st_size < (off_t)( sizeof(RBT_IMAGE_SLOT) + sizeof(RBT_IMAGE_FOOTER) ) ) || ( (uint64_t)info.st_size > (uint64_t)SIZE_MAX ) )
+    {
+        RBTPRINT_DBG_E("Image size %lld out of range",(long long)info.st_size);
+        status = RBTREE_STATUS_FAIL_CORRUPT_DATA;
+    }
+    else if ( ( image->base = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0) ) == MAP_FAILED )
+    {
+        RBTPRINT_DBG_E("mmap failed");
+        status = RBTREE_STATUS_FAIL_IO;
+    }
+    else
+    {
+        const uint8_t * base = (const uint8_t *)image->base;
+        RBT_IMAGE_FOOTER footer;
+
+        image->size = (size_t)info.st_size;
+
+        /* copied out, a damaged file need not leave the footer aligned */
+        memcpy(&footer, base + image->size - sizeof(footer), sizeof(footer));
+
+        if ( rbtree_image_prv_isValid(&footer, image->size) )
+        {
+            image->count = footer.count;
+            image->isRawValues = (bool) ( ( footer.flags & RBT_IMAGE_FLAG_RAW_VALUES ) != 0U );
+            image->search = (const RBT_IMAGE_SLOT *)base;
+            image->keys = (const RBTREE_KEY *)( base + footer.keysOffset );
+            image->values = (const uint64_t *)( base + footer.valuesOffset );
+            image->blob = base + footer.blobOffset;
+            image->blobSize = footer.blobSize;
+
+            tree->image = image;
+            tree->nodeCount = image->count;
+            RBT_ATOMIC_INIT(tree->keySeed, footer.keySeed);
+
+            status = RBTREE_STATUS_OK;
+        }
+        else
+        {
+            munmap(image->base, image->size);
+            status = RBTREE_STATUS_FAIL_CORRUPT_DATA;
+        }
+    }
+
+    if ( ( status != RBTREE_STATUS_OK ) && ( image != NULL ) )
+    {
+        tree->mem_free(image);
+    }
+
+    return status;
+}
+
+
+void rbtree_image_close ( RBT_TREE * tree )
+{
+    if ( tree->image )
+    {
+        munmap(tree->image->base, tree->image->size);
+
+        tree->mem_free(tree->image);
+        tree->image = NULL;
+    }
+}
+
+
+RBTREE_STATUS rbtree_image_findKey ( const RBT_IMAGE * image, RBTREE_KEY key, uint32_t * rank )
+{
+    const RBT_IMAGE_SLOT * search = image->search;
+    uint64_t count = image->count;
+    uint64_t slot = 1U;
+    RBTREE_STATUS status = RBTREE_STATUS_FAIL_KEY_DOES_NOT_EXIST;
+
+    while ( slot <= count )
+    {
+#if defined(__GNUC__)
+        /* descendants RBT_IMAGE_PREFETCH_LEVELS down are contiguous, fetch them while comparing */
+        if ( ( slot << RBT_IMAGE_PREFETCH_LEVELS ) <= count )
+        {
+            __builtin_prefetch(&search[slot << RBT_IMAGE_PREFETCH_LEVELS]);
+        }
+#endif
+
+        if ( key == search[slot].key )
+        {
+            /* ranks come from the file, one that misses its key is a damaged image */
+            if ( ( search[slot].rank < image->count ) && ( image->keys[search[slot].rank] == key ) )
+            {
+                *rank = search[slot].rank;
+                status = RBTREE_STATUS_OK;
+            }
+            else
+            {
+                RBTPRINT_DBG_E("Slot %llu rank %u out of range",(unsigned long long)slot,search[slot].rank);
+                status = RBTREE_STATUS_FAIL_CORRUPT_DATA;
+            }
+            break;
+        }
+
+        slot = slot * 2U + (uint64_t)( key > search[slot].key );
+    }
+
+    return status;
+}
+
+
+void * rbtree_image_getValue ( const RBT_IMAGE * image, uint32_t rank )
+{
+    void * value = NULL;
+
+    /* the values section is sized by count, the offset read from it is checked against the blob */
+    if ( rank >= image->count )
+    {
+        RBTPRINT_DBG_E("Rank %u out of range",rank);
+    }
+    else if ( image->isRawValues )
+    {
+        value = (void *)(uintptr_t)image->values[rank];
+    }
+    else if ( ( image->values[rank] > image->blobSize ) || ( image->blobSize - image->values[rank] < sizeof(uint32_t) ) )
+    {
+        RBTPRINT_DBG_E("Value at rank %u out of bounds",rank);
+    }
+    else
+    {
+        uint64_t offset = image->values[rank];
+        uint32_t length = 0U;
+
+        memcpy(&length, image->blob + offset, sizeof(length));
+
+        /* encoded bytes are returned in place, the caller's decoder knows their layout */
+        if ( image->blobSize - offset - sizeof(uint32_t) >= length )
+        {
+            value = (void *)( image->blob + offset + sizeof(uint32_t) );
+        }
+        else
+        {
+            RBTPRINT_DBG_E("Value at rank %u out of bounds",rank);
+        }
+    }
+
+    return value;
+}
@@ -0,0 +1,65 @@
+/**
+ @file
+ Red-Black Binary Search Tree - Memory mapped read-only image
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#ifndef __RBTREE_IMAGE_H
+#define __RBTREE_IMAGE_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "rbtree_common.h"
+
+
+/* search slot, the key is kept next to its rank so a probe touches one cache line */
+typedef struct _RBT_IMAGE_SLOT
+{
+    RBTREE_KEY key;
+    uint32_t rank;          /* index into the key ordered arrays */
+} RBT_IMAGE_SLOT;
+
+typedef struct _RBT_IMAGE
+{
+    void * base;            /* start of the mapping */
+    size_t size;
+    uint32_t count;
+    bool isRawValues;
+    const RBT_IMAGE_SLOT * search;  /* eytzinger order, 1-based, slot 0 unused */
+    const RBTREE_KEY * keys;        /* key order */
+    const uint64_t * values;        /* raw value bits or offset into blob */
+    const uint8_t * blob;
+    uint64_t blobSize;
+} RBT_IMAGE;
+
+
+/* writes the image of the subtree below root. encode_fn NULL stores the raw value pointers */
+RBTREE_STATUS rbtree_image_export ( RBT_NODE * root, uint32_t nodeCount, uint64_t keySeed, int fd, rbtree_encoder_t encode_fn, void * userdata, RBT_TREE * tree );
+
+/* maps & validates the image, sets tree->image, nodeCount & keySeed */
+RBTREE_STATUS rbtree_image_open ( int fd, RBT_TREE * tree );
+
+void rbtree_image_close ( RBT_TREE * tree );
+
+/* rank of key. FAIL_KEY_DOES_NOT_EXIST when absent, FAIL_CORRUPT_DATA when the slot's rank is damaged */
+RBTREE_STATUS rbtree_image_findKey ( const RBT_IMAGE * image, RBTREE_KEY key, uint32_t * rank );
+
+/* NULL when rank or the stored value lies outside the image */
+void * rbtree_image_getValue ( const RBT_IMAGE * image, uint32_t rank );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* __RBTREE_IMAGE_H */
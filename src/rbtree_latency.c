@@ -0,0 +1,293 @@
+/**
+ @file
+ Red-Black Binary Search Tree - Sampled per-operation latency histograms
+
+ @details Each thread counts calls down from the tree's sample period & times one call in that many.
+ A sampled call sums the ticks it spends waiting for the tree mutex & in the allocator, whatever is
+ left of the whole call is tree work. Ticks are the TSC where there is one, calibrated against
+ CLOCK_MONOTONIC when sampling is first turned on, & converted to ns only when read.
+
+ Histograms are HDR style: exact below #RBT_LATENCY_SUB_BUCKETS ticks, then #RBT_LATENCY_SUB_BUCKETS
+ buckets per power of two, so any value is reported to within about 3% & recording is a shift & an add.
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "rbtree.h"
+#include <string.h>         /* memset */
+#include <time.h>           /* clock_gettime */
+#include "rbtree_common.h"
+#include "rbtree_latency.h"
+
+
+static RBT_THREAD_LOCAL uint32_t rbtree_latency_countdown;    /* calls left before this thread samples */
+
+static const char * const rbtree_latency_opNames[RBT_LATENCY_OPS] =
+{
+    "insert",
+    "insertReserved",
+    "retrieveByKey",
+    "deleteByKey",
+    "deleteByIndex",
+};
+
+static const char * const rbtree_latency_phaseNames[RBT_LATENCY_PHASES] =
+{
+    "total",
+    "lockWait",
+    "alloc",
+    "treeWork",
+};
+
+
+static inline uint64_t rbtree_latency_prv_monotonicNs ( void );
+static inline uint32_t rbtree_latency_prv_bucket ( uint64_t ticks );
+static inline uint64_t rbtree_latency_prv_bucketLow ( uint32_t bucket );
+static inline uint64_t rbtree_latency_prv_bucketHigh ( uint32_t bucket );
+static inline void rbtree_latency_prv_record ( RBT_LATENCY_HIST * hist, uint64_t ticks );
+static inline uint64_t rbtree_latency_prv_toNs ( RBT_LATENCY * latency, uint64_t ticks );
+
+
+static inline uint64_t rbtree_latency_prv_monotonicNs ( void )
+{
+    struct timespec now;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ( (uint64_t)now.tv_sec * 1000000000U ) + (uint64_t)now.tv_nsec;
+}
+
+static inline uint32_t rbtree_latency_prv_bucket ( uint64_t ticks )
+{
+    uint32_t bucket = (uint32_t)ticks;
+
+    if ( ticks >= RBT_LATENCY_SUB_BUCKETS )
+    {
+        /* the power of two picks the row, the next RBT_LATENCY_SUB_BITS bits the column */
+        uint32_t msb = rbtree_common_highBit(ticks);
+        uint32_t shift = msb - RBT_LATENCY_SUB_BITS;
+
+        bucket = ( ( msb - RBT_LATENCY_SUB_BITS + 1U ) * RBT_LATENCY_SUB_BUCKETS ) + (uint32_t)( ( ticks >> shift ) & ( RBT_LATENCY_SUB_BUCKETS - 1U ) );
+    }
+
+    return bucket;
+}
+
+static inline uint64_t rbtree_latency_prv_bucketLow ( uint32_t bucket )
+{
+    uint64_t low = bucket;
+
+    if ( bucket >= RBT_LATENCY_SUB_BUCKETS )
+    {
+        uint32_t row = bucket / RBT_LATENCY_SUB_BUCKETS;
+
+        low = (uint64_t)( RBT_LATENCY_SUB_BUCKETS + ( bucket % RBT_LATENCY_SUB_BUCKETS ) ) << ( row - 1U );
+    }
+
+    return low;
+}
+
+static inline uint64_t rbtree_latency_prv_bucketHigh ( uint32_t bucket )
+{
+    uint64_t high = bucket;
+
+    if ( bucket >= RBT_LATENCY_SUB_BUCKETS )
+    {
+        uint32_t row = bucket / RBT_LATENCY_SUB_BUCKETS;
+
+        /* last value in the bucket, the top one ends at UINT64_MAX */
+        high = rbtree_latency_prv_bucketLow(bucket) + ( ( (uint64_t)1U << ( row - 1U ) ) - 1U );
+    }
+
+    return high;
+}
+
+static inline void rbtree_latency_prv_record ( RBT_LATENCY_HIST * hist, uint64_t ticks )
+{
+    RBT_STATS_ADD(hist->counts[rbtree_latency_prv_bucket(ticks)], 1U);
+}
+
+static inline uint64_t rbtree_latency_prv_toNs ( RBT_LATENCY * latency, uint64_t ticks )
+{
+    return (uint64_t)( (double)ticks * latency->nsPerTick );
+}
+
+
+#if !defined(RBT_LATENCY_USE_TSC)
+uint64_t rbtree_latency_clock ( void )
+{
+    return rbtree_latency_prv_monotonicNs();
+}
+#endif
+
+double rbtree_latency_calibrate ( void )
+{
+    double nsPerTick = 1.0;
+
+#if defined(RBT_LATENCY_USE_TSC)
+    uint64_t startNs = rbtree_latency_prv_monotonicNs();
+    uint64_t startTicks = rbtree_latency_now();
+    uint64_t elapsedNs = 0U;
+    uint64_t elapsedTicks = 0U;
+
+    /* spin rather than sleep, the clocks are read back to back either side */
+    do
+    {
+        elapsedNs = rbtree_latency_prv_monotonicNs() - startNs;
+        elapsedTicks = rbtree_latency_now() - startTicks;
+    } while ( elapsedNs < RBT_LATENCY_CALIBRATE_NS );
+
+    if ( elapsedTicks )
+    {
+        nsPerTick = (double)elapsedNs / (double)elapsedTicks;
+    }
+#endif
+
+    return nsPerTick;
+}
+
+RBT_LATENCY * rbtree_latency_create ( RBT_TREE * tree )
+{
+    RBT_LATENCY * latency = tree->mem_alloc(sizeof(RBT_LATENCY));
+
+    if ( latency )
+    {
+        memset(latency, 0, sizeof(RBT_LATENCY));
+        latency->nsPerTick = rbtree_latency_calibrate();
+    }
+    else
+    {
+        RBTPRINT_DBG_E("Malloc failure");
+    }
+
+    return latency;
+}
+
+void rbtree_latency_destroy ( RBT_LATENCY * latency, RBT_TREE * tree )
+{
+    tree->mem_free(latency);
+}
+
+bool rbtree_latency_begin ( RBT_LATENCY * latency, RBT_LATENCY_SAMPLE * sample, RBTREE_LATENCY_OP op )
+{
+    uint32_t sampleEvery = RBT_ATOMIC_LOAD(latency->sampleEvery);
+    bool isSampled = false;
+
+    if ( ( rbtree_latency_countdown > 1U ) && ( rbtree_latency_countdown <= sampleEvery ) )
+    {
+        rbtree_latency_countdown--;
+    }
+    else if ( sampleEvery )
+    {
+        /* the countdown is per thread, not per tree, a thread's calls are spread over its trees */
+        rbtree_latency_countdown = sampleEvery;
+
+        sample->latency = latency;
+        sample->op = op;
+        sample->lockWait = 0U;
+        sample->alloc = 0U;
+        sample->start = rbtree_latency_now();
+
+        isSampled = true;
+    }
+
+    return isSampled;
+}
+
+void rbtree_latency_end ( RBT_LATENCY_SAMPLE * sample )
+{
+    RBT_LATENCY_HIST * hist = sample->latency->hist[sample->op - 1U];
+    uint64_t total = rbtree_latency_now() - sample->start;
+    uint64_t waited = ( sample->lockWait < total ) ? sample->lockWait : total;
+    uint64_t alloc = ( sample->alloc < ( total - waited ) ) ? sample->alloc : ( total - waited );
+
+    rbtree_latency_prv_record(&hist[RBTREE_LATENCY_PHASE_TOTAL - 1U], total);
+    rbtree_latency_prv_record(&hist[RBTREE_LATENCY_PHASE_LOCK_WAIT - 1U], waited);
+    rbtree_latency_prv_record(&hist[RBTREE_LATENCY_PHASE_ALLOC - 1U], alloc);
+    rbtree_latency_prv_record(&hist[RBTREE_LATENCY_PHASE_TREE_WORK - 1U], total - waited - alloc);
+}
+
+void rbtree_latency_read ( RBT_LATENCY * latency, RBTREE_LATENCY_OP op, RBTREE_LATENCY_PHASE phase, RBTREE_LATENCY * out )
+{
+    RBT_LATENCY_HIST * hist = &latency->hist[op - 1U][phase - 1U];
+    uint64_t counts[RBT_LATENCY_BUCKETS];
+    uint64_t samples = 0U;
+    uint64_t * const percentiles[] = { &out->p50Ns, &out->p90Ns, &out->p99Ns, &out->p999Ns };
+    const uint64_t perMille[] = { 500U, 900U, 990U, 999U };
+    uint32_t next = 0U;
+    uint64_t seen = 0U;
+    uint32_t i = 0U;
+
+    memset(out, 0, sizeof(RBTREE_LATENCY));
+
+    /* one pass to copy, writers may carry on recording */
+    for ( i=0U; i<RBT_LATENCY_BUCKETS; i++ )
+    {
+        counts[i] = RBT_ATOMIC_LOAD(hist->counts[i]);
+        samples += counts[i];
+    }
+
+    out->samples = samples;
+
+    for ( i=0U; ( i<RBT_LATENCY_BUCKETS ) && ( samples ); i++ )
+    {
+        if ( counts[i] == 0U )
+        {
+            continue;
+        }
+
+        if ( seen == 0U )
+        {
+            out->minNs = rbtree_latency_prv_toNs(latency, rbtree_latency_prv_bucketLow(i));
+        }
+
+        seen += counts[i];
+
+        /* a percentile is reported as the middle of the bucket it falls in */
+        while ( ( next < 4U ) && ( ( seen * 1000U ) >= ( samples * perMille[next] ) ) )
+        {
+            uint64_t low = rbtree_latency_prv_bucketLow(i);
+
+            *percentiles[next] = rbtree_latency_prv_toNs(latency, low + ( ( rbtree_latency_prv_bucketHigh(i) - low ) / 2U ));
+            next++;
+        }
+
+        out->maxNs = rbtree_latency_prv_toNs(latency, rbtree_latency_prv_bucketHigh(i));
+    }
+}
+
+void rbtree_latency_print ( RBT_LATENCY * latency, FILE * fp )
+{
+    uint32_t op = 0U;
+    uint32_t phase = 0U;
+
+    fprintf(fp, "%-16s %-10s %12s %10s %10s %10s %10s %10s %10s\n", "op", "phase", "samples", "min", "p50", "p90", "p99", "p99.9", "max");
+
+    for ( op=1U; op<=RBT_LATENCY_OPS; op++ )
+    {
+        for ( phase=1U; phase<=RBT_LATENCY_PHASES; phase++ )
+        {
+            RBTREE_LATENCY summary;
+
+            rbtree_latency_read(latency, (RBTREE_LATENCY_OP)op, (RBTREE_LATENCY_PHASE)phase, &summary);
+
+            if ( summary.samples )
+            {
+                fprintf(fp, "%-16s %-10s %12llu %10llu %10llu %10llu %10llu %10llu %10llu\n",
+                        rbtree_latency_opNames[op - 1U], rbtree_latency_phaseNames[phase - 1U],
+                        (unsigned long long)summary.samples, (unsigned long long)summary.minNs,
+                        (unsigned long long)summary.p50Ns, (unsigned long long)summary.p90Ns,
+                        (unsigned long long)summary.p99Ns, (unsigned long long)summary.p999Ns,
+                        (unsigned long long)summary.maxNs);
+            }
+        }
+    }
+
+    fprintf(fp, "(ns, %.3f ns per tick)\n", latency->nsPerTick);
+}
@@ -0,0 +1,108 @@
+/**
+ @file
+ Red-Black Binary Search Tree - Sampled per-operation latency histograms
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#ifndef __RBTREE_LATENCY_H
+#define __RBTREE_LATENCY_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "rbtree_common.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#  define RBT_LATENCY_USE_TSC
+#  include <x86intrin.h>    /* __rdtsc */
+#endif
+
+
+/* log-linear buckets: values below RBT_LATENCY_SUB_BUCKETS are exact, above that each power of two is
+   split into RBT_LATENCY_SUB_BUCKETS, so a bucket is within 1/16th of its values */
+#define RBT_LATENCY_SUB_BUCKETS (16U)
+#define RBT_LATENCY_SUB_BITS (4U)
+#define RBT_LATENCY_BUCKETS ( ( 64U - RBT_LATENCY_SUB_BITS + 1U ) * RBT_LATENCY_SUB_BUCKETS )
+
+/* how long the tick rate is measured for when sampling is first turned on */
+#define RBT_LATENCY_CALIBRATE_NS (2000000U)
+
+#define RBT_LATENCY_OPS ( RBTREE_LATENCY_OP_LAST_VALUE - 1U )
+#define RBT_LATENCY_PHASES ( RBTREE_LATENCY_PHASE_LAST_VALUE - 1U )
+
+typedef struct _RBT_LATENCY_HIST
+{
+    RBT_ATOMIC(uint64_t) counts[RBT_LATENCY_BUCKETS];
+} RBT_LATENCY_HIST;
+
+typedef struct _RBT_LATENCY
+{
+    RBT_ATOMIC(uint32_t) sampleEvery;
+    double nsPerTick;
+    RBT_LATENCY_HIST hist[RBT_LATENCY_OPS][RBT_LATENCY_PHASES];
+} RBT_LATENCY;
+
+/* one sampled call, on the caller's stack. Phases are summed in ticks as the call goes */
+typedef struct _RBT_LATENCY_SAMPLE
+{
+    RBT_LATENCY * latency;
+    RBTREE_LATENCY_OP op;
+    uint64_t start;
+    uint64_t lockWait;
+    uint64_t alloc;
+} RBT_LATENCY_SAMPLE;
+
+
+#if defined(RBT_LATENCY_USE_TSC)
+static inline uint64_t rbtree_latency_now ( void )
+{
+    return (uint64_t)__rdtsc();
+}
+#else
+/* CLOCK_MONOTONIC in ns */
+uint64_t rbtree_latency_clock ( void );
+
+static inline uint64_t rbtree_latency_now ( void )
+{
+    return rbtree_latency_clock();
+}
+#endif
+
+/* timing is the sample, or NULL when the call isn't sampled */
+#define RBT_LATENCY_MARK(timing) ( ( timing ) ? rbtree_latency_now() : 0U )
+#define RBT_LATENCY_ADD(timing,phase,mark) do { if ( timing ) { (timing)->phase += rbtree_latency_now() - (mark); } } while(0)
+
+
+/* ns per rbtree_latency_now tick, measured over RBT_LATENCY_CALIBRATE_NS */
+double rbtree_latency_calibrate ( void );
+
+/* zeroed histograms & a calibrated clock, sampling off */
+RBT_LATENCY * rbtree_latency_create ( RBT_TREE * tree );
+
+void rbtree_latency_destroy ( RBT_LATENCY * latency, RBT_TREE * tree );
+
+/* true if the calling thread's turn to sample has come round, sample is then started */
+bool rbtree_latency_begin ( RBT_LATENCY * latency, RBT_LATENCY_SAMPLE * sample, RBTREE_LATENCY_OP op );
+
+/* records every phase of a sample begun by rbtree_latency_begin */
+void rbtree_latency_end ( RBT_LATENCY_SAMPLE * sample );
+
+void rbtree_latency_read ( RBT_LATENCY * latency, RBTREE_LATENCY_OP op, RBTREE_LATENCY_PHASE phase, RBTREE_LATENCY * out );
+
+void rbtree_latency_print ( RBT_LATENCY * latency, FILE * fp );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* __RBTREE_LATENCY_H */
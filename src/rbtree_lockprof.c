@@ -0,0 +1,334 @@
+/**
+ @file
+ Red-Black Binary Search Tree - Lock contention profiling
+
+ @details While profiling is on every #RBT_LOCK_MUTEX tries the lock first. Only when that fails is
+ the caller counted as contended & the blocking lock timed, so an uncontended acquisition costs what it
+ did plus a tick read for the hold. Each thread keeps the profiled locks it holds on a short stack
+ with the site & tick they were taken at, #RBT_UNLOCK_MUTEX pops the entry & records the hold against
+ that site. Sites are statics in the functions taking the lock & join a lock free list the first time
+ they are profiled, so nothing is allocated.
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#include "rbtree.h"
+#include <string.h>         /* memset */
+#include "rbtree_common.h"
+#include "rbtree_latency.h"
+#include "rbtree_lockprof.h"
+
+
+/* sites printed by rbtree_lockprof_print */
+#define RBT_LOCK_PRINT_SITES (64U)
+
+typedef struct _RBT_LOCK_HELD
+{
+    RBT_MUTEX_TYPE * mutex;
+    RBT_LOCK_SITE * site;
+    uint64_t start;
+} RBT_LOCK_HELD;
+
+/* a typedef so RBT_ATOMIC applies to the pointer */
+typedef RBT_LOCK_SITE * RBT_LOCK_SITE_REF;
+
+
+RBT_ATOMIC(uint32_t) rbtree_lockprof_isOn;
+RBT_THREAD_LOCAL uint32_t rbtree_lockprof_depth;
+
+static RBT_THREAD_LOCAL RBT_LOCK_HELD rbtree_lockprof_held[RBT_LOCK_STACK_DEPTH];
+static RBT_ATOMIC(RBT_LOCK_SITE_REF) rbtree_lockprof_sites;
+static double rbtree_lockprof_nsPerTick;    /* 0 until first turned on */
+
+
+static inline void rbtree_lockprof_prv_register ( RBT_LOCK_SITE * site );
+static inline void rbtree_lockprof_prv_push ( RBT_MUTEX_TYPE * mutex, RBT_LOCK_SITE * site );
+static inline RBT_LOCK_SITE * rbtree_lockprof_prv_pop ( RBT_MUTEX_TYPE * mutex, uint64_t * start );
+static inline void rbtree_lockprof_prv_recordHold ( RBT_LOCK_SITE * site, uint64_t ticks );
+static inline void rbtree_lockprof_prv_clear ( RBT_LOCK_COUNTERS * counters );
+static inline uint64_t rbtree_lockprof_prv_toNs ( uint64_t ticks );
+static inline void rbtree_lockprof_prv_summarise ( RBT_LOCK_SITE * site, RBTREE_LOCK_SITE * out );
+
+
+static inline void rbtree_lockprof_prv_register ( RBT_LOCK_SITE * site )
+{
+    uint32_t isRegistered = 0U;
+
+    if ( ( RBT_ATOMIC_LOAD(site->counters.isRegistered) == 0U ) && ( RBT_ATOMIC_CAS(site->counters.isRegistered, isRegistered, 1U) ) )
+    {
+        RBT_LOCK_SITE * head = RBT_ATOMIC_LOAD(rbtree_lockprof_sites);
+
+        /* only the winner of the exchange above links the site in */
+        do
+        {
+            site->counters.next = head;
+        } while ( RBT_ATOMIC_CAS_RELEASE(rbtree_lockprof_sites, head, site) == false );
+    }
+}
+
+static inline void rbtree_lockprof_prv_push ( RBT_MUTEX_TYPE * mutex, RBT_LOCK_SITE * site )
+{
+    if ( rbtree_lockprof_depth < RBT_LOCK_STACK_DEPTH )
+    {
+        RBT_LOCK_HELD * held = &rbtree_lockprof_held[rbtree_lockprof_depth];
+
+        held->mutex = mutex;
+        held->site = site;
+        held->start = rbtree_latency_now();
+
+        rbtree_lockprof_depth++;
+    }
+}
+
+static inline RBT_LOCK_SITE * rbtree_lockprof_prv_pop ( RBT_MUTEX_TYPE * mutex, uint64_t * start )
+{
+    RBT_LOCK_SITE * site = NULL;
+    uint32_t i = 0U;
+
+    /* locks are nearly always released newest first */
+    for ( i=rbtree_lockprof_depth; i>0U; i-- )
+    {
+        if ( rbtree_lockprof_held[i - 1U].mutex == mutex )
+        {
+            site = rbtree_lockprof_held[i - 1U].site;
+            *start = rbtree_lockprof_held[i - 1U].start;
+
+            for ( ; i < rbtree_lockprof_depth; i++ )
+            {
+                rbtree_lockprof_held[i - 1U] = rbtree_lockprof_held[i];
+            }
+
+            rbtree_lockprof_depth--;
+            break;
+        }
+    }
+
+    return site;
+}
+
+static inline void rbtree_lockprof_prv_recordHold ( RBT_LOCK_SITE * site, uint64_t ticks )
+{
+    RBT_LOCK_COUNTERS * counters = &site->counters;
+    uint64_t maxHold = RBT_ATOMIC_LOAD(counters->maxHoldTicks);
+    uint32_t bucket = ( ticks > 1U ) ? rbtree_common_highBit(ticks) : 0U;
+
+    RBT_STATS_ADD(counters->holdTicks, ticks);
+    RBT_STATS_ADD(counters->holds[bucket], 1U);
+
+    while ( ( ticks > maxHold ) && ( RBT_ATOMIC_CAS(counters->maxHoldTicks, maxHold, ticks) == false ) )
+    {
+        /* maxHold reloaded by the failed exchange */
+    }
+}
+
+static inline void rbtree_lockprof_prv_clear ( RBT_LOCK_COUNTERS * counters )
+{
+    uint32_t i = 0U;
+
+    RBT_ATOMIC_STORE(counters->acquisitions, 0U);
+    RBT_ATOMIC_STORE(counters->contended, 0U);
+    RBT_ATOMIC_STORE(counters->waitTicks, 0U);
+    RBT_ATOMIC_STORE(counters->holdTicks, 0U);
+    RBT_ATOMIC_STORE(counters->maxHoldTicks, 0U);
+
+    for ( i=0U; i<RBT_LOCK_HOLD_BUCKETS; i++ )
+    {
+        RBT_ATOMIC_STORE(counters->holds[i], 0U);
+    }
+}
+
+static inline uint64_t rbtree_lockprof_prv_toNs ( uint64_t ticks )
+{
+    return (uint64_t)( (double)ticks * rbtree_lockprof_nsPerTick );
+}
+
+static inline void rbtree_lockprof_prv_summarise ( RBT_LOCK_SITE * site, RBTREE_LOCK_SITE * out )
+{
+    RBT_LOCK_COUNTERS * counters = &site->counters;
+    uint64_t holds[RBT_LOCK_HOLD_BUCKETS];
+    uint64_t total = 0U;
+    uint64_t seen = 0U;
+    uint32_t i = 0U;
+
+    memset(out, 0, sizeof(RBTREE_LOCK_SITE));
+
+    out->file = site->file;
+    out->function = site->function;
+    out->line = site->line;
+    out->acquisitions = RBT_ATOMIC_LOAD(counters->acquisitions);
+    out->contended = RBT_ATOMIC_LOAD(counters->contended);
+    out->waitNs = rbtree_lockprof_prv_toNs(RBT_ATOMIC_LOAD(counters->waitTicks));
+    out->holdNs = rbtree_lockprof_prv_toNs(RBT_ATOMIC_LOAD(counters->holdTicks));
+    out->maxHoldNs = rbtree_lockprof_prv_toNs(RBT_ATOMIC_LOAD(counters->maxHoldTicks));
+
+    for ( i=0U; i<RBT_LOCK_HOLD_BUCKETS; i++ )
+    {
+        holds[i] = RBT_ATOMIC_LOAD(counters->holds[i]);
+        total += holds[i];
+    }
+
+    /* a percentile is reported as the top of its power of two */
+    for ( i=0U; ( i<RBT_LOCK_HOLD_BUCKETS ) && ( total ); i++ )
+    {
+        uint64_t top = ( i < 63U ) ? ( ( (uint64_t)2U << i ) - 1U ) : UINT64_MAX;
+
+        seen += holds[i];
+
+        if ( ( out->holdP50Ns == 0U ) && ( ( seen * 2U ) >= total ) )
+        {
+            out->holdP50Ns = rbtree_lockprof_prv_toNs(top);
+        }
+
+        if ( ( seen * 100U ) >= ( total * 99U ) )
+        {
+            out->holdP99Ns = rbtree_lockprof_prv_toNs(top);
+            break;
+        }
+    }
+}
+
+
+void rbtree_lockprof_lock ( RBT_MUTEX_TYPE * mutex, RBT_LOCK_SITE * site )
+{
+    if ( RBT_TRYLOCK_MUTEX(*mutex) == false )
+    {
+        /* the slow path, blocking dwarfs the two tick reads */
+        uint64_t start = rbtree_latency_now();
+
+        RBT_LOCK_MUTEX_UNTRACED(*mutex);
+
+        RBT_STATS_ADD(site->counters.waitTicks, rbtree_latency_now() - start);
+        RBT_STATS_ADD(site->counters.contended, 1U);
+    }
+
+    rbtree_lockprof_prv_register(site);
+    RBT_STATS_ADD(site->counters.acquisitions, 1U);
+
+    rbtree_lockprof_prv_push(mutex, site);
+}
+
+void rbtree_lockprof_unlock ( RBT_MUTEX_TYPE * mutex )
+{
+    uint64_t start = 0U;
+    uint64_t end = rbtree_latency_now();
+    RBT_LOCK_SITE * site = rbtree_lockprof_prv_pop(mutex, &start);
+
+    RBT_UNLOCK_MUTEX_UNTRACED(*mutex);
+
+    /* recorded once released so the bookkeeping isn't part of the hold */
+    if ( site )
+    {
+        rbtree_lockprof_prv_recordHold(site, end - start);
+    }
+}
+
+RBT_LOCK_SITE * rbtree_lockprof_suspend ( RBT_MUTEX_TYPE * mutex )
+{
+    uint64_t start = 0U;
+    uint64_t end = rbtree_latency_now();
+    RBT_LOCK_SITE * site = rbtree_lockprof_prv_pop(mutex, &start);
+
+    if ( site )
+    {
+        rbtree_lockprof_prv_recordHold(site, end - start);
+    }
+
+    return site;
+}
+
+void rbtree_lockprof_resume ( RBT_MUTEX_TYPE * mutex, RBT_LOCK_SITE * site )
+{
+    rbtree_lockprof_prv_push(mutex, site);
+}
+
+void rbtree_lockprof_enable ( bool enable )
+{
+    if ( ( enable ) && ( RBT_ATOMIC_LOAD(rbtree_lockprof_isOn) == 0U ) )
+    {
+        RBT_LOCK_SITE * site = RBT_ATOMIC_LOAD_ACQUIRE(rbtree_lockprof_sites);
+
+        if ( rbtree_lockprof_nsPerTick == 0.0 )
+        {
+            rbtree_lockprof_nsPerTick = rbtree_latency_calibrate();
+        }
+
+        for ( ; site; site = site->counters.next )
+        {
+            rbtree_lockprof_prv_clear(&site->counters);
+        }
+    }
+
+    RBT_ATOMIC_STORE(rbtree_lockprof_isOn, ( enable ) ? 1U : 0U);
+}
+
+void rbtree_lockprof_read ( RBTREE_LOCK_SITE * sites, uint32_t * count )
+{
+    RBT_LOCK_SITE * site = RBT_ATOMIC_LOAD_ACQUIRE(rbtree_lockprof_sites);
+    uint32_t written = 0U;
+
+    for ( ; site; site = site->counters.next )
+    {
+        RBTREE_LOCK_SITE summary;
+        uint32_t slot = written;
+
+        rbtree_lockprof_prv_summarise(site, &summary);
+
+        if ( summary.acquisitions == 0U )
+        {
+            continue;
+        }
+
+        /* insertion into the top *count by longest hold, the shortest drops off the end */
+        while ( ( slot > 0U ) && ( sites[slot - 1U].maxHoldNs < summary.maxHoldNs ) )
+        {
+            if ( slot < *count )
+            {
+                sites[slot] = sites[slot - 1U];
+            }
+
+            slot--;
+        }
+
+        if ( slot < *count )
+        {
+            sites[slot] = summary;
+
+            if ( written < *count )
+            {
+                written++;
+            }
+        }
+    }
+
+    *count = written;
+}
+
+void rbtree_lockprof_print ( FILE * fp )
+{
+    RBTREE_LOCK_SITE sites[RBT_LOCK_PRINT_SITES];
+    uint32_t count = RBT_LOCK_PRINT_SITES;
+    uint32_t i = 0U;
+
+    rbtree_lockprof_read(sites, &count);
+
+    fprintf(fp, "%-40s %12s %10s %12s %12s %10s %10s %10s\n", "site", "acquired", "contended", "wait", "held", "p50 hold", "p99 hold", "max hold");
+
+    for ( i=0U; i<count; i++ )
+    {
+        char name[256];
+
+        (void)snprintf(name, sizeof(name), "%s:%u", sites[i].function, sites[i].line);
+
+        fprintf(fp, "%-40s %12llu %10llu %12llu %12llu %10llu %10llu %10llu\n",
+                name, (unsigned long long)sites[i].acquisitions, (unsigned long long)sites[i].contended,
+                (unsigned long long)sites[i].waitNs, (unsigned long long)sites[i].holdNs,
+                (unsigned long long)sites[i].holdP50Ns, (unsigned long long)sites[i].holdP99Ns,
+                (unsigned long long)sites[i].maxHoldNs);
+    }
+
+    fprintf(fp, "(ns, longest single hold first)\n");
+}
@@ -0,0 +1,42 @@
+/**
+ @file
+ Red-Black Binary Search Tree - Lock contention profiling
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#ifndef __RBTREE_LOCKPROF_H
+#define __RBTREE_LOCKPROF_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "rbtree_common.h"
+
+
+/* profiled locks a thread can hold at once, deeper ones are taken untraced */
+#define RBT_LOCK_STACK_DEPTH (8U)
+
+
+/* turning on clears every site's counters */
+void rbtree_lockprof_enable ( bool enable );
+
+/* up to *count sites, longest single hold first. *count is set to the number written */
+void rbtree_lockprof_read ( RBTREE_LOCK_SITE * sites, uint32_t * count );
+
+void rbtree_lockprof_print ( FILE * fp );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* __RBTREE_LOCKPROF_H */
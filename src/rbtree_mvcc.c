@@ -0,0 +1,312 @@
+/**
+ @file
+ Red-Black Binary Search Tree - Multi-version (MVCC) history for persistent trees
+
+ @details Every successful mutation stamps tree->version. Once a retention is set, the root of
+ the version about to be superseded is retained in a ring before the writer touches the tree,
+ which makes the writer path-copy instead of updating in place. Any retained version can then be
+ opened as a read-only view in O(log retention) + O(1), and read in O(log n).
+ Roots falling off the end of the ring are handed to a collector thread so writers never pay
+ for freeing a whole superseded path set.
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#include "rbtree.h"
+#include "rbtree_common.h"
+#include "rbtree_persist.h"
+#include "rbtree_mvcc.h"
+
+
+static inline void rbtree_mvcc_prv_discard ( RBT_MVCC * mvcc, RBT_NODE * root );
+static inline RBT_MVCC * rbtree_mvcc_prv_create ( RBT_TREE * tree );
+static inline RBT_MVCC_ENTRY * rbtree_mvcc_prv_getEntry ( RBT_MVCC * mvcc, uint32_t index );
+static RBT_THREAD_RETURN rbtree_mvcc_prv_collector ( void * arg );
+
+
+static inline void rbtree_mvcc_prv_discard ( RBT_MVCC * mvcc, RBT_NODE * root )
+{
+    bool queued = false;
+
+    if ( root )
+    {
+        RBT_LOCK_MUTEX(mvcc->gcMutex);
+
+        if ( ( mvcc->gcRunning ) && ( mvcc->garbageCount < RBT_MVCC_GARBAGE_MAX ) )
+        {
+            mvcc->garbage[mvcc->garbageCount] = root;
+            mvcc->garbageCount++;
+            queued = true;
+
+            RBT_SIGNAL_COND(mvcc->gcCond);
+        }
+
+        RBT_UNLOCK_MUTEX(mvcc->gcMutex);
+
+        if ( queued == false )
+        {
+            /* no collector or it has fallen behind. Writer pays */
+            rbtree_persist_releaseNode(root, mvcc->tree);
+        }
+    }
+}
+
+static inline RBT_MVCC * rbtree_mvcc_prv_create ( RBT_TREE * tree )
+{
+    RBT_MVCC * mvcc = tree->mem_alloc(sizeof(RBT_MVCC));
+
+    if ( mvcc )
+    {
+        mvcc->tree = tree;
+        mvcc->retention = 0U;
+        mvcc->head = 0U;
+        mvcc->count = 0U;
+        mvcc->history = NULL;
+        mvcc->gcStop = false;
+        mvcc->garbageCount = 0U;
+
+        RBT_INIT_MUTEX(mvcc->gcMutex);
+        RBT_INIT_COND(mvcc->gcCond);
+
+        /* without a collector expired versions are released inline */
+        mvcc->gcRunning = RBT_CREATE_THREAD(mvcc->gcThread, rbtree_mvcc_prv_collector, mvcc);
+    }
+
+    return mvcc;
+}
+
+static inline RBT_MVCC_ENTRY * rbtree_mvcc_prv_getEntry ( RBT_MVCC * mvcc, uint32_t index )
+{
+    return &mvcc->history[( mvcc->head + index ) % mvcc->retention];
+}
+
+static RBT_THREAD_RETURN rbtree_mvcc_prv_collector ( void * arg )
+{
+    RBT_MVCC * mvcc = (RBT_MVCC *)arg;
+    bool running = true;
+
+    RBT_LOCK_MUTEX(mvcc->gcMutex);
+
+    while ( running )
+    {
+        if ( mvcc->garbageCount > 0U )
+        {
+            RBT_NODE * root = NULL;
+
+            mvcc->garbageCount--;
+            root = mvcc->garbage[mvcc->garbageCount];
+
+            /* nodes still shared with newer versions only lose a reference */
+            RBT_UNLOCK_MUTEX(mvcc->gcMutex);
+            rbtree_persist_releaseNode(root, mvcc->tree);
+            RBT_LOCK_MUTEX(mvcc->gcMutex);
+        }
+        else if ( mvcc->gcStop )
+        {
+            running = false;
+        }
+        else
+        {
+            RBT_WAIT_COND(mvcc->gcCond, mvcc->gcMutex);
+        }
+    }
+
+    RBT_UNLOCK_MUTEX(mvcc->gcMutex);
+
+    return RBT_THREAD_RETURN_VALUE;
+}
+
+
+RBTREE_STATUS rbtree_mvcc_setRetention ( RBT_TREE * tree, uint32_t versions )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    RBT_MVCC * mvcc = tree->mvcc;
+    RBT_MVCC_ENTRY * history = NULL;
+
+    if ( versions == 0U )
+    {
+        rbtree_mvcc_destroy(tree);
+        status = RBTREE_STATUS_OK;
+    }
+    else if ( ( mvcc == NULL ) && ( ( mvcc = rbtree_mvcc_prv_create(tree) ) == NULL ) )
+    {
+        RBTPRINT_DBG_E("Malloc failure");
+        status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+    }
+    else if ( ( history = tree->mem_alloc(sizeof(RBT_MVCC_ENTRY) * versions) ) == NULL )
+    {
+        RBTPRINT_DBG_E("Malloc failure");
+        status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+
+        if ( tree->mvcc == NULL )
+        {
+            tree->mvcc = mvcc;
+            rbtree_mvcc_destroy(tree);
+        }
+    }
+    else
+    {
+        uint32_t i = 0U;
+
+        /* keep the newest entries that still fit */
+        while ( mvcc->count > versions )
+        {
+            rbtree_mvcc_prv_discard(mvcc, rbtree_mvcc_prv_getEntry(mvcc, 0U)->root);
+            mvcc->head = ( mvcc->head + 1U ) % mvcc->retention;
+            mvcc->count--;
+        }
+
+        for ( i=0U; i<mvcc->count; i++ )
+        {
+            history[i] = *rbtree_mvcc_prv_getEntry(mvcc, i);
+        }
+
+        if ( mvcc->history )
+        {
+            tree->mem_free(mvcc->history);
+        }
+
+        mvcc->history = history;
+        mvcc->retention = versions;
+        mvcc->head = 0U;
+        tree->mvcc = mvcc;
+
+        status = RBTREE_STATUS_OK;
+    }
+
+    return status;
+}
+
+
+void rbtree_mvcc_preserve ( RBT_TREE * tree )
+{
+    RBT_MVCC * mvcc = tree->mvcc;
+
+    /* a failed mutation does not bump the version, so the entry may already be there */
+    if ( ( mvcc != NULL ) &&
+         ( ( mvcc->count == 0U ) || ( rbtree_mvcc_prv_getEntry(mvcc, mvcc->count-1U)->version != tree->version ) ) )
+    {
+        RBT_MVCC_ENTRY * entry = NULL;
+
+        if ( mvcc->count == mvcc->retention )
+        {
+            rbtree_mvcc_prv_discard(mvcc, rbtree_mvcc_prv_getEntry(mvcc, 0U)->root);
+            mvcc->head = ( mvcc->head + 1U ) % mvcc->retention;
+            mvcc->count--;
+        }
+
+        entry = rbtree_mvcc_prv_getEntry(mvcc, mvcc->count);
+        entry->version = tree->version;
+        entry->nodeCount = tree->nodeCount;
+        entry->root = tree->rootNode;
+
+        /* the extra reference makes the writer copy the path rather than update in place */
+        rbtree_persist_retainNode(entry->root);
+
+        mvcc->count++;
+    }
+}
+
+
+RBTREE_STATUS rbtree_mvcc_retainVersion ( RBT_TREE * tree, uint64_t version, RBT_NODE ** root, uint32_t * nodeCount )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    RBT_MVCC * mvcc = tree->mvcc;
+
+    if ( version == tree->version )
+    {
+        *root = tree->rootNode;
+        *nodeCount = tree->nodeCount;
+        status = RBTREE_STATUS_OK;
+    }
+    else if ( version > tree->version )
+    {
+        RBTPRINT_DBG_E("Version:%llu not yet committed",(unsigned long long)version);
+        status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+    }
+    else if ( mvcc != NULL )
+    {
+        /* history is ordered oldest to newest */
+        uint32_t lower = 0U;
+        uint32_t upper = mvcc->count;
+
+        status = RBTREE_STATUS_FAIL_VERSION_NOT_RETAINED;
+
+        while ( lower < upper )
+        {
+            uint32_t middle = lower + ( ( upper - lower ) / 2U );
+            RBT_MVCC_ENTRY * entry = rbtree_mvcc_prv_getEntry(mvcc, middle);
+
+            if ( entry->version == version )
+            {
+                *root = entry->root;
+                *nodeCount = entry->nodeCount;
+                status = RBTREE_STATUS_OK;
+                break;
+            }
+            else if ( entry->version < version )
+            {
+                lower = middle + 1U;
+            }
+            else
+            {
+                upper = middle;
+            }
+        }
+    }
+    else
+    {
+        RBTPRINT_DBG_W("Version:%llu not retained",(unsigned long long)version);
+        status = RBTREE_STATUS_FAIL_VERSION_NOT_RETAINED;
+    }
+
+    if ( status == RBTREE_STATUS_OK )
+    {
+        rbtree_persist_retainNode(*root);
+    }
+
+    return status;
+}
+
+
+void rbtree_mvcc_destroy ( RBT_TREE * tree )
+{
+    RBT_MVCC * mvcc = tree->mvcc;
+
+    if ( mvcc )
+    {
+        uint32_t i = 0U;
+
+        RBT_LOCK_MUTEX(mvcc->gcMutex);
+        mvcc->gcStop = true;
+        RBT_SIGNAL_COND(mvcc->gcCond);
+        RBT_UNLOCK_MUTEX(mvcc->gcMutex);
+
+        /* the collector drains its queue before exiting */
+        if ( mvcc->gcRunning )
+        {
+            RBT_JOIN_THREAD(mvcc->gcThread);
+            mvcc->gcRunning = false;
+        }
+
+        for ( i=0U; i<mvcc->count; i++ )
+        {
+            rbtree_persist_releaseNode(rbtree_mvcc_prv_getEntry(mvcc, i)->root, tree);
+        }
+
+        RBT_TERM_COND(mvcc->gcCond);
+        RBT_TERM_MUTEX(mvcc->gcMutex);
+
+        if ( mvcc->history )
+        {
+            tree->mem_free(mvcc->history);
+        }
+
+        tree->mem_free(mvcc);
+        tree->mvcc = NULL;
+    }
+}
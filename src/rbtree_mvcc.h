@@ -0,0 +1,69 @@
+/**
+ @file
+ Red-Black Binary Search Tree - Multi-version (MVCC) history for persistent trees
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#ifndef __RBTREE_MVCC_H
+#define __RBTREE_MVCC_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "rbtree_common.h"
+
+
+/* expired roots queued for the collector. Writers release inline once it is full */
+#define RBT_MVCC_GARBAGE_MAX (64U)
+
+
+typedef struct _RBT_MVCC_ENTRY
+{
+    uint64_t version;
+    uint32_t nodeCount;
+    RBT_NODE * root;        /* holds a reference */
+} RBT_MVCC_ENTRY;
+
+typedef struct _RBT_MVCC
+{
+    RBT_TREE * tree;
+    uint32_t retention;     /* capacity of history */
+    uint32_t head;          /* index of the oldest entry */
+    uint32_t count;
+    RBT_MVCC_ENTRY * history;
+
+    RBT_MUTEX_TYPE gcMutex; /* guards the garbage queue & gcStop */
+    RBT_COND_TYPE gcCond;
+    RBT_THREAD_TYPE gcThread;
+    bool gcRunning;
+    bool gcStop;
+    uint32_t garbageCount;
+    RBT_NODE * garbage[RBT_MVCC_GARBAGE_MAX];
+} RBT_MVCC;
+
+
+/* all calls below expect the tree mutex to be held */
+
+RBTREE_STATUS rbtree_mvcc_setRetention ( RBT_TREE * tree, uint32_t versions );
+
+void rbtree_mvcc_preserve ( RBT_TREE * tree );
+
+RBTREE_STATUS rbtree_mvcc_retainVersion ( RBT_TREE * tree, uint64_t version, RBT_NODE ** root, uint32_t * nodeCount );
+
+void rbtree_mvcc_destroy ( RBT_TREE * tree );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* __RBTREE_MVCC_H */
@@ -0,0 +1,277 @@
+/**
+ @file
+ Red-Black Binary Search Tree - Parallel traversal
+
+ @details The top few levels of the tree are unrolled into an in-order list of tasks, each
+ either a whole subtree or a single node from above the split depth. Every worker starts with
+ a contiguous block of that list and walks it front to back, so it sees keys in order. An idle
+ worker steals from the back of another worker's block, which keeps the victim's remaining
+ range contiguous. Red-black balance bounds how uneven two subtrees at the same depth can be,
+ stealing absorbs the rest.
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#include "rbtree.h"
+#include "rbtree_common.h"
+#include "rbtree_persist.h"
+#include "rbtree_parallel.h"
+
+
+typedef struct _RBT_PARALLEL_TASK
+{
+    RBT_NODE * node;
+    bool isSubtree;         /* false: node alone, its children belong to neighbouring tasks */
+} RBT_PARALLEL_TASK;
+
+struct _RBT_PARALLEL_JOB;
+
+typedef struct _RBT_PARALLEL_WORKER
+{
+    RBT_MUTEX_TYPE mutex;   /* guards lo/hi against thieves */
+    uint32_t lo;            /* next task owner takes */
+    uint32_t hi;            /* one past the task a thief takes */
+    uint32_t index;
+    RBT_THREAD_TYPE thread;
+    bool isStarted;
+    struct _RBT_PARALLEL_JOB * job;
+} RBT_PARALLEL_WORKER;
+
+typedef struct _RBT_PARALLEL_JOB
+{
+    RBT_PARALLEL_TASK * tasks;
+    uint32_t taskCount;
+    RBT_PARALLEL_WORKER * workers;
+    uint32_t workerCount;
+    rbt_parallel_visit_t visit_fn;
+    void * context;
+} RBT_PARALLEL_JOB;
+
+
+static inline uint32_t rbtree_parallel_prv_splitDepth ( uint32_t threadCount );
+static inline uint32_t rbtree_parallel_prv_split ( RBT_NODE * node, uint32_t depth, RBT_PARALLEL_TASK * tasks, uint32_t taskCount );
+static inline bool rbtree_parallel_prv_takeOwn ( RBT_PARALLEL_WORKER * worker, uint32_t * task );
+static inline bool rbtree_parallel_prv_steal ( RBT_PARALLEL_WORKER * worker, uint32_t * task );
+static inline void rbtree_parallel_prv_runTask ( RBT_PARALLEL_JOB * job, uint32_t task );
+static RBT_THREAD_RETURN rbtree_parallel_prv_worker ( void * arg );
+
+
+static inline uint32_t rbtree_parallel_prv_splitDepth ( uint32_t threadCount )
+{
+    uint32_t target = threadCount * RBT_PARALLEL_TASKS_PER_THREAD;
+    uint32_t depth = 0U;
+
+    /* a single worker walks the tree as one task */
+    while ( ( threadCount > 1U ) && ( target > 1U ) )
+    {
+        depth++;
+        target >>= 1;
+    }
+
+    return depth;
+}
+
+static inline uint32_t rbtree_parallel_prv_split ( RBT_NODE * node, uint32_t depth, RBT_PARALLEL_TASK * tasks, uint32_t taskCount )
+{
+    if ( node == NULL )
+    {
+        /* nothing to add */
+    }
+    else if ( depth == 0U )
+    {
+        if ( tasks )
+        {
+            tasks[taskCount].node = node;
+            tasks[taskCount].isSubtree = true;
+        }
+
+        taskCount++;
+    }
+    else
+    {
+        taskCount = rbtree_parallel_prv_split(node->left, depth-1U, tasks, taskCount);
+
+        if ( tasks )
+        {
+            tasks[taskCount].node = node;
+            tasks[taskCount].isSubtree = false;
+        }
+
+        taskCount++;
+
+        taskCount = rbtree_parallel_prv_split(node->right, depth-1U, tasks, taskCount);
+    }
+
+    return taskCount;
+}
+
+static inline bool rbtree_parallel_prv_takeOwn ( RBT_PARALLEL_WORKER * worker, uint32_t * task )
+{
+    bool isTaken = false;
+
+    RBT_LOCK_MUTEX(worker->mutex);
+
+    if ( worker->lo < worker->hi )
+    {
+        *task = worker->lo;
+        worker->lo++;
+        isTaken = true;
+    }
+
+    RBT_UNLOCK_MUTEX(worker->mutex);
+
+    return isTaken;
+}
+
+static inline bool rbtree_parallel_prv_steal ( RBT_PARALLEL_WORKER * worker, uint32_t * task )
+{
+    RBT_PARALLEL_JOB * job = worker->job;
+    bool isTaken = false;
+    uint32_t i = 0U;
+
+    /* no tasks are ever added, so one empty sweep means the job is drained */
+    for ( i=1U; ( i<job->workerCount ) && ( isTaken == false ); i++ )
+    {
+        RBT_PARALLEL_WORKER * victim = &job->workers[( worker->index + i ) % job->workerCount];
+
+        RBT_LOCK_MUTEX(victim->mutex);
+
+        if ( victim->lo < victim->hi )
+        {
+            victim->hi--;
+            *task = victim->hi;
+            isTaken = true;
+        }
+
+        RBT_UNLOCK_MUTEX(victim->mutex);
+    }
+
+    return isTaken;
+}
+
+static inline void rbtree_parallel_prv_runTask ( RBT_PARALLEL_JOB * job, uint32_t task )
+{
+    RBT_PARALLEL_TASK * cur_task = &job->tasks[task];
+
+    if ( cur_task->isSubtree )
+    {
+        RBT_PERSIST_ITER iter;
+        RBT_NODE * node = rbtree_persist_iterFirst(&iter, cur_task->node);
+
+        /* the iterator only follows child links, so it ends at the bottom of this subtree */
+        while ( ( node != NULL ) && ( job->visit_fn(job->context, task, node) ) )
+        {
+            node = rbtree_persist_iterNext(&iter);
+        }
+    }
+    else
+    {
+        job->visit_fn(job->context, task, cur_task->node);
+    }
+}
+
+static RBT_THREAD_RETURN rbtree_parallel_prv_worker ( void * arg )
+{
+    RBT_PARALLEL_WORKER * worker = (RBT_PARALLEL_WORKER *)arg;
+    uint32_t task = 0U;
+
+    while ( ( rbtree_parallel_prv_takeOwn(worker, &task) ) || ( rbtree_parallel_prv_steal(worker, &task) ) )
+    {
+        rbtree_parallel_prv_runTask(worker->job, task);
+    }
+
+    return RBT_THREAD_RETURN_VALUE;
+}
+
+
+uint32_t rbtree_parallel_taskCount ( RBT_NODE * root, uint32_t threadCount )
+{
+    return rbtree_parallel_prv_split(root, rbtree_parallel_prv_splitDepth(threadCount), NULL, 0U);
+}
+
+
+RBTREE_STATUS rbtree_parallel_run ( RBT_NODE * root, uint32_t threadCount, rbt_parallel_visit_t visit_fn, void * context, RBT_TREE * tree )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    RBT_PARALLEL_JOB job;
+    uint32_t i = 0U;
+
+    job.taskCount = rbtree_parallel_taskCount(root, threadCount);
+    job.workerCount = ( threadCount < job.taskCount ) ? threadCount : job.taskCount;
+    job.visit_fn = visit_fn;
+    job.context = context;
+    job.tasks = NULL;
+    job.workers = NULL;
+
+    if ( job.taskCount == 0U )
+    {
+        /* empty tree */
+        status = RBTREE_STATUS_OK;
+    }
+    else if ( ( job.tasks = tree->mem_alloc(sizeof(RBT_PARALLEL_TASK) * job.taskCount) ) == NULL )
+    {
+        RBTPRINT_DBG_E("Malloc failure");
+        status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+    }
+    else if ( ( job.workers = tree->mem_alloc(sizeof(RBT_PARALLEL_WORKER) * job.workerCount) ) == NULL )
+    {
+        RBTPRINT_DBG_E("Malloc failure");
+        status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+    }
+    else
+    {
+        rbtree_parallel_prv_split(root, rbtree_parallel_prv_splitDepth(threadCount), job.tasks, 0U);
+
+        for ( i=0U; i<job.workerCount; i++ )
+        {
+            RBT_PARALLEL_WORKER * worker = &job.workers[i];
+
+            RBT_INIT_MUTEX(worker->mutex);
+            worker->lo = (uint32_t)( ( (uint64_t)job.taskCount * i ) / job.workerCount );
+            worker->hi = (uint32_t)( ( (uint64_t)job.taskCount * ( i + 1U ) ) / job.workerCount );
+            worker->index = i;
+            worker->isStarted = false;
+            worker->job = &job;
+        }
+
+        /* a worker that fails to start leaves its block to be stolen */
+        for ( i=1U; i<job.workerCount; i++ )
+        {
+            job.workers[i].isStarted = RBT_CREATE_THREAD(job.workers[i].thread, rbtree_parallel_prv_worker, &job.workers[i]);
+        }
+
+        rbtree_parallel_prv_worker(&job.workers[0]);
+
+        for ( i=1U; i<job.workerCount; i++ )
+        {
+            if ( job.workers[i].isStarted )
+            {
+                RBT_JOIN_THREAD(job.workers[i].thread);
+            }
+        }
+
+        /* only once every thief has stopped */
+        for ( i=0U; i<job.workerCount; i++ )
+        {
+            RBT_TERM_MUTEX(job.workers[i].mutex);
+        }
+
+        status = RBTREE_STATUS_OK;
+    }
+
+    if ( job.workers )
+    {
+        tree->mem_free(job.workers);
+    }
+
+    if ( job.tasks )
+    {
+        tree->mem_free(job.tasks);
+    }
+
+    return status;
+}
@@ -0,0 +1,53 @@
+/**
+ @file
+ Red-Black Binary Search Tree - Parallel traversal
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#ifndef __RBTREE_PARALLEL_H
+#define __RBTREE_PARALLEL_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "rbtree_common.h"
+
+
+#define RBT_PARALLEL_THREADS_MAX (64U)
+
+/* tasks created per worker, enough slack for stealing to even out subtree sizes */
+#define RBT_PARALLEL_TASKS_PER_THREAD (8U)
+
+
+/**
+ @brief called for each node of a task, in key order
+ @return false to abandon the rest of the task
+ */
+typedef bool (*rbt_parallel_visit_t)(void * context, uint32_t task, RBT_NODE * node);
+
+
+/**
+ @brief split the subtree below root into key ordered tasks & visit them on threadCount workers
+ @details tasks are numbered in key order, task n only holds keys lower than task n+1.
+ The caller is worker 0. Tree must not be modified until this returns
+ */
+RBTREE_STATUS rbtree_parallel_run ( RBT_NODE * root, uint32_t threadCount, rbt_parallel_visit_t visit_fn, void * context, RBT_TREE * tree );
+
+/* number of tasks rbtree_parallel_run will create, so callers can size per-task results */
+uint32_t rbtree_parallel_taskCount ( RBT_NODE * root, uint32_t threadCount );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* __RBTREE_PARALLEL_H */
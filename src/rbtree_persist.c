@@ -0,0 +1,618 @@
+/**
+ @file
+ Red-Black Binary Search Tree - Persistent (path-copying) tree
+
+ @details Nodes are shared between the live tree and any snapshots taken of it, so they
+ carry a reference count instead of a parent link. A writer only modifies nodes it owns
+ exclusively (refCount==1). Any shared node on the way down is copied first, so a path
+ is copied from the modified node up to the root only while a snapshot holds the old one.
+ Without snapshots every node is owned and updates happen in place.
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#include "rbtree.h"
+#include <string.h>         /* memcpy */
+#include "rbtree_common.h"
+#include "rbtree_persist.h"
+
+
+static inline bool rbtree_persist_prv_isRed ( RBT_NODE * node );
+static inline bool rbtree_persist_prv_isBlack ( RBT_NODE * node );
+static inline RBTREE_STATUS rbtree_persist_prv_reserveSpares ( RBT_TREE * tree );
+static inline RBT_NODE * rbtree_persist_prv_takeSpare ( RBT_TREE * tree );
+static inline RBT_NODE * rbtree_persist_prv_ownNode ( RBT_NODE ** link, RBT_TREE * tree );
+static inline RBT_NODE ** rbtree_persist_prv_getLink ( RBT_NODE ** path, uint32_t index, RBT_TREE * tree );
+static inline RBT_NODE ** rbtree_persist_prv_getChildLink ( RBT_NODE ** path, uint32_t depth, RBT_NODE * child, RBT_TREE * tree );
+static inline void rbtree_persist_prv_setColour ( RBT_NODE * node, RBT_COLOUR colour, RBT_TREE * tree );
+static inline void rbtree_persist_prv_rotateLeft ( RBT_NODE ** link, RBT_TREE * tree );
+static inline void rbtree_persist_prv_rotateRight ( RBT_NODE ** link, RBT_TREE * tree );
+static inline void rbtree_persist_prv_insertRBFixUp ( RBT_NODE * cur_node, RBT_NODE ** path, uint32_t depth, RBT_TREE * tree );
+static inline void rbtree_persist_prv_deleteRBFixUp ( RBT_NODE * cur_node, RBT_NODE ** path, uint32_t depth, RBT_TREE * tree );
+static inline RBT_NODE * rbtree_persist_prv_findKey ( RBTREE_KEY key, RBT_NODE * node );
+static inline void rbtree_persist_prv_pushLeft ( RBT_PERSIST_ITER * iter, RBT_NODE * node );
+
+
+/* shorthand form's */
+#define isRed(n) rbtree_persist_prv_isRed(n)
+#define isBlack(n) rbtree_persist_prv_isBlack(n)
+#define own(link,tree) rbtree_persist_prv_ownNode(link,tree)
+#define refCount(n) (((RBT_PNODE *)(n))->refCount)
+
+
+static inline bool rbtree_persist_prv_isRed ( RBT_NODE * node )
+{
+    return (bool) ( ( node != NULL ) && ( node->colour == RBT_COLOUR_RED ) );
+}
+
+static inline bool rbtree_persist_prv_isBlack ( RBT_NODE * node )
+{
+    return (bool) ( ! rbtree_persist_prv_isRed(node) );
+}
+
+static inline RBTREE_STATUS rbtree_persist_prv_reserveSpares ( RBT_TREE * tree )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_OK;
+    uint64_t count = (uint64_t)tree->nodeCount + 2U;
+    uint32_t bits = 0U;
+    uint32_t required = 0U;
+
+    while ( count )
+    {
+        bits++;
+        count >>= 1;
+    }
+
+    /* height<=2*bits. Copies: the path down, plus sibling/nephews touched by each fix-up step.
+       Holding them up front means a fix-up can never fail half way */
+    required = 4U * ( ( 2U * bits ) + 2U );
+
+    while ( tree->spareCount < required )
+    {
+        RBT_NODE * node = tree->mem_alloc(tree->nodeSize);
+
+        RBT_STATS_ADD(tree->stats.allocs, 1U);
+
+        if ( node == NULL )
+        {
+            RBTPRINT_DBG_E("Malloc failure");
+            status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+            break;
+        }
+
+        node->left = tree->spareNodes;
+        tree->spareNodes = node;
+        tree->spareCount++;
+    }
+
+    return status;
+}
+
+static inline RBT_NODE * rbtree_persist_prv_takeSpare ( RBT_TREE * tree )
+{
+    RBT_NODE * node = tree->spareNodes;
+
+    RBTPRINT_ASSERT(node!=NULL);
+    tree->spareNodes = node->left;
+    tree->spareCount--;
+
+    return node;
+}
+
+static inline RBT_NODE * rbtree_persist_prv_ownNode ( RBT_NODE ** link, RBT_TREE * tree )
+{
+    RBT_NODE * node = *link;
+
+    /* the holder of link is already owned, so the count here is exact */
+    if ( ( node != NULL ) && ( RBT_ATOMIC_LOAD_ACQUIRE(refCount(node)) != 1U ) )
+    {
+        RBT_NODE * copy = rbtree_persist_prv_takeSpare(tree);
+
+        /* the count is left out, other holders may be releasing node concurrently */
+        memcpy(copy, node, sizeof(RBT_NODE));
+        RBT_ATOMIC_INIT(refCount(copy), 1U);
+
+        rbtree_persist_retainNode(copy->left);
+        rbtree_persist_retainNode(copy->right);
+
+        /* may be the last reference if a snapshot was released meanwhile */
+        rbtree_persist_releaseNode(node, tree);
+
+        *link = copy;
+        node = copy;
+    }
+
+    return node;
+}
+
+static inline RBT_NODE ** rbtree_persist_prv_getLink ( RBT_NODE ** path, uint32_t index, RBT_TREE * tree )
+{
+    RBT_NODE ** link = &tree->rootNode;
+
+    if ( index > 0U )
+    {
+        RBT_NODE * parent = path[index-1U];
+
+        link = ( parent->left == path[index] ) ? &parent->left : &parent->right;
+    }
+
+    return link;
+}
+
+static inline RBT_NODE ** rbtree_persist_prv_getChildLink ( RBT_NODE ** path, uint32_t depth, RBT_NODE * child, RBT_TREE * tree )
+{
+    RBT_NODE ** link = &tree->rootNode;
+
+    if ( depth > 0U )
+    {
+        RBT_NODE * parent = path[depth-1U];
+
+        link = ( parent->left == child ) ? &parent->left : &parent->right;
+    }
+
+    return link;
+}
+
+static inline void rbtree_persist_prv_setColour ( RBT_NODE * node, RBT_COLOUR colour, RBT_TREE * tree )
+{
+    if ( node->colour != colour )
+    {
+        node->colour = colour;
+        RBT_STATS_ADD_LOCKED(tree->stats.recolours, 1U);
+    }
+}
+
+static inline void rbtree_persist_prv_rotateLeft ( RBT_NODE ** link, RBT_TREE * tree )
+{
+    RBT_NODE * p = *link;
+    RBT_NODE * q = p->right;
+
+    /* p & q are owned. q->left changes holder, so its count is unchanged */
+    p->right = q->left;
+    q->left = p;
+    *link = q;
+
+    RBT_STATS_ADD_LOCKED(tree->stats.rotations, 1U);
+}
+
+static inline void rbtree_persist_prv_rotateRight ( RBT_NODE ** link, RBT_TREE * tree )
+{
+    RBT_NODE * p = *link;
+    RBT_NODE * q = p->left;
+
+    p->left = q->right;
+    q->right = p;
+    *link = q;
+
+    RBT_STATS_ADD_LOCKED(tree->stats.rotations, 1U);
+}
+
+static inline void rbtree_persist_prv_insertRBFixUp ( RBT_NODE * cur_node, RBT_NODE ** path, uint32_t depth, RBT_TREE * tree )
+{
+    /* path[0..depth-1] are cur_node's ancestors, all owned */
+    while ( ( depth >= 2U ) && ( isRed(path[depth-1U]) ) )
+    {
+        RBT_NODE * parent = path[depth-1U];
+        RBT_NODE * grand_parent = path[depth-2U];
+
+        RBT_STATS_ADD_LOCKED(tree->stats.fixUps, 1U);
+
+        if ( parent == grand_parent->left )
+        {
+            if ( isRed(grand_parent->right) )
+            {
+                RBT_NODE * uncle = own(&grand_parent->right, tree);
+
+                rbtree_persist_prv_setColour(parent, RBT_COLOUR_BLACK, tree);
+                rbtree_persist_prv_setColour(uncle, RBT_COLOUR_BLACK, tree);
+                rbtree_persist_prv_setColour(grand_parent, RBT_COLOUR_RED, tree);
+
+                cur_node = grand_parent;
+                depth -= 2U;
+            }
+            else
+            {
+                if ( cur_node == parent->right )
+                {
+                    rbtree_persist_prv_rotateLeft(&grand_parent->left, tree);
+                    /* cur_node took parent's place */
+                    parent = cur_node;
+                }
+
+                rbtree_persist_prv_setColour(parent, RBT_COLOUR_BLACK, tree);
+                rbtree_persist_prv_setColour(grand_parent, RBT_COLOUR_RED, tree);
+
+                rbtree_persist_prv_rotateRight(rbtree_persist_prv_getLink(path, depth-2U, tree), tree);
+
+                /* adjustments finished */
+                break;
+            }
+        }
+        /* symmetric to above branch */
+        else
+        {
+            if ( isRed(grand_parent->left) )
+            {
+                RBT_NODE * uncle = own(&grand_parent->left, tree);
+
+                rbtree_persist_prv_setColour(parent, RBT_COLOUR_BLACK, tree);
+                rbtree_persist_prv_setColour(uncle, RBT_COLOUR_BLACK, tree);
+                rbtree_persist_prv_setColour(grand_parent, RBT_COLOUR_RED, tree);
+
+                cur_node = grand_parent;
+                depth -= 2U;
+            }
+            else
+            {
+                if ( cur_node == parent->left )
+                {
+                    rbtree_persist_prv_rotateRight(&grand_parent->right, tree);
+                    parent = cur_node;
+                }
+
+                rbtree_persist_prv_setColour(parent, RBT_COLOUR_BLACK, tree);
+                rbtree_persist_prv_setColour(grand_parent, RBT_COLOUR_RED, tree);
+
+                rbtree_persist_prv_rotateLeft(rbtree_persist_prv_getLink(path, depth-2U, tree), tree);
+
+                /* adjustments finished */
+                break;
+            }
+        }
+    }
+
+    /* root is always owned after the descent */
+    rbtree_persist_prv_setColour(tree->rootNode, RBT_COLOUR_BLACK, tree);
+}
+
+static inline void rbtree_persist_prv_deleteRBFixUp ( RBT_NODE * cur_node, RBT_NODE ** path, uint32_t depth, RBT_TREE * tree )
+{
+    /* cur_node may be NULL (a black leaf) or shared. path[0..depth-1] are its ancestors, all owned */
+    while ( ( depth > 0U ) && ( isBlack(cur_node) ) )
+    {
+        RBT_NODE * parent = path[depth-1U];
+
+        RBT_STATS_ADD_LOCKED(tree->stats.fixUps, 1U);
+
+        if ( cur_node == parent->left )
+        {
+            RBT_NODE * sibling = own(&parent->right, tree);
+
+            if ( isRed(sibling) )
+            {
+                rbtree_persist_prv_setColour(sibling, RBT_COLOUR_BLACK, tree);
+                rbtree_persist_prv_setColour(parent, RBT_COLOUR_RED, tree);
+
+                rbtree_persist_prv_rotateLeft(rbtree_persist_prv_getLink(path, depth-1U, tree), tree);
+
+                /* sibling is now above parent */
+                path[depth-1U] = sibling;
+                path[depth] = parent;
+                depth++;
+
+                sibling = own(&parent->right, tree);
+            }
+
+            if ( ( isBlack(sibling->left) ) &&
+                 ( isBlack(sibling->right) ) )
+            {
+                rbtree_persist_prv_setColour(sibling, RBT_COLOUR_RED, tree);
+
+                cur_node = parent;
+                depth--;
+            }
+            else
+            {
+                if ( isBlack(sibling->right) )
+                {
+                    rbtree_persist_prv_setColour(own(&sibling->left, tree), RBT_COLOUR_BLACK, tree);
+                    rbtree_persist_prv_setColour(sibling, RBT_COLOUR_RED, tree);
+
+                    rbtree_persist_prv_rotateRight(&parent->right, tree);
+
+                    sibling = parent->right;
+                }
+
+                rbtree_persist_prv_setColour(sibling, parent->colour, tree);
+                rbtree_persist_prv_setColour(parent, RBT_COLOUR_BLACK, tree);
+                rbtree_persist_prv_setColour(own(&sibling->right, tree), RBT_COLOUR_BLACK, tree);
+
+                rbtree_persist_prv_rotateLeft(rbtree_persist_prv_getLink(path, depth-1U, tree), tree);
+
+                /* adjustments finished */
+                cur_node = tree->rootNode;
+                depth = 0U;
+            }
+        }
+        /* same as previous branch */
+        else
+        {
+            RBT_NODE * sibling = own(&parent->left, tree);
+
+            if ( isRed(sibling) )
+            {
+                rbtree_persist_prv_setColour(sibling, RBT_COLOUR_BLACK, tree);
+                rbtree_persist_prv_setColour(parent, RBT_COLOUR_RED, tree);
+
+                rbtree_persist_prv_rotateRight(rbtree_persist_prv_getLink(path, depth-1U, tree), tree);
+
+                path[depth-1U] = sibling;
+                path[depth] = parent;
+                depth++;
+
+                sibling = own(&parent->left, tree);
+            }
+
+            if ( ( isBlack(sibling->right) ) &&
+                 ( isBlack(sibling->left) ) )
+            {
+                rbtree_persist_prv_setColour(sibling, RBT_COLOUR_RED, tree);
+
+                cur_node = parent;
+                depth--;
+            }
+            else
+            {
+                if ( isBlack(sibling->left) )
+                {
+                    rbtree_persist_prv_setColour(own(&sibling->right, tree), RBT_COLOUR_BLACK, tree);
+                    rbtree_persist_prv_setColour(sibling, RBT_COLOUR_RED, tree);
+
+                    rbtree_persist_prv_rotateLeft(&parent->left, tree);
+
+                    sibling = parent->left;
+                }
+
+                rbtree_persist_prv_setColour(sibling, parent->colour, tree);
+                rbtree_persist_prv_setColour(parent, RBT_COLOUR_BLACK, tree);
+                rbtree_persist_prv_setColour(own(&sibling->left, tree), RBT_COLOUR_BLACK, tree);
+
+                rbtree_persist_prv_rotateRight(rbtree_persist_prv_getLink(path, depth-1U, tree), tree);
+
+                /* adjustments complete */
+                cur_node = tree->rootNode;
+                depth = 0U;
+            }
+        }
+    }
+
+    if ( cur_node != NULL )
+    {
+        rbtree_persist_prv_setColour(own(rbtree_persist_prv_getChildLink(path, depth, cur_node, tree), tree), RBT_COLOUR_BLACK, tree);
+    }
+}
+
+static inline RBT_NODE * rbtree_persist_prv_findKey ( RBTREE_KEY key, RBT_NODE * node )
+{
+    while ( node )
+    {
+        if ( key < node->key )
+        {
+            node = node->left;
+        }
+        else if ( key > node->key )
+        {
+            node = node->right;
+        }
+        else
+        {
+            /* match */
+            break;
+        }
+    }
+
+    return node;
+}
+
+static inline void rbtree_persist_prv_pushLeft ( RBT_PERSIST_ITER * iter, RBT_NODE * node )
+{
+    while ( node )
+    {
+        RBTPRINT_ASSERT(iter->depth<RBT_TREE_DEPTH_MAX);
+        iter->stack[iter->depth++] = node;
+        node = node->left;
+    }
+}
+
+
+void rbtree_persist_retainNode ( RBT_NODE * node )
+{
+    if ( node )
+    {
+        RBT_ATOMIC_FETCH_ADD(refCount(node), 1U);
+    }
+}
+
+void rbtree_persist_releaseNode ( RBT_NODE * node, RBT_TREE * tree )
+{
+    /* recurse left, loop right. Depth is bounded by the tree height */
+    while ( ( node != NULL ) && ( RBT_ATOMIC_FETCH_SUB_ACQREL(refCount(node), 1U) == 1U ) )
+    {
+        RBT_NODE * right = node->right;
+
+        rbtree_persist_releaseNode(node->left, tree);
+        tree->mem_free(node);
+
+        node = right;
+    }
+}
+
+RBTREE_STATUS rbtree_persist_insertNode ( RBT_NODE * ins_node, RBT_TREE * tree )
+{
+    RBT_NODE * path[RBT_TREE_DEPTH_MAX];
+    uint32_t depth = 0U;
+    RBT_NODE ** link = &tree->rootNode;
+    RBTREE_STATUS status = rbtree_persist_prv_reserveSpares(tree);
+
+    if ( status != RBTREE_STATUS_OK )
+    {
+        return status;
+    }
+
+    if ( rbtree_persist_prv_findKey(ins_node->key, tree->rootNode) != NULL )
+    {
+        return RBTREE_STATUS_FAIL_KEY_ALREADY_STORED;
+    }
+
+    /* copy the search path so every node we may modify is owned */
+    while ( *link != NULL )
+    {
+        RBT_NODE * node = own(link, tree);
+
+        path[depth++] = node;
+
+        if ( ins_node->key < node->key )
+        {
+            link = &node->left;
+        }
+        else
+        {
+            link = &node->right;
+        }
+    }
+
+    ins_node->left = NULL;
+    ins_node->right = NULL;
+    ins_node->parent = NULL;
+    ins_node->colour = RBT_COLOUR_RED;
+    *link = ins_node;
+
+    rbtree_persist_prv_insertRBFixUp(ins_node, path, depth, tree);
+
+    return RBTREE_STATUS_OK;
+}
+
+RBTREE_STATUS rbtree_persist_deleteKey ( RBTREE_KEY key, RBT_TREE * tree )
+{
+    RBT_NODE * path[RBT_TREE_DEPTH_MAX];
+    uint32_t depth = 0U;
+    RBT_NODE ** link = &tree->rootNode;
+    RBT_NODE * target = NULL;
+    RBT_NODE * child = NULL;
+    RBT_COLOUR removed_colour = RBT_COLOUR_UNDEF;
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+
+    /* don't copy anything for a miss */
+    if ( rbtree_persist_prv_findKey(key, tree->rootNode) == NULL )
+    {
+        return RBTREE_STATUS_FAIL_KEY_DOES_NOT_EXIST;
+    }
+
+    status = rbtree_persist_prv_reserveSpares(tree);
+
+    if ( status != RBTREE_STATUS_OK )
+    {
+        return status;
+    }
+
+    while ( target == NULL )
+    {
+        RBT_NODE * node = own(link, tree);
+
+        if ( key < node->key )
+        {
+            path[depth++] = node;
+            link = &node->left;
+        }
+        else if ( key > node->key )
+        {
+            path[depth++] = node;
+            link = &node->right;
+        }
+        else
+        {
+            target = node;
+        }
+    }
+
+    /* both children: take the successor's entry & unlink the successor instead */
+    if ( ( target->left != NULL ) && ( target->right != NULL ) )
+    {
+        RBT_NODE * successor = NULL;
+
+        path[depth++] = target;
+        link = &target->right;
+        successor = own(link, tree);
+
+        while ( successor->left )
+        {
+            path[depth++] = successor;
+            link = &successor->left;
+            successor = own(link, tree);
+        }
+
+        target->key = successor->key;
+        target->value = successor->value;
+
+        target = successor;
+    }
+
+    /* target has at most one child, which moves up to its link */
+    child = ( target->left != NULL ) ? target->left : target->right;
+    removed_colour = target->colour;
+    *link = child;
+
+    tree->mem_free(target);
+
+    /* removing a black node shortens every path through it. Restore the black height */
+    if ( removed_colour == RBT_COLOUR_BLACK )
+    {
+        rbtree_persist_prv_deleteRBFixUp(child, path, depth, tree);
+    }
+
+    return RBTREE_STATUS_OK;
+}
+
+RBT_NODE * rbtree_persist_iterFirst ( RBT_PERSIST_ITER * iter, RBT_NODE * root )
+{
+    iter->depth = 0U;
+    rbtree_persist_prv_pushLeft(iter, root);
+
+    return ( iter->depth > 0U ) ? iter->stack[iter->depth-1U] : NULL;
+}
+
+RBT_NODE * rbtree_persist_iterSeek ( RBT_PERSIST_ITER * iter, RBT_NODE * root, RBTREE_KEY key )
+{
+    RBT_NODE * node = root;
+
+    iter->depth = 0U;
+
+    /* stack holds every node >= key that we went left of. Top is the lowest */
+    while ( node )
+    {
+        if ( node->key >= key )
+        {
+            iter->stack[iter->depth++] = node;
+            node = node->left;
+        }
+        else
+        {
+            node = node->right;
+        }
+    }
+
+    return ( iter->depth > 0U ) ? iter->stack[iter->depth-1U] : NULL;
+}
+
+RBT_NODE * rbtree_persist_iterNext ( RBT_PERSIST_ITER * iter )
+{
+    RBT_NODE * node = NULL;
+
+    if ( iter->depth > 0U )
+    {
+        node = iter->stack[--iter->depth];
+        rbtree_persist_prv_pushLeft(iter, node->right);
+    }
+
+    return ( iter->depth > 0U ) ? iter->stack[iter->depth-1U] : NULL;
+}
+
+
+#undef isRed
+#undef isBlack
+#undef own
+#undef refCount
@@ -0,0 +1,51 @@
+/**
+ @file
+ Red-Black Binary Search Tree - Persistent (path-copying) tree
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#ifndef __RBTREE_PERSIST_H
+#define __RBTREE_PERSIST_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "rbtree_common.h"
+
+
+typedef struct _RBT_PERSIST_ITER
+{
+    uint32_t depth;
+    RBT_NODE * stack[RBT_TREE_DEPTH_MAX];
+} RBT_PERSIST_ITER;
+
+
+void rbtree_persist_retainNode ( RBT_NODE * node );
+
+void rbtree_persist_releaseNode ( RBT_NODE * node, RBT_TREE * tree );
+
+RBTREE_STATUS rbtree_persist_insertNode ( RBT_NODE * ins_node, RBT_TREE * tree );
+
+RBTREE_STATUS rbtree_persist_deleteKey ( RBTREE_KEY key, RBT_TREE * tree );
+
+RBT_NODE * rbtree_persist_iterFirst ( RBT_PERSIST_ITER * iter, RBT_NODE * root );
+
+RBT_NODE * rbtree_persist_iterSeek ( RBT_PERSIST_ITER * iter, RBT_NODE * root, RBTREE_KEY key );
+
+RBT_NODE * rbtree_persist_iterNext ( RBT_PERSIST_ITER * iter );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* __RBTREE_PERSIST_H */
@@ -0,0 +1,539 @@
+/**
+ @file
+ Red-Black Binary Search Tree - Binary serialization
+
+ @details Stream layout, all integers are unsigned LEB128 varints:
+ magic "RBTS", format, flags, entry count, key seed, then per entry in key order
+ the key minus the previous key (the first relative to 0) followed by the value.
+ Raw values are the pointer as a varint, encoded values are a length then that many bytes.
+ Sequential keys therefore cost one byte each.
+
+ The loader knows the entry count up front, so it builds the tree directly in key order:
+ median split, every level full except possibly the last, and that last level red.
+ That is a valid red-black tree in O(n) with no rotations or comparisons.
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "rbtree.h"
+#include <string.h>         /* memcpy, memset */
+#include <errno.h>
+#include <unistd.h>         /* read, write */
+#include "rbtree_common.h"
+#include "rbtree_persist.h"
+#include "rbtree_serial.h"
+
+
+#define RBT_SERIAL_MAGIC "RBTS"
+#define RBT_SERIAL_FORMAT (1U)
+#define RBT_SERIAL_FLAG_RAW_VALUES (1U<<0)
+
+
+typedef struct _RBT_SERIAL_LOADER
+{
+    RBT_SERIAL_STREAM stream;
+    RBT_TREE * tree;
+    rbtree_decoder_t decode_fn;
+    void * userdata;
+    uint8_t * scratch;
+    uint64_t prevKey;
+    uint32_t redDepth;
+} RBT_SERIAL_LOADER;
+
+
+static inline void rbtree_serial_prv_putVarint ( RBT_SERIAL_STREAM * stream, uint64_t value );
+static inline bool rbtree_serial_prv_refill ( RBT_SERIAL_STREAM * stream );
+static inline void rbtree_serial_prv_getBytes ( RBT_SERIAL_STREAM * stream, void * data, uint32_t length );
+static inline uint64_t rbtree_serial_prv_getVarint ( RBT_SERIAL_STREAM * stream );
+static inline RBT_NODE * rbtree_serial_prv_readNode ( RBT_SERIAL_LOADER * loader );
+static RBT_NODE * rbtree_serial_prv_build ( RBT_SERIAL_LOADER * loader, uint32_t count, uint32_t depth );
+
+
+void rbtree_serial_flush ( RBT_SERIAL_STREAM * stream )
+{
+    uint32_t written = 0U;
+
+    while ( ( stream->status == RBTREE_STATUS_OK ) && ( written < stream->length ) )
+    {
+        ssize_t res = write(stream->fd, stream->buffer + written, stream->length - written);
+
+        if ( res > 0 )
+        {
+            written += (uint32_t)res;
+        }
+        else if ( ( res < 0 ) && ( errno == EINTR ) )
+        {
+            /* retry */
+        }
+        else
+        {
+            RBTPRINT_DBG_E("write failed: %d",errno);
+            stream->status = RBTREE_STATUS_FAIL_IO;
+        }
+    }
+
+    stream->length = 0U;
+}
+
+void rbtree_serial_write ( RBT_SERIAL_STREAM * stream, const void * data, uint32_t length )
+{
+    const uint8_t * bytes = (const uint8_t *)data;
+
+    while ( ( stream->status == RBTREE_STATUS_OK ) && ( length > 0U ) )
+    {
+        uint32_t space = RBT_SERIAL_BUFFER_SIZE - stream->length;
+        uint32_t chunk = ( length < space ) ? length : space;
+
+        memcpy(stream->buffer + stream->length, bytes, chunk);
+        stream->length += chunk;
+        bytes += chunk;
+        length -= chunk;
+
+        if ( stream->length == RBT_SERIAL_BUFFER_SIZE )
+        {
+            rbtree_serial_flush(stream);
+        }
+    }
+}
+
+static inline void rbtree_serial_prv_putVarint ( RBT_SERIAL_STREAM * stream, uint64_t value )
+{
+    /* fast path straight into the buffer, a varint is at most 10 bytes */
+    if ( RBT_SERIAL_BUFFER_SIZE - stream->length >= 10U )
+    {
+        while ( value >= 0x80U )
+        {
+            stream->buffer[stream->length++] = (uint8_t)( value | 0x80U );
+            value >>= 7;
+        }
+
+        stream->buffer[stream->length++] = (uint8_t)value;
+    }
+    else
+    {
+        uint8_t bytes[10];
+        uint32_t length = 0U;
+
+        while ( value >= 0x80U )
+        {
+            bytes[length++] = (uint8_t)( value | 0x80U );
+            value >>= 7;
+        }
+
+        bytes[length++] = (uint8_t)value;
+
+        rbtree_serial_write(stream, bytes, length);
+    }
+}
+
+static inline bool rbtree_serial_prv_refill ( RBT_SERIAL_STREAM * stream )
+{
+    stream->length = 0U;
+    stream->offset = 0U;
+
+    while ( ( stream->status == RBTREE_STATUS_OK ) && ( stream->length == 0U ) )
+    {
+        ssize_t res = read(stream->fd, stream->buffer, RBT_SERIAL_BUFFER_SIZE);
+
+        if ( res > 0 )
+        {
+            stream->length = (uint32_t)res;
+        }
+        else if ( ( res < 0 ) && ( errno == EINTR ) )
+        {
+            /* retry */
+        }
+        else if ( res == 0 )
+        {
+            RBTPRINT_DBG_E("Unexpected end of stream");
+            stream->status = RBTREE_STATUS_FAIL_CORRUPT_DATA;
+        }
+        else
+        {
+            RBTPRINT_DBG_E("read failed: %d",errno);
+            stream->status = RBTREE_STATUS_FAIL_IO;
+        }
+    }
+
+    return (bool) ( stream->status == RBTREE_STATUS_OK );
+}
+
+static inline void rbtree_serial_prv_getBytes ( RBT_SERIAL_STREAM * stream, void * data, uint32_t length )
+{
+    uint8_t * bytes = (uint8_t *)data;
+
+    while ( ( length > 0U ) && ( ( stream->offset < stream->length ) || ( rbtree_serial_prv_refill(stream) ) ) )
+    {
+        uint32_t avail = stream->length - stream->offset;
+        uint32_t chunk = ( length < avail ) ? length : avail;
+
+        memcpy(bytes, stream->buffer + stream->offset, chunk);
+        stream->offset += chunk;
+        bytes += chunk;
+        length -= chunk;
+    }
+}
+
+static inline uint64_t rbtree_serial_prv_getVarint ( RBT_SERIAL_STREAM * stream )
+{
+    uint64_t value = 0U;
+    uint32_t shift = 0U;
+    uint8_t byte = 0x80U;
+
+    while ( ( byte & 0x80U ) && ( stream->status == RBTREE_STATUS_OK ) )
+    {
+        if ( shift > 63U )
+        {
+            RBTPRINT_DBG_E("Varint too long");
+            stream->status = RBTREE_STATUS_FAIL_CORRUPT_DATA;
+        }
+        else if ( ( stream->offset < stream->length ) || ( rbtree_serial_prv_refill(stream) ) )
+        {
+            byte = stream->buffer[stream->offset++];
+            value |= (uint64_t)( byte & 0x7FU ) << shift;
+            shift += 7U;
+        }
+    }
+
+    return value;
+}
+
+static inline RBT_NODE * rbtree_serial_prv_readNode ( RBT_SERIAL_LOADER * loader )
+{
+    RBT_SERIAL_STREAM * stream = &loader->stream;
+    RBT_NODE * node = NULL;
+    uint64_t key = loader->prevKey + rbtree_serial_prv_getVarint(stream);
+    void * value = NULL;
+
+    if ( loader->decode_fn == NULL )
+    {
+        value = (void *)(uintptr_t)rbtree_serial_prv_getVarint(stream);
+    }
+    else
+    {
+        uint64_t length = rbtree_serial_prv_getVarint(stream);
+
+        if ( length > RBTREE_ENCODED_VALUE_MAX )
+        {
+            RBTPRINT_DBG_E("Value length %llu too long",(unsigned long long)length);
+            stream->status = RBTREE_STATUS_FAIL_CORRUPT_DATA;
+        }
+        else
+        {
+            rbtree_serial_prv_getBytes(stream, loader->scratch, (uint32_t)length);
+
+            if ( ( stream->status == RBTREE_STATUS_OK ) && ( ! loader->decode_fn(loader->scratch, (uint32_t)length, &value, loader->userdata) ) )
+            {
+                RBTPRINT_DBG_E("Decoder failed");
+                stream->status = RBTREE_STATUS_FAIL;
+            }
+        }
+    }
+
+    /* keys are unique & ascending, so every delta is at least 1 */
+    if ( stream->status != RBTREE_STATUS_OK )
+    {
+        /* already failed */
+    }
+    else if ( ( key <= loader->prevKey ) || ( key > RBT_TREE_KEYSEED_MAXVALUE ) )
+    {
+        RBTPRINT_DBG_E("Key out of order");
+        stream->status = RBTREE_STATUS_FAIL_CORRUPT_DATA;
+    }
+    else if ( ( node = loader->tree->mem_alloc(loader->tree->nodeSize) ) == NULL )
+    {
+        RBTPRINT_DBG_E("Malloc failure");
+        stream->status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+    }
+    else
+    {
+        memset(node, '\0', loader->tree->nodeSize);
+
+        if ( loader->tree->mode == RBT_TREE_MODE_PERSISTENT )
+        {
+            RBT_ATOMIC_INIT(((RBT_PNODE *)node)->refCount, 1U);
+        }
+
+        node->key = (RBTREE_KEY)key;
+        node->value = value;
+        loader->prevKey = key;
+    }
+
+    return node;
+}
+
+static RBT_NODE * rbtree_serial_prv_build ( RBT_SERIAL_LOADER * loader, uint32_t count, uint32_t depth )
+{
+    RBT_NODE * node = NULL;
+
+    /* on failure returns NULL with everything it allocated freed */
+    if ( ( count > 0U ) && ( loader->stream.status == RBTREE_STATUS_OK ) )
+    {
+        uint32_t leftCount = ( count - 1U ) / 2U;
+        RBT_NODE * left = rbtree_serial_prv_build(loader, leftCount, depth+1U);
+
+        if ( loader->stream.status == RBTREE_STATUS_OK )
+        {
+            node = rbtree_serial_prv_readNode(loader);
+        }
+
+        if ( node == NULL )
+        {
+            rbtree_serial_freeNodes(left, loader->tree);
+        }
+        else
+        {
+            node->colour = ( depth == loader->redDepth ) ? RBT_COLOUR_RED : RBT_COLOUR_BLACK;
+            node->left = left;
+            node->right = rbtree_serial_prv_build(loader, count - 1U - leftCount, depth+1U);
+
+            if ( loader->stream.status != RBTREE_STATUS_OK )
+            {
+                rbtree_serial_freeNodes(node, loader->tree);
+                node = NULL;
+            }
+            else if ( loader->tree->mode == RBT_TREE_MODE_STANDARD )
+            {
+                if ( node->left )
+                {
+                    node->left->parent = node;
+                }
+
+                if ( node->right )
+                {
+                    node->right->parent = node;
+                }
+            }
+        }
+    }
+
+    return node;
+}
+
+
+RBTREE_STATUS rbtree_serial_openWriter ( RBT_SERIAL_STREAM * stream, int fd, RBT_TREE * tree )
+{
+    stream->fd = fd;
+    stream->length = 0U;
+    stream->offset = 0U;
+    stream->status = RBTREE_STATUS_OK;
+    stream->buffer = tree->mem_alloc(RBT_SERIAL_BUFFER_SIZE);
+
+    if ( stream->buffer == NULL )
+    {
+        RBTPRINT_DBG_E("Malloc failure");
+        stream->status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+    }
+
+    return stream->status;
+}
+
+
+RBTREE_STATUS rbtree_serial_closeWriter ( RBT_SERIAL_STREAM * stream, RBT_TREE * tree )
+{
+    if ( stream->buffer )
+    {
+        rbtree_serial_flush(stream);
+
+        tree->mem_free(stream->buffer);
+        stream->buffer = NULL;
+    }
+
+    return stream->status;
+}
+
+
+RBTREE_STATUS rbtree_serial_saveInto ( RBT_NODE * root, uint32_t nodeCount, uint64_t keySeed, int fd, rbtree_encoder_t encode_fn, void * userdata, uint8_t * buffer, uint8_t * scratch )
+{
+    RBT_SERIAL_STREAM stream;
+    RBT_PERSIST_ITER iter;
+    RBT_NODE * node = rbtree_persist_iterFirst(&iter, root);
+    uint64_t prevKey = 0U;
+    uint8_t header[6];
+
+    stream.fd = fd;
+    stream.buffer = buffer;
+    stream.length = 0U;
+    stream.offset = 0U;
+    stream.status = RBTREE_STATUS_OK;
+
+    memcpy(header, RBT_SERIAL_MAGIC, 4U);
+    header[4] = (uint8_t)RBT_SERIAL_FORMAT;
+    header[5] = (uint8_t)( ( encode_fn == NULL ) ? RBT_SERIAL_FLAG_RAW_VALUES : 0U );
+
+    rbtree_serial_write(&stream, header, sizeof(header));
+    rbtree_serial_prv_putVarint(&stream, nodeCount);
+    rbtree_serial_prv_putVarint(&stream, keySeed);
+
+    /* the iterator only follows child links so works for either tree mode */
+    while ( ( node != NULL ) && ( stream.status == RBTREE_STATUS_OK ) )
+    {
+        rbtree_serial_prv_putVarint(&stream, (uint64_t)node->key - prevKey);
+        prevKey = node->key;
+
+        if ( encode_fn == NULL )
+        {
+            rbtree_serial_prv_putVarint(&stream, (uint64_t)(uintptr_t)node->value);
+        }
+        else
+        {
+            uint32_t length = RBTREE_ENCODED_VALUE_MAX;
+
+            if ( ( encode_fn(node->value, scratch, &length, userdata) ) && ( length <= RBTREE_ENCODED_VALUE_MAX ) )
+            {
+                rbtree_serial_prv_putVarint(&stream, length);
+                rbtree_serial_write(&stream, scratch, length);
+            }
+            else
+            {
+                RBTPRINT_DBG_E("Encoder failed");
+                stream.status = RBTREE_STATUS_FAIL;
+            }
+        }
+
+        node = rbtree_persist_iterNext(&iter);
+    }
+
+    rbtree_serial_flush(&stream);
+
+    return stream.status;
+}
+
+RBTREE_STATUS rbtree_serial_save ( RBT_NODE * root, uint32_t nodeCount, uint64_t keySeed, int fd, rbtree_encoder_t encode_fn, void * userdata, RBT_TREE * tree )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    uint8_t * buffer = tree->mem_alloc(RBT_SERIAL_BUFFER_SIZE);
+    uint8_t * scratch = ( encode_fn != NULL ) ? tree->mem_alloc(RBTREE_ENCODED_VALUE_MAX) : NULL;
+
+    if ( ( buffer == NULL ) || ( ( encode_fn != NULL ) && ( scratch == NULL ) ) )
+    {
+        RBTPRINT_DBG_E("Malloc failure");
+        status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+    }
+    else
+    {
+        status = rbtree_serial_saveInto(root, nodeCount, keySeed, fd, encode_fn, userdata, buffer, scratch);
+    }
+
+    if ( scratch )
+    {
+        tree->mem_free(scratch);
+    }
+
+    if ( buffer )
+    {
+        tree->mem_free(buffer);
+    }
+
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_serial_load ( int fd, rbtree_decoder_t decode_fn, void * userdata, RBT_TREE * tree, RBT_NODE ** root, uint32_t * nodeCount, uint64_t * keySeed )
+{
+    RBT_SERIAL_LOADER loader;
+
+    loader.stream.fd = fd;
+    loader.stream.length = 0U;
+    loader.stream.offset = 0U;
+    loader.stream.status = RBTREE_STATUS_OK;
+    loader.stream.buffer = tree->mem_alloc(RBT_SERIAL_BUFFER_SIZE);
+    loader.tree = tree;
+    loader.decode_fn = decode_fn;
+    loader.userdata = userdata;
+    loader.scratch = NULL;
+    loader.prevKey = 0U;
+    loader.redDepth = 0U;
+
+    *root = NULL;
+
+    if ( ( loader.stream.buffer == NULL ) || ( ( decode_fn != NULL ) && ( ( loader.scratch = tree->mem_alloc(RBTREE_ENCODED_VALUE_MAX) ) == NULL ) ) )
+    {
+        RBTPRINT_DBG_E("Malloc failure");
+        loader.stream.status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+    }
+    else
+    {
+        uint8_t header[6];
+        uint64_t count = 0U;
+
+        rbtree_serial_prv_getBytes(&loader.stream, header, sizeof(header));
+        count = rbtree_serial_prv_getVarint(&loader.stream);
+        *keySeed = rbtree_serial_prv_getVarint(&loader.stream);
+
+        if ( loader.stream.status != RBTREE_STATUS_OK )
+        {
+            /* already failed */
+        }
+        else if ( ( memcmp(header, RBT_SERIAL_MAGIC, 4U) != 0 ) || ( header[4] != RBT_SERIAL_FORMAT ) || ( count >= RBT_TREE_NODECOUNT_MAXVALUE ) )
+        {
+            RBTPRINT_DBG_E("Not a tree stream");
+            loader.stream.status = RBTREE_STATUS_FAIL_CORRUPT_DATA;
+        }
+        else if ( *keySeed > (uint64_t)RBT_TREE_KEYSEED_MAXVALUE + 1U )
+        {
+            RBTPRINT_DBG_E("Key seed out of range");
+            loader.stream.status = RBTREE_STATUS_FAIL_CORRUPT_DATA;
+        }
+        else if ( ( ( header[5] & RBT_SERIAL_FLAG_RAW_VALUES ) != 0U ) != ( decode_fn == NULL ) )
+        {
+            RBTPRINT_DBG_E("Decoder does not match how values were saved");
+            loader.stream.status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+        }
+        else
+        {
+            uint64_t full = count + 1U;
+            uint32_t depth = 0U;
+
+            /* levels 0..depth-1 are full. A partial last level is coloured red */
+            while ( full > 1U )
+            {
+                depth++;
+                full >>= 1;
+            }
+
+            loader.redDepth = ( ( count & ( count + 1U ) ) == 0U ) ? UINT32_MAX : depth;
+
+            *root = rbtree_serial_prv_build(&loader, (uint32_t)count, 0U);
+            *nodeCount = (uint32_t)count;
+
+            if ( loader.prevKey >= *keySeed )
+            {
+                *keySeed = loader.prevKey + 1U;
+            }
+        }
+    }
+
+    if ( loader.scratch )
+    {
+        tree->mem_free(loader.scratch);
+    }
+
+    if ( loader.stream.buffer )
+    {
+        tree->mem_free(loader.stream.buffer);
+    }
+
+    return loader.stream.status;
+}
+
+
+void rbtree_serial_freeNodes ( RBT_NODE * node, RBT_TREE * tree )
+{
+    /* recurse left, loop right */
+    while ( node != NULL )
+    {
+        RBT_NODE * right = node->right;
+
+        rbtree_serial_freeNodes(node->left, tree);
+        tree->mem_free(node);
+
+        node = right;
+    }
+}
@@ -0,0 +1,66 @@
+/**
+ @file
+ Red-Black Binary Search Tree - Binary serialization
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#ifndef __RBTREE_SERIAL_H
+#define __RBTREE_SERIAL_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "rbtree_common.h"
+
+
+/* stream buffer, large enough that each write(2) moves a useful amount */
+#define RBT_SERIAL_BUFFER_SIZE (1U<<16)
+
+
+typedef struct _RBT_SERIAL_STREAM
+{
+    int fd;
+    uint8_t * buffer;
+    uint32_t length;        /* valid bytes in buffer */
+    uint32_t offset;        /* next byte to read */
+    RBTREE_STATUS status;   /* sticky, first failure wins */
+} RBT_SERIAL_STREAM;
+
+
+/* buffered writer shared with the other file formats */
+RBTREE_STATUS rbtree_serial_openWriter ( RBT_SERIAL_STREAM * stream, int fd, RBT_TREE * tree );
+
+void rbtree_serial_write ( RBT_SERIAL_STREAM * stream, const void * data, uint32_t length );
+
+void rbtree_serial_flush ( RBT_SERIAL_STREAM * stream );
+
+/* flushes & releases the buffer. returns the first failure seen by the stream */
+RBTREE_STATUS rbtree_serial_closeWriter ( RBT_SERIAL_STREAM * stream, RBT_TREE * tree );
+
+
+RBTREE_STATUS rbtree_serial_save ( RBT_NODE * root, uint32_t nodeCount, uint64_t keySeed, int fd, rbtree_encoder_t encode_fn, void * userdata, RBT_TREE * tree );
+
+/* rbtree_serial_save without allocating. buffer holds RBT_SERIAL_BUFFER_SIZE bytes, scratch RBTREE_ENCODED_VALUE_MAX
+   (NULL without encode_fn). Only write() & encode_fn are called, so it can run in a forked child */
+RBTREE_STATUS rbtree_serial_saveInto ( RBT_NODE * root, uint32_t nodeCount, uint64_t keySeed, int fd, rbtree_encoder_t encode_fn, void * userdata, uint8_t * buffer, uint8_t * scratch );
+
+/* builds a balanced tree of tree->mode nodes. Nothing in tree other than the allocator & mode is touched */
+RBTREE_STATUS rbtree_serial_load ( int fd, rbtree_decoder_t decode_fn, void * userdata, RBT_TREE * tree, RBT_NODE ** root, uint32_t * nodeCount, uint64_t * keySeed );
+
+void rbtree_serial_freeNodes ( RBT_NODE * node, RBT_TREE * tree );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* __RBTREE_SERIAL_H */
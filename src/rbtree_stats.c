@@ -0,0 +1,94 @@
+/**
+ @file
+ Red-Black Binary Search Tree - Operation counters & tree shape
+
+ @details Counters live in the tree & are relaxed atomics. Writers hold the tree mutex for rotations,
+ recolours & fix-ups so those are bumped with a plain load & store. Lookups are lockless & may run
+ on every thread at once, so each thread counts into one of #RBT_STATS_STRIPES cache line sized
+ stripes, handed out round robin on its first lookup, & a read sums them.
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#include "rbtree.h"
+#include "rbtree_common.h"
+#include "rbtree_stats.h"
+
+
+static RBT_ATOMIC(uint32_t) rbtree_stats_nextStripe;
+static RBT_THREAD_LOCAL uint32_t rbtree_stats_threadStripe;    /* 0 until assigned, then stripe+1 */
+
+
+static uint32_t rbtree_stats_prv_height ( RBT_NODE * node );
+
+
+static uint32_t rbtree_stats_prv_height ( RBT_NODE * node )
+{
+    uint32_t height = 0U;
+
+    /* recursion depth is the height, at most 2*log2(n) */
+    if ( node )
+    {
+        uint32_t left = rbtree_stats_prv_height(node->left);
+        uint32_t right = rbtree_stats_prv_height(node->right);
+
+        height = 1U + ( ( left > right ) ? left : right );
+    }
+
+    return height;
+}
+
+
+RBT_STATS_STRIPE * rbtree_stats_stripe ( RBT_STATS * stats )
+{
+    if ( rbtree_stats_threadStripe == 0U )
+    {
+        rbtree_stats_threadStripe = ( RBT_ATOMIC_FETCH_ADD(rbtree_stats_nextStripe, 1U) % RBT_STATS_STRIPES ) + 1U;
+    }
+
+    return &stats->stripes[rbtree_stats_threadStripe - 1U];
+}
+
+void rbtree_stats_read ( RBT_STATS * stats, RBTREE_STATS * out )
+{
+    uint32_t i = 0U;
+
+    out->inserts = RBT_ATOMIC_LOAD(stats->inserts);
+    out->deletes = RBT_ATOMIC_LOAD(stats->deletes);
+    out->allocs = RBT_ATOMIC_LOAD(stats->allocs);
+    out->rotations = RBT_ATOMIC_LOAD(stats->rotations);
+    out->recolours = RBT_ATOMIC_LOAD(stats->recolours);
+    out->fixUpIterations = RBT_ATOMIC_LOAD(stats->fixUps);
+    out->lookups = 0U;
+    out->misses = 0U;
+
+    for ( i=0U; i<RBT_STATS_STRIPES; i++ )
+    {
+        out->lookups += RBT_ATOMIC_LOAD(stats->stripes[i].lookups);
+        out->misses += RBT_ATOMIC_LOAD(stats->stripes[i].misses);
+    }
+}
+
+void rbtree_stats_shape ( RBT_NODE * root, uint32_t * height, uint32_t * blackHeight )
+{
+    RBT_NODE * node = root;
+    uint32_t blacks = 0U;
+
+    /* every root to leaf path has the same number of black nodes, the leftmost will do */
+    while ( node )
+    {
+        if ( node->colour == RBT_COLOUR_BLACK )
+        {
+            blacks++;
+        }
+
+        node = node->left;
+    }
+
+    *height = rbtree_stats_prv_height(root);
+    *blackHeight = blacks;
+}
@@ -0,0 +1,39 @@
+/**
+ @file
+ Red-Black Binary Search Tree - Operation counters & tree shape
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#ifndef __RBTREE_STATS_H
+#define __RBTREE_STATS_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "rbtree_common.h"
+
+
+/* the stripe the calling thread counts its lookups in */
+RBT_STATS_STRIPE * rbtree_stats_stripe ( RBT_STATS * stats );
+
+/* sums the counters into out, the shape fields are left alone */
+void rbtree_stats_read ( RBT_STATS * stats, RBTREE_STATS * out );
+
+/* O(n) height & O(log n) black height of a pointer linked tree. The caller keeps root stable */
+void rbtree_stats_shape ( RBT_NODE * root, uint32_t * height, uint32_t * blackHeight );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* __RBTREE_STATS_H */
@@ -0,0 +1,856 @@
+/**
+ @file
+ Red-Black Binary Search Tree - Call trace record & replay
+
+ @details A traced call appends one record when it returns, under the trace mutex, so records are in
+ the order calls completed. Records are buffered & written with one write(2) per #RBT_TRACE_BUFFER_SIZE.
+
+ File layout, native endian: magic, version byte, flags byte, then the records. A record is the op
+ byte, the thread as a varint (1.. in the order threads first traced a call, process wide), the start
+ of the call less the start of the previous record as a zigzag varint, the call's duration in ns, the
+ #RBTREE_TRACE_OP arg & result as varints & the status byte.
+
+ Replay runs the records in file order against a new tree. Keys the new tree hands out are mapped from
+ the recorded ones, so calls that overlapped when recorded & reserved keys in a different order than
+ they completed still find their entries. Interleaved replay gives each recorded thread a thread of
+ its own & passes a turn between them in file order, so each call runs on the thread that made it.
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "rbtree.h"
+#include <stdlib.h>         /* realloc */
+#include <string.h>         /* memset, memcpy */
+#include <errno.h>
+#include <time.h>           /* clock_gettime */
+#include <unistd.h>         /* read, write */
+#include "rbtree_common.h"
+#include "rbtree_trace.h"
+
+
+#define RBT_TRACE_MAGIC (0x54544252U)   /* "RBTT" */
+#define RBT_TRACE_VERSION (1U)
+#define RBT_TRACE_FLAG_PERSISTENT (1U<<0)
+#define RBT_TRACE_HEADER_SIZE (6U)
+
+/* op, thread, start, duration, arg, result & status */
+#define RBT_TRACE_RECORD_MAX ( 1U + 5U + 10U + 10U + 10U + 10U + 1U )
+
+#define RBT_TRACE_READ_SIZE (1U<<20)
+
+
+typedef struct _RBT_TRACE_CALL
+{
+    RBTREE_TRACE_OP op;
+    RBTREE_STATUS status;
+    uint32_t thread;        /* recorded thread */
+    uint32_t player;        /* index of the player for thread */
+    int64_t start;          /* since the first record */
+    uint64_t duration;
+    uint64_t arg;
+    uint64_t result;
+} RBT_TRACE_CALL;
+
+/* keys from one recorded rbtree_reserveKeys */
+typedef struct _RBT_TRACE_RANGE
+{
+    uint64_t recorded;
+    uint64_t count;
+    RBTREE_KEY replayed;
+    bool isPlayed;          /* replayed is set */
+} RBT_TRACE_RANGE;
+
+struct _RBT_TRACE_REPLAY;
+
+typedef struct _RBT_TRACE_PLAYER
+{
+    struct _RBT_TRACE_REPLAY * replay;
+    uint32_t thread;        /* recorded thread */
+    RBT_COND_TYPE turn;
+    RBT_THREAD_TYPE handle;
+    bool isStarted;
+    uint64_t calls[RBTREE_TRACE_OP_LAST_VALUE];
+    uint64_t callNs[RBTREE_TRACE_OP_LAST_VALUE];
+    uint64_t mismatches;
+} RBT_TRACE_PLAYER;
+
+typedef struct _RBT_TRACE_REPLAY
+{
+    RBTREE_HANDLE handle;
+    RBT_TRACE_CALL * calls;
+    uint32_t count;
+    RBT_TRACE_PLAYER * players;
+    uint32_t playerCount;
+    RBTREE_KEY * keys;      /* open addressed pairs, recorded key then replayed key */
+    uint32_t keyMask;       /* pairs - 1 */
+    RBT_TRACE_RANGE * ranges;   /* every recorded reservation, sorted by recorded */
+    uint32_t rangeCount;
+    RBT_MUTEX_TYPE mutex;   /* guards next & isAborted */
+    uint32_t next;          /* call whose turn it is */
+    bool isAborted;         /* a player could not be started, the rest give up */
+} RBT_TRACE_REPLAY;
+
+
+static RBT_ATOMIC(uint32_t) rbtree_trace_threads;
+static RBT_THREAD_LOCAL uint32_t rbtree_trace_thread;        /* 0 until this thread first traces */
+
+
+static inline uint32_t rbtree_trace_prv_putVarint ( uint8_t * buffer, uint64_t value );
+static inline bool rbtree_trace_prv_getVarint ( const uint8_t ** cursor, const uint8_t * end, uint64_t * value );
+static inline RBTREE_STATUS rbtree_trace_prv_writeAll ( int fd, const uint8_t * data, uint32_t length );
+static inline void rbtree_trace_prv_flush ( RBT_TRACE * trace );
+static inline RBTREE_STATUS rbtree_trace_prv_read ( int fd, uint8_t ** data, size_t * length );
+static inline RBTREE_STATUS rbtree_trace_prv_decode ( const uint8_t * data, size_t length, RBT_TRACE_REPLAY * replay, bool * isPersistent );
+static inline void rbtree_trace_prv_mapKey ( RBT_TRACE_REPLAY * replay, RBTREE_KEY recorded, RBTREE_KEY replayed );
+static int rbtree_trace_prv_compareRanges ( const void * a, const void * b );
+static inline RBT_TRACE_RANGE * rbtree_trace_prv_findRange ( RBT_TRACE_REPLAY * replay, uint64_t recorded );
+static inline RBTREE_KEY rbtree_trace_prv_translate ( RBT_TRACE_REPLAY * replay, uint64_t recorded );
+static inline void rbtree_trace_prv_play ( RBT_TRACE_PLAYER * player, const RBT_TRACE_CALL * call );
+static RBT_THREAD_RETURN rbtree_trace_prv_player ( void * arg );
+static inline RBTREE_STATUS rbtree_trace_prv_assignPlayers ( RBT_TRACE_REPLAY * replay );
+
+
+static inline uint32_t rbtree_trace_prv_putVarint ( uint8_t * buffer, uint64_t value )
+{
+    uint32_t length = 0U;
+
+    while ( value >= 0x80U )
+    {
+        buffer[length++] = (uint8_t)( value | 0x80U );
+        value >>= 7;
+    }
+
+    buffer[length++] = (uint8_t)value;
+
+    return length;
+}
+
+static inline bool rbtree_trace_prv_getVarint ( const uint8_t ** cursor, const uint8_t * end, uint64_t * value )
+{
+    const uint8_t * pos = *cursor;
+    uint32_t shift = 0U;
+    bool isDone = false;
+
+    *value = 0U;
+
+    while ( ( isDone == false ) && ( pos < end ) && ( shift <= 63U ) )
+    {
+        *value |= (uint64_t)( *pos & 0x7FU ) << shift;
+        isDone = (bool) ( ( *pos & 0x80U ) == 0U );
+        shift += 7U;
+        pos++;
+    }
+
+    *cursor = pos;
+
+    return isDone;
+}
+
+static inline RBTREE_STATUS rbtree_trace_prv_writeAll ( int fd, const uint8_t * data, uint32_t length )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_OK;
+
+    while ( ( status == RBTREE_STATUS_OK ) && ( length > 0U ) )
+    {
+        ssize_t res = write(fd, data, length);
+
+        if ( res > 0 )
+        {
+            data += res;
+            length -= (uint32_t)res;
+        }
+        else if ( ( res < 0 ) && ( errno == EINTR ) )
+        {
+            /* retry */
+        }
+        else
+        {
+            RBTPRINT_DBG_E("write failed: %d",errno);
+            status = RBTREE_STATUS_FAIL_IO;
+        }
+    }
+
+    return status;
+}
+
+/* caller holds the trace mutex */
+static inline void rbtree_trace_prv_flush ( RBT_TRACE * trace )
+{
+    if ( ( trace->length > 0U ) && ( trace->status == RBTREE_STATUS_OK ) )
+    {
+        trace->status = rbtree_trace_prv_writeAll(trace->fd, trace->buffer, trace->length);
+    }
+
+    trace->length = 0U;
+}
+
+static inline RBTREE_STATUS rbtree_trace_prv_read ( int fd, uint8_t ** data, size_t * length )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_OK;
+    size_t capacity = 0U;
+    bool isEof = false;
+
+    *data = NULL;
+    *length = 0U;
+
+    while ( ( status == RBTREE_STATUS_OK ) && ( isEof == false ) )
+    {
+        ssize_t res = 0;
+
+        if ( *length == capacity )
+        {
+            uint8_t * grown = realloc(*data, capacity + RBT_TRACE_READ_SIZE);
+
+            if ( grown )
+            {
+                *data = grown;
+                capacity += RBT_TRACE_READ_SIZE;
+            }
+            else
+            {
+                RBTPRINT_DBG_E("Malloc failure");
+                status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+                break;
+            }
+        }
+
+        res = read(fd, *data + *length, capacity - *length);
+
+        if ( res > 0 )
+        {
+            *length += (size_t)res;
+        }
+        else if ( res == 0 )
+        {
+            isEof = true;
+        }
+        else if ( errno != EINTR )
+        {
+            RBTPRINT_DBG_E("read failed: %d",errno);
+            status = RBTREE_STATUS_FAIL_IO;
+        }
+    }
+
+    return status;
+}
+
+static inline RBTREE_STATUS rbtree_trace_prv_decode ( const uint8_t * data, size_t length, RBT_TRACE_REPLAY * replay, bool * isPersistent )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_OK;
+    const uint8_t * cursor = data + RBT_TRACE_HEADER_SIZE;
+    const uint8_t * end = data + length;
+    uint32_t magic = 0U;
+    int64_t start = 0;
+    uint32_t capacity = 0U;
+
+    if ( length >= RBT_TRACE_HEADER_SIZE )
+    {
+        memcpy(&magic, data, sizeof(magic));
+    }
+
+    /* magic only matches once the whole header is there */
+    if ( ( magic != RBT_TRACE_MAGIC ) || ( data[4] != RBT_TRACE_VERSION ) )
+    {
+        RBTPRINT_DBG_E("Not a trace");
+        status = RBTREE_STATUS_FAIL_CORRUPT_DATA;
+    }
+    else
+    {
+        *isPersistent = (bool) ( ( data[5] & RBT_TRACE_FLAG_PERSISTENT ) != 0U );
+    }
+
+    /* a record that runs off the end is what stopping mid-write leaves, replay up to it */
+    while ( ( status == RBTREE_STATUS_OK ) && ( cursor < end ) )
+    {
+        RBT_TRACE_CALL call;
+        uint64_t values[5] = { 0U, 0U, 0U, 0U, 0U };  /* thread, start delta, duration, arg, result */
+        bool isWhole = true;
+        uint32_t i = 0U;
+
+        call.op = (RBTREE_TRACE_OP)*cursor++;
+
+        for ( i=0U; ( i<5U ) && ( isWhole ); i++ )
+        {
+            isWhole = rbtree_trace_prv_getVarint(&cursor, end, &values[i]);
+        }
+
+        if ( ( isWhole == false ) || ( cursor >= end ) )
+        {
+            break;
+        }
+
+        call.status = (RBTREE_STATUS)*cursor++;
+
+        if ( ( call.op <= RBTREE_TRACE_OP_UNDEF ) || ( call.op >= RBTREE_TRACE_OP_LAST_VALUE ) || ( values[0] == 0U ) )
+        {
+            RBTPRINT_DBG_E("Bad record");
+            status = RBTREE_STATUS_FAIL_CORRUPT_DATA;
+        }
+        else
+        {
+            if ( replay->count == capacity )
+            {
+                uint32_t grownCapacity = ( capacity ) ? capacity * 2U : 1024U;
+                RBT_TRACE_CALL * grown = realloc(replay->calls, grownCapacity * sizeof(RBT_TRACE_CALL));
+
+                if ( grown == NULL )
+                {
+                    RBTPRINT_DBG_E("Malloc failure");
+                    status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+                    break;
+                }
+
+                replay->calls = grown;
+                capacity = grownCapacity;
+            }
+
+            /* zigzag: low bit is the sign */
+            start += (int64_t)( values[1] >> 1 ) ^ -(int64_t)( values[1] & 1U );
+
+            call.thread = (uint32_t)values[0];
+            call.player = 0U;
+            call.start = start;
+            call.duration = values[2];
+            call.arg = values[3];
+            call.result = values[4];
+
+            replay->calls[replay->count++] = call;
+        }
+    }
+
+    return status;
+}
+
+/* caller has the turn, so no other player is using the table */
+static inline void rbtree_trace_prv_mapKey ( RBT_TRACE_REPLAY * replay, RBTREE_KEY recorded, RBTREE_KEY replayed )
+{
+    uint32_t slot = ( recorded * 0x9E3779B1U ) & replay->keyMask;
+
+    while ( ( replay->keys[slot * 2U] != RBTREE_KEY_INVALID ) && ( replay->keys[slot * 2U] != recorded ) )
+    {
+        slot = ( slot + 1U ) & replay->keyMask;
+    }
+
+    replay->keys[slot * 2U] = recorded;
+    replay->keys[( slot * 2U ) + 1U] = replayed;
+}
+
+static int rbtree_trace_prv_compareRanges ( const void * a, const void * b )
+{
+    const RBT_TRACE_RANGE * rangeA = (const RBT_TRACE_RANGE *)a;
+    const RBT_TRACE_RANGE * rangeB = (const RBT_TRACE_RANGE *)b;
+
+    return ( rangeA->recorded > rangeB->recorded ) - ( rangeA->recorded < rangeB->recorded );
+}
+
+/* the reservation recorded falls in, NULL if none */
+static inline RBT_TRACE_RANGE * rbtree_trace_prv_findRange ( RBT_TRACE_REPLAY * replay, uint64_t recorded )
+{
+    RBT_TRACE_RANGE * range = NULL;
+    uint32_t low = 0U;
+    uint32_t high = replay->rangeCount;
+
+    /* first range starting after recorded */
+    while ( low < high )
+    {
+        uint32_t middle = low + ( ( high - low ) / 2U );
+
+        if ( replay->ranges[middle].recorded <= recorded )
+        {
+            low = middle + 1U;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    if ( ( low > 0U ) && ( recorded - replay->ranges[low - 1U].recorded < replay->ranges[low - 1U].count ) )
+    {
+        range = &replay->ranges[low - 1U];
+    }
+
+    return range;
+}
+
+/* keys the trace never saw handed out, from before it started, are passed through */
+static inline RBTREE_KEY rbtree_trace_prv_translate ( RBT_TRACE_REPLAY * replay, uint64_t recorded )
+{
+    RBTREE_KEY key = (RBTREE_KEY)recorded;
+    uint32_t slot = ( key * 0x9E3779B1U ) & replay->keyMask;
+
+    while ( ( replay->keys[slot * 2U] != RBTREE_KEY_INVALID ) && ( replay->keys[slot * 2U] != key ) )
+    {
+        slot = ( slot + 1U ) & replay->keyMask;
+    }
+
+    if ( replay->keys[slot * 2U] == key )
+    {
+        key = replay->keys[( slot * 2U ) + 1U];
+    }
+    else
+    {
+        RBT_TRACE_RANGE * range = rbtree_trace_prv_findRange(replay, recorded);
+
+        if ( ( range ) && ( range->isPlayed ) )
+        {
+            key = range->replayed + (RBTREE_KEY)( recorded - range->recorded );
+        }
+    }
+
+    return key;
+}
+
+static inline void rbtree_trace_prv_play ( RBT_TRACE_PLAYER * player, const RBT_TRACE_CALL * call )
+{
+    RBT_TRACE_REPLAY * replay = player->replay;
+    RBTREE_HANDLE handle = replay->handle;
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    void * value = (void *)(uintptr_t)call->arg;
+    uint64_t start = 0U;
+
+    /* translate before the clock starts, it is not the library's time */
+    if ( ( call->op == RBTREE_TRACE_OP_INSERT_RESERVED ) || ( call->op == RBTREE_TRACE_OP_RETRIEVE_BY_KEY ) || ( call->op == RBTREE_TRACE_OP_DELETE_BY_KEY ) )
+    {
+        key = rbtree_trace_prv_translate(replay, ( call->op == RBTREE_TRACE_OP_INSERT_RESERVED ) ? call->result : call->arg);
+    }
+
+    start = rbtree_trace_now();
+
+    switch ( call->op )
+    {
+        case RBTREE_TRACE_OP_INSERT:
+            status = rbtree_insert(handle, value, &key);
+            break;
+        case RBTREE_TRACE_OP_INSERT_RESERVED:
+            status = rbtree_insertReserved(handle, value, key);
+            break;
+        case RBTREE_TRACE_OP_RESERVE_KEYS:
+            status = rbtree_reserveKeys(handle, (uint32_t)call->arg, &key);
+            break;
+        case RBTREE_TRACE_OP_RETRIEVE_BY_KEY:
+            status = rbtree_retrieveByKey(handle, key, &value);
+            break;
+        case RBTREE_TRACE_OP_RETRIEVE_BY_INDEX:
+            status = rbtree_retrieveByIndex(handle, (uint32_t)call->arg, &value, &key);
+            break;
+        case RBTREE_TRACE_OP_DELETE_BY_KEY:
+            status = rbtree_deleteByKey(handle, key);
+            break;
+        case RBTREE_TRACE_OP_DELETE_BY_INDEX:
+            status = rbtree_deleteByIndex(handle, (uint32_t)call->arg);
+            break;
+        case RBTREE_TRACE_OP_DELETE_BY_VALUE:
+            status = rbtree_deleteByValue(handle, value);
+            break;
+        default:
+            break;
+    }
+
+    player->callNs[call->op] += rbtree_trace_now() - start;
+    player->calls[call->op]++;
+
+    if ( status != call->status )
+    {
+        player->mismatches++;
+    }
+    else if ( ( status == RBTREE_STATUS_OK ) && ( call->op == RBTREE_TRACE_OP_INSERT ) )
+    {
+        rbtree_trace_prv_mapKey(replay, (RBTREE_KEY)call->result, key);
+    }
+    else if ( ( status == RBTREE_STATUS_OK ) && ( call->op == RBTREE_TRACE_OP_RESERVE_KEYS ) )
+    {
+        RBT_TRACE_RANGE * range = rbtree_trace_prv_findRange(replay, call->result);
+
+        if ( range )
+        {
+            range->replayed = key;
+            range->isPlayed = true;
+        }
+    }
+}
+
+static RBT_THREAD_RETURN rbtree_trace_prv_player ( void * arg )
+{
+    RBT_TRACE_PLAYER * player = (RBT_TRACE_PLAYER *)arg;
+    RBT_TRACE_REPLAY * replay = player->replay;
+    uint32_t index = (uint32_t)( player - replay->players );
+    uint32_t i = 0U;
+
+    bool isAborted = false;
+
+    for ( i=0U; ( i<replay->count ) && ( isAborted == false ); i++ )
+    {
+        if ( replay->calls[i].player == index )
+        {
+            RBT_LOCK_MUTEX(replay->mutex);
+
+            while ( ( replay->next != i ) && ( replay->isAborted == false ) )
+            {
+                RBT_WAIT_COND(player->turn, replay->mutex);
+            }
+
+            isAborted = replay->isAborted;
+
+            RBT_UNLOCK_MUTEX(replay->mutex);
+
+            if ( isAborted == false )
+            {
+                rbtree_trace_prv_play(player, &replay->calls[i]);
+
+                RBT_LOCK_MUTEX(replay->mutex);
+
+                replay->next = i + 1U;
+
+                if ( replay->next < replay->count )
+                {
+                    RBT_SIGNAL_COND(replay->players[replay->calls[replay->next].player].turn);
+                }
+
+                RBT_UNLOCK_MUTEX(replay->mutex);
+            }
+        }
+    }
+
+    return RBT_THREAD_RETURN_VALUE;
+}
+
+/* a player per recorded thread, a single threaded replay only uses the first */
+static inline RBTREE_STATUS rbtree_trace_prv_assignPlayers ( RBT_TRACE_REPLAY * replay )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_OK;
+    uint32_t i = 0U;
+    uint32_t p = 0U;
+
+    replay->players = calloc(( replay->count > 0U ) ? replay->count : 1U, sizeof(RBT_TRACE_PLAYER));
+
+    if ( replay->players == NULL )
+    {
+        RBTPRINT_DBG_E("Malloc failure");
+        status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+    }
+
+    for ( i=0U; ( status == RBTREE_STATUS_OK ) && ( i<replay->count ); i++ )
+    {
+        /* a trace has a handful of threads, a linear search is fine */
+        for ( p=0U; ( p<replay->playerCount ) && ( replay->players[p].thread != replay->calls[i].thread ); p++ )
+        {
+        }
+
+        if ( p == replay->playerCount )
+        {
+            replay->players[p].replay = replay;
+            replay->players[p].thread = replay->calls[i].thread;
+            replay->playerCount++;
+        }
+
+        replay->calls[i].player = p;
+    }
+
+    if ( ( status == RBTREE_STATUS_OK ) && ( replay->playerCount == 0U ) )
+    {
+        replay->players[0].replay = replay;
+        replay->playerCount = 1U;
+    }
+
+    return status;
+}
+
+
+uint64_t rbtree_trace_now ( void )
+{
+    struct timespec now;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ( (uint64_t)now.tv_sec * 1000000000U ) + (uint64_t)now.tv_nsec;
+}
+
+
+RBT_TRACE * rbtree_trace_create ( RBT_TREE * tree )
+{
+    RBT_TRACE * trace = tree->mem_alloc(sizeof(RBT_TRACE));
+
+    if ( trace )
+    {
+        memset(trace, 0, sizeof(RBT_TRACE));
+        trace->fd = -1;
+        trace->status = RBTREE_STATUS_OK;
+        RBT_INIT_MUTEX(trace->mutex);
+    }
+
+    return trace;
+}
+
+
+void rbtree_trace_destroy ( RBT_TRACE * trace, RBT_TREE * tree )
+{
+    (void)rbtree_trace_stop(trace);
+
+    RBT_TERM_MUTEX(trace->mutex);
+
+    tree->mem_free(trace);
+}
+
+
+RBTREE_STATUS rbtree_trace_start ( RBT_TRACE * trace, int fd, bool isPersistent )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+
+    RBT_LOCK_MUTEX(trace->mutex);
+
+    if ( trace->fd >= 0 )
+    {
+        RBTPRINT_DBG_E("Already tracing");
+        status = RBTREE_STATUS_FAIL;
+    }
+    else
+    {
+        uint32_t magic = RBT_TRACE_MAGIC;
+
+        memcpy(trace->buffer, &magic, sizeof(magic));
+        trace->buffer[4] = RBT_TRACE_VERSION;
+        trace->buffer[5] = ( isPersistent ) ? RBT_TRACE_FLAG_PERSISTENT : 0U;
+
+        trace->fd = fd;
+        trace->length = RBT_TRACE_HEADER_SIZE;
+        trace->status = RBTREE_STATUS_OK;
+        trace->origin = rbtree_trace_now();
+        trace->lastStart = trace->origin;
+
+        status = RBTREE_STATUS_OK;
+    }
+
+    RBT_UNLOCK_MUTEX(trace->mutex);
+
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_trace_stop ( RBT_TRACE * trace )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_OK;
+
+    RBT_LOCK_MUTEX(trace->mutex);
+
+    if ( trace->fd >= 0 )
+    {
+        rbtree_trace_prv_flush(trace);
+        status = trace->status;
+        trace->fd = -1;
+    }
+
+    RBT_UNLOCK_MUTEX(trace->mutex);
+
+    return status;
+}
+
+
+void rbtree_trace_log ( RBT_TRACE * trace, RBTREE_TRACE_OP op, uint64_t start, uint64_t arg, uint64_t result, RBTREE_STATUS status )
+{
+    uint64_t end = rbtree_trace_now();
+
+    if ( rbtree_trace_thread == 0U )
+    {
+        rbtree_trace_thread = RBT_ATOMIC_FETCH_ADD(rbtree_trace_threads, 1U) + 1U;
+    }
+
+    RBT_LOCK_MUTEX(trace->mutex);
+
+    /* a call that loaded the trace before it stopped is dropped */
+    if ( trace->fd >= 0 )
+    {
+        int64_t delta = (int64_t)( start - trace->lastStart );
+        uint8_t * record = NULL;
+
+        if ( trace->length + RBT_TRACE_RECORD_MAX > RBT_TRACE_BUFFER_SIZE )
+        {
+            rbtree_trace_prv_flush(trace);
+        }
+
+        record = trace->buffer + trace->length;
+        *record++ = (uint8_t)op;
+        record += rbtree_trace_prv_putVarint(record, rbtree_trace_thread);
+        record += rbtree_trace_prv_putVarint(record, ( (uint64_t)delta << 1 ) ^ (uint64_t)( delta >> 63 ));
+        record += rbtree_trace_prv_putVarint(record, end - start);
+        record += rbtree_trace_prv_putVarint(record, arg);
+        record += rbtree_trace_prv_putVarint(record, result);
+        *record++ = (uint8_t)status;
+
+        trace->length = (uint32_t)( record - trace->buffer );
+        trace->lastStart = start;
+    }
+
+    RBT_UNLOCK_MUTEX(trace->mutex);
+}
+
+
+RBTREE_STATUS rbtree_trace_replay ( int fd, bool isInterleaved, RBTREE_TRACE_REPORT * report )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    RBT_TRACE_REPLAY replay;
+    uint8_t * data = NULL;
+    size_t length = 0U;
+    bool isPersistent = false;
+    uint32_t inserts = 0U;
+    uint32_t reserves = 0U;
+    uint32_t i = 0U;
+    uint32_t p = 0U;
+
+    memset(&replay, 0, sizeof(replay));
+    memset(report, 0, sizeof(RBTREE_TRACE_REPORT));
+
+    status = rbtree_trace_prv_read(fd, &data, &length);
+
+    if ( status == RBTREE_STATUS_OK )
+    {
+        status = rbtree_trace_prv_decode(data, length, &replay, &isPersistent);
+    }
+
+    free(data);
+
+    for ( i=0U; ( status == RBTREE_STATUS_OK ) && ( i<replay.count ); i++ )
+    {
+        inserts += ( replay.calls[i].op == RBTREE_TRACE_OP_INSERT ) ? 1U : 0U;
+        reserves += ( replay.calls[i].op == RBTREE_TRACE_OP_RESERVE_KEYS ) ? 1U : 0U;
+    }
+
+    if ( status == RBTREE_STATUS_OK )
+    {
+        /* at most half full */
+        replay.keyMask = 1U;
+
+        while ( replay.keyMask < inserts * 2U )
+        {
+            replay.keyMask <<= 1;
+        }
+
+        replay.keys = calloc((size_t)replay.keyMask * 2U, sizeof(RBTREE_KEY));
+        replay.keyMask--;
+        replay.ranges = calloc(( reserves > 0U ) ? reserves : 1U, sizeof(RBT_TRACE_RANGE));
+
+        status = ( ( replay.keys ) && ( replay.ranges ) ) ? rbtree_trace_prv_assignPlayers(&replay) : RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+    }
+
+    if ( status == RBTREE_STATUS_OK )
+    {
+        /* known up front & sorted so a key is looked up in O(log n), replayed keys are filled in as they are handed out */
+        for ( i=0U; i<replay.count; i++ )
+        {
+            if ( ( replay.calls[i].op == RBTREE_TRACE_OP_RESERVE_KEYS ) && ( replay.calls[i].status == RBTREE_STATUS_OK ) )
+            {
+                replay.ranges[replay.rangeCount].recorded = replay.calls[i].result;
+                replay.ranges[replay.rangeCount].count = replay.calls[i].arg;
+                replay.rangeCount++;
+            }
+        }
+
+        qsort(replay.ranges, replay.rangeCount, sizeof(RBT_TRACE_RANGE), rbtree_trace_prv_compareRanges);
+    }
+
+    if ( status == RBTREE_STATUS_OK )
+    {
+        status = ( isPersistent ) ? rbtree_createPersistentTree(&replay.handle, NULL, NULL) : rbtree_createTree(&replay.handle, NULL, NULL);
+    }
+
+    if ( status == RBTREE_STATUS_OK )
+    {
+        uint64_t start = rbtree_trace_now();
+
+        if ( isInterleaved )
+        {
+            RBT_INIT_MUTEX(replay.mutex);
+
+            for ( p=0U; p<replay.playerCount; p++ )
+            {
+                RBT_INIT_COND(replay.players[p].turn);
+            }
+
+            for ( p=0U; ( p<replay.playerCount ) && ( status == RBTREE_STATUS_OK ); p++ )
+            {
+                replay.players[p].isStarted = RBT_CREATE_THREAD(replay.players[p].handle, rbtree_trace_prv_player, &replay.players[p]);
+
+                if ( replay.players[p].isStarted == false )
+                {
+                    /* the turn would reach a thread that is not there, wake the rest to give up */
+                    RBTPRINT_DBG_E("Thread create failure");
+                    status = RBTREE_STATUS_FAIL;
+
+                    RBT_LOCK_MUTEX(replay.mutex);
+                    replay.isAborted = true;
+
+                    for ( i=0U; i<p; i++ )
+                    {
+                        RBT_SIGNAL_COND(replay.players[i].turn);
+                    }
+
+                    RBT_UNLOCK_MUTEX(replay.mutex);
+                }
+            }
+
+            for ( p=0U; p<replay.playerCount; p++ )
+            {
+                if ( replay.players[p].isStarted )
+                {
+                    RBT_JOIN_THREAD(replay.players[p].handle);
+                }
+
+                RBT_TERM_COND(replay.players[p].turn);
+            }
+
+            RBT_TERM_MUTEX(replay.mutex);
+        }
+        else
+        {
+            for ( i=0U; i<replay.count; i++ )
+            {
+                rbtree_trace_prv_play(&replay.players[0], &replay.calls[i]);
+            }
+        }
+
+        report->replayNs = rbtree_trace_now() - start;
+        (void)rbtree_destroyTree(replay.handle);
+    }
+
+    if ( status == RBTREE_STATUS_OK )
+    {
+        int64_t first = ( replay.count > 0U ) ? replay.calls[0].start : 0;
+        int64_t last = first;
+
+        for ( i=0U; i<replay.count; i++ )
+        {
+            first = ( replay.calls[i].start < first ) ? replay.calls[i].start : first;
+            last = ( replay.calls[i].start + (int64_t)replay.calls[i].duration > last ) ? replay.calls[i].start + (int64_t)replay.calls[i].duration : last;
+            report->tracedCallNs[replay.calls[i].op] += replay.calls[i].duration;
+        }
+
+        report->records = replay.count;
+        report->threads = replay.playerCount;
+        report->tracedNs = (uint64_t)( last - first );
+
+        for ( p=0U; p<replay.playerCount; p++ )
+        {
+            report->mismatches += replay.players[p].mismatches;
+
+            for ( i=0U; i<RBTREE_TRACE_OP_LAST_VALUE; i++ )
+            {
+                report->calls[i] += replay.players[p].calls[i];
+                report->replayCallNs[i] += replay.players[p].callNs[i];
+            }
+        }
+    }
+
+    free(replay.calls);
+    free(replay.players);
+    free(replay.keys);
+    free(replay.ranges);
+
+    return status;
+}
@@ -0,0 +1,63 @@
+/**
+ @file
+ Red-Black Binary Search Tree - Call trace record & replay
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#ifndef __RBTREE_TRACE_H
+#define __RBTREE_TRACE_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "rbtree_common.h"
+
+
+/* records are buffered & written when this fills or the trace stops */
+#define RBT_TRACE_BUFFER_SIZE (1U<<16)
+
+typedef struct _RBT_TRACE
+{
+    int fd;                 /* -1 while stopped */
+    uint64_t origin;        /* when tracing started, ns */
+    uint64_t lastStart;     /* start of the previous record, each record holds the difference */
+    RBT_MUTEX_TYPE mutex;   /* guards everything here */
+    RBTREE_STATUS status;   /* sticky, first write failure wins */
+    uint32_t length;
+    uint8_t buffer[RBT_TRACE_BUFFER_SIZE];
+} RBT_TRACE;
+
+
+/* CLOCK_MONOTONIC in ns */
+uint64_t rbtree_trace_now ( void );
+
+RBT_TRACE * rbtree_trace_create ( RBT_TREE * tree );
+
+void rbtree_trace_destroy ( RBT_TRACE * trace, RBT_TREE * tree );
+
+/* writes the header & starts recording to fd */
+RBTREE_STATUS rbtree_trace_start ( RBT_TRACE * trace, int fd, bool isPersistent );
+
+/* writes what is buffered & stops, later calls to rbtree_trace_log are dropped. Sticky failures are returned */
+RBTREE_STATUS rbtree_trace_stop ( RBT_TRACE * trace );
+
+/* one call that began at start (rbtree_trace_now). arg is the call's input, result what it handed back */
+void rbtree_trace_log ( RBT_TRACE * trace, RBTREE_TRACE_OP op, uint64_t start, uint64_t arg, uint64_t result, RBTREE_STATUS status );
+
+RBTREE_STATUS rbtree_trace_replay ( int fd, bool isInterleaved, RBTREE_TRACE_REPORT * report );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* __RBTREE_TRACE_H */
@@ -0,0 +1,608 @@
+/**
+ @file
+ Red-Black Binary Search Tree - Write-ahead operation log
+
+ @details Mutations append a record to an in-memory frame while they hold the tree mutex, so the
+ log order is the order the tree changed in. Committing happens after the tree mutex is released:
+ the first thread to ask becomes the leader, swaps the frame out & writes it with a single
+ write(2) (and fdatasync when the policy asks). Threads arriving meanwhile keep appending to the
+ fresh frame & wait for the next leader, so concurrent writers share a sync (group commit).
+
+ Frame layout, native endian: magic, payload length, flags, record count, checksum of the payload,
+ then the records. A record is an op byte, the key as a varint, and for inserts the value as a raw
+ varint or a varint length followed by the encoded bytes.
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "rbtree.h"
+#include <string.h>         /* memcpy, memmove */
+#include <errno.h>
+#include <unistd.h>         /* read, write, fdatasync, lseek */
+#include "rbtree_common.h"
+#include "rbtree_wal.h"
+
+
+#define RBT_WAL_MAGIC (0x4C544252U)  /* "RBTL" */
+#define RBT_WAL_FLAG_RAW_VALUES (1U<<0)
+
+/* op byte, key varint & value or length varint. Encoded bytes come on top */
+#define RBT_WAL_RECORD_OVERHEAD ( 1U + 5U + 10U )
+
+
+/* replay reads whole runs of frames per read(2), any frame fits with room to spare */
+#define RBT_WAL_READ_SIZE ( RBT_WAL_BUFFER_SIZE * 2U )
+
+
+typedef struct _RBT_WAL_FRAME
+{
+    uint32_t magic;
+    uint32_t length;        /* payload bytes following the frame header */
+    uint32_t flags;
+    uint32_t count;
+    uint64_t checksum;
+} RBT_WAL_FRAME;
+
+typedef struct _RBT_WAL_READER
+{
+    int fd;
+    uint8_t * buffer;
+    uint32_t begin;         /* first byte not yet replayed */
+    uint32_t end;           /* one past the last byte read */
+    bool isEof;
+} RBT_WAL_READER;
+
+
+static inline uint64_t rbtree_wal_prv_checksum ( const uint8_t * data, uint32_t length );
+static inline uint32_t rbtree_wal_prv_putVarint ( uint8_t * buffer, uint64_t value );
+static inline bool rbtree_wal_prv_getVarint ( const uint8_t ** cursor, const uint8_t * end, uint64_t * value );
+static inline RBTREE_STATUS rbtree_wal_prv_writeAll ( int fd, const uint8_t * data, uint32_t length );
+static inline uint32_t rbtree_wal_prv_fill ( RBT_WAL_READER * reader, uint32_t length, RBTREE_STATUS * status );
+static inline void rbtree_wal_prv_commitLocked ( RBT_WAL * wal, uint64_t target, bool isSync );
+static inline void rbtree_wal_prv_reserve ( RBT_WAL * wal, uint32_t length );
+static inline RBTREE_STATUS rbtree_wal_prv_applyFrame ( const uint8_t * data, uint32_t length, bool isEncoded, rbt_wal_apply_t apply_fn, void * context );
+
+
+static inline uint64_t rbtree_wal_prv_checksum ( const uint8_t * data, uint32_t length )
+{
+    /* FNV-1a. Only has to catch torn & stale frames, not tampering */
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    uint32_t i = 0U;
+
+    for ( i=0U; i<length; i++ )
+    {
+        hash ^= data[i];
+        hash *= 0x100000001B3ULL;
+    }
+
+    return hash;
+}
+
+static inline uint32_t rbtree_wal_prv_putVarint ( uint8_t * buffer, uint64_t value )
+{
+    uint32_t length = 0U;
+
+    while ( value >= 0x80U )
+    {
+        buffer[length++] = (uint8_t)( value | 0x80U );
+        value >>= 7;
+    }
+
+    buffer[length++] = (uint8_t)value;
+
+    return length;
+}
+
+static inline bool rbtree_wal_prv_getVarint ( const uint8_t ** cursor, const uint8_t * end, uint64_t * value )
+{
+    const uint8_t * pos = *cursor;
+    uint32_t shift = 0U;
+    bool isDone = false;
+
+    *value = 0U;
+
+    while ( ( isDone == false ) && ( pos < end ) && ( shift <= 63U ) )
+    {
+        *value |= (uint64_t)( *pos & 0x7FU ) << shift;
+        isDone = (bool) ( ( *pos & 0x80U ) == 0U );
+        shift += 7U;
+        pos++;
+    }
+
+    *cursor = pos;
+
+    return isDone;
+}
+
+static inline RBTREE_STATUS rbtree_wal_prv_writeAll ( int fd, const uint8_t * data, uint32_t length )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_OK;
+
+    while ( ( status == RBTREE_STATUS_OK ) && ( length > 0U ) )
+    {
+        ssize_t res = write(fd, data, length);
+
+        if ( res > 0 )
+        {
+            data += res;
+            length -= (uint32_t)res;
+        }
+        else if ( ( res < 0 ) && ( errno == EINTR ) )
+        {
+            /* retry */
+        }
+        else
+        {
+            RBTPRINT_DBG_E("write failed: %d",errno);
+            status = RBTREE_STATUS_FAIL_IO;
+        }
+    }
+
+    return status;
+}
+
+static inline uint32_t rbtree_wal_prv_fill ( RBT_WAL_READER * reader, uint32_t length, RBTREE_STATUS * status )
+{
+    if ( ( reader->end - reader->begin < length ) && ( reader->begin > 0U ) )
+    {
+        memmove(reader->buffer, reader->buffer + reader->begin, reader->end - reader->begin);
+        reader->end -= reader->begin;
+        reader->begin = 0U;
+    }
+
+    while ( ( *status == RBTREE_STATUS_OK ) && ( reader->isEof == false ) && ( reader->end - reader->begin < length ) )
+    {
+        ssize_t res = read(reader->fd, reader->buffer + reader->end, RBT_WAL_READ_SIZE - reader->end);
+
+        if ( res > 0 )
+        {
+            reader->end += (uint32_t)res;
+        }
+        else if ( res == 0 )
+        {
+            reader->isEof = true;
+        }
+        else if ( errno != EINTR )
+        {
+            RBTPRINT_DBG_E("read failed: %d",errno);
+            *status = RBTREE_STATUS_FAIL_IO;
+        }
+    }
+
+    return reader->end - reader->begin;
+}
+
+static inline void rbtree_wal_prv_commitLocked ( RBT_WAL * wal, uint64_t target, bool isSync )
+{
+    while ( ( wal->status == RBTREE_STATUS_OK ) && ( ( wal->written < target ) || ( ( isSync ) && ( wal->synced < target ) ) ) )
+    {
+        if ( wal->isCommitting )
+        {
+            /* the leader's frame may not hold our records, check again once it is done */
+            RBT_WAIT_COND(wal->committed, wal->mutex);
+        }
+        else
+        {
+            RBTREE_STATUS status = RBTREE_STATUS_OK;
+            RBT_WAL_FRAME * frame = (RBT_WAL_FRAME *)wal->active;
+            uint32_t length = wal->activeLength;
+            uint64_t upto = wal->appended;
+            bool isSyncing = (bool) ( ( isSync ) || ( wal->sync == RBTREE_LOG_SYNC_FSYNC ) );
+
+            /* appenders carry on into the other buffer while this one is written */
+            wal->active = wal->spare;
+            wal->spare = (uint8_t *)frame;
+            wal->activeLength = sizeof(RBT_WAL_FRAME);
+            wal->isCommitting = true;
+
+            RBT_UNLOCK_MUTEX(wal->mutex);
+
+            if ( length > sizeof(RBT_WAL_FRAME) )
+            {
+                frame->length = length - (uint32_t)sizeof(RBT_WAL_FRAME);
+                frame->checksum = rbtree_wal_prv_checksum((uint8_t *)( frame + 1 ), frame->length);
+
+                status = rbtree_wal_prv_writeAll(wal->fd, (uint8_t *)frame, length);
+            }
+
+            if ( ( status == RBTREE_STATUS_OK ) && ( isSyncing ) && ( fdatasync(wal->fd) != 0 ) )
+            {
+                RBTPRINT_DBG_E("fdatasync failed: %d",errno);
+                status = RBTREE_STATUS_FAIL_IO;
+            }
+
+            frame->count = 0U;
+
+            RBT_LOCK_MUTEX(wal->mutex);
+
+            wal->written = upto;
+
+            if ( isSyncing )
+            {
+                wal->synced = upto;
+            }
+
+            if ( wal->status == RBTREE_STATUS_OK )
+            {
+                wal->status = status;
+            }
+
+            wal->isCommitting = false;
+            RBT_BROADCAST_COND(wal->committed);
+        }
+    }
+}
+
+static inline void rbtree_wal_prv_reserve ( RBT_WAL * wal, uint32_t length )
+{
+    /* a full frame is written out from under the tree mutex, rare with the buffer this size */
+    while ( ( wal->status == RBTREE_STATUS_OK ) && ( RBT_WAL_BUFFER_SIZE - wal->activeLength < length ) )
+    {
+        rbtree_wal_prv_commitLocked(wal, wal->appended, false);
+    }
+}
+
+static inline RBTREE_STATUS rbtree_wal_prv_applyFrame ( const uint8_t * data, uint32_t length, bool isEncoded, rbt_wal_apply_t apply_fn, void * context )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_OK;
+    const uint8_t * pos = data;
+    const uint8_t * end = data + length;
+
+    while ( ( status == RBTREE_STATUS_OK ) && ( pos < end ) )
+    {
+        RBT_WAL_RECORD record;
+        uint64_t key = 0U;
+        uint64_t value = 0U;
+
+        record.op = (RBT_WAL_OP)*pos++;
+        record.bytes = NULL;
+        record.length = 0U;
+        record.rawValue = 0U;
+
+        if ( ( ! rbtree_wal_prv_getVarint(&pos, end, &key) ) || ( key == RBTREE_KEY_INVALID ) || ( key > RBT_TREE_KEYSEED_MAXVALUE ) )
+        {
+            RBTPRINT_DBG_E("Bad key in log record");
+            status = RBTREE_STATUS_FAIL_CORRUPT_DATA;
+        }
+        else if ( record.op == RBT_WAL_OP_DELETE )
+        {
+            /* no value */
+        }
+        else if ( record.op != RBT_WAL_OP_INSERT )
+        {
+            RBTPRINT_DBG_E("Unknown log op:%u",record.op);
+            status = RBTREE_STATUS_FAIL_CORRUPT_DATA;
+        }
+        else if ( ! rbtree_wal_prv_getVarint(&pos, end, &value) )
+        {
+            RBTPRINT_DBG_E("Bad value in log record");
+            status = RBTREE_STATUS_FAIL_CORRUPT_DATA;
+        }
+        else if ( isEncoded == false )
+        {
+            record.rawValue = value;
+        }
+        else if ( ( value > RBTREE_ENCODED_VALUE_MAX ) || ( value > (uint64_t)( end - pos ) ) )
+        {
+            RBTPRINT_DBG_E("Bad value length in log record");
+            status = RBTREE_STATUS_FAIL_CORRUPT_DATA;
+        }
+        else
+        {
+            record.bytes = pos;
+            record.length = (uint32_t)value;
+            pos += value;
+        }
+
+        if ( status == RBTREE_STATUS_OK )
+        {
+            record.key = (RBTREE_KEY)key;
+            status = apply_fn(context, &record);
+        }
+    }
+
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_wal_create ( int fd, RBTREE_LOG_SYNC sync, rbtree_encoder_t encode_fn, void * userdata, RBT_TREE * tree, RBT_WAL ** wal )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    RBT_WAL * new_wal = tree->mem_alloc(sizeof(RBT_WAL));
+
+    if ( new_wal == NULL )
+    {
+        RBTPRINT_DBG_E("Malloc failure");
+        status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+    }
+    else
+    {
+        memset(new_wal, 0, sizeof(RBT_WAL));
+
+        new_wal->active = tree->mem_alloc(RBT_WAL_BUFFER_SIZE);
+        new_wal->spare = tree->mem_alloc(RBT_WAL_BUFFER_SIZE);
+
+        if ( encode_fn )
+        {
+            new_wal->scratch = tree->mem_alloc(RBTREE_ENCODED_VALUE_MAX);
+        }
+
+        if ( ( new_wal->active == NULL ) || ( new_wal->spare == NULL ) || ( ( encode_fn != NULL ) && ( new_wal->scratch == NULL ) ) )
+        {
+            RBTPRINT_DBG_E("Malloc failure");
+            status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+        }
+        else
+        {
+            uint8_t * buffers[2] = { new_wal->active, new_wal->spare };
+            uint32_t i = 0U;
+
+            for ( i=0U; i<2U; i++ )
+            {
+                RBT_WAL_FRAME * frame = (RBT_WAL_FRAME *)buffers[i];
+
+                frame->magic = RBT_WAL_MAGIC;
+                frame->flags = ( encode_fn == NULL ) ? RBT_WAL_FLAG_RAW_VALUES : 0U;
+                frame->count = 0U;
+            }
+
+            new_wal->fd = fd;
+            new_wal->sync = sync;
+            new_wal->encode_fn = encode_fn;
+            new_wal->userdata = userdata;
+            new_wal->activeLength = sizeof(RBT_WAL_FRAME);
+            new_wal->status = RBTREE_STATUS_OK;
+
+            RBT_INIT_MUTEX(new_wal->mutex);
+            RBT_INIT_COND(new_wal->committed);
+
+            *wal = new_wal;
+            status = RBTREE_STATUS_OK;
+        }
+
+        if ( status != RBTREE_STATUS_OK )
+        {
+            uint8_t * buffers[3] = { new_wal->active, new_wal->spare, new_wal->scratch };
+            uint32_t i = 0U;
+
+            for ( i=0U; i<3U; i++ )
+            {
+                if ( buffers[i] )
+                {
+                    tree->mem_free(buffers[i]);
+                }
+            }
+
+            tree->mem_free(new_wal);
+        }
+    }
+
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_wal_destroy ( RBT_WAL * wal, RBT_TREE * tree )
+{
+    RBTREE_STATUS status = rbtree_wal_sync(wal);
+
+    RBT_TERM_COND(wal->committed);
+    RBT_TERM_MUTEX(wal->mutex);
+
+    tree->mem_free(wal->active);
+    tree->mem_free(wal->spare);
+
+    if ( wal->scratch )
+    {
+        tree->mem_free(wal->scratch);
+    }
+
+    tree->mem_free(wal);
+
+    return status;
+}
+
+
+void rbtree_wal_logInsert ( RBT_WAL * wal, RBTREE_KEY key, void * value )
+{
+    uint32_t length = 0U;
+
+    /* encode before taking the log mutex. The tree mutex already guards scratch */
+    if ( wal->encode_fn )
+    {
+        length = RBTREE_ENCODED_VALUE_MAX;
+
+        if ( ( ! wal->encode_fn(value, wal->scratch, &length, wal->userdata) ) || ( length > RBTREE_ENCODED_VALUE_MAX ) )
+        {
+            RBTPRINT_DBG_E("Encoder failed");
+            length = UINT32_MAX;
+        }
+    }
+
+    RBT_LOCK_MUTEX(wal->mutex);
+
+    if ( length == UINT32_MAX )
+    {
+        /* the log can no longer replay to this state */
+        if ( wal->status == RBTREE_STATUS_OK )
+        {
+            wal->status = RBTREE_STATUS_FAIL;
+        }
+    }
+    else
+    {
+        rbtree_wal_prv_reserve(wal, RBT_WAL_RECORD_OVERHEAD + length);
+    }
+
+    if ( wal->status == RBTREE_STATUS_OK )
+    {
+        uint8_t * record = wal->active + wal->activeLength;
+        uint32_t used = 0U;
+
+        record[used++] = (uint8_t)RBT_WAL_OP_INSERT;
+        used += rbtree_wal_prv_putVarint(record + used, key);
+
+        if ( wal->encode_fn )
+        {
+            used += rbtree_wal_prv_putVarint(record + used, length);
+            memcpy(record + used, wal->scratch, length);
+            used += length;
+        }
+        else
+        {
+            used += rbtree_wal_prv_putVarint(record + used, (uint64_t)(uintptr_t)value);
+        }
+
+        wal->activeLength += used;
+        ((RBT_WAL_FRAME *)wal->active)->count++;
+        wal->appended++;
+    }
+
+    RBT_UNLOCK_MUTEX(wal->mutex);
+}
+
+
+void rbtree_wal_logDelete ( RBT_WAL * wal, RBTREE_KEY key )
+{
+    RBT_LOCK_MUTEX(wal->mutex);
+
+    rbtree_wal_prv_reserve(wal, RBT_WAL_RECORD_OVERHEAD);
+
+    if ( wal->status == RBTREE_STATUS_OK )
+    {
+        uint8_t * record = wal->active + wal->activeLength;
+        uint32_t used = 0U;
+
+        record[used++] = (uint8_t)RBT_WAL_OP_DELETE;
+        used += rbtree_wal_prv_putVarint(record + used, key);
+
+        wal->activeLength += used;
+        ((RBT_WAL_FRAME *)wal->active)->count++;
+        wal->appended++;
+    }
+
+    RBT_UNLOCK_MUTEX(wal->mutex);
+}
+
+
+RBTREE_STATUS rbtree_wal_commit ( RBT_WAL * wal )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+
+    RBT_LOCK_MUTEX(wal->mutex);
+
+    /* SYNC_NONE leaves records buffered until the frame fills or the log is synced */
+    if ( wal->sync != RBTREE_LOG_SYNC_NONE )
+    {
+        rbtree_wal_prv_commitLocked(wal, wal->appended, (bool) ( wal->sync == RBTREE_LOG_SYNC_FSYNC ));
+    }
+
+    status = wal->status;
+
+    RBT_UNLOCK_MUTEX(wal->mutex);
+
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_wal_sync ( RBT_WAL * wal )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+
+    RBT_LOCK_MUTEX(wal->mutex);
+
+    rbtree_wal_prv_commitLocked(wal, wal->appended, true);
+    status = wal->status;
+
+    RBT_UNLOCK_MUTEX(wal->mutex);
+
+    return status;
+}
+
+
+RBTREE_STATUS rbtree_wal_replay ( int fd, bool isEncoded, rbt_wal_apply_t apply_fn, void * context, RBT_TREE * tree )
+{
+    RBTREE_STATUS status = RBTREE_STATUS_OK;
+    RBT_WAL_READER reader;
+    bool isEnd = false;
+
+    reader.fd = fd;
+    reader.begin = 0U;
+    reader.end = 0U;
+    reader.isEof = false;
+    reader.buffer = tree->mem_alloc(RBT_WAL_READ_SIZE);
+
+    if ( reader.buffer == NULL )
+    {
+        RBTPRINT_DBG_E("Malloc failure");
+        status = RBTREE_STATUS_FAIL_MALLOC_FAILURE;
+    }
+
+    while ( ( status == RBTREE_STATUS_OK ) && ( isEnd == false ) )
+    {
+        RBT_WAL_FRAME frame;
+        uint32_t avail = rbtree_wal_prv_fill(&reader, sizeof(RBT_WAL_FRAME), &status);
+
+        /* header copied out, frames are packed so it is rarely aligned */
+        if ( avail >= sizeof(RBT_WAL_FRAME) )
+        {
+            memcpy(&frame, reader.buffer + reader.begin, sizeof(frame));
+        }
+
+        if ( status != RBTREE_STATUS_OK )
+        {
+            /* read failed */
+        }
+        else if ( avail == 0U )
+        {
+            /* clean end of log */
+            isEnd = true;
+        }
+        else if ( ( avail < sizeof(RBT_WAL_FRAME) ) || ( frame.magic != RBT_WAL_MAGIC ) || ( frame.length > RBT_WAL_BUFFER_SIZE - sizeof(RBT_WAL_FRAME) ) )
+        {
+            RBTPRINT_DBG_W("Log ends in a partial frame header");
+            isEnd = true;
+        }
+        else if ( rbtree_wal_prv_fill(&reader, sizeof(RBT_WAL_FRAME) + frame.length, &status) < sizeof(RBT_WAL_FRAME) + frame.length )
+        {
+            if ( status == RBTREE_STATUS_OK )
+            {
+                RBTPRINT_DBG_W("Log ends in a partial frame");
+                isEnd = true;
+            }
+        }
+        else if ( frame.checksum != rbtree_wal_prv_checksum(reader.buffer + reader.begin + sizeof(RBT_WAL_FRAME), frame.length) )
+        {
+            RBTPRINT_DBG_W("Log ends in a damaged frame");
+            isEnd = true;
+        }
+        else if ( (bool) ( ( frame.flags & RBT_WAL_FLAG_RAW_VALUES ) == 0U ) != isEncoded )
+        {
+            RBTPRINT_DBG_E("Log values %s a decoder",isEncoded ? "do not need" : "need");
+            status = RBTREE_STATUS_FAIL_INVALID_PARAM;
+        }
+        else
+        {
+            status = rbtree_wal_prv_applyFrame(reader.buffer + reader.begin + sizeof(RBT_WAL_FRAME), frame.length, isEncoded, apply_fn, context);
+            reader.begin += (uint32_t)sizeof(RBT_WAL_FRAME) + frame.length;
+        }
+    }
+
+    /* rewind over the torn tail so the log can be truncated there before appending again */
+    if ( ( isEnd ) && ( status == RBTREE_STATUS_OK ) && ( reader.end > reader.begin ) )
+    {
+        (void)lseek(fd, -(off_t)( reader.end - reader.begin ), SEEK_CUR);
+    }
+
+    if ( reader.buffer )
+    {
+        tree->mem_free(reader.buffer);
+    }
+
+    return status;
+}
@@ -0,0 +1,102 @@
+/**
+ @file
+ Red-Black Binary Search Tree - Write-ahead operation log
+
+ @author Ryan Powell
+ @date 23-12-12
+ @copyright Copyright (c) 2012  Ryan Powell
+ @licence https://raw.github.com/Ryandev/RBTreelib/master/LICENSE
+ */
+
+
+#ifndef __RBTREE_WAL_H
+#define __RBTREE_WAL_H
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+#include "rbtree_common.h"
+
+
+/* a frame holds one commit's records, big enough for the largest encoded value */
+#define RBT_WAL_BUFFER_SIZE (1U<<17)
+
+
+typedef enum _RBT_WAL_OP
+{
+    RBT_WAL_OP_UNDEF = 0,
+    RBT_WAL_OP_INSERT,
+    RBT_WAL_OP_DELETE,
+    RBT_WAL_OP_LAST_VALUE,
+} RBT_WAL_OP;
+
+/* one replayed record. Encoded values point into the frame, only valid during the callback */
+typedef struct _RBT_WAL_RECORD
+{
+    RBT_WAL_OP op;
+    RBTREE_KEY key;
+    uint64_t rawValue;
+    const uint8_t * bytes;  /* NULL if the value was logged raw */
+    uint32_t length;
+} RBT_WAL_RECORD;
+
+typedef struct _RBT_WAL
+{
+    int fd;
+    RBTREE_LOG_SYNC sync;
+    rbtree_encoder_t encode_fn;
+    void * userdata;
+    uint8_t * scratch;      /* encoder output, guarded by the tree mutex */
+    RBT_MUTEX_TYPE mutex;   /* guards everything below */
+    RBT_COND_TYPE committed;
+    uint8_t * active;       /* frame header space then records waiting to commit */
+    uint32_t activeLength;
+    uint8_t * spare;        /* frame being written by the committing thread */
+    bool isCommitting;
+    uint64_t appended;      /* records appended */
+    uint64_t written;       /* records handed to the OS */
+    uint64_t synced;        /* records on stable storage */
+    RBTREE_STATUS status;   /* sticky, first failure wins */
+} RBT_WAL;
+
+
+/**
+ @brief apply one replayed record
+ @return RBTREE_STATUS_OK to carry on, anything else stops the replay with that status
+ */
+typedef RBTREE_STATUS (*rbt_wal_apply_t)(void * context, const RBT_WAL_RECORD * record);
+
+
+RBTREE_STATUS rbtree_wal_create ( int fd, RBTREE_LOG_SYNC sync, rbtree_encoder_t encode_fn, void * userdata, RBT_TREE * tree, RBT_WAL ** wal );
+
+/* syncs what is buffered & frees. Sticky failures are returned */
+RBTREE_STATUS rbtree_wal_destroy ( RBT_WAL * wal, RBT_TREE * tree );
+
+/* caller holds the tree mutex, so records are in the same order as the tree changes */
+void rbtree_wal_logInsert ( RBT_WAL * wal, RBTREE_KEY key, void * value );
+
+void rbtree_wal_logDelete ( RBT_WAL * wal, RBTREE_KEY key );
+
+/* called without the tree mutex once a change is applied. Waits as the sync policy asks */
+RBTREE_STATUS rbtree_wal_commit ( RBT_WAL * wal );
+
+/* writes & syncs everything appended so far regardless of policy */
+RBTREE_STATUS rbtree_wal_sync ( RBT_WAL * wal );
+
+/**
+ @brief read frames from fd & hand each record to apply_fn
+ @details stops quietly at the first incomplete or damaged frame, which is what a crash mid-commit
+ leaves behind. fd is left positioned after the last whole frame where it can seek
+ */
+RBTREE_STATUS rbtree_wal_replay ( int fd, bool isEncoded, rbt_wal_apply_t apply_fn, void * context, RBT_TREE * tree );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* __RBTREE_WAL_H */
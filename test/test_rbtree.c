@@ -1,15 +1,70 @@
 
 
+#define _POSIX_C_SOURCE 200809L     /* fileno, lseek, pipe */
+
 #include "test_rbtree.h"
 #include "rbtree.h"
+#include "rbtree_inline.h"
+#include "rbtree_gen.h"
+#include "rbtree_common.h"
+#include "rbtree_arena.h"
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <signal.h>
 
 
 /* range is inclusive. Meaning returned value can be equal to x or y (hence:+1) */
 #define RANDOM_UINT32_RANGE(x,y) (uint32_t) ( (rand() % (((y)+1)-(x))) + (x) )
 
 
+/* black height of the subtree, 0 if it breaks key order (bounded by low/high) or a red-black rule */
+static uint32_t test_rbtree_blackHeight ( const RBT_NODE * node, const RBT_NODE * low, const RBT_NODE * high, uint32_t * count )
+{
+    uint32_t height = 1U;
+    uint32_t leftHeight = 0U;
+    uint32_t rightHeight = 0U;
+    
+    if ( node )
+    {
+        (*count)++;
+        leftHeight = test_rbtree_blackHeight(node->left, low, node, count);
+        rightHeight = test_rbtree_blackHeight(node->right, node, high, count);
+        
+        if ( ( leftHeight == 0U ) || ( leftHeight != rightHeight )
+          || ( ( low ) && ( node->key <= low->key ) ) || ( ( high ) && ( node->key >= high->key ) )
+          || ( ( node->colour != RBT_COLOUR_RED ) && ( node->colour != RBT_COLOUR_BLACK ) )
+          || ( ( node->colour == RBT_COLOUR_RED ) && ( ( ( node->left ) && ( node->left->colour == RBT_COLOUR_RED ) )
+                                                    || ( ( node->right ) && ( node->right->colour == RBT_COLOUR_RED ) ) ) ) )
+        {
+            height = 0U;
+        }
+        else
+        {
+            height = leftHeight + ( ( node->colour == RBT_COLOUR_BLACK ) ? 1U : 0U );
+        }
+    }
+    
+    return height;
+}
+
+/* validates the nodes behind the handle in any build, the library's own checks only run in checked builds */
+static bool test_rbtree_isTreeValid ( RBTREE_HANDLE handle )
+{
+    const RBT_TREE * tree = (const RBT_TREE *)handle;
+    uint32_t count = 0U;
+    uint32_t entries = 0U;
+    
+    return (bool) ( ( ( tree->rootNode == NULL ) || ( tree->rootNode->colour == RBT_COLOUR_BLACK ) )
+                 && ( test_rbtree_blackHeight(tree->rootNode, NULL, NULL, &count) > 0U )
+                 && ( rbtree_entryCount(handle, &entries) == RBTREE_STATUS_OK ) && ( count == entries ) );
+}
+
+
 bool test_rbtree_nullParam ( void )
 {
     bool didPass = false;
@@ -90,6 +145,22 @@ bool test_rbtree_nullParam ( void )
     {
         printf("NULL param accepted %s:%d",__FILE__,__LINE__);        
     }
+    else if ( rbtree_reserveKeys (RBTREE_HANDLE_INVALID, 1U, (RBTREE_KEY *)1U) == RBTREE_STATUS_OK )
+    {
+        printf("NULL param accepted %s:%d",__FILE__,__LINE__);        
+    }
+    else if ( rbtree_reserveKeys ((RBTREE_HANDLE)1U, 1U, NULL) == RBTREE_STATUS_OK )
+    {
+        printf("NULL param accepted %s:%d",__FILE__,__LINE__);        
+    }
+    else if ( rbtree_insertReserved (RBTREE_HANDLE_INVALID, (void *)1U, (RBTREE_KEY)1U) == RBTREE_STATUS_OK )
+    {
+        printf("NULL param accepted %s:%d",__FILE__,__LINE__);        
+    }
+    else if ( rbtree_insertReserved ((RBTREE_HANDLE)1U, (void *)1U, RBTREE_KEY_INVALID) == RBTREE_STATUS_OK )
+    {
+        printf("NULL param accepted %s:%d",__FILE__,__LINE__);        
+    }
     else
     {
         didPass = true;
@@ -517,6 +588,100 @@ bool test_rbtree_linearInsertRandomDeletion ( void )
     return didPass;
 }
 
+/* inserted & deleted out of key order, so every rebalancing case is taken */
+static bool test_rbtree_randomInsertionMode ( bool persistent, uint32_t size )
+{
+    bool didPass = true;
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_KEY first = RBTREE_KEY_INVALID;
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    void * value = NULL;
+    
+    if ( ( ( persistent ? rbtree_createPersistentTree(&handle,NULL,NULL) : rbtree_createTree(&handle,NULL,NULL) ) != RBTREE_STATUS_OK )
+      || ( rbtree_reserveKeys(handle, size, &first) != RBTREE_STATUS_OK ) )
+    {
+        printf("random insertion create failed\n");
+        didPass = false;
+    }
+    
+    /* 7919 is prime, so i*7919 % size visits every offset once */
+    for ( uint32_t i=0U; ( i<size ) && didPass; i++ )
+    {
+        uint32_t offset = (uint32_t)( ( (uint64_t)i * 7919U ) % size );
+        
+        didPass = (bool) ( rbtree_insertReserved(handle, (void *)(uintptr_t)offset, first + offset) == RBTREE_STATUS_OK );
+    }
+    
+    for ( uint32_t i=0U; ( i<size ) && didPass; i++ )
+    {
+        didPass = (bool) ( ( rbtree_retrieveByIndex(handle, i, &value, &key) == RBTREE_STATUS_OK ) && ( key == first + i ) && ( value == (void *)(uintptr_t)i ) );
+    }
+    
+    if ( didPass == false )
+    {
+        printf("random insertion lost order\n");
+    }
+    else if ( ! test_rbtree_isTreeValid(handle) )
+    {
+        printf("random insertion left an invalid tree\n");
+        didPass = false;
+    }
+    
+    /* delete every other entry, again out of order */
+    for ( uint32_t i=0U; ( i<size ) && didPass; i++ )
+    {
+        uint32_t offset = (uint32_t)( ( (uint64_t)i * 7919U ) % size );
+        
+        if ( offset & 1U )
+        {
+            didPass = (bool) ( rbtree_deleteByKey(handle, first + offset) == RBTREE_STATUS_OK );
+        }
+    }
+    
+    for ( uint32_t i=0U; ( i<size/2U ) && didPass; i++ )
+    {
+        didPass = (bool) ( ( rbtree_retrieveByIndex(handle, i, &value, &key) == RBTREE_STATUS_OK ) && ( key == first + ( i * 2U ) ) );
+    }
+    
+    if ( didPass == false )
+    {
+        printf("random deletion lost order\n");
+    }
+    else if ( ! test_rbtree_isTreeValid(handle) )
+    {
+        printf("random deletion left an invalid tree\n");
+        didPass = false;
+    }
+    
+    if ( handle != RBTREE_HANDLE_INVALID )
+    {
+        rbtree_destroyTree(handle);
+    }
+    
+    return didPass;
+}
+
+bool test_rbtree_randomInsertion ( void )
+{
+    bool didPass = true;
+    
+    for ( uint32_t size=1U; ( size<=4096U ) && didPass; size *= 4U )
+    {
+        if ( ! test_rbtree_randomInsertionMode(false, size) )
+        {
+            printf("standard random insertion size:%u failed\n",size);
+            didPass = false;
+        }
+        else if ( ! test_rbtree_randomInsertionMode(true, size) )
+        {
+            printf("persistent random insertion size:%u failed\n",size);
+            didPass = false;
+        }
+    }
+    
+    return didPass;
+}
+
 bool test_rbtree_singleCycle ( void )
 {
     bool didPass = false;
@@ -707,42 +872,3142 @@ bool test_rbtree_linearInsertDeletion ( void )
     return true;
 }
 
-bool test_rbtree ( void )
+bool test_rbtree_reserveKeys ( void )
 {
     bool didPass = false;
     
-    if ( ! test_rbtree_nullParam() )
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_KEY firstKey = RBTREE_KEY_INVALID;
+    RBTREE_KEY insertKey = RBTREE_KEY_INVALID;
+    uint32_t count = 0U;
+    void * retVal = NULL;
+    
+    if ( rbtree_createTree(&handle,NULL,NULL) != RBTREE_STATUS_OK )
     {
-        printf("test_rbtree_nullParam() failed\n");
+        printf("create tree failed\n");
+        return false;
     }
-    else if ( ! test_rbtree_createEmpty() )
+    
+    if ( rbtree_reserveKeys(handle, 0U, &firstKey) == RBTREE_STATUS_OK )
     {
-        printf("test_rbtree_linearInsertDeletion() failed\n");
+        printf("zero key reservation accepted\n");
     }
-    else if ( ! test_rbtree_singleCycle() )
+    else if ( rbtree_reserveKeys(handle, 16U, &firstKey) != RBTREE_STATUS_OK )
     {
-        printf("test_rbtree_singleCycle() failed\n");
+        printf("failed to reserve keys\n");
     }
-    else if ( ! test_rbtree_linearInsertDeletion() )
+    else if ( rbtree_insert(handle, (void *)100U, &insertKey) != RBTREE_STATUS_OK )
     {
-        printf("test_rbtree_linearInsertDeletion() failed\n");
+        printf("failed to insert\n");
     }
-    else if ( ! test_rbtree_linearInsertRandomDeletion() )
+    else if ( ( insertKey >= firstKey ) && ( insertKey < firstKey+16U ) )
     {
-        printf("test_rbtree_linearInsertRandomDeletion() failed\n");
+        printf("insert used reserved key %u\n",insertKey);
     }
-    else if ( ! test_rbtree_indexApi() )
+    else if ( rbtree_insertReserved(handle, (void *)1U, insertKey+1U) == RBTREE_STATUS_OK )
     {
-        printf("test_rbtree_linearInsertRandomDeletion() failed\n");
+        printf("insert of unreserved key accepted\n");
     }
-    else if ( ! test_rbtree_customMemoryManagers() )
+    else
     {
-        printf("test_rbtree_customMemoryManagers() failed\n");
+        didPass = true;
         
+        /* fill reserved range out of order, 5 is coprime to 16 so every offset is visited once */
+        for ( uint32_t i=0U; i<16U; i++ )
+        {
+            uint32_t offset = ( ( i * 5U ) + 3U ) % 16U;
+            
+            if ( rbtree_insertReserved(handle, (void *)(uintptr_t)( offset + 1U ), firstKey+offset) != RBTREE_STATUS_OK )
+            {
+                printf("failed to insert reserved key %u\n",firstKey+offset);
+                didPass = false;
+                break;
+            }
+        }
     }
-    else if ( ! test_rbtree_mergeTrees() )
+    
+    if ( didPass == false )
     {
-        printf("test_rbtree_mergeTrees() failed\n");
+        /* already failed */
+    }
+    else if ( ! test_rbtree_isTreeValid(handle) )
+    {
+        printf("reserved inserts left an invalid tree\n");
+        didPass = false;
+    }
+    else if ( rbtree_insertReserved(handle, (void *)1U, firstKey) != RBTREE_STATUS_FAIL_KEY_ALREADY_STORED )
+    {
+        printf("duplicate reserved key accepted\n");
+        didPass = false;
+    }
+    else if ( rbtree_entryCount(handle, &count) != RBTREE_STATUS_OK )
+    {
+        printf("get entry count failed\n");
+        didPass = false;
+    }
+    else if ( count != 17U )
+    {
+        printf("entry count != 17 (%d) \n",count);
+        didPass = false;
+    }
+    else if ( rbtree_retrieveByKey(handle, firstKey+4U, &retVal) != RBTREE_STATUS_OK )
+    {
+        printf("retrieve reserved key failed\n");
+        didPass = false;
+    }
+    else if ( retVal != (void *)5U )
+    {
+        printf("retrieve reserved value mismatch\n");
+        didPass = false;
+    }
+    
+    if ( rbtree_destroyTree(handle) != RBTREE_STATUS_OK )
+    {
+        printf("failed to destroy tree\n");
+        didPass = false;
+    }
+    
+    return didPass;
+}
+
+bool test_rbtree_persistentSnapshot ( void )
+{
+    bool didPass = true;
+    
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_HANDLE snapshot = RBTREE_HANDLE_INVALID;
+    RBTREE_KEY keys[200];
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    uint32_t count = 0U;
+    void * retVal = NULL;
+    
+    if ( rbtree_createPersistentTree(&handle,NULL,NULL) != RBTREE_STATUS_OK )
+    {
+        printf("create persistent tree failed\n");
+        return false;
+    }
+    
+    for ( uint32_t i=0U; ( i<200U ) && didPass; i++ )
+    {
+        if ( rbtree_insert(handle, (void *)i, &keys[i]) != RBTREE_STATUS_OK )
+        {
+            printf("insert %d failed\n",i);
+            didPass = false;
+        }
+    }
+    
+    if ( didPass == false )
+    {
+        /* already failed */
+    }
+    else if ( rbtree_snapshot(handle, &snapshot) != RBTREE_STATUS_OK )
+    {
+        printf("snapshot failed\n");
+        didPass = false;
+    }
+    else
+    {
+        /* mutate the live tree every way we can */
+        for ( uint32_t i=0U; ( i<200U ) && didPass; i+=2U )
+        {
+            if ( rbtree_deleteByKey(handle, keys[i]) != RBTREE_STATUS_OK )
+            {
+                printf("delete key:%u failed\n",keys[i]);
+                didPass = false;
+            }
+        }
+        
+        if ( didPass == false )
+        {
+            /* already failed */
+        }
+        else if ( rbtree_deleteByIndex(handle, 0U) != RBTREE_STATUS_OK )
+        {
+            printf("delete index 0 failed\n");
+            didPass = false;
+        }
+        else if ( rbtree_deleteByValue(handle, (void *)199U) != RBTREE_STATUS_OK )
+        {
+            printf("delete value 199 failed\n");
+            didPass = false;
+        }
+        else if ( rbtree_insert(handle, (void *)1000U, &key) != RBTREE_STATUS_OK )
+        {
+            printf("insert after snapshot failed\n");
+            didPass = false;
+        }
+        else if ( ( rbtree_entryCount(handle, &count) != RBTREE_STATUS_OK ) || ( count != 99U ) )
+        {
+            printf("live entry count != 99 (%d) \n",count);
+            didPass = false;
+        }
+        else if ( ( rbtree_entryCount(snapshot, &count) != RBTREE_STATUS_OK ) || ( count != 200U ) )
+        {
+            printf("snapshot entry count != 200 (%d) \n",count);
+            didPass = false;
+        }
+        else if ( rbtree_retrieveByKey(snapshot, key, &retVal) != RBTREE_STATUS_FAIL_KEY_DOES_NOT_EXIST )
+        {
+            printf("snapshot sees later insert\n");
+            didPass = false;
+        }
+        else if ( rbtree_insert(snapshot, (void *)1U, &key) != RBTREE_STATUS_FAIL_READ_ONLY )
+        {
+            printf("snapshot accepted insert\n");
+            didPass = false;
+        }
+        else if ( rbtree_deleteByKey(snapshot, keys[1]) != RBTREE_STATUS_FAIL_READ_ONLY )
+        {
+            printf("snapshot accepted delete\n");
+            didPass = false;
+        }
+        
+        for ( uint32_t i=0U; ( i<200U ) && didPass; i++ )
+        {
+            RBTREE_KEY retKey = RBTREE_KEY_INVALID;
+            
+            if ( ( rbtree_retrieveByKey(snapshot, keys[i], &retVal) != RBTREE_STATUS_OK ) || ( retVal != (void *)i ) )
+            {
+                printf("snapshot lost key:%u\n",keys[i]);
+                didPass = false;
+            }
+            else if ( ( rbtree_retrieveByIndex(snapshot, i, &retVal, &retKey) != RBTREE_STATUS_OK ) || ( retKey != keys[i] ) )
+            {
+                printf("snapshot index:%u mismatch\n",i);
+                didPass = false;
+            }
+        }
+    }
+    
+    /* live tree first, the snapshot keeps its nodes alive */
+    if ( rbtree_destroyTree(handle) != RBTREE_STATUS_OK )
+    {
+        printf("failed to destroy tree\n");
+        didPass = false;
+    }
+    else if ( ( didPass ) && ( rbtree_retrieveByKey(snapshot, keys[100], &retVal) != RBTREE_STATUS_OK ) )
+    {
+        printf("snapshot lost key after tree destroyed\n");
+        didPass = false;
+    }
+    
+    if ( ( snapshot != RBTREE_HANDLE_INVALID ) && ( rbtree_destroyTree(snapshot) != RBTREE_STATUS_OK ) )
+    {
+        printf("failed to destroy snapshot\n");
+        didPass = false;
+    }
+    
+    return didPass;
+}
+
+bool test_rbtree_versions ( void )
+{
+    bool didPass = true;
+    
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_HANDLE view = RBTREE_HANDLE_INVALID;
+    RBTREE_KEY keys[20];
+    uint64_t version = 0U;
+    uint32_t count = 0U;
+    void * retVal = NULL;
+    
+    if ( rbtree_createTree(&handle,NULL,NULL) != RBTREE_STATUS_OK )
+    {
+        printf("create tree failed\n");
+        return false;
+    }
+    else if ( rbtree_setVersionRetention(handle, 4U) != RBTREE_STATUS_FAIL_NOT_SUPPORTED )
+    {
+        printf("standard tree accepted retention\n");
+        didPass = false;
+    }
+    
+    rbtree_destroyTree(handle);
+    
+    if ( ( didPass ) && ( rbtree_createPersistentTree(&handle,NULL,NULL) != RBTREE_STATUS_OK ) )
+    {
+        printf("create persistent tree failed\n");
+        return false;
+    }
+    else if ( ( didPass ) && ( rbtree_setVersionRetention(handle, 4U) != RBTREE_STATUS_OK ) )
+    {
+        printf("set retention failed\n");
+        didPass = false;
+    }
+    
+    /* version v holds values 0..v-1 */
+    for ( uint32_t i=0U; ( i<20U ) && didPass; i++ )
+    {
+        if ( rbtree_insert(handle, (void *)i, &keys[i]) != RBTREE_STATUS_OK )
+        {
+            printf("insert %d failed\n",i);
+            didPass = false;
+        }
+    }
+    
+    if ( didPass == false )
+    {
+        /* already failed */
+    }
+    else if ( ( rbtree_currentVersion(handle, &version) != RBTREE_STATUS_OK ) || ( version != 20U ) )
+    {
+        printf("current version != 20 (%llu)\n",(unsigned long long)version);
+        didPass = false;
+    }
+    else if ( rbtree_deleteByKey(handle, keys[0]) != RBTREE_STATUS_OK )
+    {
+        printf("delete key failed\n");
+        didPass = false;
+    }
+    else if ( rbtree_beginRead(handle, 16U, &view) != RBTREE_STATUS_FAIL_VERSION_NOT_RETAINED )
+    {
+        printf("version 16 should be beyond the horizon\n");
+        didPass = false;
+    }
+    else if ( rbtree_beginRead(handle, 22U, &view) != RBTREE_STATUS_FAIL_INVALID_PARAM )
+    {
+        printf("version 22 has not been written\n");
+        didPass = false;
+    }
+    else if ( rbtree_beginRead(handle, 17U, &view) != RBTREE_STATUS_OK )
+    {
+        printf("begin read of version 17 failed\n");
+        didPass = false;
+    }
+    else
+    {
+        /* later mutations & history expiring must not affect an open view */
+        for ( uint32_t i=1U; ( i<10U ) && didPass; i++ )
+        {
+            if ( rbtree_deleteByKey(handle, keys[i]) != RBTREE_STATUS_OK )
+            {
+                printf("delete key:%u failed\n",keys[i]);
+                didPass = false;
+            }
+        }
+        
+        if ( didPass == false )
+        {
+            /* already failed */
+        }
+        else if ( ( rbtree_entryCount(view, &count) != RBTREE_STATUS_OK ) || ( count != 17U ) )
+        {
+            printf("view entry count != 17 (%d)\n",count);
+            didPass = false;
+        }
+        else if ( ( rbtree_retrieveByKey(view, keys[0], &retVal) != RBTREE_STATUS_OK ) || ( retVal != (void *)0U ) )
+        {
+            printf("view lost key:%u\n",keys[0]);
+            didPass = false;
+        }
+        else if ( rbtree_retrieveByKey(view, keys[17], &retVal) != RBTREE_STATUS_FAIL_KEY_DOES_NOT_EXIST )
+        {
+            printf("view sees later insert\n");
+            didPass = false;
+        }
+        else if ( rbtree_insert(view, (void *)1U, &keys[0]) != RBTREE_STATUS_FAIL_READ_ONLY )
+        {
+            printf("view accepted insert\n");
+            didPass = false;
+        }
+        else if ( rbtree_endRead(view) != RBTREE_STATUS_OK )
+        {
+            printf("end read failed\n");
+            didPass = false;
+        }
+        else if ( rbtree_endRead(handle) != RBTREE_STATUS_FAIL_INVALID_PARAM )
+        {
+            printf("end read accepted a live tree\n");
+            didPass = false;
+        }
+    }
+    
+    if ( didPass == false )
+    {
+        /* already failed */
+    }
+    else if ( rbtree_beginRead(handle, 27U, &view) != RBTREE_STATUS_OK )
+    {
+        printf("begin read of version 27 failed\n");
+        didPass = false;
+    }
+    else if ( ( rbtree_entryCount(view, &count) != RBTREE_STATUS_OK ) || ( count != 13U ) )
+    {
+        printf("version 27 entry count != 13 (%d)\n",count);
+        didPass = false;
+    }
+    else if ( rbtree_endRead(view) != RBTREE_STATUS_OK )
+    {
+        printf("end read failed\n");
+        didPass = false;
+    }
+    else if ( rbtree_setVersionRetention(handle, 0U) != RBTREE_STATUS_OK )
+    {
+        printf("clear retention failed\n");
+        didPass = false;
+    }
+    else if ( rbtree_beginRead(handle, 28U, &view) != RBTREE_STATUS_FAIL_VERSION_NOT_RETAINED )
+    {
+        printf("version 28 should be dropped\n");
+        didPass = false;
+    }
+    
+    if ( rbtree_destroyTree(handle) != RBTREE_STATUS_OK )
+    {
+        printf("failed to destroy tree\n");
+        didPass = false;
+    }
+    
+    return didPass;
+}
+
+static uint8_t test_parallel_visits[2000];
+
+
+void test_rbtree_parallel_visit ( void * storevalue, RBTREE_KEY key, void * userdata )
+{
+    /* every key has its own slot so threads never share one */
+    test_parallel_visits[(uintptr_t)storevalue]++;
+}
+
+void * test_rbtree_parallel_accumulate ( void * accumulator, void * storevalue, RBTREE_KEY key, void * userdata )
+{
+    return (void *)( (uintptr_t)accumulator + (uintptr_t)storevalue );
+}
+
+void * test_rbtree_parallel_combine ( void * lhs, void * rhs, void * userdata )
+{
+    return (void *)( (uintptr_t)lhs + (uintptr_t)rhs );
+}
+
+bool test_rbtree_parallel_atLeast ( void * storevalue, void * userdata )
+{
+    return (bool) ( (uintptr_t)storevalue >= (uintptr_t)userdata );
+}
+
+bool test_rbtree_parallelSize ( uint32_t size, bool persistent )
+{
+    bool didPass = true;
+    
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    void * result = NULL;
+    uintptr_t expected = 0U;
+    
+    if ( ( persistent ? rbtree_createPersistentTree(&handle,NULL,NULL) : rbtree_createTree(&handle,NULL,NULL) ) != RBTREE_STATUS_OK )
+    {
+        printf("create tree failed\n");
+        return false;
+    }
+    
+    for ( uint32_t i=0U; ( i<size ) && didPass; i++ )
+    {
+        expected += i;
+        
+        if ( rbtree_insert(handle, (void *)(uintptr_t)i, &key) != RBTREE_STATUS_OK )
+        {
+            printf("insert %d failed\n",i);
+            didPass = false;
+        }
+    }
+    
+    for ( uint32_t threads=1U; ( threads<=8U ) && didPass; threads++ )
+    {
+        for ( uint32_t i=0U; i<size; i++ )
+        {
+            test_parallel_visits[i] = 0U;
+        }
+        
+        if ( rbtree_parallelForEach(handle, threads, test_rbtree_parallel_visit, NULL) != RBTREE_STATUS_OK )
+        {
+            printf("parallel for each failed, threads:%u\n",threads);
+            didPass = false;
+        }
+        else if ( rbtree_parallelReduce(handle, threads, NULL, test_rbtree_parallel_accumulate, test_rbtree_parallel_combine, NULL, &result) != RBTREE_STATUS_OK )
+        {
+            printf("parallel reduce failed, threads:%u\n",threads);
+            didPass = false;
+        }
+        else if ( (uintptr_t)result != expected )
+        {
+            printf("parallel reduce mismatch, threads:%u size:%u\n",threads,size);
+            didPass = false;
+        }
+        else if ( rbtree_parallelFind(handle, threads, test_rbtree_parallel_atLeast, (void *)(uintptr_t)size, &result, &key) != RBTREE_STATUS_FAIL )
+        {
+            printf("parallel find matched nothing, threads:%u\n",threads);
+            didPass = false;
+        }
+        
+        /* every value from target up matches, the lowest key must win */
+        for ( uint32_t target=0U; ( target<size ) && didPass; target+=( size/5U )+1U )
+        {
+            if ( rbtree_parallelFind(handle, threads, test_rbtree_parallel_atLeast, (void *)(uintptr_t)target, &result, &key) != RBTREE_STATUS_OK )
+            {
+                printf("parallel find failed, threads:%u target:%u\n",threads,target);
+                didPass = false;
+            }
+            else if ( (uintptr_t)result != target )
+            {
+                printf("parallel find returned %u not first match %u, threads:%u\n",(uint32_t)(uintptr_t)result,target,threads);
+                didPass = false;
+            }
+        }
+        
+        for ( uint32_t i=0U; ( i<size ) && didPass; i++ )
+        {
+            if ( test_parallel_visits[i] != 1U )
+            {
+                printf("value:%u visited %u times, threads:%u\n",i,test_parallel_visits[i],threads);
+                didPass = false;
+            }
+        }
+    }
+    
+    if ( rbtree_destroyTree(handle) != RBTREE_STATUS_OK )
+    {
+        printf("failed to destroy tree\n");
+        didPass = false;
+    }
+    
+    return didPass;
+}
+
+bool test_rbtree_parallel ( void )
+{
+    bool didPass = true;
+    uint32_t sizes[] = { 0U, 1U, 2U, 7U, 100U, 2000U };
+    
+    for ( uint32_t i=0U; ( i<sizeof(sizes)/sizeof(sizes[0]) ) && didPass; i++ )
+    {
+        if ( ( ! test_rbtree_parallelSize(sizes[i], false) ) || ( ! test_rbtree_parallelSize(sizes[i], true) ) )
+        {
+            printf("parallel failed, size:%u\n",sizes[i]);
+            didPass = false;
+        }
+    }
+    
+    if ( ( didPass ) && ( rbtree_parallelForEach(RBTREE_HANDLE_INVALID, 1U, test_rbtree_parallel_visit, NULL) != RBTREE_STATUS_FAIL_INVALID_PARAM ) )
+    {
+        printf("parallel for each accepted invalid handle\n");
+        didPass = false;
+    }
+    
+    return didPass;
+}
+
+bool test_rbtree_serialize_encode ( void * storevalue, void * buffer, uint32_t * length, void * userdata )
+{
+    uint32_t value = (uint32_t)(uintptr_t)storevalue;
+    
+    memcpy(buffer, &value, sizeof(value));
+    *length = sizeof(value);
+    
+    return true;
+}
+
+bool test_rbtree_serialize_decode ( const void * buffer, uint32_t length, void ** storevalue, void * userdata )
+{
+    uint32_t value = 0U;
+    
+    if ( length == sizeof(value) )
+    {
+        memcpy(&value, buffer, sizeof(value));
+        *storevalue = (void *)(uintptr_t)value;
+    }
+    
+    return (bool) ( length == sizeof(value) );
+}
+
+bool test_rbtree_serializeSize ( uint32_t size, bool encoded )
+{
+    bool didPass = true;
+    
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_HANDLE loaded = RBTREE_HANDLE_INVALID;
+    RBTREE_KEY * keys = malloc(sizeof(RBTREE_KEY) * ( size + 1U ));
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    FILE * fp = tmpfile();
+    uint32_t count = 0U;
+    void * retVal = NULL;
+    
+    if ( ( keys == NULL ) || ( fp == NULL ) || ( rbtree_createTree(&handle,NULL,NULL) != RBTREE_STATUS_OK ) || ( rbtree_createPersistentTree(&loaded,NULL,NULL) != RBTREE_STATUS_OK ) )
+    {
+        printf("serialize setup failed\n");
+        return false;
+    }
+    
+    for ( uint32_t i=0U; ( i<size ) && didPass; i++ )
+    {
+        if ( rbtree_insert(handle, (void *)(uintptr_t)( i * 3U ), &keys[i]) != RBTREE_STATUS_OK )
+        {
+            printf("insert %d failed\n",i);
+            didPass = false;
+        }
+    }
+    
+    /* gaps in the keys */
+    for ( uint32_t i=0U; ( i<size ) && didPass; i+=7U )
+    {
+        if ( rbtree_deleteByKey(handle, keys[i]) != RBTREE_STATUS_OK )
+        {
+            printf("delete key:%u failed\n",keys[i]);
+            didPass = false;
+        }
+        
+        keys[i] = RBTREE_KEY_INVALID;
+    }
+    
+    if ( didPass == false )
+    {
+        /* already failed */
+    }
+    else if ( rbtree_saveToFd(handle, fileno(fp), encoded ? test_rbtree_serialize_encode : NULL, NULL) != RBTREE_STATUS_OK )
+    {
+        printf("save failed\n");
+        didPass = false;
+    }
+    else if ( ( lseek(fileno(fp), 0, SEEK_SET) != 0 ) || ( rbtree_loadFromFd(loaded, fileno(fp), encoded ? NULL : test_rbtree_serialize_decode, NULL) != RBTREE_STATUS_FAIL_INVALID_PARAM ) )
+    {
+        printf("load accepted the wrong decoder\n");
+        didPass = false;
+    }
+    else if ( ( lseek(fileno(fp), 0, SEEK_SET) != 0 ) || ( rbtree_loadFromFd(loaded, fileno(fp), encoded ? test_rbtree_serialize_decode : NULL, NULL) != RBTREE_STATUS_OK ) )
+    {
+        printf("load failed\n");
+        didPass = false;
+    }
+    else if ( ( rbtree_entryCount(loaded, &count) != RBTREE_STATUS_OK ) || ( count != size - ( ( size + 6U ) / 7U ) ) )
+    {
+        printf("loaded entry count mismatch (%u)\n",count);
+        didPass = false;
+    }
+    else if ( ( count > 0U ) && ( ( lseek(fileno(fp), 0, SEEK_SET) != 0 ) || ( rbtree_loadFromFd(loaded, fileno(fp), encoded ? test_rbtree_serialize_decode : NULL, NULL) != RBTREE_STATUS_FAIL_INVALID_PARAM ) ) )
+    {
+        printf("load into a filled tree\n");
+        didPass = false;
+    }
+    
+    for ( uint32_t i=0U; ( i<size ) && didPass; i++ )
+    {
+        if ( keys[i] == RBTREE_KEY_INVALID )
+        {
+            /* deleted */
+        }
+        else if ( ( rbtree_retrieveByKey(loaded, keys[i], &retVal) != RBTREE_STATUS_OK ) || ( retVal != (void *)(uintptr_t)( i * 3U ) ) )
+        {
+            printf("loaded tree lost key:%u\n",keys[i]);
+            didPass = false;
+        }
+    }
+    
+    if ( didPass == false )
+    {
+        /* already failed */
+    }
+    else if ( ( rbtree_insert(loaded, NULL, &key) != RBTREE_STATUS_OK ) || ( ( size > 0U ) && ( key <= keys[size-1U] ) ) )
+    {
+        printf("loaded tree reused key:%u\n",key);
+        didPass = false;
+    }
+    
+    rbtree_destroyTree(handle);
+    rbtree_destroyTree(loaded);
+    fclose(fp);
+    free(keys);
+    
+    return didPass;
+}
+
+bool test_rbtree_serialize ( void )
+{
+    bool didPass = true;
+    uint32_t sizes[] = { 0U, 1U, 2U, 3U, 4U, 100U, 5000U };
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    FILE * fp = tmpfile();
+    
+    for ( uint32_t i=0U; ( i<sizeof(sizes)/sizeof(sizes[0]) ) && didPass; i++ )
+    {
+        if ( ( ! test_rbtree_serializeSize(sizes[i], false) ) || ( ! test_rbtree_serializeSize(sizes[i], true) ) )
+        {
+            printf("serialize failed, size:%u\n",sizes[i]);
+            didPass = false;
+        }
+    }
+    
+    /* truncated stream */
+    if ( ( didPass == false ) || ( fp == NULL ) || ( rbtree_createTree(&handle,NULL,NULL) != RBTREE_STATUS_OK ) )
+    {
+        didPass = false;
+    }
+    else
+    {
+        for ( uint32_t i=0U; i<100U; i++ )
+        {
+            rbtree_insert(handle, NULL, &key);
+        }
+        
+        if ( ( rbtree_saveToFd(handle, fileno(fp), NULL, NULL) != RBTREE_STATUS_OK ) || ( ftruncate(fileno(fp), 50) != 0 ) )
+        {
+            printf("save for truncation failed\n");
+            didPass = false;
+        }
+        
+        rbtree_destroyTree(handle);
+        rbtree_createTree(&handle,NULL,NULL);
+        
+        if ( didPass == false )
+        {
+            /* already failed */
+        }
+        else if ( ( lseek(fileno(fp), 0, SEEK_SET) != 0 ) || ( rbtree_loadFromFd(handle, fileno(fp), NULL, NULL) != RBTREE_STATUS_FAIL_CORRUPT_DATA ) )
+        {
+            printf("truncated stream loaded\n");
+            didPass = false;
+        }
+        else if ( ( rbtree_entryCount(handle, &key) != RBTREE_STATUS_OK ) || ( key != 0U ) )
+        {
+            printf("failed load left entries\n");
+            didPass = false;
+        }
+        
+        rbtree_destroyTree(handle);
+    }
+    
+    /* empty raw streams whose key seeds are 2^32, all keys used, & 2^32+1 which no tree can reach */
+    if ( didPass )
+    {
+        const uint8_t exhausted[] = { 'R', 'B', 'T', 'S', 1U, 1U, 0x00U, 0x80U, 0x80U, 0x80U, 0x80U, 0x10U };
+        const uint8_t beyond[] = { 'R', 'B', 'T', 'S', 1U, 1U, 0x00U, 0x81U, 0x80U, 0x80U, 0x80U, 0x10U };
+        
+        rbtree_createTree(&handle,NULL,NULL);
+        
+        if ( ( ftruncate(fileno(fp), 0) != 0 ) || ( pwrite(fileno(fp), exhausted, sizeof(exhausted), 0) != (ssize_t)sizeof(exhausted) )
+          || ( lseek(fileno(fp), 0, SEEK_SET) != 0 ) || ( rbtree_loadFromFd(handle, fileno(fp), NULL, NULL) != RBTREE_STATUS_OK ) )
+        {
+            printf("exhausted key seed not loaded\n");
+            didPass = false;
+        }
+        else if ( rbtree_insert(handle, NULL, &key) == RBTREE_STATUS_OK )
+        {
+            printf("insert after exhausted key seed accepted, key:%u\n",key);
+            didPass = false;
+        }
+        
+        rbtree_destroyTree(handle);
+        rbtree_createTree(&handle,NULL,NULL);
+        
+        if ( didPass == false )
+        {
+            /* already failed */
+        }
+        else if ( ( pwrite(fileno(fp), beyond, sizeof(beyond), 0) != (ssize_t)sizeof(beyond) )
+               || ( lseek(fileno(fp), 0, SEEK_SET) != 0 ) || ( rbtree_loadFromFd(handle, fileno(fp), NULL, NULL) != RBTREE_STATUS_FAIL_CORRUPT_DATA ) )
+        {
+            printf("key seed past the key range loaded\n");
+            didPass = false;
+        }
+        else if ( ( rbtree_insert(handle, NULL, &key) != RBTREE_STATUS_OK ) || ( key != RBTREE_KEY_INVALID + 1U ) )
+        {
+            printf("insert after rejected key seed failed, key:%u\n",key);
+            didPass = false;
+        }
+        
+        rbtree_destroyTree(handle);
+    }
+    
+    if ( fp )
+    {
+        fclose(fp);
+    }
+    
+    return didPass;
+}
+
+bool test_rbtree_imageSize ( uint32_t size, bool encoded )
+{
+    bool didPass = true;
+    
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_HANDLE image = RBTREE_HANDLE_INVALID;
+    RBTREE_HANDLE copy = RBTREE_HANDLE_INVALID;
+    RBTREE_KEY * keys = malloc(sizeof(RBTREE_KEY) * ( size + 1U ));
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    FILE * fp = tmpfile();
+    uint32_t count = 0U;
+    uint32_t rank = 0U;
+    void * retVal = NULL;
+    bool doesExist = false;
+    
+    if ( ( keys == NULL ) || ( fp == NULL ) || ( rbtree_createTree(&handle,NULL,NULL) != RBTREE_STATUS_OK ) || ( rbtree_createTree(&copy,NULL,NULL) != RBTREE_STATUS_OK ) )
+    {
+        printf("image setup failed\n");
+        return false;
+    }
+    
+    for ( uint32_t i=0U; ( i<size ) && didPass; i++ )
+    {
+        if ( rbtree_insert(handle, (void *)(uintptr_t)( i * 3U + 1U ), &keys[i]) != RBTREE_STATUS_OK )
+        {
+            printf("insert %d failed\n",i);
+            didPass = false;
+        }
+    }
+    
+    /* gaps in the keys */
+    for ( uint32_t i=0U; ( i<size ) && didPass; i+=5U )
+    {
+        if ( rbtree_deleteByKey(handle, keys[i]) != RBTREE_STATUS_OK )
+        {
+            printf("delete key:%u failed\n",keys[i]);
+            didPass = false;
+        }
+        
+        keys[i] = RBTREE_KEY_INVALID;
+    }
+    
+    if ( didPass == false )
+    {
+        /* already failed */
+    }
+    else if ( rbtree_exportImage(handle, fileno(fp), encoded ? test_rbtree_serialize_encode : NULL, NULL) != RBTREE_STATUS_OK )
+    {
+        printf("export failed\n");
+        didPass = false;
+    }
+    else if ( rbtree_openImage(&image, fileno(fp), NULL, NULL) != RBTREE_STATUS_OK )
+    {
+        printf("open image failed\n");
+        didPass = false;
+    }
+    else if ( ( rbtree_entryCount(image, &count) != RBTREE_STATUS_OK ) || ( count != size - ( ( size + 4U ) / 5U ) ) )
+    {
+        printf("image entry count mismatch (%u)\n",count);
+        didPass = false;
+    }
+    
+    for ( uint32_t i=0U; ( i<size ) && didPass; i++ )
+    {
+        uint32_t value = 0U;
+        
+        if ( keys[i] == RBTREE_KEY_INVALID )
+        {
+            if ( ( rbtree_retrieveByKey(image, i + 1U, &retVal) != RBTREE_STATUS_FAIL_KEY_DOES_NOT_EXIST ) || ( rbtree_doesKeyExist(image, i + 1U, &doesExist) != RBTREE_STATUS_OK ) || ( doesExist ) )
+            {
+                printf("image holds deleted key:%u\n",i + 1U);
+                didPass = false;
+            }
+            
+            continue;
+        }
+        else if ( rbtree_retrieveByKey(image, keys[i], &retVal) != RBTREE_STATUS_OK )
+        {
+            printf("image lost key:%u\n",keys[i]);
+            didPass = false;
+        }
+        else if ( encoded )
+        {
+            /* encoded values are handed back in place */
+            memcpy(&value, retVal, sizeof(value));
+        }
+        else
+        {
+            value = (uint32_t)(uintptr_t)retVal;
+        }
+        
+        if ( ( didPass ) && ( value != i * 3U + 1U ) )
+        {
+            printf("image value mismatch for key:%u\n",keys[i]);
+            didPass = false;
+        }
+        else if ( ( didPass ) && ( ( rbtree_retrieveByIndex(image, rank, &retVal, &key) != RBTREE_STATUS_OK ) || ( key != keys[i] ) ) )
+        {
+            printf("image index:%u mismatch\n",rank);
+            didPass = false;
+        }
+        
+        rank++;
+    }
+    
+    if ( ( didPass == false ) || ( size < 2U ) )
+    {
+        /* failed, or too small to hold a value */
+    }
+    else if ( ( encoded == false ) && ( ( rbtree_doesValueExist(image, (void *)(uintptr_t)( ( size - 1U ) * 3U + 1U ), &doesExist) != RBTREE_STATUS_OK ) || ( doesExist == false ) ) )
+    {
+        printf("image value not found\n");
+        didPass = false;
+    }
+    else if ( ( encoded == false ) && ( ( rbtree_copyInTree(copy, image) != RBTREE_STATUS_OK ) || ( rbtree_entryCount(copy, &rank) != RBTREE_STATUS_OK ) || ( rank != count ) ) )
+    {
+        printf("copy from image failed\n");
+        didPass = false;
+    }
+    
+    if ( didPass == false )
+    {
+        /* already failed */
+    }
+    else if ( ( rbtree_insert(image, NULL, &key) != RBTREE_STATUS_FAIL_READ_ONLY ) || ( rbtree_deleteByIndex(image, 0U) != RBTREE_STATUS_FAIL_READ_ONLY ) )
+    {
+        printf("image was modified\n");
+        didPass = false;
+    }
+    else if ( rbtree_exportImage(image, fileno(fp), NULL, NULL) != RBTREE_STATUS_FAIL_NOT_SUPPORTED )
+    {
+        printf("image exported itself\n");
+        didPass = false;
+    }
+    
+    rbtree_destroyTree(handle);
+    rbtree_destroyTree(copy);
+    
+    if ( image != RBTREE_HANDLE_INVALID )
+    {
+        rbtree_destroyTree(image);
+    }
+    
+    fclose(fp);
+    free(keys);
+    
+    return didPass;
+}
+
+bool test_rbtree_image ( void )
+{
+    bool didPass = true;
+    uint32_t sizes[] = { 0U, 1U, 2U, 3U, 7U, 8U, 100U, 5000U };
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_HANDLE image = RBTREE_HANDLE_INVALID;
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    FILE * fp = tmpfile();
+    
+    for ( uint32_t i=0U; ( i<sizeof(sizes)/sizeof(sizes[0]) ) && didPass; i++ )
+    {
+        if ( ( ! test_rbtree_imageSize(sizes[i], false) ) || ( ! test_rbtree_imageSize(sizes[i], true) ) )
+        {
+            printf("image failed, size:%u\n",sizes[i]);
+            didPass = false;
+        }
+    }
+    
+    /* a serialized stream is not an image, nor is a truncated image */
+    if ( ( didPass == false ) || ( fp == NULL ) || ( rbtree_createTree(&handle,NULL,NULL) != RBTREE_STATUS_OK ) )
+    {
+        didPass = false;
+    }
+    else
+    {
+        for ( uint32_t i=0U; i<100U; i++ )
+        {
+            rbtree_insert(handle, NULL, &key);
+        }
+        
+        if ( ( rbtree_saveToFd(handle, fileno(fp), NULL, NULL) != RBTREE_STATUS_OK ) || ( rbtree_openImage(&image, fileno(fp), NULL, NULL) != RBTREE_STATUS_FAIL_CORRUPT_DATA ) )
+        {
+            printf("opened a serialized stream as an image\n");
+            didPass = false;
+        }
+        else if ( ( ftruncate(fileno(fp), 0) != 0 ) || ( lseek(fileno(fp), 0, SEEK_SET) != 0 ) || ( rbtree_exportImage(handle, fileno(fp), NULL, NULL) != RBTREE_STATUS_OK ) )
+        {
+            printf("export for truncation failed\n");
+            didPass = false;
+        }
+        else if ( ( ftruncate(fileno(fp), 200) != 0 ) || ( rbtree_openImage(&image, fileno(fp), NULL, NULL) != RBTREE_STATUS_FAIL_CORRUPT_DATA ) )
+        {
+            printf("opened a truncated image\n");
+            didPass = false;
+        }
+        else if ( ( ftruncate(fileno(fp), 0) != 0 ) || ( lseek(fileno(fp), 0, SEEK_SET) != 0 ) || ( rbtree_exportImage(handle, fileno(fp), NULL, NULL) != RBTREE_STATUS_OK ) )
+        {
+            printf("export for corruption failed\n");
+            didPass = false;
+        }
+        else
+        {
+            /* slot 1 is the first probe of every lookup, point its rank past the key arrays */
+            uint32_t slot[2] = { 0U, 0U };
+            void * retVal = NULL;
+
+            if ( pread(fileno(fp), slot, sizeof(slot), (off_t)sizeof(slot)) == (ssize_t)sizeof(slot) )
+            {
+                slot[1] = 0xFFFFFFF0U;
+            }
+
+            if ( ( slot[1] != 0xFFFFFFF0U ) || ( pwrite(fileno(fp), slot, sizeof(slot), (off_t)sizeof(slot)) != (ssize_t)sizeof(slot) ) )
+            {
+                printf("image corruption failed\n");
+                didPass = false;
+            }
+            else if ( rbtree_openImage(&image, fileno(fp), NULL, NULL) != RBTREE_STATUS_OK )
+            {
+                printf("open of damaged image failed\n");
+                didPass = false;
+            }
+            else if ( rbtree_retrieveByKey(image, slot[0], &retVal) != RBTREE_STATUS_FAIL_KEY_DOES_NOT_EXIST )
+            {
+                printf("damaged image rank was followed\n");
+                didPass = false;
+            }
+
+            if ( image != RBTREE_HANDLE_INVALID )
+            {
+                rbtree_destroyTree(image);
+            }
+        }
+
+        rbtree_destroyTree(handle);
+    }
+    
+    if ( fp )
+    {
+        fclose(fp);
+    }
+    
+    return didPass;
+}
+
+bool test_rbtree_log_isEqual ( RBTREE_HANDLE lhs, RBTREE_HANDLE rhs )
+{
+    bool isEqual = true;
+    uint32_t lhsCount = 0U;
+    uint32_t rhsCount = 0U;
+    
+    rbtree_entryCount(lhs, &lhsCount);
+    rbtree_entryCount(rhs, &rhsCount);
+    
+    if ( lhsCount != rhsCount )
+    {
+        printf("entry count %u != %u\n",lhsCount,rhsCount);
+        isEqual = false;
+    }
+    
+    for ( uint32_t i=0U; ( i<lhsCount ) && isEqual; i++ )
+    {
+        void * lhsValue = NULL;
+        void * rhsValue = NULL;
+        RBTREE_KEY lhsKey = RBTREE_KEY_INVALID;
+        RBTREE_KEY rhsKey = RBTREE_KEY_INVALID;
+        
+        if ( ( rbtree_retrieveByIndex(lhs, i, &lhsValue, &lhsKey) != RBTREE_STATUS_OK ) || ( rbtree_retrieveByIndex(rhs, i, &rhsValue, &rhsKey) != RBTREE_STATUS_OK ) || ( lhsKey != rhsKey ) || ( lhsValue != rhsValue ) )
+        {
+            printf("entry %u differs\n",i);
+            isEqual = false;
+        }
+    }
+    
+    return isEqual;
+}
+
+bool test_rbtree_logPolicy ( RBTREE_LOG_SYNC sync, bool persistent, bool encoded )
+{
+    bool didPass = true;
+    
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_HANDLE replayed = RBTREE_HANDLE_INVALID;
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    RBTREE_KEY lastKey = RBTREE_KEY_INVALID;
+    FILE * log = tmpfile();
+    FILE * base = tmpfile();
+    rbtree_encoder_t encode_fn = encoded ? test_rbtree_serialize_encode : NULL;
+    rbtree_decoder_t decode_fn = encoded ? test_rbtree_serialize_decode : NULL;
+    RBTREE_STATUS (*create_fn)(RBTREE_HANDLE *, rbtree_memalloc_t, rbtree_memfree_t) = persistent ? rbtree_createPersistentTree : rbtree_createTree;
+    off_t logLength = 0;
+    
+    if ( ( log == NULL ) || ( base == NULL ) || ( create_fn(&handle,NULL,NULL) != RBTREE_STATUS_OK ) )
+    {
+        printf("log setup failed\n");
+        return false;
+    }
+    
+    /* entries from before the log are only in the base */
+    for ( uint32_t i=0U; i<50U; i++ )
+    {
+        rbtree_insert(handle, (void *)(uintptr_t)( i + 1000U ), &key);
+    }
+    
+    if ( rbtree_attachLog(handle, fileno(log), sync, encode_fn, NULL) != RBTREE_STATUS_OK )
+    {
+        printf("attach log failed\n");
+        didPass = false;
+    }
+    else if ( rbtree_attachLog(handle, fileno(log), sync, encode_fn, NULL) != RBTREE_STATUS_FAIL_INVALID_PARAM )
+    {
+        printf("attached two logs\n");
+        didPass = false;
+    }
+    else if ( rbtree_saveToFd(handle, fileno(base), encode_fn, NULL) != RBTREE_STATUS_OK )
+    {
+        printf("base save failed\n");
+        didPass = false;
+    }
+    
+    for ( uint32_t i=0U; ( i<500U ) && didPass; i++ )
+    {
+        if ( rbtree_insert(handle, (void *)(uintptr_t)( i % 100U ), &key) != RBTREE_STATUS_OK )
+        {
+            printf("logged insert %u failed\n",i);
+            didPass = false;
+        }
+        else if ( ( i % 3U ) == 0U )
+        {
+            didPass = (bool) ( rbtree_deleteByKey(handle, key) == RBTREE_STATUS_OK );
+        }
+        else if ( ( i % 7U ) == 0U )
+        {
+            didPass = (bool) ( rbtree_deleteByIndex(handle, i % 40U) == RBTREE_STATUS_OK );
+        }
+        
+        lastKey = key;
+    }
+    
+    /* removes several entries in one call */
+    if ( ( didPass == false ) || ( rbtree_deleteByValue(handle, (void *)(uintptr_t)42U) != RBTREE_STATUS_OK ) )
+    {
+        printf("logged delete failed\n");
+        didPass = false;
+    }
+    else if ( rbtree_syncLog(handle) != RBTREE_STATUS_OK )
+    {
+        printf("log sync failed\n");
+        didPass = false;
+    }
+    else if ( rbtree_detachLog(handle) != RBTREE_STATUS_OK )
+    {
+        printf("log detach failed\n");
+        didPass = false;
+    }
+    
+    /* base then log, the log also covers the save point */
+    if ( didPass == false )
+    {
+        /* already failed */
+    }
+    else if ( ( create_fn(&replayed,NULL,NULL) != RBTREE_STATUS_OK ) || ( lseek(fileno(base), 0, SEEK_SET) != 0 ) || ( rbtree_loadFromFd(replayed, fileno(base), decode_fn, NULL) != RBTREE_STATUS_OK ) )
+    {
+        printf("base load failed\n");
+        didPass = false;
+    }
+    else if ( ( lseek(fileno(log), 0, SEEK_SET) != 0 ) || ( rbtree_replayLog(replayed, fileno(log), decode_fn, NULL) != RBTREE_STATUS_OK ) )
+    {
+        printf("replay failed\n");
+        didPass = false;
+    }
+    else if ( ! test_rbtree_log_isEqual(handle, replayed) )
+    {
+        printf("replayed tree differs\n");
+        didPass = false;
+    }
+    else if ( ( rbtree_insert(replayed, NULL, &key) != RBTREE_STATUS_OK ) || ( key <= lastKey ) )
+    {
+        printf("replayed tree reused key:%u\n",key);
+        didPass = false;
+    }
+    else if ( ( lseek(fileno(log), 0, SEEK_SET) != 0 ) || ( rbtree_replayLog(replayed, fileno(log), encoded ? NULL : test_rbtree_serialize_decode, NULL) != RBTREE_STATUS_FAIL_INVALID_PARAM ) )
+    {
+        printf("replay accepted the wrong decoder\n");
+        didPass = false;
+    }
+    
+    if ( replayed != RBTREE_HANDLE_INVALID )
+    {
+        rbtree_destroyTree(replayed);
+        replayed = RBTREE_HANDLE_INVALID;
+    }
+    
+    /* a crash mid-commit leaves a torn frame. Everything before it replays */
+    logLength = lseek(fileno(log), 0, SEEK_END);
+    
+    if ( didPass == false )
+    {
+        /* already failed */
+    }
+    else if ( ( ftruncate(fileno(log), logLength - 3) != 0 ) || ( lseek(fileno(log), 0, SEEK_SET) != 0 ) )
+    {
+        didPass = false;
+    }
+    else if ( ( create_fn(&replayed,NULL,NULL) != RBTREE_STATUS_OK ) || ( rbtree_replayLog(replayed, fileno(log), decode_fn, NULL) != RBTREE_STATUS_OK ) )
+    {
+        printf("torn log replay failed\n");
+        didPass = false;
+    }
+    else if ( lseek(fileno(log), 0, SEEK_CUR) >= logLength - 3 )
+    {
+        printf("torn log not rewound\n");
+        didPass = false;
+    }
+    
+    if ( replayed != RBTREE_HANDLE_INVALID )
+    {
+        rbtree_destroyTree(replayed);
+    }
+    
+    rbtree_destroyTree(handle);
+    fclose(log);
+    fclose(base);
+    
+    return didPass;
+}
+
+bool test_rbtree_log ( void )
+{
+    bool didPass = true;
+    RBTREE_LOG_SYNC syncs[] = { RBTREE_LOG_SYNC_NONE, RBTREE_LOG_SYNC_WRITE, RBTREE_LOG_SYNC_FSYNC };
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    
+    for ( uint32_t i=0U; ( i<sizeof(syncs)/sizeof(syncs[0]) ) && didPass; i++ )
+    {
+        if ( ( ! test_rbtree_logPolicy(syncs[i], false, false) ) || ( ! test_rbtree_logPolicy(syncs[i], true, true) ) )
+        {
+            printf("log failed, sync:%u\n",syncs[i]);
+            didPass = false;
+        }
+    }
+    
+    if ( ( didPass == false ) || ( rbtree_createTree(&handle,NULL,NULL) != RBTREE_STATUS_OK ) )
+    {
+        didPass = false;
+    }
+    else
+    {
+        if ( ( rbtree_syncLog(handle) != RBTREE_STATUS_FAIL_INVALID_PARAM ) || ( rbtree_detachLog(handle) != RBTREE_STATUS_FAIL_INVALID_PARAM ) || ( rbtree_attachLog(handle, 0, RBTREE_LOG_SYNC_UNDEF, NULL, NULL) != RBTREE_STATUS_FAIL_INVALID_PARAM ) )
+        {
+            printf("log api accepted invalid params\n");
+            didPass = false;
+        }
+        
+        rbtree_destroyTree(handle);
+    }
+    
+    return didPass;
+}
+
+static void test_rbtree_checkpoint_done ( RBTREE_STATUS status, void * userdata )
+{
+    int32_t result = (int32_t)status;
+    
+    /* the pipe both hands back the status & waits for it */
+    if ( write(*(int *)userdata, &result, sizeof(result)) != (ssize_t)sizeof(result) )
+    {
+        printf("checkpoint callback write failed\n");
+    }
+}
+
+static RBTREE_STATUS test_rbtree_checkpoint_wait ( int fd )
+{
+    int32_t result = (int32_t)RBTREE_STATUS_UNDEF;
+    
+    if ( read(fd, &result, sizeof(result)) != (ssize_t)sizeof(result) )
+    {
+        result = (int32_t)RBTREE_STATUS_UNDEF;
+    }
+    
+    return (RBTREE_STATUS)result;
+}
+
+static bool test_rbtree_checkpointMode ( bool persistent )
+{
+    bool didPass = true;
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_HANDLE loaded = RBTREE_HANDLE_INVALID;
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    char path[64];
+    int fds[2] = { -1, -1 };
+    int fd = -1;
+    uint32_t count = 0U;
+    
+    snprintf(path, sizeof(path), "/tmp/rbtree_test_%d.ckpt", (int)getpid());
+    
+    if ( ( pipe(fds) != 0 ) || ( ( persistent ? rbtree_createPersistentTree(&handle,NULL,NULL) : rbtree_createTree(&handle,NULL,NULL) ) != RBTREE_STATUS_OK ) )
+    {
+        printf("checkpoint setup failed\n");
+        didPass = false;
+    }
+    
+    for ( uint32_t i=0U; ( i<2000U ) && didPass; i++ )
+    {
+        didPass = (bool) ( rbtree_insert(handle, (void *)(uintptr_t)i, &key) == RBTREE_STATUS_OK );
+    }
+    
+    if ( didPass == false )
+    {
+        printf("checkpoint insert failed\n");
+    }
+    else if ( rbtree_checkpointAsync(handle, path, NULL, NULL, test_rbtree_checkpoint_done, &fds[1]) != RBTREE_STATUS_OK )
+    {
+        printf("checkpoint start failed\n");
+        didPass = false;
+    }
+    
+    /* writers carry on while it is written, none of this is in the checkpoint */
+    for ( uint32_t i=0U; ( i<500U ) && didPass; i++ )
+    {
+        didPass = (bool) ( ( rbtree_insert(handle, (void *)(uintptr_t)i, &key) == RBTREE_STATUS_OK ) && ( rbtree_deleteByIndex(handle, 0U) == RBTREE_STATUS_OK ) );
+    }
+    
+    if ( didPass == false )
+    {
+        printf("write during checkpoint failed\n");
+    }
+    else if ( test_rbtree_checkpoint_wait(fds[0]) != RBTREE_STATUS_OK )
+    {
+        printf("checkpoint failed\n");
+        didPass = false;
+    }
+    else if ( ( ( fd = open(path, O_RDONLY) ) < 0 ) || ( rbtree_createTree(&loaded,NULL,NULL) != RBTREE_STATUS_OK ) || ( rbtree_loadFromFd(loaded, fd, NULL, NULL) != RBTREE_STATUS_OK ) )
+    {
+        printf("checkpoint load failed\n");
+        didPass = false;
+    }
+    else if ( ( rbtree_entryCount(loaded, &count) != RBTREE_STATUS_OK ) || ( count != 2000U ) )
+    {
+        printf("checkpoint holds %u entries\n",count);
+        didPass = false;
+    }
+    
+    for ( uint32_t i=0U; ( i<2000U ) && didPass; i++ )
+    {
+        void * value = NULL;
+        
+        if ( ( rbtree_retrieveByIndex(loaded, i, &value, &key) != RBTREE_STATUS_OK ) || ( value != (void *)(uintptr_t)i ) || ( key != i + 1U ) )
+        {
+            printf("checkpoint entry %u differs\n",i);
+            didPass = false;
+        }
+    }
+    
+    /* failures are reported through the callback too */
+    if ( didPass == false )
+    {
+        /* already failed */
+    }
+    else if ( rbtree_checkpointAsync(handle, "/nonexistent/rbtree_test.ckpt", NULL, NULL, test_rbtree_checkpoint_done, &fds[1]) != RBTREE_STATUS_OK )
+    {
+        printf("checkpoint start failed\n");
+        didPass = false;
+    }
+    else if ( test_rbtree_checkpoint_wait(fds[0]) != RBTREE_STATUS_FAIL_IO )
+    {
+        printf("checkpoint to a bad path did not fail\n");
+        didPass = false;
+    }
+    
+    if ( fd >= 0 )
+    {
+        close(fd);
+    }
+    
+    if ( loaded != RBTREE_HANDLE_INVALID )
+    {
+        rbtree_destroyTree(loaded);
+    }
+    
+    if ( handle != RBTREE_HANDLE_INVALID )
+    {
+        rbtree_destroyTree(handle);
+    }
+    
+    if ( fds[0] >= 0 )
+    {
+        close(fds[0]);
+        close(fds[1]);
+    }
+    
+    unlink(path);
+    
+    return didPass;
+}
+
+static pid_t test_rbtree_checkpointPid = 0;
+
+/* fails in any process but the test's, a forked checkpoint writer must not allocate */
+static void * test_rbtree_checkpointAlloc ( size_t size )
+{
+    return ( getpid() == test_rbtree_checkpointPid ) ? malloc(size) : NULL;
+}
+
+/* a standard tree's writer is forked, it must get by without the allocator & be waited for with SIGCHLD ignored.
+   The exit status is then lost so the checkpoint is reported failed, although the file was written */
+static bool test_rbtree_checkpointForked ( void )
+{
+    bool didPass = true;
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_HANDLE loaded = RBTREE_HANDLE_INVALID;
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    char path[64];
+    int fds[2] = { -1, -1 };
+    int fd = -1;
+    uint32_t count = 0U;
+    void (*prevHandler)(int) = SIG_ERR;
+    
+    test_rbtree_checkpointPid = getpid();
+    snprintf(path, sizeof(path), "/tmp/rbtree_test_%d.ckpt", (int)getpid());
+    
+    if ( ( pipe(fds) != 0 ) || ( rbtree_createTree(&handle, test_rbtree_checkpointAlloc, free) != RBTREE_STATUS_OK ) )
+    {
+        printf("forked checkpoint setup failed\n");
+        didPass = false;
+    }
+    
+    for ( uint32_t i=0U; ( i<100U ) && didPass; i++ )
+    {
+        didPass = (bool) ( rbtree_insert(handle, (void *)(uintptr_t)i, &key) == RBTREE_STATUS_OK );
+    }
+    
+    if ( didPass == false )
+    {
+        printf("forked checkpoint insert failed\n");
+    }
+    else if ( ( prevHandler = signal(SIGCHLD, SIG_IGN) ) == SIG_ERR )
+    {
+        printf("ignoring SIGCHLD failed\n");
+        didPass = false;
+    }
+    else if ( rbtree_checkpointAsync(handle, path, NULL, NULL, test_rbtree_checkpoint_done, &fds[1]) != RBTREE_STATUS_OK )
+    {
+        printf("forked checkpoint start failed\n");
+        didPass = false;
+    }
+    else if ( test_rbtree_checkpoint_wait(fds[0]) != RBTREE_STATUS_FAIL )
+    {
+        printf("forked checkpoint claimed a lost exit status\n");
+        didPass = false;
+    }
+    else if ( ( ( fd = open(path, O_RDONLY) ) < 0 ) || ( rbtree_createTree(&loaded,NULL,NULL) != RBTREE_STATUS_OK )
+           || ( rbtree_loadFromFd(loaded, fd, NULL, NULL) != RBTREE_STATUS_OK )
+           || ( rbtree_entryCount(loaded, &count) != RBTREE_STATUS_OK ) || ( count != 100U ) )
+    {
+        printf("forked checkpoint load failed, %u entries\n",count);
+        didPass = false;
+    }
+    
+    if ( prevHandler != SIG_ERR )
+    {
+        signal(SIGCHLD, prevHandler);
+    }
+    
+    if ( fd >= 0 )
+    {
+        close(fd);
+    }
+    
+    if ( loaded != RBTREE_HANDLE_INVALID )
+    {
+        rbtree_destroyTree(loaded);
+    }
+    
+    if ( handle != RBTREE_HANDLE_INVALID )
+    {
+        rbtree_destroyTree(handle);
+    }
+    
+    if ( fds[0] >= 0 )
+    {
+        close(fds[0]);
+        close(fds[1]);
+    }
+    
+    unlink(path);
+    
+    return didPass;
+}
+
+bool test_rbtree_checkpoint ( void )
+{
+    bool didPass = false;
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    
+    if ( ! test_rbtree_checkpointMode(true) )
+    {
+        printf("persistent checkpoint failed\n");
+    }
+    else if ( ! test_rbtree_checkpointMode(false) )
+    {
+        printf("standard checkpoint failed\n");
+    }
+    else if ( ! test_rbtree_checkpointForked() )
+    {
+        printf("forked checkpoint failed\n");
+    }
+    else if ( rbtree_createTree(&handle,NULL,NULL) != RBTREE_STATUS_OK )
+    {
+        printf("create failed\n");
+    }
+    else
+    {
+        didPass = (bool) ( ( rbtree_checkpointAsync(handle, NULL, NULL, NULL, test_rbtree_checkpoint_done, NULL) == RBTREE_STATUS_FAIL_INVALID_PARAM )
+                        && ( rbtree_checkpointAsync(handle, "", NULL, NULL, test_rbtree_checkpoint_done, NULL) == RBTREE_STATUS_FAIL_INVALID_PARAM )
+                        && ( rbtree_checkpointAsync(handle, "/tmp/x", NULL, NULL, NULL, NULL) == RBTREE_STATUS_FAIL_INVALID_PARAM ) );
+        
+        if ( didPass == false )
+        {
+            printf("checkpoint accepted invalid params\n");
+        }
+        
+        rbtree_destroyTree(handle);
+    }
+    
+    return didPass;
+}
+
+static int test_rbtree_shared_child ( const char * name )
+{
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    void * value = NULL;
+    uint32_t count = 0U;
+    int res = 1;
+    
+    /* a fresh mapping at whatever address this process picks */
+    if ( rbtree_attachSharedTree(&handle, name, NULL, NULL) != RBTREE_STATUS_OK )
+    {
+        printf("attach failed\n");
+    }
+    else if ( ( rbtree_entryCount(handle, &count) != RBTREE_STATUS_OK ) || ( count != 1000U ) )
+    {
+        printf("attached tree holds %u entries\n",count);
+    }
+    else if ( ( rbtree_retrieveByKey(handle, 500U, &value) != RBTREE_STATUS_OK ) || ( value != (void *)(uintptr_t)499U ) )
+    {
+        printf("attached lookup failed\n");
+    }
+    else if ( ( rbtree_insert(handle, (void *)(uintptr_t)7777U, &key) != RBTREE_STATUS_OK ) || ( key != 1001U ) )
+    {
+        printf("insert from child failed\n");
+    }
+    else if ( rbtree_deleteByKey(handle, 1U) != RBTREE_STATUS_OK )
+    {
+        printf("delete from child failed\n");
+    }
+    else
+    {
+        res = 0;
+    }
+    
+    if ( handle != RBTREE_HANDLE_INVALID )
+    {
+        rbtree_destroyTree(handle);
+    }
+    
+    return res;
+}
+
+bool test_rbtree_shared ( void )
+{
+    bool didPass = true;
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_HANDLE other = RBTREE_HANDLE_INVALID;
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    void * value = NULL;
+    uint32_t count = 0U;
+    char name[64];
+    int wstatus = 0;
+    pid_t child = -1;
+    
+    snprintf(name, sizeof(name), "/rbtree_test_%d", (int)getpid());
+    
+    if ( rbtree_createSharedTree(&handle, name, 1001U, NULL, NULL) != RBTREE_STATUS_OK )
+    {
+        printf("shared create failed\n");
+        didPass = false;
+    }
+    
+    for ( uint32_t i=0U; ( i<1000U ) && didPass; i++ )
+    {
+        didPass = (bool) ( ( rbtree_insert(handle, (void *)(uintptr_t)i, &key) == RBTREE_STATUS_OK ) && ( key == i + 1U ) );
+    }
+    
+    if ( didPass == false )
+    {
+        printf("shared insert failed\n");
+    }
+    else if ( ( child = fork() ) == 0 )
+    {
+        _exit(test_rbtree_shared_child(name));
+    }
+    else if ( ( child < 0 ) || ( waitpid(child, &wstatus, 0) != child ) || ( ! WIFEXITED(wstatus) ) || ( WEXITSTATUS(wstatus) != 0 ) )
+    {
+        printf("shared child failed\n");
+        didPass = false;
+    }
+    
+    /* the child's changes are visible here */
+    if ( didPass == false )
+    {
+        /* already failed */
+    }
+    else if ( ( rbtree_entryCount(handle, &count) != RBTREE_STATUS_OK ) || ( count != 1000U ) )
+    {
+        printf("shared tree holds %u entries\n",count);
+        didPass = false;
+    }
+    else if ( ( rbtree_retrieveByKey(handle, 1001U, &value) != RBTREE_STATUS_OK ) || ( value != (void *)(uintptr_t)7777U ) )
+    {
+        printf("child insert not visible\n");
+        didPass = false;
+    }
+    else if ( rbtree_retrieveByKey(handle, 1U, &value) != RBTREE_STATUS_FAIL_KEY_DOES_NOT_EXIST )
+    {
+        printf("child delete not visible\n");
+        didPass = false;
+    }
+    else if ( ( rbtree_retrieveByIndex(handle, 0U, &value, &key) != RBTREE_STATUS_OK ) || ( key != 2U ) )
+    {
+        printf("shared index lookup failed\n");
+        didPass = false;
+    }
+    else if ( ( rbtree_insert(handle, NULL, &key) != RBTREE_STATUS_OK ) || ( rbtree_insert(handle, NULL, &key) != RBTREE_STATUS_FAIL_MALLOC_FAILURE ) )
+    {
+        printf("shared capacity not enforced\n");
+        didPass = false;
+    }
+    else if ( ( rbtree_deleteByValue(handle, NULL) != RBTREE_STATUS_OK ) || ( rbtree_deleteByIndex(handle, 0U) != RBTREE_STATUS_OK ) )
+    {
+        printf("shared delete failed\n");
+        didPass = false;
+    }
+    else if ( ( rbtree_entryCount(handle, &count) != RBTREE_STATUS_OK ) || ( count != 999U ) )
+    {
+        printf("shared tree holds %u entries after delete\n",count);
+        didPass = false;
+    }
+    else if ( ( rbtree_saveToFd(handle, 1, NULL, NULL) != RBTREE_STATUS_FAIL_NOT_SUPPORTED ) || ( rbtree_parallelForEach(handle, 2U, NULL, NULL) != RBTREE_STATUS_FAIL_NOT_SUPPORTED ) )
+    {
+        printf("shared tree allowed an unsupported call\n");
+        didPass = false;
+    }
+    else if ( rbtree_createSharedTree(&other, name, 10U, NULL, NULL) != RBTREE_STATUS_FAIL_INVALID_PARAM )
+    {
+        printf("shared create over an existing name\n");
+        didPass = false;
+    }
+    else if ( rbtree_unlinkSharedTree(name) != RBTREE_STATUS_OK )
+    {
+        printf("shared unlink failed\n");
+        didPass = false;
+    }
+    else if ( rbtree_attachSharedTree(&other, name, NULL, NULL) != RBTREE_STATUS_FAIL_INVALID_PARAM )
+    {
+        printf("attached to an unlinked name\n");
+        didPass = false;
+    }
+    else if ( ( rbtree_retrieveByKey(handle, 1001U, &value) != RBTREE_STATUS_OK ) || ( value != (void *)(uintptr_t)7777U ) )
+    {
+        printf("unlink dropped an attached tree\n");
+        didPass = false;
+    }
+    
+    if ( handle != RBTREE_HANDLE_INVALID )
+    {
+        rbtree_destroyTree(handle);
+    }
+    
+    if ( didPass == false )
+    {
+        (void)rbtree_unlinkSharedTree(name);
+    }
+    
+    return didPass;
+}
+
+bool test_rbtree_mapped ( void )
+{
+    bool didPass = true;
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    void * value = NULL;
+    uint32_t count = 0U;
+    char path[64];
+    char junk[4096];
+    int wstatus = 0;
+    int fd = -1;
+    pid_t child = -1;
+    
+    snprintf(path, sizeof(path), "/tmp/rbtree_test_%d.map", (int)getpid());
+    unlink(path);
+    
+    /* grows through several doublings */
+    if ( rbtree_openMappedTree(&handle, path, 10000U, NULL, NULL) != RBTREE_STATUS_OK )
+    {
+        printf("mapped create failed\n");
+        didPass = false;
+    }
+    
+    for ( uint32_t i=0U; ( i<5000U ) && didPass; i++ )
+    {
+        didPass = (bool) ( ( rbtree_insert(handle, (void *)(uintptr_t)i, &key) == RBTREE_STATUS_OK ) && ( key == i + 1U ) );
+    }
+    
+    for ( uint32_t i=1U; ( i<=100U ) && didPass; i++ )
+    {
+        didPass = (bool) ( rbtree_deleteByKey(handle, i) == RBTREE_STATUS_OK );
+    }
+    
+    if ( didPass == false )
+    {
+        printf("mapped insert/delete failed\n");
+    }
+    else if ( rbtree_syncMappedTree(handle) != RBTREE_STATUS_OK )
+    {
+        printf("mapped sync failed\n");
+        didPass = false;
+    }
+    else if ( ( child = fork() ) == 0 )
+    {
+        RBTREE_HANDLE other = RBTREE_HANDLE_INVALID;
+        
+        _exit(( rbtree_openMappedTree(&other, path, 10000U, NULL, NULL) == RBTREE_STATUS_FAIL ) ? 0 : 1);
+    }
+    else if ( ( child < 0 ) || ( waitpid(child, &wstatus, 0) != child ) || ( ! WIFEXITED(wstatus) ) || ( WEXITSTATUS(wstatus) != 0 ) )
+    {
+        printf("mapped file opened by two processes\n");
+        didPass = false;
+    }
+    
+    if ( handle != RBTREE_HANDLE_INVALID )
+    {
+        rbtree_destroyTree(handle);
+        handle = RBTREE_HANDLE_INVALID;
+    }
+    
+    /* everything is back without a load */
+    if ( didPass == false )
+    {
+        /* already failed */
+    }
+    else if ( rbtree_openMappedTree(&handle, path, 10U, NULL, NULL) != RBTREE_STATUS_OK )
+    {
+        printf("mapped reopen failed\n");
+        didPass = false;
+    }
+    else if ( ( rbtree_entryCount(handle, &count) != RBTREE_STATUS_OK ) || ( count != 4900U ) )
+    {
+        printf("reopened tree holds %u entries\n",count);
+        didPass = false;
+    }
+    else if ( ( rbtree_retrieveByKey(handle, 2500U, &value) != RBTREE_STATUS_OK ) || ( value != (void *)(uintptr_t)2499U ) )
+    {
+        printf("reopened lookup failed\n");
+        didPass = false;
+    }
+    else if ( ( rbtree_retrieveByIndex(handle, 0U, &value, &key) != RBTREE_STATUS_OK ) || ( key != 101U ) )
+    {
+        printf("reopened index lookup failed\n");
+        didPass = false;
+    }
+    else if ( ( rbtree_insert(handle, NULL, &key) != RBTREE_STATUS_OK ) || ( key != 5001U ) )
+    {
+        printf("reopened key seed lost %u\n",key);
+        didPass = false;
+    }
+    
+    if ( handle != RBTREE_HANDLE_INVALID )
+    {
+        rbtree_destroyTree(handle);
+        handle = RBTREE_HANDLE_INVALID;
+    }
+    
+    unlink(path);
+    
+    /* growth stops at maxEntries */
+    if ( ( didPass ) && ( rbtree_openMappedTree(&handle, path, 1500U, NULL, NULL) != RBTREE_STATUS_OK ) )
+    {
+        printf("mapped create failed\n");
+        didPass = false;
+    }
+    
+    for ( uint32_t i=0U; ( i<1500U ) && didPass; i++ )
+    {
+        didPass = (bool) ( rbtree_insert(handle, NULL, &key) == RBTREE_STATUS_OK );
+    }
+    
+    if ( didPass == false )
+    {
+        printf("mapped fill failed\n");
+    }
+    else if ( rbtree_insert(handle, NULL, &key) != RBTREE_STATUS_FAIL_MALLOC_FAILURE )
+    {
+        printf("mapped tree grew past maxEntries\n");
+        didPass = false;
+    }
+    
+    if ( handle != RBTREE_HANDLE_INVALID )
+    {
+        rbtree_destroyTree(handle);
+        handle = RBTREE_HANDLE_INVALID;
+    }
+    
+    /* a damaged root ref is caught on reopen, not on the first lookup */
+    if ( didPass == false )
+    {
+        /* already failed */
+    }
+    else if ( ( fd = open(path, O_RDWR) ) < 0 )
+    {
+        printf("mapped reopen for damage failed\n");
+        didPass = false;
+    }
+    else
+    {
+        RBT_AREF root = 0U;
+        uint32_t used = 0U;
+        
+        if ( pread(fd, &used, sizeof(used), (off_t)offsetof(RBT_ARENA_HEADER, used)) == (ssize_t)sizeof(used) )
+        {
+            root = used + 1U;
+        }
+        
+        if ( ( root == 0U ) || ( pwrite(fd, &root, sizeof(root), (off_t)offsetof(RBT_ARENA_HEADER, root)) != (ssize_t)sizeof(root) ) )
+        {
+            printf("mapped damage failed\n");
+            didPass = false;
+        }
+        else if ( rbtree_openMappedTree(&handle, path, 1500U, NULL, NULL) != RBTREE_STATUS_FAIL_CORRUPT_DATA )
+        {
+            printf("opened an arena with root:%u past used:%u\n",root,used);
+            didPass = false;
+        }
+        
+        close(fd);
+        fd = -1;
+    }
+    
+    unlink(path);
+    
+    /* not an arena */
+    memset(junk, 'x', sizeof(junk));
+    
+    if ( didPass == false )
+    {
+        /* already failed */
+    }
+    else if ( ( ( fd = open(path, O_WRONLY | O_CREAT, 0644) ) < 0 ) || ( write(fd, junk, sizeof(junk)) != (ssize_t)sizeof(junk) ) )
+    {
+        printf("junk file setup failed\n");
+        didPass = false;
+    }
+    else if ( rbtree_openMappedTree(&handle, path, 10U, NULL, NULL) != RBTREE_STATUS_FAIL_CORRUPT_DATA )
+    {
+        printf("opened a junk file\n");
+        didPass = false;
+    }
+    else if ( rbtree_createTree(&handle, NULL, NULL) != RBTREE_STATUS_OK )
+    {
+        printf("create failed\n");
+        didPass = false;
+    }
+    else
+    {
+        didPass = (bool) ( ( rbtree_syncMappedTree(handle) == RBTREE_STATUS_FAIL_NOT_SUPPORTED )
+                        && ( rbtree_openMappedTree(&handle, path, 0U, NULL, NULL) == RBTREE_STATUS_FAIL_INVALID_PARAM ) );
+        
+        if ( didPass == false )
+        {
+            printf("mapped params not checked\n");
+        }
+        
+        rbtree_destroyTree(handle);
+    }
+    
+    if ( fd >= 0 )
+    {
+        close(fd);
+    }
+    
+    unlink(path);
+    
+    return didPass;
+}
+
+static void test_rbtree_stats_visit ( void * storevalue, RBTREE_KEY key, void * userdata )
+{
+    void * value = NULL;
+    
+    /* lookups from the walk's worker threads */
+    (void)rbtree_retrieveByKey((RBTREE_HANDLE)userdata, key, &value);
+    (void)storevalue;
+}
+
+static bool test_rbtree_statsMode ( bool persistent )
+{
+    bool didPass = true;
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_STATS stats;
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    void * value = NULL;
+    
+    if ( ( persistent ? rbtree_createPersistentTree(&handle,NULL,NULL) : rbtree_createTree(&handle,NULL,NULL) ) != RBTREE_STATUS_OK )
+    {
+        printf("stats create failed\n");
+        didPass = false;
+    }
+    
+    for ( uint32_t i=0U; ( i<1000U ) && didPass; i++ )
+    {
+        didPass = (bool) ( rbtree_insert(handle, (void *)(uintptr_t)i, &key) == RBTREE_STATUS_OK );
+    }
+    
+    for ( uint32_t i=1U; ( i<=100U ) && didPass; i++ )
+    {
+        didPass = (bool) ( rbtree_deleteByKey(handle, i) == RBTREE_STATUS_OK );
+    }
+    
+    for ( uint32_t i=1U; ( i<=200U ) && didPass; i++ )
+    {
+        /* keys 1..100 are gone */
+        (void)rbtree_retrieveByKey(handle, i, &value);
+    }
+    
+    if ( didPass == false )
+    {
+        printf("stats setup failed\n");
+    }
+    else if ( rbtree_parallelForEach(handle, 4U, test_rbtree_stats_visit, handle) != RBTREE_STATUS_OK )
+    {
+        printf("stats walk failed\n");
+        didPass = false;
+    }
+    else if ( rbtree_getStats(handle, &stats) != RBTREE_STATUS_OK )
+    {
+        printf("getStats failed\n");
+        didPass = false;
+    }
+    else if ( ( stats.inserts != 1000U ) || ( stats.deletes != 100U ) || ( stats.lookups != 1100U ) || ( stats.misses != 100U ) || ( stats.entries != 900U ) )
+    {
+        printf("stats counted %llu inserts %llu deletes %llu lookups %llu misses\n",(unsigned long long)stats.inserts,(unsigned long long)stats.deletes,(unsigned long long)stats.lookups,(unsigned long long)stats.misses);
+        didPass = false;
+    }
+    else if ( ( stats.allocs < 1000U ) || ( stats.rotations == 0U ) || ( stats.recolours == 0U ) || ( stats.fixUpIterations == 0U ) )
+    {
+        printf("stats missed rebalancing work\n");
+        didPass = false;
+    }
+    else if ( ( stats.height < 10U ) || ( stats.height > 20U ) || ( stats.blackHeight == 0U ) || ( stats.blackHeight * 2U < stats.height ) )
+    {
+        /* log2(900) < height <= 2*log2(901) */
+        printf("stats shape height %u black height %u\n",stats.height,stats.blackHeight);
+        didPass = false;
+    }
+    
+    if ( handle != RBTREE_HANDLE_INVALID )
+    {
+        rbtree_destroyTree(handle);
+    }
+    
+    return didPass;
+}
+
+bool test_rbtree_stats ( void )
+{
+    bool didPass = false;
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_STATS stats;
+    
+    if ( ! test_rbtree_statsMode(false) )
+    {
+        printf("standard stats failed\n");
+    }
+    else if ( ! test_rbtree_statsMode(true) )
+    {
+        printf("persistent stats failed\n");
+    }
+    else if ( rbtree_createTree(&handle,NULL,NULL) != RBTREE_STATUS_OK )
+    {
+        printf("create failed\n");
+    }
+    else
+    {
+        didPass = (bool) ( ( rbtree_getStats(handle, NULL) == RBTREE_STATUS_FAIL_INVALID_PARAM )
+                        && ( rbtree_getStats(handle, &stats) == RBTREE_STATUS_OK )
+                        && ( stats.height == 0U ) && ( stats.blackHeight == 0U ) && ( stats.inserts == 0U ) );
+        
+        if ( didPass == false )
+        {
+            printf("empty tree stats wrong\n");
+        }
+        
+        rbtree_destroyTree(handle);
+    }
+    
+    return didPass;
+}
+
+static uint64_t test_rbtree_latencySamples ( RBTREE_HANDLE handle, RBTREE_LATENCY_OP op, RBTREE_LATENCY_PHASE phase )
+{
+    RBTREE_LATENCY latency;
+    
+    memset(&latency, 0xFF, sizeof(latency));
+    
+    if ( rbtree_getLatency(handle, op, phase, &latency) != RBTREE_STATUS_OK )
+    {
+        latency.samples = UINT64_MAX;
+    }
+    else if ( ( latency.samples ) && ( ( latency.minNs > latency.p50Ns ) || ( latency.p50Ns > latency.p90Ns ) || ( latency.p90Ns > latency.p99Ns ) || ( latency.p99Ns > latency.p999Ns ) || ( latency.p999Ns > latency.maxNs ) ) )
+    {
+        printf("latency percentiles out of order %llu %llu %llu %llu %llu %llu\n",(unsigned long long)latency.minNs,(unsigned long long)latency.p50Ns,(unsigned long long)latency.p90Ns,(unsigned long long)latency.p99Ns,(unsigned long long)latency.p999Ns,(unsigned long long)latency.maxNs);
+        latency.samples = UINT64_MAX;
+    }
+    
+    return latency.samples;
+}
+
+static bool test_rbtree_latencyMode ( bool persistent )
+{
+    bool didPass = true;
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_LATENCY latency;
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    void * value = NULL;
+    FILE * fp = NULL;
+    
+    if ( ( persistent ? rbtree_createPersistentTree(&handle,NULL,NULL) : rbtree_createTree(&handle,NULL,NULL) ) != RBTREE_STATUS_OK )
+    {
+        printf("latency create failed\n");
+        didPass = false;
+    }
+    else if ( ( rbtree_printLatency(handle, stdout) != RBTREE_STATUS_FAIL ) || ( test_rbtree_latencySamples(handle, RBTREE_LATENCY_OP_INSERT, RBTREE_LATENCY_PHASE_TOTAL) != 0U ) )
+    {
+        printf("latency reported before sampling was on\n");
+        didPass = false;
+    }
+    else if ( rbtree_setLatencySampling(handle, 1U) != RBTREE_STATUS_OK )
+    {
+        printf("setLatencySampling failed\n");
+        didPass = false;
+    }
+    
+    for ( uint32_t i=0U; ( i<1000U ) && didPass; i++ )
+    {
+        didPass = (bool) ( rbtree_insert(handle, (void *)(uintptr_t)i, &key) == RBTREE_STATUS_OK );
+    }
+    
+    for ( uint32_t i=1U; ( i<=500U ) && didPass; i++ )
+    {
+        didPass = (bool) ( rbtree_retrieveByKey(handle, i, &value) == RBTREE_STATUS_OK );
+    }
+    
+    for ( uint32_t i=1U; ( i<=100U ) && didPass; i++ )
+    {
+        didPass = (bool) ( rbtree_deleteByKey(handle, i) == RBTREE_STATUS_OK );
+    }
+    
+    for ( uint32_t i=1U; ( i<=100U ) && didPass; i++ )
+    {
+        didPass = (bool) ( rbtree_deleteByIndex(handle, 0U) == RBTREE_STATUS_OK );
+    }
+    
+    if ( didPass == false )
+    {
+        printf("latency setup failed\n");
+    }
+    else
+    {
+        /* every phase of a sampled call is recorded, even when it spent nothing there */
+        for ( uint32_t phase = RBTREE_LATENCY_PHASE_TOTAL; ( phase < RBTREE_LATENCY_PHASE_LAST_VALUE ) && didPass; phase++ )
+        {
+            didPass = (bool) ( ( test_rbtree_latencySamples(handle, RBTREE_LATENCY_OP_INSERT, (RBTREE_LATENCY_PHASE)phase) == 1000U )
+                            && ( test_rbtree_latencySamples(handle, RBTREE_LATENCY_OP_RETRIEVE_BY_KEY, (RBTREE_LATENCY_PHASE)phase) == 500U )
+                            && ( test_rbtree_latencySamples(handle, RBTREE_LATENCY_OP_DELETE_BY_KEY, (RBTREE_LATENCY_PHASE)phase) == 100U )
+                            && ( test_rbtree_latencySamples(handle, RBTREE_LATENCY_OP_DELETE_BY_INDEX, (RBTREE_LATENCY_PHASE)phase) == 100U )
+                            && ( test_rbtree_latencySamples(handle, RBTREE_LATENCY_OP_INSERT_RESERVED, (RBTREE_LATENCY_PHASE)phase) == 0U ) );
+        }
+        
+        if ( didPass == false )
+        {
+            printf("latency sampled the wrong number of calls\n");
+        }
+        else if ( ( rbtree_getLatency(handle, RBTREE_LATENCY_OP_INSERT, RBTREE_LATENCY_PHASE_TOTAL, &latency) != RBTREE_STATUS_OK ) || ( latency.maxNs == 0U ) )
+        {
+            printf("latency insert took no time\n");
+            didPass = false;
+        }
+    }
+    
+    if ( didPass )
+    {
+        /* 1 in 10 from here, the countdown was at the end of a period so the first call is sampled */
+        didPass = (bool) ( rbtree_setLatencySampling(handle, 10U) == RBTREE_STATUS_OK );
+        
+        for ( uint32_t i=0U; ( i<1000U ) && didPass; i++ )
+        {
+            didPass = (bool) ( rbtree_insert(handle, (void *)(uintptr_t)i, &key) == RBTREE_STATUS_OK );
+        }
+        
+        didPass = (bool) ( didPass && ( rbtree_setLatencySampling(handle, 0U) == RBTREE_STATUS_OK ) );
+        
+        for ( uint32_t i=0U; ( i<100U ) && didPass; i++ )
+        {
+            didPass = (bool) ( rbtree_insert(handle, (void *)(uintptr_t)i, &key) == RBTREE_STATUS_OK );
+        }
+        
+        if ( ( didPass == false ) || ( test_rbtree_latencySamples(handle, RBTREE_LATENCY_OP_INSERT, RBTREE_LATENCY_PHASE_TOTAL) != 1100U ) )
+        {
+            printf("latency sampling period not followed\n");
+            didPass = false;
+        }
+    }
+    
+    if ( didPass )
+    {
+        fp = tmpfile();
+        
+        if ( ( fp == NULL ) || ( rbtree_printLatency(handle, fp) != RBTREE_STATUS_OK ) )
+        {
+            printf("printLatency failed\n");
+            didPass = false;
+        }
+        else if ( ftell(fp) <= 0 )
+        {
+            printf("printLatency printed nothing\n");
+            didPass = false;
+        }
+        
+        if ( fp )
+        {
+            fclose(fp);
+        }
+    }
+    
+    if ( handle != RBTREE_HANDLE_INVALID )
+    {
+        rbtree_destroyTree(handle);
+    }
+    
+    return didPass;
+}
+
+bool test_rbtree_latency ( void )
+{
+    bool didPass = false;
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_LATENCY latency;
+    
+    if ( ! test_rbtree_latencyMode(false) )
+    {
+        printf("standard latency failed\n");
+    }
+    else if ( ! test_rbtree_latencyMode(true) )
+    {
+        printf("persistent latency failed\n");
+    }
+    else if ( rbtree_createTree(&handle,NULL,NULL) != RBTREE_STATUS_OK )
+    {
+        printf("create failed\n");
+    }
+    else
+    {
+        didPass = (bool) ( ( rbtree_setLatencySampling(RBTREE_HANDLE_INVALID, 1U) == RBTREE_STATUS_FAIL_INVALID_PARAM )
+                        && ( rbtree_setLatencySampling(handle, 0U) == RBTREE_STATUS_OK )
+                        && ( rbtree_getLatency(handle, RBTREE_LATENCY_OP_UNDEF, RBTREE_LATENCY_PHASE_TOTAL, &latency) == RBTREE_STATUS_FAIL_INVALID_PARAM )
+                        && ( rbtree_getLatency(handle, RBTREE_LATENCY_OP_INSERT, RBTREE_LATENCY_PHASE_LAST_VALUE, &latency) == RBTREE_STATUS_FAIL_INVALID_PARAM )
+                        && ( rbtree_getLatency(handle, RBTREE_LATENCY_OP_INSERT, RBTREE_LATENCY_PHASE_TOTAL, NULL) == RBTREE_STATUS_FAIL_INVALID_PARAM )
+                        && ( rbtree_printLatency(handle, NULL) == RBTREE_STATUS_FAIL_INVALID_PARAM ) );
+        
+        if ( didPass == false )
+        {
+            printf("latency param checks failed\n");
+        }
+        
+        rbtree_destroyTree(handle);
+    }
+    
+    return didPass;
+}
+
+static void test_rbtree_lockProfile_visit ( void * storevalue, RBTREE_KEY key, void * userdata )
+{
+    RBTREE_KEY newKey = RBTREE_KEY_INVALID;
+    
+    /* writers on every worker thread, so the tree mutex can be contended */
+    (void)rbtree_insert((RBTREE_HANDLE)userdata, storevalue, &newKey);
+    (void)key;
+}
+
+static const RBTREE_LOCK_SITE * test_rbtree_lockProfile_site ( const RBTREE_LOCK_SITE * sites, uint32_t count, const char * function )
+{
+    const RBTREE_LOCK_SITE * site = NULL;
+    
+    for ( uint32_t i=0U; ( i<count ) && ( site == NULL ); i++ )
+    {
+        if ( strcmp(sites[i].function, function) == 0 )
+        {
+            site = &sites[i];
+        }
+    }
+    
+    return site;
+}
+
+bool test_rbtree_lockProfile ( void )
+{
+    bool didPass = true;
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_HANDLE other = RBTREE_HANDLE_INVALID;
+    RBTREE_LOCK_SITE sites[64];
+    uint32_t count = 64U;
+    const RBTREE_LOCK_SITE * inserts = NULL;
+    const RBTREE_LOCK_SITE * deletes = NULL;
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    FILE * fp = NULL;
+    
+    if ( ( rbtree_createTree(&handle,NULL,NULL) != RBTREE_STATUS_OK ) || ( rbtree_createTree(&other,NULL,NULL) != RBTREE_STATUS_OK ) )
+    {
+        printf("lock profile create failed\n");
+        didPass = false;
+    }
+    else if ( rbtree_setLockProfiling(true) != RBTREE_STATUS_OK )
+    {
+        printf("setLockProfiling failed\n");
+        didPass = false;
+    }
+    
+    for ( uint32_t i=0U; ( i<1000U ) && didPass; i++ )
+    {
+        didPass = (bool) ( rbtree_insert(handle, (void *)(uintptr_t)i, &key) == RBTREE_STATUS_OK );
+    }
+    
+    for ( uint32_t i=1U; ( i<=100U ) && didPass; i++ )
+    {
+        didPass = (bool) ( rbtree_deleteByKey(handle, i) == RBTREE_STATUS_OK );
+    }
+    
+    if ( didPass == false )
+    {
+        printf("lock profile setup failed\n");
+    }
+    else if ( rbtree_parallelForEach(handle, 4U, test_rbtree_lockProfile_visit, other) != RBTREE_STATUS_OK )
+    {
+        printf("lock profile walk failed\n");
+        didPass = false;
+    }
+    else if ( ( rbtree_getLockProfile(sites, &count) != RBTREE_STATUS_OK ) || ( count == 0U ) )
+    {
+        printf("getLockProfile failed\n");
+        didPass = false;
+    }
+    else
+    {
+        inserts = test_rbtree_lockProfile_site(sites, count, "rbtree_prv_linkNodeIntoTree");
+        deletes = test_rbtree_lockProfile_site(sites, count, "rbtree_prv_removeNodeFromTree");
+        
+        if ( ( inserts == NULL ) || ( inserts->acquisitions != 1900U ) || ( deletes == NULL ) || ( deletes->acquisitions != 100U ) )
+        {
+            printf("lock profile missed the insert or delete sites\n");
+            didPass = false;
+        }
+        else if ( ( inserts->contended > inserts->acquisitions ) || ( inserts->holdNs == 0U ) || ( inserts->maxHoldNs == 0U ) || ( inserts->holdP50Ns > inserts->holdP99Ns ) )
+        {
+            printf("lock profile insert site counted %llu contended %llu held\n",(unsigned long long)inserts->contended,(unsigned long long)inserts->holdNs);
+            didPass = false;
+        }
+        
+        for ( uint32_t i=1U; ( i<count ) && didPass; i++ )
+        {
+            if ( sites[i].maxHoldNs > sites[i - 1U].maxHoldNs )
+            {
+                printf("lock profile not sorted by longest hold\n");
+                didPass = false;
+            }
+        }
+    }
+    
+    if ( didPass )
+    {
+        /* off again, a site's counts stand still */
+        didPass = (bool) ( ( rbtree_setLockProfiling(false) == RBTREE_STATUS_OK ) && ( rbtree_insert(handle, NULL, &key) == RBTREE_STATUS_OK ) );
+        count = 64U;
+        
+        if ( ( didPass == false ) || ( rbtree_getLockProfile(sites, &count) != RBTREE_STATUS_OK ) )
+        {
+            printf("lock profile stop failed\n");
+            didPass = false;
+        }
+        else if ( ( ( inserts = test_rbtree_lockProfile_site(sites, count, "rbtree_prv_linkNodeIntoTree") ) == NULL ) || ( inserts->acquisitions != 1900U ) )
+        {
+            printf("lock profile counted with profiling off\n");
+            didPass = false;
+        }
+    }
+    
+    if ( didPass )
+    {
+        count = 1U;
+        fp = tmpfile();
+        
+        if ( ( rbtree_getLockProfile(sites, &count) != RBTREE_STATUS_OK ) || ( count != 1U ) || ( rbtree_getLockProfile(NULL, &count) != RBTREE_STATUS_FAIL_INVALID_PARAM ) || ( rbtree_printLockProfile(NULL) != RBTREE_STATUS_FAIL_INVALID_PARAM ) )
+        {
+            printf("lock profile params failed\n");
+            didPass = false;
+        }
+        else if ( ( fp == NULL ) || ( rbtree_printLockProfile(fp) != RBTREE_STATUS_OK ) || ( ftell(fp) <= 0 ) )
+        {
+            printf("printLockProfile failed\n");
+            didPass = false;
+        }
+        
+        if ( fp )
+        {
+            fclose(fp);
+        }
+    }
+    
+    (void)rbtree_setLockProfiling(false);
+    
+    if ( handle != RBTREE_HANDLE_INVALID )
+    {
+        rbtree_destroyTree(handle);
+    }
+    
+    if ( other != RBTREE_HANDLE_INVALID )
+    {
+        rbtree_destroyTree(other);
+    }
+    
+    return didPass;
+}
+
+static bool test_rbtree_traceMode ( bool persistent )
+{
+    bool didPass = true;
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_TRACE_REPORT report;
+    RBTREE_KEY keys[200];
+    RBTREE_KEY before = RBTREE_KEY_INVALID;
+    RBTREE_KEY first = RBTREE_KEY_INVALID;
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    void * value = NULL;
+    FILE * fp = tmpfile();
+    
+    if ( ( fp == NULL ) || ( ( persistent ? rbtree_createPersistentTree(&handle,NULL,NULL) : rbtree_createTree(&handle,NULL,NULL) ) != RBTREE_STATUS_OK ) )
+    {
+        printf("trace create failed\n");
+        didPass = false;
+    }
+    else if ( rbtree_insert(handle, (void *)(uintptr_t)1000U, &before) != RBTREE_STATUS_OK )
+    {
+        printf("trace insert before tracing failed\n");
+        didPass = false;
+    }
+    else if ( rbtree_startTrace(handle, fileno(fp)) != RBTREE_STATUS_OK )
+    {
+        printf("startTrace failed\n");
+        didPass = false;
+    }
+    else if ( rbtree_startTrace(handle, fileno(fp)) != RBTREE_STATUS_FAIL )
+    {
+        printf("startTrace started twice\n");
+        didPass = false;
+    }
+    
+    for ( uint32_t i=0U; ( i<200U ) && didPass; i++ )
+    {
+        didPass = (bool) ( rbtree_insert(handle, (void *)(uintptr_t)( i + 1U ), &keys[i]) == RBTREE_STATUS_OK );
+    }
+    
+    didPass = (bool) ( didPass && ( rbtree_reserveKeys(handle, 10U, &first) == RBTREE_STATUS_OK ) );
+    
+    for ( uint32_t i=0U; ( i<10U ) && didPass; i++ )
+    {
+        didPass = (bool) ( rbtree_insertReserved(handle, (void *)(uintptr_t)( 500U + i ), first + i) == RBTREE_STATUS_OK );
+    }
+    
+    for ( uint32_t i=0U; ( i<100U ) && didPass; i++ )
+    {
+        didPass = (bool) ( rbtree_retrieveByKey(handle, keys[i], &value) == RBTREE_STATUS_OK );
+    }
+    
+    for ( uint32_t i=0U; ( i<50U ) && didPass; i++ )
+    {
+        didPass = (bool) ( rbtree_deleteByKey(handle, keys[i]) == RBTREE_STATUS_OK );
+    }
+    
+    /* the entry from before the trace is found now but not on replay */
+    didPass = (bool) ( didPass && ( rbtree_retrieveByKey(handle, before, &value) == RBTREE_STATUS_OK ) );
+    
+    for ( uint32_t i=0U; ( i<10U ) && didPass; i++ )
+    {
+        didPass = (bool) ( rbtree_deleteByIndex(handle, 0U) == RBTREE_STATUS_OK );
+    }
+    
+    /* a failed call is recorded as failing */
+    didPass = (bool) ( didPass
+                    && ( rbtree_deleteByValue(handle, (void *)(uintptr_t)200U) == RBTREE_STATUS_OK )
+                    && ( rbtree_retrieveByKey(handle, keys[0], &value) != RBTREE_STATUS_OK )
+                    && ( rbtree_stopTrace(handle) == RBTREE_STATUS_OK )
+                    && ( rbtree_insert(handle, (void *)(uintptr_t)2000U, &key) == RBTREE_STATUS_OK ) );
+    
+    if ( didPass == false )
+    {
+        printf("trace setup failed\n");
+    }
+    
+    for ( uint32_t interleaved=0U; ( interleaved<2U ) && didPass; interleaved++ )
+    {
+        if ( ( lseek(fileno(fp), 0, SEEK_SET) != 0 ) || ( rbtree_replayTrace(fileno(fp), (bool)interleaved, &report) != RBTREE_STATUS_OK ) )
+        {
+            printf("replayTrace failed\n");
+            didPass = false;
+        }
+        else if ( ( report.records != 374U ) || ( report.threads != 1U ) || ( report.mismatches != 1U ) )
+        {
+            printf("replayTrace records:%llu threads:%u mismatches:%llu\n", (unsigned long long)report.records, report.threads, (unsigned long long)report.mismatches);
+            didPass = false;
+        }
+        else if ( ( report.calls[RBTREE_TRACE_OP_INSERT] != 200U ) || ( report.calls[RBTREE_TRACE_OP_INSERT_RESERVED] != 10U )
+               || ( report.calls[RBTREE_TRACE_OP_RETRIEVE_BY_KEY] != 102U ) || ( report.calls[RBTREE_TRACE_OP_DELETE_BY_INDEX] != 10U )
+               || ( report.tracedNs == 0U ) || ( report.replayNs == 0U ) )
+        {
+            printf("replayTrace miscounted calls\n");
+            didPass = false;
+        }
+    }
+    
+    if ( handle != RBTREE_HANDLE_INVALID )
+    {
+        rbtree_destroyTree(handle);
+    }
+    
+    if ( fp )
+    {
+        fclose(fp);
+    }
+    
+    return didPass;
+}
+
+bool test_rbtree_trace ( void )
+{
+    bool didPass = false;
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_TRACE_REPORT report;
+    FILE * fp = tmpfile();
+    
+    if ( ! test_rbtree_traceMode(false) )
+    {
+        printf("standard trace failed\n");
+    }
+    else if ( ! test_rbtree_traceMode(true) )
+    {
+        printf("persistent trace failed\n");
+    }
+    else if ( ( fp == NULL ) || ( rbtree_createTree(&handle,NULL,NULL) != RBTREE_STATUS_OK ) )
+    {
+        printf("create failed\n");
+    }
+    else
+    {
+        didPass = (bool) ( ( rbtree_startTrace(RBTREE_HANDLE_INVALID, fileno(fp)) == RBTREE_STATUS_FAIL_INVALID_PARAM )
+                        && ( rbtree_startTrace(handle, -1) == RBTREE_STATUS_FAIL_INVALID_PARAM )
+                        && ( rbtree_stopTrace(RBTREE_HANDLE_INVALID) == RBTREE_STATUS_FAIL_INVALID_PARAM )
+                        && ( rbtree_stopTrace(handle) == RBTREE_STATUS_OK )
+                        && ( rbtree_replayTrace(-1, false, &report) == RBTREE_STATUS_FAIL_INVALID_PARAM )
+                        && ( rbtree_replayTrace(fileno(fp), false, NULL) == RBTREE_STATUS_FAIL_INVALID_PARAM ) );
+        
+        if ( didPass == false )
+        {
+            printf("trace param checks failed\n");
+        }
+        else if ( ( fputs("not a trace", fp) < 0 ) || ( fflush(fp) != 0 ) || ( lseek(fileno(fp), 0, SEEK_SET) != 0 )
+               || ( rbtree_replayTrace(fileno(fp), false, &report) != RBTREE_STATUS_FAIL_CORRUPT_DATA ) )
+        {
+            printf("replayTrace accepted a file that is not a trace\n");
+            didPass = false;
+        }
+        
+        rbtree_destroyTree(handle);
+    }
+    
+    if ( fp )
+    {
+        fclose(fp);
+    }
+    
+    return didPass;
+}
+
+static bool test_rbtree_inlineMode ( bool persistent )
+{
+    bool didPass = false;
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_HANDLE snapshot = RBTREE_HANDLE_INVALID;
+    RBTREE_INLINE_TREE tree;
+    RBTREE_INLINE_TREE snapTree;
+    RBTREE_INLINE_CURSOR cursor;
+    const RBTREE_INLINE_NODE * node = NULL;
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    void * value = NULL;
+    void * inlineValue = NULL;
+    uint32_t count = 0U;
+    
+    if ( ( persistent ? rbtree_createPersistentTree(&handle,NULL,NULL) : rbtree_createTree(&handle,NULL,NULL) ) != RBTREE_STATUS_OK )
+    {
+        printf("create failed\n");
+    }
+    else if ( rbtree_getInlineTree(handle, &tree) != RBTREE_STATUS_OK )
+    {
+        printf("getInlineTree failed\n");
+    }
+    else if ( ( rbtree_inline_find(&tree, 1U) != NULL ) || ( rbtree_inline_cursorFirst(&tree, &cursor) != NULL ) )
+    {
+        printf("inline lookup found an entry in an empty tree\n");
+    }
+    else
+    {
+        didPass = true;
+    }
+    
+    /* keys 1..1000, then every third removed so seeks land on gaps */
+    for ( uint32_t i=0U; ( i<1000U ) && didPass; i++ )
+    {
+        didPass = (bool) ( rbtree_insert(handle, (void *)(uintptr_t)( i + 1U ), &key) == RBTREE_STATUS_OK );
+    }
+    
+    for ( uint32_t i=3U; ( i<=1000U ) && didPass; i+=3U )
+    {
+        didPass = (bool) ( rbtree_deleteByKey(handle, i) == RBTREE_STATUS_OK );
+    }
+    
+    for ( uint32_t i=0U; ( i<=1001U ) && didPass; i++ )
+    {
+        bool isStored = (bool) ( rbtree_retrieveByKey(handle, i, &value) == RBTREE_STATUS_OK );
+        
+        if ( ( rbtree_inline_retrieveByKey(&tree, i, &inlineValue) != isStored ) || ( rbtree_inline_doesKeyExist(&tree, i) != isStored )
+          || ( ( isStored ) && ( inlineValue != value ) ) )
+        {
+            printf("inline lookup of key:%u disagrees\n", i);
+            didPass = false;
+        }
+    }
+    
+    for ( node = rbtree_inline_cursorFirst(&tree, &cursor); ( node != NULL ) && didPass; node = rbtree_inline_cursorNext(&cursor) )
+    {
+        if ( ( rbtree_retrieveByIndex(handle, count, &value, &key) != RBTREE_STATUS_OK ) || ( node->key != key ) || ( node->value != value ) )
+        {
+            printf("inline cursor at:%u out of order\n", count);
+            didPass = false;
+        }
+        
+        count++;
+    }
+    
+    if ( ( didPass ) && ( count != 667U ) )
+    {
+        printf("inline cursor visited:%u\n", count);
+        didPass = false;
+    }
+    
+    if ( didPass )
+    {
+        node = rbtree_inline_cursorSeek(&tree, &cursor, 3U);
+        didPass = (bool) ( ( node != NULL ) && ( node->key == 4U ) && ( rbtree_inline_cursorNode(&cursor) == node )
+                        && ( rbtree_inline_cursorNext(&cursor)->key == 5U ) && ( rbtree_inline_cursorNext(&cursor)->key == 7U )
+                        && ( rbtree_inline_cursorSeek(&tree, &cursor, 1001U) == NULL ) && ( rbtree_inline_cursorNext(&cursor) == NULL ) );
+        
+        if ( didPass == false )
+        {
+            printf("inline cursor seek failed\n");
+        }
+    }
+    
+    /* a snapshot keeps its version while the tree moves on */
+    if ( ( didPass ) && ( persistent ) )
+    {
+        didPass = (bool) ( ( rbtree_snapshot(handle, &snapshot) == RBTREE_STATUS_OK )
+                        && ( rbtree_getInlineTree(snapshot, &snapTree) == RBTREE_STATUS_OK )
+                        && ( rbtree_deleteByKey(handle, 1U) == RBTREE_STATUS_OK )
+                        && ( rbtree_inline_doesKeyExist(&tree, 1U) == false )
+                        && ( rbtree_inline_doesKeyExist(&snapTree, 1U) ) );
+        
+        if ( didPass == false )
+        {
+            printf("inline lookup in a snapshot failed\n");
+        }
+    }
+    
+    if ( snapshot != RBTREE_HANDLE_INVALID )
+    {
+        rbtree_destroyTree(snapshot);
+    }
+    
+    if ( handle != RBTREE_HANDLE_INVALID )
+    {
+        rbtree_destroyTree(handle);
+    }
+    
+    return didPass;
+}
+
+bool test_rbtree_inline ( void )
+{
+    bool didPass = false;
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_HANDLE image = RBTREE_HANDLE_INVALID;
+    RBTREE_INLINE_TREE tree;
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    FILE * fp = tmpfile();
+    
+    if ( ! test_rbtree_inlineMode(false) )
+    {
+        printf("standard inline lookups failed\n");
+    }
+    else if ( ! test_rbtree_inlineMode(true) )
+    {
+        printf("persistent inline lookups failed\n");
+    }
+    else if ( ( fp == NULL ) || ( rbtree_createTree(&handle,NULL,NULL) != RBTREE_STATUS_OK ) )
+    {
+        printf("create failed\n");
+    }
+    else if ( ( rbtree_getInlineTree(RBTREE_HANDLE_INVALID, &tree) != RBTREE_STATUS_FAIL_INVALID_PARAM )
+           || ( rbtree_getInlineTree(handle, NULL) != RBTREE_STATUS_FAIL_INVALID_PARAM ) )
+    {
+        printf("getInlineTree param checks failed\n");
+    }
+    else if ( ( rbtree_insert(handle, (void *)(uintptr_t)1U, &key) != RBTREE_STATUS_OK )
+           || ( rbtree_exportImage(handle, fileno(fp), NULL, NULL) != RBTREE_STATUS_OK )
+           || ( rbtree_openImage(&image, fileno(fp), NULL, NULL) != RBTREE_STATUS_OK ) )
+    {
+        printf("image setup failed\n");
+    }
+    else if ( rbtree_getInlineTree(image, &tree) != RBTREE_STATUS_FAIL_NOT_SUPPORTED )
+    {
+        printf("getInlineTree accepted an image\n");
+    }
+    else
+    {
+        didPass = true;
+    }
+    
+    if ( image != RBTREE_HANDLE_INVALID )
+    {
+        rbtree_destroyTree(image);
+    }
+    
+    if ( handle != RBTREE_HANDLE_INVALID )
+    {
+        rbtree_destroyTree(handle);
+    }
+    
+    if ( fp )
+    {
+        fclose(fp);
+    }
+    
+    return didPass;
+}
+
+typedef struct
+{
+    uint32_t key;
+    uint32_t hits;
+    char tag[12];
+} TEST_RBTREE_GEN_RECORD;
+
+#define TEST_RBTREE_GEN_CMP_DESC(a,b) RBTREE_GEN_CMP_NUM(b,a)
+
+RBTREE_GENERATE(test_rbtree_genRecords, uint32_t, TEST_RBTREE_GEN_RECORD, RBTREE_GEN_CMP_NUM)
+RBTREE_GENERATE(test_rbtree_genDesc, int64_t, int, TEST_RBTREE_GEN_CMP_DESC)
+RBTREE_GENERATE(test_rbtree_genNames, const char *, uint32_t, strcmp)
+
+static bool test_rbtree_genRecords ( void )
+{
+    bool didPass = true;
+    test_rbtree_genRecords_tree tree;
+    test_rbtree_genRecords_node * node = NULL;
+    TEST_RBTREE_GEN_RECORD record;
+    TEST_RBTREE_GEN_RECORD * stored = NULL;
+    bool isStored[512] = { false };
+    uint32_t storedCount = 0U;
+    uint32_t count = 0U;
+    uint32_t lastKey = 0U;
+    
+    test_rbtree_genRecords_init(&tree);
+    
+    /* mixed inserts & deletes checked against a plain array, the whole tree validated every 64 */
+    for ( uint32_t i=0U; ( i<20000U ) && didPass; i++ )
+    {
+        uint32_t key = RANDOM_UINT32_RANGE(0U, 511U);
+        RBTREE_STATUS status = RBTREE_STATUS_UNDEF;
+    
+        if ( RANDOM_UINT32_RANGE(0U, 2U) != 0U )
+        {
+            memset(&record, 0, sizeof(record));
+            record.key = key;
+            snprintf(record.tag, sizeof(record.tag), "k%u", key);
+    
+            status = test_rbtree_genRecords_insert(&tree, key, record);
+            didPass = (bool) ( status == ( isStored[key] ? RBTREE_STATUS_FAIL_KEY_ALREADY_STORED : RBTREE_STATUS_OK ) );
+            storedCount += isStored[key] ? 0U : 1U;
+            isStored[key] = true;
+        }
+        else
+        {
+            record.key = UINT32_MAX;
+            status = test_rbtree_genRecords_delete(&tree, key, &record);
+            didPass = (bool) ( isStored[key] ? ( ( status == RBTREE_STATUS_OK ) && ( record.key == key ) )
+                                             : ( status == RBTREE_STATUS_FAIL_KEY_DOES_NOT_EXIST ) );
+            storedCount -= isStored[key] ? 1U : 0U;
+            isStored[key] = false;
+        }
+    
+        if ( ( didPass ) && ( ( i % 64U ) == 0U ) )
+        {
+            didPass = (bool) ( ( test_rbtree_genRecords_validate(&tree) == RBTREE_STATUS_OK ) && ( test_rbtree_genRecords_count(&tree) == storedCount ) );
+        }
+    
+        if ( didPass == false )
+        {
+            printf("generated tree op:%u key:%u failed\n", i, key);
+        }
+    }
+    
+    /* values live in the node, so a retrieved pointer updates in place */
+    for ( uint32_t key=0U; ( key<512U ) && didPass; key++ )
+    {
+        stored = test_rbtree_genRecords_retrieve(&tree, key);
+    
+        if ( ( stored != NULL ) != isStored[key] )
+        {
+            printf("generated tree retrieve key:%u disagrees\n", key);
+            didPass = false;
+        }
+        else if ( stored )
+        {
+            stored->hits++;
+        }
+    }
+    
+    for ( node = test_rbtree_genRecords_first(&tree); ( node != NULL ) && didPass; node = test_rbtree_genRecords_next(node) )
+    {
+        char tag[12];
+    
+        snprintf(tag, sizeof(tag), "k%u", node->key);
+    
+        if ( ( node->value.key != node->key ) || ( node->value.hits != 1U ) || ( strcmp(node->value.tag, tag) != 0 )
+          || ( ( count > 0U ) && ( node->key <= lastKey ) ) )
+        {
+            printf("generated tree walk at key:%u failed\n", node->key);
+            didPass = false;
+        }
+    
+        lastKey = node->key;
+        count++;
+    }
+    
+    /* and back down again */
+    for ( node = test_rbtree_genRecords_last(&tree); ( node != NULL ) && didPass; node = test_rbtree_genRecords_prev(node) )
+    {
+        if ( ( count < storedCount ) && ( node->key >= lastKey ) )
+        {
+            printf("generated tree reverse walk at key:%u failed\n", node->key);
+            didPass = false;
+        }
+    
+        lastKey = node->key;
+        count--;
+    }
+    
+    if ( ( didPass ) && ( count != 0U ) )
+    {
+        printf("generated tree walks disagree with count:%u\n", storedCount);
+        didPass = false;
+    }
+    
+    test_rbtree_genRecords_destroy(&tree);
+    
+    if ( ( didPass ) && ( ( test_rbtree_genRecords_count(&tree) != 0U ) || ( test_rbtree_genRecords_first(&tree) != NULL ) ) )
+    {
+        printf("generated tree not empty after destroy\n");
+        didPass = false;
+    }
+    
+    return didPass;
+}
+
+bool test_rbtree_gen ( void )
+{
+    bool didPass = false;
+    test_rbtree_genDesc_tree desc;
+    test_rbtree_genNames_tree names;
+    test_rbtree_genDesc_node * descNode = NULL;
+    test_rbtree_genNames_node * namesNode = NULL;
+    const char * words[] = { "pear", "apple", "fig", "plum", "cherry", "date" };
+    char lookup[8] = "fig";
+    int value = 0;
+    
+    test_rbtree_genDesc_init(&desc);
+    test_rbtree_genNames_init(&names);
+    
+    /* descending int64's, both ends of the range */
+    for ( int64_t key=-1000; key<=1000; key+=7 )
+    {
+        (void)test_rbtree_genDesc_insert(&desc, key * 1000000007LL, (int)key);
+    }
+    
+    (void)test_rbtree_genDesc_insert(&desc, INT64_MIN, -1);
+    (void)test_rbtree_genDesc_insert(&desc, INT64_MAX, 1);
+    descNode = test_rbtree_genDesc_first(&desc);
+    
+    for ( uint32_t i=0U; i<(uint32_t)( sizeof(words) / sizeof(words[0]) ); i++ )
+    {
+        (void)test_rbtree_genNames_insert(&names, words[i], i);
+    }
+    
+    namesNode = test_rbtree_genNames_first(&names);
+    
+    if ( ! test_rbtree_genRecords() )
+    {
+        printf("generated record tree failed\n");
+    }
+    else if ( ( test_rbtree_genDesc_validate(&desc) != RBTREE_STATUS_OK ) || ( test_rbtree_genDesc_count(&desc) != 288U )
+           || ( descNode->key != INT64_MAX ) || ( test_rbtree_genDesc_next(descNode)->value != 995 )
+           || ( test_rbtree_genDesc_last(&desc)->key != INT64_MIN ) )
+    {
+        printf("generated descending tree out of order\n");
+    }
+    else if ( ( test_rbtree_genDesc_delete(&desc, 995LL * 1000000007LL, &value) != RBTREE_STATUS_OK ) || ( value != 995 )
+           || ( test_rbtree_genDesc_delete(&desc, 995LL * 1000000007LL, NULL) != RBTREE_STATUS_FAIL_KEY_DOES_NOT_EXIST )
+           || ( test_rbtree_genDesc_validate(&desc) != RBTREE_STATUS_OK ) )
+    {
+        printf("generated descending tree delete failed\n");
+    }
+    /* keys compared by content, not by pointer */
+    else if ( ( test_rbtree_genNames_validate(&names) != RBTREE_STATUS_OK ) || ( strcmp(namesNode->key, "apple") != 0 )
+           || ( strcmp(test_rbtree_genNames_next(namesNode)->key, "cherry") != 0 ) || ( strcmp(test_rbtree_genNames_last(&names)->key, "plum") != 0 )
+           || ( test_rbtree_genNames_retrieve(&names, lookup) == NULL ) || ( *test_rbtree_genNames_retrieve(&names, lookup) != 2U )
+           || ( test_rbtree_genNames_retrieve(&names, "kiwi") != NULL )
+           || ( test_rbtree_genNames_insert(&names, lookup, 9U) != RBTREE_STATUS_FAIL_KEY_ALREADY_STORED ) )
+    {
+        printf("generated string tree failed\n");
+    }
+    else
+    {
+        didPass = true;
+    }
+    
+    test_rbtree_genDesc_destroy(&desc);
+    test_rbtree_genNames_destroy(&names);
+    
+    return didPass;
+}
+
+typedef struct
+{
+    uint32_t id;
+    double weight;
+    char name[36];
+} TEST_RBTREE_VALUE_RECORD;
+
+static uint32_t test_rbtree_valueAllocs = 0U;
+static size_t test_rbtree_valueAllocSize = 0U;
+
+static void * test_rbtree_valueAlloc ( size_t size )
+{
+    test_rbtree_valueAllocs++;
+    test_rbtree_valueAllocSize = size;
+    
+    return malloc(size);
+}
+
+static bool test_rbtree_valueMatch ( void * storevalue, void * userdata )
+{
+    return (bool) ( ((TEST_RBTREE_VALUE_RECORD *)storevalue)->id == *(uint32_t *)userdata );
+}
+
+bool test_rbtree_valueTree ( void )
+{
+    bool didPass = false;
+    RBTREE_HANDLE handle = RBTREE_HANDLE_INVALID;
+    RBTREE_HANDLE copy = RBTREE_HANDLE_INVALID;
+    RBTREE_HANDLE pointers = RBTREE_HANDLE_INVALID;
+    TEST_RBTREE_VALUE_RECORD record;
+    TEST_RBTREE_VALUE_RECORD copied;
+    void * found = NULL;
+    RBTREE_KEY key = RBTREE_KEY_INVALID;
+    RBTREE_KEY first = RBTREE_KEY_INVALID;
+    RBTREE_KEY foundKey = RBTREE_KEY_INVALID;
+    uint32_t count = 0U;
+    uint32_t id = 0U;
+    FILE * fp = tmpfile();
+    
+    if ( ( rbtree_createValueTree(NULL, sizeof(record), NULL, NULL) != RBTREE_STATUS_FAIL_INVALID_PARAM )
+      || ( rbtree_createValueTree(&handle, 0U, NULL, NULL) != RBTREE_STATUS_FAIL_INVALID_PARAM )
+      || ( rbtree_createValueTree(&handle, RBTREE_VALUE_SIZE_MAX + 1U, NULL, NULL) != RBTREE_STATUS_FAIL_INVALID_PARAM ) )
+    {
+        printf("createValueTree param checks failed\n");
+    }
+    else if ( ( fp == NULL ) || ( rbtree_createValueTree(&handle, sizeof(record), test_rbtree_valueAlloc, NULL) != RBTREE_STATUS_OK )
+           || ( rbtree_createTree(&pointers, NULL, NULL) != RBTREE_STATUS_OK ) )
+    {
+        printf("create failed\n");
+    }
+    else if ( ( rbtree_insert(handle, NULL, &key) != RBTREE_STATUS_FAIL_INVALID_PARAM )
+           || ( rbtree_retrieveValue(handle, 1U, NULL) != RBTREE_STATUS_FAIL_INVALID_PARAM )
+           || ( rbtree_retrieveValue(pointers, 1U, &copied) != RBTREE_STATUS_FAIL_NOT_SUPPORTED ) )
+    {
+        printf("value tree param checks failed\n");
+    }
+    /* decoders hand back values of their own */
+    else if ( ( rbtree_loadFromFd(handle, fileno(fp), NULL, NULL) != RBTREE_STATUS_FAIL_NOT_SUPPORTED )
+           || ( rbtree_replayLog(handle, fileno(fp), NULL, NULL) != RBTREE_STATUS_FAIL_NOT_SUPPORTED ) )
+    {
+        printf("value tree decode checks failed\n");
+    }
+    else
+    {
+        test_rbtree_valueAllocs = 0U;
+        didPass = true;
+    }
+    
+    /* the same local is overwritten for every insert, the tree keeps its own copies */
+    for ( uint32_t i=1U; ( i<=1000U ) && didPass; i++ )
+    {
+        memset(&record, 0, sizeof(record));
+        record.id = i;
+        record.weight = (double)i / 4.0;
+        snprintf(record.name, sizeof(record.name), "record %u", i);
+    
+        didPass = (bool) ( ( rbtree_insert(handle, &record, &key) == RBTREE_STATUS_OK ) && ( key == i ) );
+    }
+    
+    if ( ( didPass ) && ( ( test_rbtree_valueAllocs != 1000U ) || ( test_rbtree_valueAllocSize < sizeof(record) ) ) )
+    {
+        printf("value tree made %u allocations of %u\n", test_rbtree_valueAllocs, (uint32_t)test_rbtree_valueAllocSize);
+        didPass = false;
+    }
+    
+    for ( uint32_t i=1U; ( i<=1000U ) && didPass; i++ )
+    {
+        char name[36];
+    
+        snprintf(name, sizeof(name), "record %u", i);
+    
+        if ( ( rbtree_retrieveByKey(handle, i, &found) != RBTREE_STATUS_OK ) || ( rbtree_retrieveValue(handle, i, &copied) != RBTREE_STATUS_OK )
+          || ( memcmp(found, &copied, sizeof(copied)) != 0 ) || ( copied.id != i ) || ( copied.weight != (double)i / 4.0 ) || ( strcmp(copied.name, name) != 0 ) )
+        {
+            printf("value tree retrieve of key:%u failed\n", i);
+            didPass = false;
+        }
+    }
+    
+    /* encoders would only see the address in the node, nothing may reach the file */
+    if ( didPass )
+    {
+        didPass = (bool) ( ( rbtree_saveToFd(handle, fileno(fp), NULL, NULL) == RBTREE_STATUS_FAIL_NOT_SUPPORTED )
+                        && ( rbtree_attachLog(handle, fileno(fp), RBTREE_LOG_SYNC_WRITE, NULL, NULL) == RBTREE_STATUS_FAIL_NOT_SUPPORTED )
+                        && ( rbtree_checkpointAsync(handle, "/tmp/rbtree_value.ckpt", NULL, NULL, test_rbtree_checkpoint_done, NULL) == RBTREE_STATUS_FAIL_NOT_SUPPORTED )
+                        && ( rbtree_exportImage(handle, fileno(fp), NULL, NULL) == RBTREE_STATUS_FAIL_NOT_SUPPORTED )
+                        && ( rbtree_insert(handle, &record, &key) == RBTREE_STATUS_OK ) && ( rbtree_deleteByKey(handle, key) == RBTREE_STATUS_OK )
+                        && ( lseek(fileno(fp), 0, SEEK_END) == 0 ) && ( access("/tmp/rbtree_value.ckpt", F_OK) != 0 ) );
+    
+        if ( didPass == false )
+        {
+            printf("value tree save, log, checkpoint & export checks failed\n");
+        }
+    }
+    
+    /* the pointer is to the value in the node, the copy outlives the entry */
+    if ( didPass )
+    {
+        didPass = (bool) ( rbtree_retrieveByKey(handle, 10U, &found) == RBTREE_STATUS_OK );
+    }
+    
+    if ( didPass )
+    {
+        ((TEST_RBTREE_VALUE_RECORD *)found)->weight = -1.0;
+    
+        didPass = (bool) ( ( rbtree_retrieveValue(handle, 10U, &copied) == RBTREE_STATUS_OK ) && ( copied.weight == -1.0 )
+                        && ( rbtree_deleteByKey(handle, 10U) == RBTREE_STATUS_OK ) && ( copied.id == 10U )
+                        && ( rbtree_retrieveValue(handle, 10U, &copied) == RBTREE_STATUS_FAIL_KEY_DOES_NOT_EXIST ) );
+    
+        if ( didPass == false )
+        {
+            printf("value tree in place update failed\n");
+        }
+    }
+    
+    /* comparators & deleteByValue see the pointer into the node */
+    if ( didPass )
+    {
+        id = 500U;
+        didPass = (bool) ( ( rbtree_find(handle, test_rbtree_valueMatch, &id, &found, &foundKey) == RBTREE_STATUS_OK ) && ( foundKey == 500U )
+                        && ( rbtree_deleteByValue(handle, found) == RBTREE_STATUS_OK )
+                        && ( rbtree_retrieveByKey(handle, 500U, &found) == RBTREE_STATUS_FAIL_KEY_DOES_NOT_EXIST ) );
+    
+        if ( didPass == false )
+        {
+            printf("value tree find & delete by value failed\n");
+        }
+    }
+    
+    if ( didPass )
+    {
+        memset(&record, 0, sizeof(record));
+        record.id = 2000U;
+    
+        didPass = (bool) ( ( rbtree_reserveKeys(handle, 4U, &first) == RBTREE_STATUS_OK )
+                        && ( rbtree_insertReserved(handle, &record, first + 2U) == RBTREE_STATUS_OK )
+                        && ( rbtree_insertReserved(handle, NULL, first + 3U) == RBTREE_STATUS_FAIL_INVALID_PARAM )
+                        && ( rbtree_retrieveValue(handle, first + 2U, &copied) == RBTREE_STATUS_OK ) && ( copied.id == 2000U ) );
+    
+        if ( didPass == false )
+        {
+            printf("value tree reserved insert failed\n");
+        }
+    }
+    
+    /* copies only between trees storing values of the same size */
+    if ( didPass )
+    {
+        didPass = (bool) ( ( rbtree_createValueTree(&copy, sizeof(record), NULL, NULL) == RBTREE_STATUS_OK )
+                        && ( rbtree_copyInTree(copy, handle) == RBTREE_STATUS_OK )
+                        && ( rbtree_entryCount(copy, &count) == RBTREE_STATUS_OK ) && ( count == 999U )
+                        && ( rbtree_retrieveValue(copy, 1U, &copied) == RBTREE_STATUS_OK ) && ( copied.id == 1U )
+                        && ( rbtree_copyInTree(pointers, handle) == RBTREE_STATUS_FAIL_INVALID_PARAM )
+                        && ( rbtree_copyInTree(handle, pointers) == RBTREE_STATUS_FAIL_INVALID_PARAM ) );
+    
+        if ( didPass == false )
+        {
+            printf("value tree copy failed\n");
+        }
+    }
+    
+    if ( copy != RBTREE_HANDLE_INVALID )
+    {
+        rbtree_destroyTree(copy);
+    }
+    
+    if ( pointers != RBTREE_HANDLE_INVALID )
+    {
+        rbtree_destroyTree(pointers);
+    }
+    
+    if ( handle != RBTREE_HANDLE_INVALID )
+    {
+        rbtree_destroyTree(handle);
+    }
+    
+    if ( fp )
+    {
+        fclose(fp);
+    }
+    
+    return didPass;
+}
+
+bool test_rbtree ( void )
+{
+    bool didPass = false;
+    
+    if ( ! test_rbtree_nullParam() )
+    {
+        printf("test_rbtree_nullParam() failed\n");
+    }
+    else if ( ! test_rbtree_createEmpty() )
+    {
+        printf("test_rbtree_linearInsertDeletion() failed\n");
+    }
+    else if ( ! test_rbtree_singleCycle() )
+    {
+        printf("test_rbtree_singleCycle() failed\n");
+    }
+    else if ( ! test_rbtree_linearInsertDeletion() )
+    {
+        printf("test_rbtree_linearInsertDeletion() failed\n");
+    }
+    else if ( ! test_rbtree_linearInsertRandomDeletion() )
+    {
+        printf("test_rbtree_linearInsertRandomDeletion() failed\n");
+    }
+    else if ( ! test_rbtree_randomInsertion() )
+    {
+        printf("test_rbtree_randomInsertion() failed\n");
+    }
+    else if ( ! test_rbtree_indexApi() )
+    {
+        printf("test_rbtree_linearInsertRandomDeletion() failed\n");
+    }
+    else if ( ! test_rbtree_customMemoryManagers() )
+    {
+        printf("test_rbtree_customMemoryManagers() failed\n");
+        
+    }
+    else if ( ! test_rbtree_mergeTrees() )
+    {
+        printf("test_rbtree_mergeTrees() failed\n");
+    }
+    else if ( ! test_rbtree_reserveKeys() )
+    {
+        printf("test_rbtree_reserveKeys() failed\n");
+    }
+    else if ( ! test_rbtree_persistentSnapshot() )
+    {
+        printf("test_rbtree_persistentSnapshot() failed\n");
+    }
+    else if ( ! test_rbtree_versions() )
+    {
+        printf("test_rbtree_versions() failed\n");
+    }
+    else if ( ! test_rbtree_parallel() )
+    {
+        printf("test_rbtree_parallel() failed\n");
+    }
+    else if ( ! test_rbtree_serialize() )
+    {
+        printf("test_rbtree_serialize() failed\n");
+    }
+    else if ( ! test_rbtree_image() )
+    {
+        printf("test_rbtree_image() failed\n");
+    }
+    else if ( ! test_rbtree_log() )
+    {
+        printf("test_rbtree_log() failed\n");
+    }
+    else if ( ! test_rbtree_checkpoint() )
+    {
+        printf("test_rbtree_checkpoint() failed\n");
+    }
+    else if ( ! test_rbtree_shared() )
+    {
+        printf("test_rbtree_shared() failed\n");
+    }
+    else if ( ! test_rbtree_mapped() )
+    {
+        printf("test_rbtree_mapped() failed\n");
+    }
+    else if ( ! test_rbtree_stats() )
+    {
+        printf("test_rbtree_stats() failed\n");
+    }
+    else if ( ! test_rbtree_latency() )
+    {
+        printf("test_rbtree_latency() failed\n");
+    }
+    else if ( ! test_rbtree_lockProfile() )
+    {
+        printf("test_rbtree_lockProfile() failed\n");
+    }
+    else if ( ! test_rbtree_trace() )
+    {
+        printf("test_rbtree_trace() failed\n");
+    }
+    else if ( ! test_rbtree_inline() )
+    {
+        printf("test_rbtree_inline() failed\n");
+    }
+    else if ( ! test_rbtree_map() )
+    {
+        printf("test_rbtree_map() failed\n");
+    }
+    else if ( ! test_rbtree_gen() )
+    {
+        printf("test_rbtree_gen() failed\n");
+    }
+    else if ( ! test_rbtree_valueTree() )
+    {
+        printf("test_rbtree_valueTree() failed\n");
     }
     else
     {
@@ -4,6 +4,17 @@
 
 #include <stdbool.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 bool test_rbtree ( void );
 
+/* test_rbtree_map.cpp, the C++ layer */
+bool test_rbtree_map ( void );
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* _TEST_RBTREELIB_H */
@@ -0,0 +1,447 @@
+
+
+#include "test_rbtree.h"
+#include "rbtree.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <numeric>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#include <functional>
+
+
+/* counts how an entry was made, emplace must build it in the node without copies or moves */
+struct test_rbtree_map_tracked
+{
+    static int copies;
+    static int moves;
+    static int live;
+
+    int a;
+    std::string b;
+
+    test_rbtree_map_tracked ( int x, const char * y ) : a(x), b(y) { live++; }
+    test_rbtree_map_tracked ( const test_rbtree_map_tracked & other ) : a(other.a), b(other.b) { copies++; live++; }
+    test_rbtree_map_tracked ( test_rbtree_map_tracked && other ) : a(other.a), b(std::move(other.b)) { moves++; live++; }
+    ~test_rbtree_map_tracked ( ) { live--; }
+};
+
+int test_rbtree_map_tracked::copies = 0;
+int test_rbtree_map_tracked::moves = 0;
+int test_rbtree_map_tracked::live = 0;
+
+/* std::allocator that counts the blocks it has out */
+template < typename T >
+struct test_rbtree_map_allocator
+{
+    typedef T value_type;
+
+    long * outstanding;
+
+    explicit test_rbtree_map_allocator ( long * counter ) : outstanding(counter) { }
+    template < typename U > test_rbtree_map_allocator ( const test_rbtree_map_allocator<U> & other ) : outstanding(other.outstanding) { }
+
+    T * allocate ( std::size_t n )
+    {
+        (*outstanding)++;
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate ( T * p, std::size_t n )
+    {
+        (*outstanding)--;
+        std::allocator<T>().deallocate(p, n);
+    }
+
+    template < typename U > bool operator== ( const test_rbtree_map_allocator<U> & other ) const { return outstanding == other.outstanding; }
+    template < typename U > bool operator!= ( const test_rbtree_map_allocator<U> & other ) const { return outstanding != other.outstanding; }
+};
+
+
+/* random inserts & erases checked against std::map after every step */
+static bool test_rbtree_map_againstStdMap ( uint32_t size )
+{
+    bool didPass = true;
+    rbtree::map<uint32_t, uint32_t> tree;
+    std::map<uint32_t, uint32_t> reference;
+
+    for ( uint32_t i=0U; ( i<size*4U ) && didPass; i++ )
+    {
+        uint32_t key = (uint32_t)( rand() % (int)size );
+
+        if ( rand() % 3 )
+        {
+            didPass = ( tree.try_emplace(key, i).second == reference.emplace(key, i).second );
+        }
+        else
+        {
+            didPass = ( tree.erase(key) == reference.erase(key) );
+        }
+    }
+
+    if ( ( didPass ) && ( tree.size() == reference.size() ) )
+    {
+        std::map<uint32_t, uint32_t>::const_iterator it = reference.begin();
+
+        tree.for_each([&] ( const std::pair<const uint32_t, uint32_t> & entry )
+        {
+            if ( ( it == reference.end() ) || ( it->first != entry.first ) || ( it->second != entry.second ) )
+            {
+                didPass = false;
+            }
+            else
+            {
+                ++it;
+            }
+        });
+    }
+    else
+    {
+        didPass = false;
+    }
+
+    if ( didPass == false )
+    {
+        printf("rbtree::map of %u disagrees with std::map\n", size);
+    }
+
+    return didPass;
+}
+
+static bool test_rbtree_map_inPlace ( void )
+{
+    bool didPass = false;
+
+    {
+        rbtree::map<int, test_rbtree_map_tracked> tree;
+
+        test_rbtree_map_tracked::copies = 0;
+        test_rbtree_map_tracked::moves = 0;
+
+        for ( int i=0; i<100; i++ )
+        {
+            tree.try_emplace(i, i * 2, "value");
+        }
+
+        /* a duplicate built by emplace is destroyed again, try_emplace never builds one */
+        tree.emplace(std::piecewise_construct, std::forward_as_tuple(5), std::forward_as_tuple(0, "dup"));
+        tree.try_emplace(6, 0, "dup");
+
+        if ( ( test_rbtree_map_tracked::copies != 0 ) || ( test_rbtree_map_tracked::moves != 0 ) )
+        {
+            printf("emplace copied:%d moved:%d\n", test_rbtree_map_tracked::copies, test_rbtree_map_tracked::moves);
+        }
+        else if ( ( test_rbtree_map_tracked::live != 100 ) || ( tree.at(5).a != 10 ) || ( tree.at(6).b != "value" ) )
+        {
+            printf("emplace replaced or leaked an entry\n");
+        }
+        else
+        {
+            didPass = true;
+        }
+    }
+
+    if ( ( didPass ) && ( test_rbtree_map_tracked::live != 0 ) )
+    {
+        printf("entries leaked:%d\n", test_rbtree_map_tracked::live);
+        didPass = false;
+    }
+
+    return didPass;
+}
+
+static bool test_rbtree_map_api ( void )
+{
+    bool didPass = false;
+    bool didThrow = false;
+    rbtree::map<std::string, int> tree;
+    rbtree::map<std::string, int>::iterator entry;
+    int sum = 0;
+
+    tree["b"] = 2;
+    tree["a"] = 1;
+    tree.insert(std::make_pair(std::string("c"), 3));
+    tree.emplace("d", 4);
+
+    try
+    {
+        tree.at("missing");
+    }
+    catch ( const std::out_of_range & )
+    {
+        didThrow = true;
+    }
+
+    entry = tree.find_if([] ( const std::pair<const std::string, int> & e ) { return ( e.second % 2 ) == 0; });
+    tree.for_each([&sum] ( std::pair<const std::string, int> & e ) { sum = ( sum * 10 ) + e.second; });
+
+    if ( ( tree.size() != 4U ) || ( tree.empty() ) || ( tree.find("c")->second != 3 ) || ( tree.find("z") != tree.end() ) || ( ! tree.contains("a") ) )
+    {
+        printf("rbtree::map lookups failed\n");
+    }
+    else if ( ( didThrow == false ) || ( entry == tree.end() ) || ( entry->first != "b" ) || ( sum != 1234 ) )
+    {
+        printf("rbtree::map at/find_if/for_each failed\n");
+    }
+    else if ( ( tree.insert(std::make_pair(std::string("a"), 9)).second ) || ( tree["a"] != 1 ) || ( tree.erase("a") != 1U ) || ( tree.erase("a") != 0U ) )
+    {
+        printf("rbtree::map insert/erase of a stored key failed\n");
+    }
+    else
+    {
+        rbtree::map<std::string, int> copy(tree);
+        rbtree::map<std::string, int> moved(std::move(copy));
+        rbtree::map<std::string, int> assigned;
+
+        moved["b"] = 20;
+        assigned = moved;
+        assigned.erase("c");
+
+        didPass = ( ( copy.empty() ) && ( tree["b"] == 2 ) && ( moved.size() == 3U ) && ( assigned.size() == 2U ) && ( assigned["b"] == 20 ) );
+
+        swap(tree, assigned);
+        didPass = ( ( didPass ) && ( tree.size() == 2U ) && ( assigned.size() == 3U ) );
+
+        if ( didPass == false )
+        {
+            printf("rbtree::map copy/move/swap failed\n");
+        }
+    }
+
+    return didPass;
+}
+
+static bool test_rbtree_map_iterators ( void )
+{
+    bool didPass = false;
+    rbtree::map<int, int> tree = { { 5, 50 }, { 1, 10 }, { 3, 30 }, { 9, 90 }, { 7, 70 } };
+    const rbtree::map<int, int> & constTree = tree;
+    rbtree::map<int, int>::const_iterator last = constTree.end();
+    std::vector<int> reversed;
+    int sum = 0;
+
+    for ( auto & entry : tree )
+    {
+        entry.second++;
+    }
+
+    for ( const auto & entry : constTree )
+    {
+        sum += entry.second;
+    }
+
+    for ( auto it = tree.rbegin(); it != tree.rend(); ++it )
+    {
+        reversed.push_back(it->first);
+    }
+
+    --last;
+
+    if ( ( sum != 255 ) || ( std::distance(tree.begin(), tree.end()) != 5 ) || ( reversed != std::vector<int>({ 9, 7, 5, 3, 1 }) ) || ( last->first != 9 ) )
+    {
+        printf("rbtree::map iteration failed\n");
+    }
+    else if ( ( tree.lower_bound(5)->first != 5 ) || ( tree.lower_bound(6)->first != 7 ) || ( tree.upper_bound(5)->first != 7 )
+           || ( tree.upper_bound(9) != tree.end() ) || ( tree.count(3) != 1U ) || ( tree.count(4) != 0U ) )
+    {
+        printf("rbtree::map bounds failed\n");
+    }
+    else if ( ( std::accumulate(tree.begin(), tree.end(), 0, [] ( int acc, const std::pair<const int, int> & e ) { return acc + e.first; }) != 25 )
+           || ( std::find_if(tree.cbegin(), tree.cend(), [] ( const std::pair<const int, int> & e ) { return e.second > 60; })->first != 7 ) )
+    {
+        printf("rbtree::map with <algorithm> failed\n");
+    }
+    else
+    {
+        rbtree::map<int, int> copy(tree.begin(), tree.end());
+
+        /* erase returns the next entry, so erasing while walking is safe */
+        for ( auto it = tree.begin(); it != tree.end(); )
+        {
+            it = ( it->first % 3 ) ? tree.erase(it) : std::next(it);
+        }
+
+        didPass = ( ( tree.size() == 2U ) && ( tree.begin()->first == 3 ) && ( std::prev(tree.end())->first == 9 ) && ( copy != tree ) );
+
+        copy.erase(copy.find(1), copy.find(9));
+        copy.erase(7);
+        didPass = ( ( didPass ) && ( copy.size() == 1U ) && ( copy.begin()->first == 9 ) );
+
+        if ( didPass == false )
+        {
+            printf("rbtree::map erase through iterators failed\n");
+        }
+    }
+
+    return didPass;
+}
+
+/* std::inserter goes through the hinted insert, a hint never changes where an entry lands or replaces one */
+static bool test_rbtree_map_inserters ( void )
+{
+    bool didPass = false;
+    std::map<int, std::string> source = { { 4, "four" }, { 2, "two" }, { 8, "eight" } };
+    std::vector<std::pair<int, std::string>> more = { { 1, "one" }, { 2, "again" }, { 6, "six" } };
+    rbtree::map<int, std::string> tree = { { 5, "five" } };
+    rbtree::map<int, std::string>::iterator emplaced;
+    rbtree::map<int, std::string>::iterator existing;
+    std::vector<int> keys;
+
+    std::copy(source.begin(), source.end(), std::inserter(tree, tree.end()));
+    std::copy(more.begin(), more.end(), std::inserter(tree, tree.begin()));
+    emplaced = tree.emplace_hint(tree.cend(), 3, "three");
+    existing = tree.emplace_hint(tree.cbegin(), 8, "again");
+
+    std::transform(tree.begin(), tree.end(), std::back_inserter(keys), [] ( const std::pair<const int, std::string> & e ) { return e.first; });
+
+    if ( ( keys != std::vector<int>({ 1, 2, 3, 4, 5, 6, 8 }) ) || ( tree.find(2)->second != "two" ) )
+    {
+        printf("rbtree::map std::inserter failed\n");
+    }
+    else if ( ( emplaced->first != 3 ) || ( emplaced->second != "three" ) || ( existing->second != "eight" )
+           || ( tree.insert(tree.cbegin(), std::make_pair(9, std::string("nine")))->first != 9 )
+           || ( tree.insert(tree.cend(), *tree.find(1))->second != "one" ) || ( tree.size() != 8U ) )
+    {
+        printf("rbtree::map hinted insert failed\n");
+    }
+    else
+    {
+        didPass = true;
+    }
+
+    return didPass;
+}
+
+#ifdef RBTREE_HPP_PMR
+/* entries & the strings in them come from the arena, nothing from the default resource */
+static bool test_rbtree_map_pmr ( void )
+{
+    bool didPass = false;
+    static unsigned char buffer[1024U * 1024U];
+    std::pmr::monotonic_buffer_resource arena(buffer, sizeof(buffer), std::pmr::null_memory_resource());
+    std::pmr::memory_resource * defaultResource = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+
+    try
+    {
+        rbtree::pmr::map<int, std::pmr::string> tree(&arena);
+        rbtree::pmr::map<int, std::pmr::string> other(&arena);
+
+        for ( int i=0; i<1000; i++ )
+        {
+            tree.try_emplace(i, "a value that is too long for the small string buffer");
+        }
+
+        other = tree;
+        other.erase(other.begin(), other.find(500));
+
+        didPass = ( ( tree.size() == 1000U ) && ( other.size() == 500U ) && ( tree.at(999).get_allocator().resource() == &arena )
+                 && ( other.begin()->first == 500 ) && ( other.get_allocator().resource() == &arena ) );
+    }
+    catch ( const std::bad_alloc & )
+    {
+        printf("rbtree::pmr::map allocated outside its resource\n");
+    }
+
+    std::pmr::set_default_resource(defaultResource);
+
+    if ( didPass )
+    {
+        /* one reset hands everything back */
+        arena.release();
+    }
+    else
+    {
+        printf("rbtree::pmr::map failed\n");
+    }
+
+    return didPass;
+}
+#endif
+
+static bool test_rbtree_map_compareAndAlloc ( void )
+{
+    bool didPass = false;
+    long outstanding = 0;
+
+    {
+        test_rbtree_map_allocator< std::pair<const int, int> > alloc(&outstanding);
+        rbtree::map<int, int, std::greater<int>, test_rbtree_map_allocator< std::pair<const int, int> > > tree(std::greater<int>(), alloc);
+        int last = 1000;
+        bool isDescending = true;
+
+        for ( int i=0; i<500; i++ )
+        {
+            tree[rand() % 1000] = i;
+        }
+
+        tree.for_each([&] ( const std::pair<const int, int> & e ) { isDescending = ( isDescending && ( e.first < last ) ); last = e.first; });
+
+        if ( ( isDescending == false ) || ( outstanding != (long)tree.size() ) )
+        {
+            printf("rbtree::map compare/allocator: descending:%d nodes:%ld size:%u\n", (int)isDescending, outstanding, (unsigned)tree.size());
+        }
+        else
+        {
+            decltype(tree) copy(tree);
+
+            didPass = ( outstanding == (long)( tree.size() * 2U ) );
+            tree.clear();
+            didPass = ( ( didPass ) && ( outstanding == (long)copy.size() ) );
+        }
+    }
+
+    if ( ( didPass ) && ( outstanding != 0 ) )
+    {
+        printf("rbtree::map nodes leaked:%ld\n", outstanding);
+        didPass = false;
+    }
+
+    return didPass;
+}
+
+extern "C" bool test_rbtree_map ( void )
+{
+    bool didPass = false;
+
+    if ( ! test_rbtree_map_againstStdMap(1U) || ! test_rbtree_map_againstStdMap(64U) || ! test_rbtree_map_againstStdMap(4096U) )
+    {
+        printf("rbtree::map random operations failed\n");
+    }
+    else if ( ! test_rbtree_map_inPlace() )
+    {
+        printf("rbtree::map in place construction failed\n");
+    }
+    else if ( ! test_rbtree_map_api() )
+    {
+        printf("rbtree::map api failed\n");
+    }
+    else if ( ! test_rbtree_map_iterators() )
+    {
+        printf("rbtree::map iterators failed\n");
+    }
+    else if ( ! test_rbtree_map_inserters() )
+    {
+        printf("rbtree::map inserters failed\n");
+    }
+#ifdef RBTREE_HPP_PMR
+    else if ( ! test_rbtree_map_pmr() )
+    {
+        printf("rbtree::map pmr failed\n");
+    }
+#endif
+    else if ( ! test_rbtree_map_compareAndAlloc() )
+    {
+        printf("rbtree::map comparator & allocator failed\n");
+    }
+    else
+    {
+        didPass = true;
+    }
+
+    return didPass;
+}
@@ -1,2 +1,3 @@
-gcc -std=c99 test_main.c test_rbtree.c ../src/rbtree.c ../src/rbtree_checks.c ../src/rbtree_common.c -I ../inc -I ../src -o rbtree_test
+g++ -std=c++17 -c test_rbtree_map.cpp -I ../inc -o test_rbtree_map.o
+gcc -std=c99 test_main.c test_rbtree.c test_rbtree_map.o ../src/rbtree.c ../src/rbtree_checks.c ../src/rbtree_common.c ../src/rbtree_persist.c ../src/rbtree_mvcc.c ../src/rbtree_parallel.c ../src/rbtree_serial.c ../src/rbtree_image.c ../src/rbtree_wal.c ../src/rbtree_checkpoint.c ../src/rbtree_arena.c ../src/rbtree_stats.c ../src/rbtree_latency.c ../src/rbtree_lockprof.c ../src/rbtree_trace.c -I ../inc -I ../src -lstdc++ -o rbtree_test
 ./rbtree_test